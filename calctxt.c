@@ -23,6 +23,10 @@
 #include "plottxt.h"
 #include "insert.h"
 #include "calctxt.h"
+#include "cubegrid.h"
+#include "pvs.h"
+#include "plot.h"
+#include "do_light.h"
 
 void newcubecorners(struct node *c, int pointnum) {
     int i;
@@ -252,7 +256,12 @@ void newcorners(struct node *np) {
 
     for (nc = np->d.lp->c.head; nc->next != NULL; nc = nc->next) {
         newcubecorners(nc->d.n, nc->no);
+        setlightdirty(nc->d.n);
+        updatedescmap(nc->d.n);
     }
+
+    cg_updatepnt(l, np);
+    pvs_cubeschanged(l);
 }
 
 
@@ -33,6 +33,7 @@ struct clickhit
     struct node *data;
     int wall;
     struct point p;
+    int seq; /* which one is first if d is the same */
 };
 
 /* x0 is the start of the beam, v the direction. sx,sy are the coords of
@@ -130,183 +131,291 @@ float checkeverypnt(struct point *a, struct point *m, struct point *p) {
 #define NUM_CLICKLIST 5
 #define PIX_CLICKLIST 2
 
-/* draw little circles around the hits. If slr==-1 it is single persp.,
-   slr==0 double left, slr==1 double right */
 /* check if point p is in the clicking circle around x,y (window coord.
-   but with 0,0 in the middle of the window) */
-struct clickhit *checkclick(struct point *p, int clickradius, int x, int y,
-                            struct node *data,
-                            int wall)
+   but with 0,0 in the middle of the window). If so, the hit is written
+   to ch and a 1 is returned. */
+static int checkclick(struct point *p, int clickradius, int x, int y,
+                      struct node *data, int wall, struct clickhit *ch)
 {
     struct pixel pix;
-    struct clickhit *ch;
-    float d;
+    int d;
 
 
     if ( !in_getpixelcoords(p, &pix)
        || (pix.d > view.maxvisibility * 1.1 && wall != 7) ) {
-        return NULL;
+        return 0;
     }
 
-    if ( ( d =
-              (float)(x -
-                      pix.x) *
-              (x - pix.x) + (float)(y - pix.y) * (y - pix.y) ) <=
+    if ( ( d = (x - pix.x) * (x - pix.x) + (y - pix.y) * (y - pix.y) ) >
         clickradius * clickradius ) {
-        checkmem( ch = MALLOC( sizeof(struct clickhit) ) );
-        ch->x = pix.x;
-        ch->y = pix.y;
-        ch->d = d;
-        ch->p = *p;
-        ch->data = data;
-        ch->wall = wall;
-    }
-    else {
-        ch = NULL;
+        return 0;
     }
 
-    return ch;
+    ch->x = pix.x;
+    ch->y = pix.y;
+    ch->d = d;
+    ch->p = *p;
+    ch->data = data;
+    ch->wall = wall;
+    ch->seq = -1;
+    return 1;
 }
 
 
 #define MAX_CLICKHITS 3
+static struct clickhit clickhits[MAX_CLICKHITS];
 
-void add_clickhit(struct clickhit **nearest, struct clickhit *ch) {
-    int i, j;
+/* put a copy of ch into the sorted list of the nearest hits if it's near
+   enough. The copies are in clickhits, so nearest must be set to NULLs
+   before the first hit is added. Returns the copy or NULL. */
+static struct clickhit *add_clickhit(struct clickhit **nearest,
+                                     struct clickhit *ch)
+{
+    struct clickhit *slot;
+    int i, j, k;
 
 
     for (i = 0; i < MAX_CLICKHITS; i++) {
-        if (!nearest[i] || nearest[i]->d > ch->d) {
-            if (nearest[MAX_CLICKHITS -
-                        1])                                          {
-                FREE(nearest[MAX_CLICKHITS - 1]);
-            }
+        if ( !nearest[i] || nearest[i]->d > ch->d
+           || (nearest[i]->d == ch->d && nearest[i]->seq > ch->seq) ) {
+            break;
+        }
+    }
 
-            for (j = MAX_CLICKHITS - 1; j > i; j--) {
-                nearest[j] = nearest[j - 1];
+    if (i == MAX_CLICKHITS) {
+        return NULL;
+    }
+
+    if ( ( slot = nearest[MAX_CLICKHITS - 1] ) == NULL ) {
+        /* a copy which isn't in the list */
+        for (k = 0; k < MAX_CLICKHITS; k++) {
+            for (j = 0; j < MAX_CLICKHITS && nearest[j] != &clickhits[k];
+                 j++) {
             }
 
-            nearest[i] = ch;
-            break;
+            if (j == MAX_CLICKHITS) {
+                break;
+            }
         }
+
+        my_assert(k < MAX_CLICKHITS);
+        slot = &clickhits[k];
     }
+
+    for (j = MAX_CLICKHITS - 1; j > i; j--) {
+        nearest[j] = nearest[j - 1];
+    }
+
+    *slot = *ch;
+    nearest[i] = slot;
+    return slot;
+}
+
+
+#define MINI_CLICKRADIUS (clickradius / 4)
+static int xoffset, yoffset, xsize, ysize, lr, clickradius;
+
+/* All things which can be clicked in the current mode with their place on
+   the screen, sorted into a grid of squares with the size of the clicking
+   circle. So only the squares under the circle must be checked for each
+   position of the mouse. It's made for each drawing of the level when
+   it's needed (see pick_makegrid). */
+struct picktarget {
+    int x, y; /* window coords with 0,0 in the middle */
+    struct node *data;
+    int wall;
+    int seq; /* position in the order of the run loops */
+};
+static struct picktarget *pick_targets, *pick_sorted;
+static int pick_num, pick_max;
+static int *pick_cells; /* first target of each square in pick_sorted */
+static int pick_xcells, pick_ycells, pick_xstart, pick_ystart;
+static int pick_mode = -1, pick_lr, pick_radius;
+static unsigned long pick_drawing;
+static struct leveldata *pick_level;
+
+/* add the target data,wall at pix (visible is the result of
+   in_getpixelcoords) */
+static void pick_addtarget(struct pixel *pix, int visible,
+                           struct node *data, int wall)
+{
+    struct picktarget *t;
+
+
+    if ( !visible || pix->d > view.maxvisibility * 1.1 ) {
+        return;
+    }
+
+    /* it can only be clicked if the circle can touch it */
+    if (pix->x < pick_xstart || pix->y < pick_ystart
+       || pix->x >= pick_xstart + pick_xcells * clickradius
+       || pix->y >= pick_ystart + pick_ycells * clickradius) {
+        return;
+    }
+
+    if (pick_num == pick_max) {
+        pick_max = pick_max * 2 + 256;
+        checkmem( pick_targets = REALLOC(pick_targets,
+                                         sizeof(struct picktarget) *
+                                         pick_max) );
+    }
+
+    t = &pick_targets[pick_num];
+    t->x = pix->x;
+    t->y = pix->y;
+    t->data = data;
+    t->wall = wall;
+    t->seq = pick_num++;
+}
+
+
+/* like pick_addtarget for a point with the view coords v (see
+   vc_getpnt) */
+static void pick_addview(float *v, struct node *data, int wall) {
+    struct pixel pix;
+    int visible;
+
+
+    visible = in_getviewpixelcoords(v, &pix);
+    pick_addtarget(&pix, visible, data, wall);
+}
+
+
+static void pick_addpnt(struct point *p, struct node *data, int wall) {
+    struct pixel pix;
+    int visible;
+
+
+    visible = in_getpixelcoords(p, &pix);
+    pick_addtarget(&pix, visible, data, wall);
 }
 
 
-void run_thingloop(struct clickhit **hits, int clickradius, int x, int y) {
+static void run_thingloop(void) {
     struct node *n;
-    struct clickhit *ch;
 
 
     for (n = l->things.head; n->next != NULL; n = n->next) {
-        if ( ( ch =
-                  checkclick(&n->d.t->p[0], clickradius, x, y, n,
-                             -1) ) != NULL ) {
-            add_clickhit(hits, ch);
-        }
+        pick_addpnt(&n->d.t->p[0], n, -1);
     }
 }
 
 
-void run_doorloop(struct clickhit **hits, int clickradius, int x, int y) {
+static void run_doorloop(void) {
     struct node *n;
-    struct clickhit *ch;
 
 
     for (n = l->doors.head; n->next != NULL; n = n->next) {
-        if ( ( ch =
-                  checkclick(&n->d.d->p, clickradius, x, y, n,
-                             -1) ) != NULL ) {
-            add_clickhit(hits, ch);
-        }
+        pick_addpnt(&n->d.d->p, n, -1);
     }
 }
 
 
-void run_pntloop(struct clickhit **hits, int clickradius, int x, int y) {
+static void run_pntloop(void) {
     struct node *n;
-    struct clickhit *ch;
+    struct viewcache *vc = vc_get();
+    float v[4];
 
 
     for (n = l->pts.head; n->next != NULL; n = n->next) {
-        if ( ( ch =
-                  checkclick(n->d.p, clickradius, x, y, n, -1) ) != NULL ) {
-            add_clickhit(hits, ch);
-        }
+        vc_getpnt(vc, n, v);
+        pick_addview(v, n, -1);
     }
 }
 
 
-void run_wallloop(struct clickhit **hits, int clickradius, int x, int y) {
+/* the view coords of the corners of cube n in v */
+static void getcubeviewcoords(struct viewcache *vc, struct node *n,
+                              float v[8][4])
+{
+    int i;
+
+
+    for (i = 0; i < 8; i++) {
+        vc_getpnt(vc, n->d.c->p[i], v[i]);
+    }
+}
+
+
+/* the normal of wall w of cube n (only used for walls with a neighbour) */
+static void getwallnormal(struct node *n, int w, struct point *nv) {
+    struct point d1, d2;
+    int i;
+
+
+    for (i = 0; i < 3; i++) {
+        d1.x[i] = n->d.c->p[wallpts[w][2]]->d.p->x[i] -
+                  n->d.c->p[wallpts[w][0]]->d.p->x[i];
+        d2.x[i] = n->d.c->p[wallpts[w][3]]->d.p->x[i] -
+                  n->d.c->p[wallpts[w][1]]->d.p->x[i];
+    }
+
+    VECTOR(nv, &d1, &d2);
+    normalize(nv);
+}
+
+
+static void run_wallloop(void) {
     struct node *n;
-    struct clickhit *ch;
+    struct viewcache *vc = vc_get();
     int w, i, j;
-    struct point p, d1, d2, nv;
+    struct point nv;
+    float v[8][4], c[3], vn[3];
 
 
     for (n = l->cubes.head; n->next != NULL; n = n->next) {
+        getcubeviewcoords(vc, n, v);
+
         for (w = 0; w < 6; w++) {
             for (i = 0; i < 3; i++) {
-                p.x[i] = 0.0;
+                c[i] = 0.0;
 
                 for (j = 0; j < 4; j++) {
-                    p.x[i] += n->d.c->p[wallpts[w][j]]->d.p->x[i] / 4.0;
+                    c[i] += v[wallpts[w][j]][i] / 4.0;
                 }
             }
 
             if (n->d.c->nc[w]) {
-                for (i = 0; i < 3; i++) {
-                    d1.x[i] = n->d.c->p[wallpts[w][2]]->d.p->x[i] -
-                              n->d.c->p[wallpts[w][0]]->d.p->x[i];
-                    d2.x[i] = n->d.c->p[wallpts[w][3]]->d.p->x[i] -
-                              n->d.c->p[wallpts[w][1]]->d.p->x[i];
-                }
-
-                VECTOR(&nv, &d1, &d2);
-                normalize(&nv);
+                getwallnormal(n, w, &nv);
+                in_getviewdir(&nv, vn);
 
                 for (i = 0; i < 3; i++) {
-                    p.x[i] += nv.x[i] * view.dsize;
+                    c[i] += vn[i] * view.dsize;
                 }
             }
 
-            if ( ( ch = checkclick(&p, clickradius, x, y, n, w) ) != NULL ) {
-                add_clickhit(hits, ch);
-            }
+            pick_addview(c, n, w);
         }
     }
 }
 
 
-void run_edgeloop(struct clickhit **hits, int clickradius, int x, int y) {
+static void run_edgeloop(void) {
     struct node *n;
-    struct clickhit *ch;
+    struct viewcache *vc = vc_get();
     int w, e, i, j;
-    struct point p, c;
+    float v[8][4], m[3], p[3];
 
 
     for (n = l->cubes.head; n->next != NULL; n = n->next) {
+        getcubeviewcoords(vc, n, v);
+
         for (w = 0; w < 6; w++) {
             if (!n->d.c->nc[w] || n->d.c->nc[w]->no > n->no) {
                 for (i = 0; i < 3; i++) {
-                    c.x[i] = 0.0;
+                    m[i] = 0.0;
 
                     for (j = 0; j < 4; j++) {
-                        c.x[i] += n->d.c->p[wallpts[w][j]]->d.p->x[i] / 4.0;
+                        m[i] += v[wallpts[w][j]][i] / 4.0;
                     }
                 }
 
                 for (e = 0; e < 4; e++) {
                     for (i = 0; i < 3; i++) {
-                        p.x[i] = c.x[i] * 0.4 +
-                                 n->d.c->p[wallpts[w][e]]->d.p->x[i] * 0.6;
+                        p[i] = m[i] * 0.4 + v[wallpts[w][e]][i] * 0.6;
                     }
 
-                    if ( ( ch =
-                              checkclick(&p, clickradius, x, y, n,
-                                         w * 4 + e + 100) ) != NULL ) {
-                        add_clickhit(hits, ch);
-                    }
+                    pick_addview(p, n, w * 4 + e + 100);
                 }
             }
         }
@@ -314,32 +423,214 @@ void run_edgeloop(struct clickhit **hits, int clickradius, int x, int y) {
 }
 
 
-void run_cubeloop(struct clickhit **hits, int clickradius, int x, int y) {
+static void run_cubeloop(void) {
     struct node *n;
-    struct clickhit *ch;
+    struct viewcache *vc = vc_get();
     int i, j;
-    struct point p;
+    float v[8][4], c[3];
 
 
     for (n = l->cubes.head; n->next != NULL; n = n->next) {
+        getcubeviewcoords(vc, n, v);
+
         for (i = 0; i < 3; i++) {
-            p.x[i] = 0.0;
+            c[i] = 0.0;
 
             for (j = 0; j < 8; j++) {
-                p.x[i] += n->d.c->p[j]->d.p->x[i] / 8.0;
+                c[i] += v[j][i] / 8.0;
             }
         }
 
-        if ( ( ch = checkclick(&p, clickradius, x, y, n, 6) ) != NULL ) {
-            add_clickhit(hits, ch);
-        }
+        pick_addview(c, n, 6);
     }
 }
 
 
-#define MINI_CLICKRADIUS (clickradius / 4)
-static int xoffset, yoffset, xsize, ysize, lr, clickradius;
+static void(*run_loop[tt_number]) (void) = {
+    run_cubeloop, run_wallloop, run_edgeloop, run_pntloop, run_thingloop,
+    run_doorloop
+};
+
+/* the point in the level which was clicked with ch (in the mode of the
+   grid) */
+static void pick_targetpnt(struct clickhit *ch) {
+    struct node *n = ch->data;
+    struct point c, nv;
+    int w, e, i, j;
+
 
+    switch (pick_mode) {
+        case tt_cube:
+
+            for (i = 0; i < 3; i++) {
+                ch->p.x[i] = 0.0;
+
+                for (j = 0; j < 8; j++) {
+                    ch->p.x[i] += n->d.c->p[j]->d.p->x[i] / 8.0;
+                }
+            }
+
+            break;
+
+        case tt_wall:
+            w = ch->wall;
+
+            if (n->d.c->nc[w]) {
+                getwallnormal(n, w, &nv);
+            }
+
+            for (i = 0; i < 3; i++) {
+                ch->p.x[i] = 0.0;
+
+                for (j = 0; j < 4; j++) {
+                    ch->p.x[i] += n->d.c->p[wallpts[w][j]]->d.p->x[i] / 4.0;
+                }
+
+                if (n->d.c->nc[w]) {
+                    ch->p.x[i] += nv.x[i] * view.dsize;
+                }
+            }
+
+            break;
+
+        case tt_edge:
+            w = (ch->wall - 100) / 4;
+            e = (ch->wall - 100) % 4;
+
+            for (i = 0; i < 3; i++) {
+                c.x[i] = 0.0;
+
+                for (j = 0; j < 4; j++) {
+                    c.x[i] += n->d.c->p[wallpts[w][j]]->d.p->x[i] / 4.0;
+                }
+
+                ch->p.x[i] = c.x[i] * 0.4 +
+                             n->d.c->p[wallpts[w][e]]->d.p->x[i] * 0.6;
+            }
+
+            break;
+
+        case tt_pnt:
+            ch->p = *n->d.p;
+            break;
+
+        case tt_thing:
+            ch->p = n->d.t->p[0];
+            break;
+
+        case tt_door:
+            ch->p = n->d.d->p;
+            break;
+
+        default:
+            my_assert(0);
+    }
+}
+
+
+/* make the grid for the current mode and view (the view must be set with
+   makeview, see start_scansequence). Nothing is done if it's already made
+   since the level was drawn. */
+static void pick_makegrid(void) {
+    struct picktarget *t;
+    int i, c;
+
+
+    if (pick_level == l && pick_mode == view.currmode && pick_lr == lr
+       && pick_radius == clickradius && pick_drawing == plot_drawings) {
+        return;
+    }
+
+    pick_level = l;
+    pick_mode = view.currmode;
+    pick_lr = lr;
+    pick_radius = clickradius;
+    pick_drawing = plot_drawings;
+    /* the window and one circle around it */
+    pick_xstart = -xsize / 2 - clickradius;
+    pick_ystart = -ysize / 2 - clickradius;
+    pick_xcells = xsize / clickradius + 3;
+    pick_ycells = ysize / clickradius + 3;
+    pick_num = 0;
+    run_loop[pick_mode]();
+    FREE(pick_cells);
+    FREE(pick_sorted);
+    checkmem( pick_cells = CALLOC(pick_xcells * pick_ycells + 1,
+                                  sizeof(int) ) );
+    checkmem( pick_sorted = MALLOC(sizeof(struct picktarget) *
+                                   (pick_num + 1) ) );
+
+    /* sort the targets into the squares, in each square they stay in the
+       order of the run loop */
+    for (i = 0, t = pick_targets; i < pick_num; i++, t++) {
+        pick_cells[(t->y - pick_ystart) / clickradius * pick_xcells +
+                   (t->x - pick_xstart) / clickradius + 1]++;
+    }
+
+    /* pick_cells[c] is the start of square c */
+    for (c = 1; c <= pick_xcells * pick_ycells; c++) {
+        pick_cells[c] += pick_cells[c - 1];
+    }
+
+    for (i = 0, t = pick_targets; i < pick_num; i++, t++) {
+        c = (t->y - pick_ystart) / clickradius * pick_xcells +
+            (t->x - pick_xstart) / clickradius;
+        pick_sorted[pick_cells[c]++] = *t;
+    }
+
+    /* now pick_cells[c] is the end of square c */
+    for (c = pick_xcells * pick_ycells; c > 0; c--) {
+        pick_cells[c] = pick_cells[c - 1];
+    }
+
+    pick_cells[0] = 0;
+}
+
+
+/* add all targets in the circle around x,y to nearest */
+static void pick_scan(struct clickhit **nearest, int x, int y) {
+    struct picktarget *t;
+    struct clickhit ch, *slot;
+    int cx, cy, cx1, cy1, cx2, cy2, k;
+
+
+    cx1 = (x - clickradius - pick_xstart) / clickradius;
+    cy1 = (y - clickradius - pick_ystart) / clickradius;
+    cx2 = (x + clickradius - pick_xstart) / clickradius;
+    cy2 = (y + clickradius - pick_ystart) / clickradius;
+    cx1 = cx1 < 0 ? 0 : cx1;
+    cy1 = cy1 < 0 ? 0 : cy1;
+    cx2 = cx2 >= pick_xcells ? pick_xcells - 1 : cx2;
+    cy2 = cy2 >= pick_ycells ? pick_ycells - 1 : cy2;
+
+    for (cy = cy1; cy <= cy2; cy++) {
+        for (cx = cx1; cx <= cx2; cx++) {
+            for (k = pick_cells[cy * pick_xcells + cx];
+                 k < pick_cells[cy * pick_xcells + cx + 1]; k++) {
+                t = &pick_sorted[k];
+                ch.d = (x - t->x) * (x - t->x) + (y - t->y) * (y - t->y);
+
+                if (ch.d > clickradius * clickradius) {
+                    continue;
+                }
+
+                ch.x = t->x;
+                ch.y = t->y;
+                ch.data = t->data;
+                ch.wall = t->wall;
+                ch.seq = t->seq;
+
+                if ( ( slot = add_clickhit(nearest, &ch) ) != NULL ) {
+                    pick_targetpnt(slot);
+                }
+            }
+        }
+    }
+}
+
+
+/* draw little circles around the hits. If slr==-1 it is single persp.,
+   slr==0 double left, slr==1 double right */
 void plotclickmarker(int lr, struct clickhit *ch, int color, int xor) {
     int i;
     struct pixel spix, epix;
@@ -394,12 +685,6 @@ void plotclickmarker(int lr, struct clickhit *ch, int color, int xor) {
 }
 
 
-void(*run_loop[tt_number]) (struct clickhit **hits, int cr, int x,
-                            int y) = {
-    run_cubeloop, run_wallloop, run_edgeloop, run_pntloop, run_thingloop,
-    run_doorloop
-};
-
 struct track *check_for_corr(struct w_window *w, int sx, int sy) {
     float min_f, f;
     struct point a, m;
@@ -484,15 +769,12 @@ void start_scansequence(struct w_window *w, int wx) {
 }
 
 
-struct clickhit *newpos_scansequence(
-    struct w_window *w, int wx, int wy,
-    void (*run_loop)(struct clickhit **nearest, int cr, int x,
-                     int y),
-    struct clickhit **nearest)
+struct clickhit *newpos_scansequence(struct w_window *w, int wx, int wy,
+                                     struct clickhit **nearest)
 {
     int i;
     struct node *t;
-    struct clickhit *ch;
+    struct clickhit ch;
 
 
     for (i = 0; i < MAX_CLICKHITS; i++) {
@@ -502,17 +784,16 @@ struct clickhit *newpos_scansequence(
     if (l->cur_corr != NULL) {
         for (t = l->cur_corr->tracking.head; t->next != NULL; t =
                  t->next)                               {
-            if (t->d.ct->fixed <= 0 && ( ch = checkclick(&t->d.ct->x,
-                                                         clickradius, wx -
-                                                         xoffset, yoffset -
-                                                         wy, t,
-                                                         7) ) != NULL) {
-                add_clickhit(nearest, ch);
+            if (t->d.ct->fixed <= 0 && checkclick(&t->d.ct->x, clickradius,
+                                                  wx - xoffset, yoffset - wy,
+                                                  t, 7, &ch) ) {
+                add_clickhit(nearest, &ch);
             }
         }
     }
 
-    run_loop(nearest, clickradius, wx - xoffset, yoffset - wy);
+    pick_makegrid();
+    pick_scan(nearest, wx - xoffset, yoffset - wy);
 
     for (i = 0; i < MAX_CLICKHITS && nearest[i] != NULL; i++) {
         nearest[i]->y = w_ywinincoord(l->w, yoffset - nearest[i]->y);
@@ -524,10 +805,10 @@ struct clickhit *newpos_scansequence(
 
 
 void click_in_level(struct w_window *w, struct w_event *we) {
-    struct clickhit *first, *nearest[MAX_CLICKHITS];
+    struct clickhit *nearest[MAX_CLICKHITS];
     struct node *ctrl_pressed;
     struct ws_event ws;
-    int i, right_pressed = 0, t;
+    int i, t;
     int x = we->ws->x, y = we->ws->y, wx = we->x, wy = we->y;
 
 
@@ -562,8 +843,7 @@ void click_in_level(struct w_window *w, struct w_event *we) {
     ws = *we->ws;
 
     do {
-        first = newpos_scansequence(w, wx, wy, run_loop[view.currmode],
-                                    nearest);
+        newpos_scansequence(w, wx, wy, nearest);
 
         if (t == 0 && (ws.kbstat & ws_ks_ctrl) != 0) {
             ctrl_pressed = nearest[0] ? nearest[0]->data : NULL;
@@ -630,7 +910,6 @@ void click_in_level(struct w_window *w, struct w_event *we) {
         if ( (ws.buttons & ws_bt_right) != 0 && nearest[0] != NULL ) { /* move
                                                                          or rotate
                                                                          */
-            right_pressed = 1;
             scan_setclipping(w, 0);
 
             if (nearest[0]->wall == 7) {
@@ -743,11 +1022,6 @@ void click_in_level(struct w_window *w, struct w_event *we) {
     }
 
     view.pcurrwall = view.pcurrcube->d.c->walls[view.currwall];
-
-    for (i = 0; i < MAX_CLICKHITS - 1 && nearest[i] != NULL; i++) {
-        FREE(nearest[i]);
-    }
-
     drawopt(view.currmode);
     plotlevel();
 }
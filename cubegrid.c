@@ -0,0 +1,393 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    cubegrid.c - spatial index to find the cube around a point
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+#include "structs.h"
+#include "tools.h"
+#include "cubegrid.h"
+
+/* The space is divided in cubic cells of the size cellsize. Every cube
+   is entered in all cells its bounding box touches (cells with the same
+   hash value share one bucket). Cubes which touch more than
+   CG_MAXCELLS cells are kept in the extra bucket big.
+   The grid is made when it's needed first. Cubes inserted in or deleted
+   from the level are entered in or removed from the grid of the level
+   (cg_insertcube, cg_deletecube). Everything which moves points of the
+   level must move their cubes in the grid, too (cg_updatepnt, called by
+   newcorners, or cg_updatecube), so the grid is always right. */
+#define CG_MAXCELLS 27
+#define CG_MINCELLSIZE 65536.0
+
+struct cg_bucket {
+    int num, max;
+    struct node **cubes;
+};
+struct cubegrid {
+    float cellsize;
+    unsigned int mask; /* number of buckets-1, number is a power of 2 */
+    struct cg_bucket *buckets, big;
+    struct cg_bucket found; /* the cubes of the last cg_getcubes call */
+    unsigned long id; /* cube->grid_id of all cubes in this grid */
+};
+
+/* the last grid id and the last cg_getcubes call */
+unsigned long cg_ids = 0, cg_queries = 0;
+
+
+static unsigned int cg_hash(struct cubegrid *g, int x, int y, int z) {
+    return ( (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^
+            (unsigned int)z * 83492791u ) & g->mask;
+}
+
+
+static int cg_cell(struct cubegrid *g, float x) {
+    return (int)floor(x / g->cellsize);
+}
+
+
+static void cg_addtobucket(struct cg_bucket *b, struct node *nc) {
+    if (b->num == b->max) {
+        b->max = b->max ? b->max * 2 : 4;
+        checkmem( b->cubes =
+                     REALLOC(b->cubes, sizeof(struct node *) * b->max) );
+    }
+
+    b->cubes[b->num++] = nc;
+}
+
+
+/* add nc to b if it's not in the cubes of the query cg_queries yet */
+static void cg_addfound(struct cg_bucket *b, struct node *nc) {
+    if (nc->d.c->grid_query != cg_queries) {
+        nc->d.c->grid_query = cg_queries;
+        cg_addtobucket(b, nc);
+    }
+}
+
+
+static int qs_compcubenos(const void *n1, const void *n2) {
+    return (*(struct node * const *)n1)->no - (*(struct node * const *)n2)->no;
+}
+
+
+static void cg_delfrombucket(struct cg_bucket *b, struct node *nc) {
+    int i;
+
+
+    for (i = 0; i < b->num; i++) {
+        if (b->cubes[i] == nc) {
+            b->cubes[i] = b->cubes[--b->num];
+            return;
+        }
+    }
+}
+
+
+static int cg_isbig(int *box) {
+    return (float)(box[3] - box[0] + 1) * (box[4] - box[1] + 1) *
+           (box[5] - box[2] + 1) > CG_MAXCELLS;
+}
+
+
+/* calculate the cells the cube nc touches and enter it in the grid */
+static void cg_entercube(struct cubegrid *g, struct node *nc) {
+    struct cube *c = nc->d.c;
+    int i, j, x, y, z, *box = c->grid_box;
+
+
+    c->grid_id = g->id;
+
+    for (j = 0; j < 3; j++) {
+        box[j] = box[j + 3] = cg_cell(g, c->p[0]->d.p->x[j]);
+
+        for (i = 1; i < 8; i++) {
+            x = cg_cell(g, c->p[i]->d.p->x[j]);
+
+            if (x < box[j]) {
+                box[j] = x;
+            }
+            else if (x > box[j + 3]) {
+                box[j + 3] = x;
+            }
+        }
+    }
+
+    if ( cg_isbig(box) ) {
+        cg_addtobucket(&g->big, nc);
+        return;
+    }
+
+    for (x = box[0]; x <= box[3]; x++) {
+        for (y = box[1]; y <= box[4]; y++) {
+            for (z = box[2]; z <= box[5]; z++) {
+                cg_addtobucket(&g->buckets[cg_hash(g, x, y, z)], nc);
+            }
+        }
+    }
+}
+
+
+static void cg_removecube(struct cubegrid *g, struct node *nc) {
+    int x, y, z, *box = nc->d.c->grid_box;
+
+
+    if ( cg_isbig(box) ) {
+        cg_delfrombucket(&g->big, nc);
+        return;
+    }
+
+    for (x = box[0]; x <= box[3]; x++) {
+        for (y = box[1]; y <= box[4]; y++) {
+            for (z = box[2]; z <= box[5]; z++) {
+                cg_delfrombucket(&g->buckets[cg_hash(g, x, y, z)], nc);
+            }
+        }
+    }
+}
+
+
+void cg_freegrid(struct leveldata *ld) {
+    unsigned int i;
+
+
+    if (ld->grid == NULL) {
+        return;
+    }
+
+    for (i = 0; i <= ld->grid->mask; i++) {
+        if (ld->grid->buckets[i].cubes) {
+            FREE(ld->grid->buckets[i].cubes);
+        }
+    }
+
+    if (ld->grid->big.cubes) {
+        FREE(ld->grid->big.cubes);
+    }
+
+    if (ld->grid->found.cubes) {
+        FREE(ld->grid->found.cubes);
+    }
+
+    FREE(ld->grid->buckets);
+    FREE(ld->grid);
+    ld->grid = NULL;
+}
+
+
+/* make the grid for all cubes in ld. The size of the cells is the
+   average size of the cubes */
+static void cg_makegrid(struct leveldata *ld) {
+    struct cubegrid *g;
+    struct node *n;
+    float size, min, max;
+    int i, j;
+
+
+    cg_freegrid(ld);
+    checkmem( g = MALLOC( sizeof(struct cubegrid) ) );
+
+    for (n = ld->cubes.head, size = 0.0; n->next != NULL; n = n->next) {
+        for (j = 0; j < 3; j++) {
+            min = max = n->d.c->p[0]->d.p->x[j];
+
+            for (i = 1; i < 8; i++) {
+                if (n->d.c->p[i]->d.p->x[j] < min) {
+                    min = n->d.c->p[i]->d.p->x[j];
+                }
+                else if (n->d.c->p[i]->d.p->x[j] > max) {
+                    max = n->d.c->p[i]->d.p->x[j];
+                }
+            }
+
+            size += max - min;
+        }
+    }
+
+    g->cellsize = ld->cubes.size > 0 ? size / (ld->cubes.size * 3) : 0.0;
+
+    if (g->cellsize < CG_MINCELLSIZE) {
+        g->cellsize = CG_MINCELLSIZE;
+    }
+
+    for (g->mask = 64; (int)g->mask < ld->cubes.size * 2; g->mask *= 2) {
+    }
+
+    checkmem( g->buckets = CALLOC(g->mask, sizeof(struct cg_bucket) ) );
+    g->mask--;
+    g->big.num = g->big.max = 0;
+    g->big.cubes = NULL;
+    g->found.num = g->found.max = 0;
+    g->found.cubes = NULL;
+    g->id = ++cg_ids;
+
+    for (n = ld->cubes.head; n->next != NULL; n = n->next) {
+        cg_entercube(g, n);
+    }
+
+    ld->grid = g;
+}
+
+
+/* cube nc was inserted in ld->cubes */
+void cg_insertcube(struct leveldata *ld, struct node *nc) {
+    if ( ld != NULL && ld->grid != NULL
+        && nc->d.c->grid_id != ld->grid->id ) {
+        cg_entercube(ld->grid, nc);
+    }
+}
+
+
+/* cube nc will be deleted from ld->cubes */
+void cg_deletecube(struct leveldata *ld, struct node *nc) {
+    if ( ld != NULL && ld->grid != NULL
+        && nc->d.c->grid_id == ld->grid->id ) {
+        cg_removecube(ld->grid, nc);
+        nc->d.c->grid_id = 0;
+    }
+}
+
+
+/* the points of the cube nc were moved. Move it in the grid, too */
+void cg_updatecube(struct leveldata *ld, struct node *nc) {
+    if (ld == NULL || ld->grid == NULL || nc->d.c->grid_id != ld->grid->id) {
+        return;
+    }
+
+    cg_removecube(ld->grid, nc);
+    cg_entercube(ld->grid, nc);
+}
+
+
+/* the points of all cubes in the list cubes (data are the nodes of the
+   cubes) were moved */
+void cg_updatecubes(struct leveldata *ld, struct list *cubes) {
+    struct node *n;
+
+
+    for (n = cubes->head; n->next != NULL; n = n->next) {
+        cg_updatecube(ld, n->d.n);
+    }
+}
+
+
+/* the point np was moved. Move all cubes with this point in the grid */
+void cg_updatepnt(struct leveldata *ld, struct node *np) {
+    struct node *nc;
+
+
+    for (nc = np->d.lp->c.head; nc->next != NULL; nc = nc->next) {
+        cg_updatecube(ld, nc->d.n);
+    }
+}
+
+
+/* make an array with all cubes in ld whose cells touch the box from min
+   to max (and maybe some more). Each cube is only once in the array and
+   the cubes are sorted by their numbers. Returns the number of cubes. The
+   array belongs to the grid and is valid until the next call. */
+int cg_getcubes(struct leveldata *ld, struct point *min, struct point *max,
+                struct node ***cubes)
+{
+    struct cubegrid *g;
+    struct cg_bucket *b;
+    struct node *n;
+    int i, x, y, z, box[6];
+
+
+    if (ld->grid == NULL) {
+        cg_makegrid(ld);
+    }
+
+    g = ld->grid;
+    cg_queries++;
+    g->found.num = 0;
+
+    for (i = 0; i < 3; i++) {
+        box[i] = cg_cell(g, min->x[i]);
+        box[i + 3] = cg_cell(g, max->x[i]);
+    }
+
+    /* if the box is larger than the level it's faster to take all cubes */
+    if ( (float)(box[3] - box[0] + 1) * (box[4] - box[1] + 1) *
+        (box[5] - box[2] + 1) > ld->cubes.size ) {
+        for (n = ld->cubes.head; n->next != NULL; n = n->next) {
+            cg_addtobucket(&g->found, n);
+        }
+    }
+    else {
+        for (x = box[0]; x <= box[3]; x++) {
+            for (y = box[1]; y <= box[4]; y++) {
+                for (z = box[2]; z <= box[5]; z++) {
+                    b = &g->buckets[cg_hash(g, x, y, z)];
+
+                    for (i = 0; i < b->num; i++) {
+                        cg_addfound(&g->found, b->cubes[i]);
+                    }
+                }
+            }
+        }
+
+        for (i = 0; i < g->big.num; i++) {
+            cg_addfound(&g->found, g->big.cubes[i]);
+        }
+
+        qsort(g->found.cubes, g->found.num, sizeof(struct node *),
+              qs_compcubenos);
+    }
+
+    *cubes = g->found.cubes;
+    return g->found.num;
+}
+
+
+/* find cube around position p. if there's no cube, return NULL */
+struct node *cg_findpntcube(struct leveldata *ld, struct point *p) {
+    struct cubegrid *g;
+    struct cg_bucket *b;
+    int i, x, y, z;
+
+
+    if (ld->grid == NULL) {
+        cg_makegrid(ld);
+    }
+
+    g = ld->grid;
+    x = cg_cell(g, p->x[0]);
+    y = cg_cell(g, p->x[1]);
+    z = cg_cell(g, p->x[2]);
+    b = &g->buckets[cg_hash(g, x, y, z)];
+
+    for (i = 0; i < b->num; i++) {
+        if (x >= b->cubes[i]->d.c->grid_box[0]
+           && x <= b->cubes[i]->d.c->grid_box[3]
+           && y >= b->cubes[i]->d.c->grid_box[1]
+           && y <= b->cubes[i]->d.c->grid_box[4]
+           && z >= b->cubes[i]->d.c->grid_box[2]
+           && z <= b->cubes[i]->d.c->grid_box[5]
+           && checkpntcube(b->cubes[i], p) ) {
+            return b->cubes[i];
+        }
+    }
+
+    for (i = 0; i < g->big.num; i++) {
+        if ( checkpntcube(g->big.cubes[i], p) ) {
+            return g->big.cubes[i];
+        }
+    }
+
+    return NULL;
+}
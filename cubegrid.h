@@ -0,0 +1,13 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+    Further info see .c-files. */
+
+void cg_insertcube(struct leveldata *ld, struct node *nc);
+void cg_deletecube(struct leveldata *ld, struct node *nc);
+void cg_freegrid(struct leveldata *ld);
+void cg_updatecube(struct leveldata *ld, struct node *nc);
+void cg_updatecubes(struct leveldata *ld, struct list *cubes);
+void cg_updatepnt(struct leveldata *ld, struct node *np);
+int cg_getcubes(struct leveldata *ld, struct point *min, struct point *max,
+                struct node ***cubes);
+struct node *cg_findpntcube(struct leveldata *ld, struct point *p);
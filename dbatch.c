@@ -0,0 +1,670 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    dbatch.c - processing levels without display
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+/* dbatch loads levels with the configuration of Devil, illuminates them,
+   checks them and saves them again, without display (it's compiled with
+   -DHEADLESS like rbench, see the Makefile). Levels for Descent 1 are
+   converted to Descent 2 while they are read if Devil is configured for
+   Descent 2 (see convert_textures).
+
+   The arguments are levels or missions (.msn/.mn2 files, their levels are
+   read from the hog-file of the mission or, if they aren't in it, from the
+   directory of the mission). Each level is done in its own process, up to
+   -j processes run at the same time. A level from a hog-file is copied to
+   a temporary directory and saved there, when all levels are done the
+   hog-file is written again with them. Each level is checked before it's
+   saved, a level with errors isn't saved. The messages of a level are
+   printed when it's finished, at the end a line for each level is printed
+   to stdout. The exit code is 0 if all levels are ok. */
+#define _POSIX_C_SOURCE 200809L /* mkdtemp */
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "structs.h"
+#include "tools.h"
+#include "initio.h"
+#include "config.h"
+#include "userio.h"
+#include "readlvl.h"
+#include "readtxt.h"
+#include "plottxt.h"
+#include "tag.h"
+#include "do_light.h"
+#include "threads.h"
+#include "lac_cfg.h"
+#include "hogfile.h"
+
+extern enum descent loading_level_version;
+
+struct batchjob {
+    char *level;
+    const char *hog; /* the hog-file with the level (then level is the name
+                        of the entry) or NULL */
+    FILE *log; /* the messages of the process */
+    pid_t pid;
+    double time;
+    int ok;
+};
+
+static struct batchjob *jobs;
+static int num_jobs, max_jobs;
+/* what is done with each level (set by the options) */
+static int b_illum, b_smooth, b_convert, b_strict, b_save = 1;
+static const char *b_outdir;
+static char *b_tmpdir; /* where the levels from hog-files are saved */
+
+
+static void usage(void) {
+    fprintf(errf, "Usage: dbatch [-j processes] [-i] [-s] [-c] [-v] [-n] "
+            "[-o dir] level|mission ...\n"
+            " -i  illuminate all cubes\n"
+            " -s  smooth the light while illuminating\n"
+            " -c  convert Descent 1 levels to Descent 2\n"
+            " -v  a level fails if there's any warning\n"
+            " -n  don't save the levels\n"
+            " -o  save the levels to dir instead of over the old ones\n");
+    exit(1);
+}
+
+
+static void addjob(const char *path, int len, const char *name,
+                   const char *hog) {
+    struct batchjob *j;
+
+
+    if (num_jobs == max_jobs) {
+        max_jobs = max_jobs * 2 + 16;
+        checkmem( jobs = REALLOC(jobs, sizeof(struct batchjob) * max_jobs) );
+    }
+
+    j = &jobs[num_jobs++];
+    checkmem( j->level = MALLOC(len + strlen(name) + 1) );
+    strncpy(j->level, path, len);
+    strcpy(j->level + len, name);
+    j->hog = hog;
+    j->log = NULL;
+    j->pid = -1;
+    j->ok = 0;
+}
+
+
+/* the length of the directory part of fname */
+static int pathlen(const char *fname) {
+    const char *s = strrchr(fname, '/');
+
+
+    return s == NULL ? 0 : s - fname + 1;
+}
+
+
+static int hasext(const char *fname, const char *ext) {
+    const char *s = strrchr(fname, '.');
+
+
+    if (s == NULL || strlen(s + 1) != strlen(ext)) {
+        return 0;
+    }
+
+    for (s++; *s != 0; s++, ext++) {
+        if (toupper(*s) != toupper(*ext)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* add the levels of the mission fname: after the lines num_levels=n and
+   num_secrets=n the next n lines are the names of the levels (the
+   secret ones followed by a comma and the level they are reached from).
+   The levels are taken from the hog-file with the name of the mission if
+   they are in it. */
+static int addmission(const char *fname) {
+    struct hog_file *h;
+    FILE *f;
+    char buffer[256], name[256], *hogname;
+    int n = 0, e, used = 0;
+
+
+    if ( ( f = fopen(fname, "r") ) == NULL ) {
+        return 0;
+    }
+
+    checkmem( hogname = MALLOC(strlen(fname) + 1) );
+    strcpy(hogname, fname);
+    strcpy(&hogname[strlen(hogname) - 3],
+           isupper(fname[strlen(fname) - 1]) ? "HOG" : "hog");
+    h = hog_open(hogname);
+
+    while ( fgets(buffer, 256, f) != NULL ) {
+        if (n > 0) {
+            if (sscanf(buffer, " %255[^,; \t\r\n]", name) == 1) {
+                if ( h != NULL && ( e = hog_find(h, name) ) >= 0 ) {
+                    addjob("", 0, h->entries[e].name, hogname);
+                    used = 1;
+                }
+                else {
+                    addjob(fname, pathlen(fname), name, NULL);
+                }
+
+                n--;
+            }
+        }
+        else if (sscanf(buffer, " num_levels = %d", &n) != 1
+                && sscanf(buffer, " num_secrets = %d", &n) != 1) {
+            n = 0;
+        }
+    }
+
+    fclose(f);
+    hog_close(h);
+
+    if (!used) {
+        FREE(hogname);
+    }
+
+    return 1;
+}
+
+
+/* where the level fname is saved. Converted levels get the extension of
+   the new version. */
+static char *outname(const char *fname, int converted) {
+    const char *base = fname + pathlen(fname);
+    char *out;
+    int len = b_outdir != NULL ? strlen(b_outdir) + 1 : base - fname;
+
+
+    checkmem( out = MALLOC(len + strlen(base) + 1) );
+
+    if (b_outdir != NULL) {
+        strcpy(out, b_outdir);
+        strcat(out, "/");
+    }
+    else {
+        strncpy(out, fname, len);
+        out[len] = 0;
+    }
+
+    strcat(out, base);
+
+    if ( converted && strrchr(base, '.') != NULL
+        && strlen( strrchr(base, '.') ) == 4 ) {
+        strcpy(&out[strlen(out) - 3], extnames[init.d_ver]);
+    }
+
+    return out;
+}
+
+
+/* the file in b_tmpdir for the level name from a hog-file */
+static char *tmpname(const char *name) {
+    char *fname;
+
+
+    checkmem( fname = MALLOC(strlen(b_tmpdir) + strlen(name) + 2) );
+    sprintf(fname, "%s/%s", b_tmpdir, name);
+    return fname;
+}
+
+
+/* copy the level of j from its hog-file to b_tmpdir. Returns the name of
+   the copy or NULL if it fails. */
+static char *extractlevel(const struct batchjob *j) {
+    struct hog_file *h;
+    FILE *f;
+    char *fname;
+    int e, ok = 0;
+
+
+    if ( ( h = hog_open(j->hog) ) == NULL ) {
+        return NULL;
+    }
+
+    fname = tmpname(j->level);
+
+    if ( ( e = hog_find(h, j->level) ) >= 0
+        && ( f = fopen(fname, "wb") ) != NULL ) {
+        ok = hog_copytofile(f, h->fd, h->entries[e].pos, h->entries[e].size);
+        ok = fclose(f) == 0 && ok;
+    }
+
+    hog_close(h);
+
+    if (!ok) {
+        FREE(fname);
+    }
+
+    return ok ? fname : NULL;
+}
+
+
+/* check the level like savelevel does, with the lights which are saved.
+   Returns 1 if it's ok. */
+static int checklevel(struct leveldata *ld) {
+    struct list turnoffs, changedlights, fl_lights;
+    int ok;
+
+
+    initlist(&turnoffs);
+    initlist(&changedlights);
+    initlist(&fl_lights);
+
+    if (init.d_ver >= d2_10_sw && ld->levelillum > 0) {
+        makelights(ld, &turnoffs, &changedlights, &fl_lights, 1);
+    }
+
+    ok = checklvl(ld, 1, &turnoffs, &changedlights);
+    freelist(&turnoffs, free);
+    freelist(&changedlights, free);
+    freelist(&fl_lights, NULL);
+    return ok;
+}
+
+
+/* the work of one process. Returns 1 if the level is ok. */
+static int dolevel(struct batchjob *j) {
+    struct leveldata *ld;
+    unsigned long questions;
+    char *fname, *out;
+    int converted, ok = 1;
+
+
+    questions = userio_questions;
+    fname = j->level;
+
+    if ( j->hog != NULL && ( fname = extractlevel(j) ) == NULL ) {
+        fprintf(errf, "Can't read level %s from %s\n", j->level, j->hog);
+        return 0;
+    }
+
+    if ( ( ld = readlevel(fname) ) == NULL ) {
+        fprintf(errf, "Can't read level %s\n", j->level);
+        return 0;
+    }
+
+    converted = loading_level_version < d2_10_sw && init.d_ver >= d2_10_sw;
+
+    if (converted && !b_convert) {
+        fprintf(errf, "%s is a Descent 1 level, use -c to convert it\n",
+                j->level);
+        return 0;
+    }
+
+    if (loading_level_version >= d2_10_sw && init.d_ver < d2_10_sw) {
+        fprintf(errf, "%s is a Descent 2 level, but Devil is configured "
+                "for Descent 1\n", j->level);
+        return 0;
+    }
+
+    if (converted && j->hog != NULL) {
+        fprintf(errf, "%s is in %s, it can't be converted without its "
+                "mission\n", j->level, j->hog);
+        return 0;
+    }
+
+    in_changecurrentlevel(ld);
+    newpigfile(ld->pigname, pig.pogfile);
+
+    if (b_illum && ld->cubes.size > 0) {
+        if ( !tagall(tt_cube) ) {
+            fprintf(errf, "Can't tag the cubes of %s\n", j->level);
+            return 0;
+        }
+
+        calccornerlight(b_smooth || isAlwaysSmoothing);
+        setinnercubelight();
+        ld->levelillum = 1;
+    }
+
+    if ( !checklevel(ld) ) {
+        fprintf(errf, "%s has errors\n", j->level);
+        ok = 0;
+    }
+    else if (b_save) {
+        /* a level from a hog-file is saved over its copy */
+        out = j->hog != NULL ? fname : outname(fname, converted);
+
+        /* it's checked already, savelevel only numbers the data */
+        if ( !savelevel(out, ld, -1, 1, init.d_ver, 1) ) {
+            fprintf(errf, "Can't save level %s to %s\n", j->level, out);
+            ok = 0;
+        }
+
+        if (out != fname) {
+            FREE(out);
+        }
+    }
+
+    if (b_strict && userio_questions != questions) {
+        fprintf(errf, "%lu warnings for %s\n", userio_questions - questions,
+                j->level);
+        ok = 0;
+    }
+
+    return ok;
+}
+
+
+/* write the hog-file hogname again with the levels which were saved in
+   b_tmpdir, the other entries are copied. Returns 0 if it fails. */
+static int savehog(const char *hogname) {
+    struct hog_file *h;
+    struct hog_entry *e;
+    struct batchjob *j;
+    FILE *f;
+    char *out, *newname, *fname;
+    int i, ok;
+
+
+    if ( ( h = hog_open(hogname) ) == NULL ) {
+        return 0;
+    }
+
+    out = outname(hogname, 0);
+    checkmem( newname = MALLOC(strlen(out) + 5) );
+    strcpy(newname, out);
+    strcat(newname, ".new");
+
+    if ( ( f = fopen(newname, "wb") ) == NULL ) {
+        hog_close(h);
+        FREE(newname);
+        FREE(out);
+        return 0;
+    }
+
+    ok = fwrite("DHF", 1, 3, f) == 3;
+
+    for (i = 0, e = h->entries; ok && i < h->num_entries; i++, e++) {
+        for (j = jobs; j < jobs + num_jobs; j++) {
+            if (j->hog == hogname && j->ok && strcmp(j->level, e->name) == 0) {
+                break;
+            }
+        }
+
+        if (j < jobs + num_jobs) {
+            fname = tmpname(e->name);
+            ok = hog_writefile(f, e->name, fname) > 0;
+            FREE(fname);
+        }
+        else {
+            ok = hog_writeentry(f, e->name, h->fd, e->pos, e->size);
+        }
+    }
+
+    ok = fclose(f) == 0 && ok;
+    hog_close(h);
+    ok = ok && rename(newname, out) == 0;
+
+    if (!ok) {
+        remove(newname);
+    }
+
+    FREE(newname);
+    FREE(out);
+    return ok;
+}
+
+
+/* write the hog-files with the saved levels and remove b_tmpdir. The
+   levels of a hog-file which can't be written fail. */
+static void finishhogs(void) {
+    struct batchjob *j, *k;
+    char *fname;
+
+
+    for (j = jobs; j < jobs + num_jobs; j++) {
+        if (j->hog == NULL) {
+            continue;
+        }
+
+        for (k = jobs; k < j && k->hog != j->hog; k++) {
+        }
+
+        if (k == j && b_save && !savehog(j->hog) ) {
+            fprintf(errf, "Can't write the hog-file %s\n", j->hog);
+
+            for (k = j; k < jobs + num_jobs; k++) {
+                if (k->hog == j->hog) {
+                    k->ok = 0;
+                }
+            }
+        }
+    }
+
+    for (j = jobs; j < jobs + num_jobs; j++) {
+        if (j->hog != NULL) {
+            fname = tmpname(j->level);
+            remove(fname);
+            FREE(fname);
+        }
+    }
+
+    rmdir(b_tmpdir);
+}
+
+
+/* wait for one of the running processes and print its messages */
+static void waitjob(void) {
+    struct batchjob *j;
+    pid_t pid;
+    int status, c;
+
+
+    if ( ( pid = wait(&status) ) < 0 ) {
+        return;
+    }
+
+    for (j = jobs; j < jobs + num_jobs && j->pid != pid; j++) {
+    }
+
+    if (j == jobs + num_jobs) {
+        return;
+    }
+
+    j->pid = -1;
+    j->time = thr_walltime() - j->time;
+    j->ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    rewind(j->log);
+
+    while ( ( c = getc(j->log) ) != EOF ) {
+        putc(c, stderr);
+    }
+
+    fclose(j->log);
+}
+
+
+int main(int argn, char *argc[]) {
+    struct batchjob *j;
+    int i, arg, num_processes = 0, running = 0, failed = 0, cpus, ok;
+    int hoglevels = 0;
+    char *pigname;
+
+
+    if (sizeof(float) != 4 || sizeof(long int) != 4 || sizeof(short int) != 2
+       || sizeof(int) != 4 || sizeof(char) != 1) {
+        printf("Wrong float/int size. Check your compiler flags.\n");
+        exit(2);
+    }
+
+    errf = stderr;
+
+    for (arg = 1; arg < argn && argc[arg][0] == '-'; arg++) {
+        switch (argc[arg][1]) {
+            case 'j':
+
+                if (++arg >= argn || ( num_processes = atoi(argc[arg]) ) < 1) {
+                    usage();
+                }
+
+                break;
+
+            case 'o':
+
+                if (++arg >= argn) {
+                    usage();
+                }
+
+                b_outdir = argc[arg];
+                break;
+
+            case 'i':
+                b_illum = 1;
+                break;
+
+            case 's':
+                b_smooth = 1;
+                break;
+
+            case 'c':
+                b_convert = 1;
+                break;
+
+            case 'v':
+                b_strict = 1;
+                break;
+
+            case 'n':
+                b_save = 0;
+                break;
+
+            default:
+                usage();
+        }
+    }
+
+    if (arg >= argn) {
+        usage();
+    }
+
+    for (; arg < argn; arg++) {
+        if ( hasext(argc[arg], "msn") || hasext(argc[arg], "mn2") ) {
+            if ( !addmission(argc[arg]) ) {
+                fprintf(errf, "Can't read mission %s\n", argc[arg]);
+                exit(2);
+            }
+        }
+        else {
+            addjob("", 0, argc[arg], NULL);
+        }
+    }
+
+    /* e.g. a mission with an empty hog-file */
+    if (num_jobs == 0) {
+        fprintf(errf, "No levels to do\n");
+        exit(2);
+    }
+
+    for (i = 0; i < num_jobs; i++) {
+        hoglevels += jobs[i].hog != NULL;
+    }
+
+    if (hoglevels > 0) {
+        checkmem( b_tmpdir = MALLOC(strlen("/tmp/dbatchXXXXXX") + 1) );
+        strcpy(b_tmpdir, "/tmp/dbatchXXXXXX");
+
+        if (mkdtemp(b_tmpdir) == NULL) {
+            fprintf(errf, "Can't make a directory for the levels\n");
+            exit(2);
+        }
+    }
+
+    initeditor(INIFILE, 0);
+
+    if ( !readconfig() ) {
+        fprintf(errf, "Can't read the configuration. Start Devil first.\n");
+        exit(2);
+    }
+
+    /* nobody can answer the question if the level should be illuminated
+       before it's saved */
+    view.warn_illuminate = 0;
+    inittimer();
+    pigname = pig.current_pigname;
+    pig.current_pigname = NULL;
+    newpigfile(pigname, NULL);
+    FREE(pigname);
+
+    /* the processors are shared between the processes, each one takes
+       its part for the illumination threads */
+    cpus = thr_numthreads();
+
+    if (num_processes == 0) {
+        num_processes = cpus;
+    }
+
+    if (num_processes > num_jobs) {
+        num_processes = num_jobs;
+    }
+
+    theNumThreads = cpus / num_processes > 1 ? cpus / num_processes : 1;
+    fflush(NULL);
+
+    for (i = 0, j = jobs; i < num_jobs; i++, j++) {
+        while (running >= num_processes) {
+            waitjob();
+            running--;
+        }
+
+        if ( ( j->log = tmpfile() ) == NULL ) {
+            fprintf(errf, "Can't make a file for the messages\n");
+            exit(2);
+        }
+
+        j->time = thr_walltime();
+
+        if ( ( j->pid = fork() ) == 0 ) {
+            errf = j->log;
+            fprintf(errf, "--- %s%s%s\n", j->hog != NULL ? j->hog : "",
+                    j->hog != NULL ? ": " : "", j->level);
+            ok = dolevel(j);
+            fflush(NULL);
+            _exit(ok ? 0 : 1);
+        }
+
+        if (j->pid < 0) {
+            fprintf(errf, "Can't start a process for %s\n", j->level);
+            fclose(j->log);
+            j->time = 0.0;
+            continue;
+        }
+
+        running++;
+    }
+
+    for (; running > 0; running--) {
+        waitjob();
+    }
+
+    if (b_tmpdir != NULL) {
+        finishhogs();
+    }
+
+    for (i = 0, j = jobs; i < num_jobs; i++, j++) {
+        printf("%s%s%s: %s (%.1f s)\n", j->hog != NULL ? j->hog : "",
+               j->hog != NULL ? ": " : "", j->level,
+               j->ok ? "ok" : "failed", j->time);
+        failed += !j->ok;
+    }
+
+    releasetimer();
+    return failed > 0;
+}
@@ -28,6 +28,10 @@
 #include "version.h"
 #include "do_event.h"
 #include "askcfg.h"
+#include "pvs.h"
+#include "profile.h"
+#include "plot.h"
+#include "do_light.h"
 
 const char *extnames[desc_number] = {
     "SDL", "RDL", "RDL", "SL2", "RL2", "RL2", "RL2"
@@ -146,6 +150,19 @@ const char *cmdline_switches[num_cmdlineparams] = {
 const char *cmdline_txts[num_cmdlineparams] = {
     TXT_CMDSTARTNEW, TXT_CMDDONTSHOWTITLE, TXT_CMDCONFIG
 };
+#ifndef HEADLESS /* the headless programs have their own main, see rbench.c */
+/* called in the main loop when the user does nothing: the light of the
+   changed cubes is calculated again (and the level drawn with it), then
+   the pvs is calculated */
+static void devil_idle(void) {
+    if (relightdirty() > 0) {
+        plotlevel();
+    }
+
+    pvs_idle();
+}
+
+
 int main(int argn, char *argc[]) {
     int i, j, title = 1;
     long int with_cfg = 1, reconfig = 0;
@@ -221,6 +238,8 @@ int main(int argn, char *argc[]) {
         writeconfig(1);
     }
 
+    /* with Profile=1 in devilx.ini the times are written at the end */
+    atexit(prof_atexit);
     initgrph(title);
     ws_disablectrlc();
     l = NULL;
@@ -240,9 +259,13 @@ int main(int argn, char *argc[]) {
         openlevel(load_file_name);
        }
      */
+    w_setpermanentroutine(devil_idle);
     w_handleuser(0, NULL, 0, NULL, view.num_keycodes, view.ec_keycodes,
                  do_event);
     return 1;
 }
 
 
+#endif
+
+
@@ -212,7 +212,7 @@ void help_refresh(struct w_window *w) {
     int i, j, o_y, x, y;
 
 
-    o_y = (int)w->data;
+    o_y = (long)w->data;
     ws_drawfilledbox(w_xwinincoord(w, 0), w_ywinincoord(w, o_y),
                      w_xwininsize(w), w_ywininsize(
                          w) - o_y, view.color[BLACK], 0);
@@ -339,7 +339,7 @@ void dec_help(int ec) {
                  w_addstdbutton(w, w_b_press, 100, 0, w_xwininsize(w) - 100,
                                 -1,
                                 TXT_OK, &ok, 1) );
-    w->data = (void *)(b_ok->ysize + 2);
+    w->data = (void *)(long)(b_ok->ysize + 2);
     cur_help_pos = 0;
     num_codes =
         (w_ymaxwinsize() - b_ok->ysize -
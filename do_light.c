@@ -26,6 +26,8 @@
 #include "do_event.h"
 #include "do_light.h"
 #include "lac_cfg.h"
+#include "threads.h"
+#include "profile.h"
 
 extern int init_test;
 
@@ -130,14 +132,85 @@ int checkcolltriangle(struct point *p1, struct point *m, struct point *r,
 }
 
 
+/* a side is split in the triangles 0,1,3 and 2,3,1. e is the first corner
+   of a triangle, r and s the vectors to the other corners and t=r X s */
+struct sidetriangles {
+    struct point e[2], r[2], s[2], t[2];
+};
+/* the triangles of all sides of the current level while the lightsources
+   are calculated, index cube->no*6+wall (see illum_makesides) */
+static struct sidetriangles *illum_sides;
+static int illum_numsides;
+
+
+static void maketriangles(struct node *c, int w, struct sidetriangles *st) {
+    static const int tc[2][3] = { { 0, 1, 3 }, { 2, 3, 1 } };
+    int k, i;
+
+
+    for (k = 0; k < 2; k++) {
+        for (i = 0; i < 3; i++) {
+            st->e[k].x[i] = c->d.c->p[wallpts[w][tc[k][0]]]->d.p->x[i];
+            st->r[k].x[i] = c->d.c->p[wallpts[w][tc[k][1]]]->d.p->x[i] -
+                            st->e[k].x[i];
+            st->s[k].x[i] = c->d.c->p[wallpts[w][tc[k][2]]]->d.p->x[i] -
+                            st->e[k].x[i];
+        }
+
+        VECTOR(&st->t[k], &st->r[k], &st->s[k]);
+    }
+}
+
+
+/* the triangles of side c,w from illum_sides or (if they aren't there)
+   calculated in st */
+static struct sidetriangles *gettriangles(struct node *c, int w,
+                                          struct sidetriangles *st) {
+    if (illum_sides != NULL && c->no >= 0 && c->no * 6 + w < illum_numsides) {
+        return &illum_sides[c->no * 6 + w];
+    }
+
+    maketriangles(c, w, st);
+    return st;
+}
+
+
+/* calculate the triangles of all sides once before the lightsources are
+   calculated, the points can't move while the threads are running */
+static void illum_makesides(void) {
+    struct node *n;
+    int w;
+
+
+    illum_numsides = (l->cubes.maxnum > 0 ? l->cubes.maxnum : 1) * 6;
+    checkmem( illum_sides =
+                 MALLOC(sizeof(struct sidetriangles) * illum_numsides) );
+
+    for (n = l->cubes.head; n->next != NULL; n = n->next) {
+        my_assert(n->no >= 0 && n->no * 6 < illum_numsides);
+
+        for (w = 0; w < 6; w++) {
+            maketriangles(n, w, &illum_sides[n->no * 6 + w]);
+        }
+    }
+}
+
+
+static void illum_freesides(void) {
+    FREE(illum_sides);
+    illum_numsides = 0;
+}
+
+
 /* procedure to check if the line from p1 to c->p[p] goes through all sides
    in arrays nc, nc_w. Number of sides: num_s. */
 int checkforline(struct point *p1, struct point *p2, int num_s,
                  struct node **nc,
                  int *nc_w)
 {
-    int side, i;
-    struct point ea, r, s, t, m, a;
+    int side, i, k;
+    struct point m, a;
+    struct sidetriangles sbuf, *st;
 
 
     /* m=p2-p1 */
@@ -158,45 +231,112 @@ int checkforline(struct point *p1, struct point *p2, int num_s,
                     nc_w[side]);
         }
 
+        st = gettriangles(nc[side], nc_w[side], &sbuf);
+
+        for (k = 0; k < 2; k++) {
+            for (i = 0; i < 3; i++) {
+                a.x[i] = p1->x[i] - st->e[k].x[i];
+            }
+
+            if ( checkcolltriangle(&a, &m, &st->r[k], &st->s[k],
+                                   &st->t[k]) ) {
+                if (init_test & 8) {
+                    fprintf(errf, "%d. checkcolltriangle true\n", k + 1);
+                }
+
+                break;
+            }
+        }
+
+        if (k == 2) { /* missed both triangles */
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* checkforline for the lines from p1 to each of the num_p points p2 at
+   once. The triangles and everything which depends only on p1 are
+   calculated once for each side instead of once for each line. vis[i] is
+   set to 0 if the line to p2[i] doesn't go through all sides, lines with
+   vis[i]==0 are not checked. */
+static void checkforlines(struct point *p1, struct point *p2, int num_p,
+                          int *vis, int num_s, struct node **nc, int *nc_w) {
+    int side, i, j, k, num_vis;
+    struct point m[24], a[2], h;
+    float at[2], d, x1, x2;
+    struct sidetriangles sbuf, *st;
+
+
+    my_assert(num_p <= 24);
+
+    for (j = 0, num_vis = 0; j < num_p; j++) {
         for (i = 0; i < 3; i++) {
-            ea.x[i] = nc[side]->d.c->p[wallpts[nc_w[side]][0]]->d.p->x[i];
-            r.x[i] = nc[side]->d.c->p[wallpts[nc_w[side]][1]]->d.p->x[i] -
-                     ea.x[i];
-            s.x[i] = nc[side]->d.c->p[wallpts[nc_w[side]][3]]->d.p->x[i] -
-                     ea.x[i];
-            a.x[i] = p1->x[i] - ea.x[i];
+            m[j].x[i] = p2[j].x[i] - p1->x[i];
         }
 
-        VECTOR(&t, &r, &s);
+        num_vis += vis[j] != 0;
+    }
+
+    for (side = num_s - 1; side >= 0 && num_vis > 0; side--) {
+        st = gettriangles(nc[side], nc_w[side], &sbuf);
 
-        if ( !checkcolltriangle(&a, &m, &r, &s, &t) ) { /* missed the triangle
-                                                          at all */
+        for (k = 0; k < 2; k++) {
             for (i = 0; i < 3; i++) {
-                ea.x[i] = nc[side]->d.c->p[wallpts[nc_w[side]][2]]->d.p->x[i];
-                r.x[i] =
-                    nc[side]->d.c->p[wallpts[nc_w[side]][3]]->d.p->x[i] -
-                    ea.x[i];
-                s.x[i] =
-                    nc[side]->d.c->p[wallpts[nc_w[side]][1]]->d.p->x[i] -
-                    ea.x[i];
-                a.x[i] = p1->x[i] - ea.x[i];
+                a[k].x[i] = p1->x[i] - st->e[k].x[i];
+            }
+
+            at[k] = SCALAR(&a[k], &st->t[k]);
+        }
+
+        /* the same as checkcolltriangle */
+        for (j = 0; j < num_p; j++) {
+            if (!vis[j]) {
+                continue;
             }
 
-            VECTOR(&t, &r, &s);
+            for (k = 0; k < 2; k++) {
+                d = SCALAR(&m[j], &st->t[k]);
+
+                if (fabs(d) <= ZERO) {
+                    if (fabs(at[k]) <= ZERO) {
+                        break;
+                    }
+
+                    continue;
+                }
+
+                d = 1 / d;
+                x1 = -at[k] * d;
+
+                if (x1 < -ZERO || x1 > 1.0 + ZERO) {
+                    continue;
+                }
+
+                VECTOR(&h, &a[k], &m[j]);
+                x1 = -SCALAR(&h, &st->s[k]) * d;
+
+                if (x1 < -ZERO || x1 > 1.0 + ZERO) {
+                    continue;
+                }
+
+                x2 = SCALAR(&h, &st->r[k]) * d;
+
+                if (x2 < -ZERO || x1 + x2 > 1.0 + ZERO) {
+                    continue;
+                }
 
-            if ( !checkcolltriangle(&a, &m, &r, &s, &t) ) {
-                return 0;
+                break;
             }
-            else if (init_test & 8) {
-                fprintf(errf, "2. checkcolltriangle true\n");
+
+            if (k == 2) {
+                vis[j] = 0;
+                num_vis--;
             }
         }
-        else if (init_test & 8) {
-            fprintf(errf, "1. checkcolltriangle true\n");
-        }
     }
-
-    return 1;
 }
 
 
@@ -239,18 +379,76 @@ int illum_checkwall(struct cube *c, int w) {
 }
 
 
+/* an index from the cube numbers to the effects of one lightsource, so
+   the effect on a cube is found without searching the list of effects */
+struct lse_index {
+    struct ls_effect **lse;
+    int size;
+};
+
+
+/* make an empty index for the cubes of the current level */
+static void lsei_init(struct lse_index *ei) {
+    ei->size = l->cubes.maxnum > 0 ? l->cubes.maxnum : 1;
+    checkmem( ei->lse = CALLOC( ei->size, sizeof(struct ls_effect *) ) );
+}
+
+
+static void lsei_free(struct lse_index *ei) {
+    FREE(ei->lse);
+    ei->size = 0;
+}
+
+
+static struct ls_effect *lsei_find(struct lse_index *ei, struct node *cube) {
+    return cube->no >= 0 && cube->no < ei->size ? ei->lse[cube->no] : NULL;
+}
+
+
+static void lsei_enter(struct lse_index *ei, struct ls_effect *lse) {
+    int size;
+
+
+    my_assert(lse->cube->no >= 0);
+
+    if (lse->cube->no >= ei->size) {
+        size = ei->size * 2 > lse->cube->no ? ei->size * 2 :
+               lse->cube->no + 1;
+        checkmem( ei->lse = REALLOC( ei->lse, sizeof(struct ls_effect *) *
+                                     size ) );
+        memset( ei->lse + ei->size, 0, sizeof(struct ls_effect *) *
+               (size - ei->size) );
+        ei->size = size;
+    }
+
+    ei->lse[lse->cube->no] = lse;
+}
+
+
+/* remove all effects in the list effects from the index */
+static void lsei_clear(struct lse_index *ei, struct list *effects) {
+    struct node *n;
+
+
+    for (n = effects->head; n->next != NULL; n = n->next) {
+        if (lsei_find(ei, n->d.lse->cube) == n->d.lse) {
+            ei->lse[n->d.lse->cube->no] = NULL;
+        }
+    }
+}
+
+
 /* init the list effects for the lightsources at lsp with light "light".
    The lightsource is in the cube cube_n, depth=0,
    nc and nc_w are two arrays of the size MAXDEPTH, depth=0. effects is an
-   empty list */
+   empty list and ei an empty index for it */
 void calclseffects(struct point *lsp, unsigned int light, struct node *cube_n,
                    int depth, struct node **nc, int *nc_w,
-                   struct list *effects)
+                   struct list *effects, struct lse_index *ei)
 {
-    int w, j, vis, onevis, wd, cd;
+    int w, j, vis[24], onevis, wd, cd;
     unsigned short add[24];
-    struct point endp;
-    struct node *n;
+    struct point endp[24];
     struct cube *c = cube_n->d.c;
     struct ls_effect *lse;
 
@@ -282,13 +480,7 @@ void calclseffects(struct point *lsp, unsigned int light, struct node *cube_n,
                 fprintf(errf, "\n");
             }
 
-            for (n = effects->head, lse = NULL; n->next != NULL; n =
-                     n->next) {
-                if (c->nc[w] == n->d.lse->cube) {
-                    lse = n->d.lse;
-                    break;
-                }
-            }
+            lse = lsei_find(ei, c->nc[w]);
 
             /* ok, a new cube. check if there's a wall which is in the way... */
             if (c->d[w] != NULL) {
@@ -307,12 +499,10 @@ void calclseffects(struct point *lsp, unsigned int light, struct node *cube_n,
                 fprintf(errf, "Checking points...");
             }
 
-            for (wd = 0, onevis = 0; wd < 6; wd++) {
+            for (wd = 0; wd < 6; wd++) {
                 for (cd = 0; cd < 4; cd++) {
-                    add[wd * 4 + cd] = 0;
-
                     for (j = 0; j < 3; j++) {
-                        endp.x[j] =
+                        endp[wd * 4 + cd].x[j] =
                             (c->nc[w]->d.c->p[wallpts[wd][(cd +
                                                            1) &
                                                           3]]->d.p->x[j] +
@@ -324,20 +514,27 @@ void calclseffects(struct point *lsp, unsigned int light, struct node *cube_n,
                             [j] * 0.98;
                     }
 
-                    /* check if the light can go from point p to point c->nc[w],p
-                       by
-                       passing all sides in the arrays nc, nc_w */
-                    vis = ( c->nc[w]->d.c->nc[wd] != cube_n
-                          && checkforline(lsp, &endp, depth + 1, nc, nc_w) );
+                    vis[wd * 4 + cd] = c->nc[w]->d.c->nc[wd] != cube_n;
+                }
+            }
+
+            /* check if the light can go from point p to the points of
+               c->nc[w] by passing all sides in the arrays nc, nc_w */
+            checkforlines(lsp, endp, 24, vis, depth + 1, nc, nc_w);
 
-                    if ( vis && (!lse || lse->add_light[w * 4 + cd] == 0) ) {
+            for (wd = 0, onevis = 0; wd < 6; wd++) {
+                for (cd = 0; cd < 4; cd++) {
+                    add[wd * 4 + cd] = 0;
+
+                    if ( vis[wd * 4 + cd] &&
+                        (!lse || lse->add_light[w * 4 + cd] == 0) ) {
                         onevis |= setcornerlight(lsp, light, c->nc[w], wd, cd,
                                                  add);
                     }
 
                     if (init_test & 4) {
-                        fprintf(errf, " %d:%d:%d:%d\n", wd, cd, vis,
-                                add[wd * 4 + cd]);
+                        fprintf(errf, " %d:%d:%d:%d\n", wd, cd,
+                                vis[wd * 4 + cd], add[wd * 4 + cd]);
                     }
                 }
             }
@@ -362,6 +559,7 @@ void calclseffects(struct point *lsp, unsigned int light, struct node *cube_n,
                 }
 
                 checkmem( addnode(effects, -1, lse) );
+                lsei_enter(ei, lse);
             }
 
             for (j = 0; j < 24; j++) {
@@ -378,7 +576,7 @@ void calclseffects(struct point *lsp, unsigned int light, struct node *cube_n,
                further, i.e. make the same procedure with the neighbour cube */
             if (depth < maxdepth - 1) {
                 calclseffects(lsp, light, c->nc[w], depth + 1, nc, nc_w,
-                              effects);
+                              effects, ei);
             }
         } /* end of for(w=0..5) if(walls[w]!=NULL) for each neighbour of cube c
             */
@@ -387,8 +585,14 @@ void calclseffects(struct point *lsp, unsigned int light, struct node *cube_n,
 }
 
 
-/* Calculate the effect from the lightsource light on side c,wall */
-void calcillumwall(struct node *c, int wall, int *light) {
+/* Calculate the effect from the lightsource light on side c,wall and
+   store it in the list effects. ei are two empty indexes (see
+   illum_getindexes), they are empty again at the end. Returns 0 if the
+   shape of the side is not valid. Only the level is read here, so this
+   may run in several threads at the same time. */
+int calcillumwall(struct node *c, int wall, int *light,
+                  struct list *effects, struct lse_index *ei)
+{
     int i, j, x, y, x2, y2, minx, maxx, miny, maxy, e1x, e1y, e2x, e2y, e3x,
         e3y, e4x, e4y, d1, d2,
         px, py, dp1, dp2 = 0, *nc_w, gx, gy, ox, oy, sub_in_sum,
@@ -400,10 +604,11 @@ void calcillumwall(struct node *c, int wall, int *light) {
     float sub_a[ILLUM_SUBGRIDSIZE * ILLUM_SUBGRIDSIZE],
           sub_b[ILLUM_SUBGRIDSIZE * ILLUM_SUBGRIDSIZE], a, b;
     struct point lsp;
-    struct lightsource *ls;
-    struct list effects, illum_cubes;
-    struct ls_effect *lse;
+    struct list illum_cubes;
+    struct ls_effect *lse, *old_lse;
+    struct lse_index *effects_index = &ei[0], *illum_index = &ei[1];
     unsigned long tmp;
+    double t = prof_start();
 
 
     if (init_test & 4) {
@@ -411,8 +616,6 @@ void calcillumwall(struct node *c, int wall, int *light) {
                 wall);
     }
 
-    checkmem( nc_w = MALLOC(sizeof(int) * maxdepth) );
-    checkmem( nc = MALLOC(sizeof(struct node *)*maxdepth) );
     minx = miny = 65536;
     maxx = maxy = -65536;
 
@@ -450,10 +653,13 @@ void calcillumwall(struct node *c, int wall, int *light) {
     d2 = e3x * e4y - e3y * e4x;
 
     if (d1 == 0 || d2 == 0) {
-        waitmsg(TXT_CANTCALCLIGHT, c->no, wall);
-        return;
+        prof_end(ps_illumwall, t);
+        return 0;
     }
 
+    checkmem( nc_w = MALLOC(sizeof(int) * maxdepth) );
+    checkmem( nc = MALLOC(sizeof(struct node *)*maxdepth) );
+
     for (i = 0; i < 3; i++) {
         center.x[i] = 0.0;
 
@@ -468,9 +674,9 @@ void calcillumwall(struct node *c, int wall, int *light) {
         e4.x[i] = w->p[3]->d.p->x[i] - w->p[2]->d.p->x[i];
     }
 
-    initlist(&effects);
+    initlist(effects);
     checkmem( lse = MALLOC( sizeof(struct ls_effect) ) );
-    checkmem( addnode(&effects, -1, lse) );
+    checkmem( addnode(effects, -1, lse) );
 
     for (i = 0; i < 24; i++) {
         lse->add_light[i] = 0;
@@ -478,6 +684,7 @@ void calcillumwall(struct node *c, int wall, int *light) {
     }
 
     lse->cube = c;
+    lsei_enter(effects_index, lse);
 
     if (init_test & 4) {
         fprintf(errf, "cube %d wall %d: %hd,%hd %hd,%hd %hd,%hd %hd,%hd\n",
@@ -626,35 +833,30 @@ void calcillumwall(struct node *c, int wall, int *light) {
                             (unsigned int)(light[y * ILLUM_GRIDSIZE + x] * a),
                             c,
                             0, nc,
-                            nc_w, &illum_cubes);
+                            nc_w, &illum_cubes, illum_index);
+                        lsei_clear(illum_index, &illum_cubes);
 
                         for (n = illum_cubes.head->next; n != NULL;
                              n = n->next) {
-                            for (ne = effects.head; ne->next != NULL;
-                                 ne = ne->next) {
-                                if (ne->d.lse->cube ==
-                                    n->prev->d.lse->cube) {
-                                    break;
-                                }
-                            }
+                            ne = n->prev;
+                            unlistnode(&illum_cubes, ne);
 
-                            if (ne->next) {
+                            if ( ( old_lse = lsei_find(effects_index,
+                                                       ne->d.lse->cube) ) !=
+                                NULL ) {
                                 for (i = 0; i < 24; i++)                    {
-                                    ne->d.lse->add_light[i] =
-                                        (tmp = ne->d.lse->add_light[i] +
-                                               n->prev->d.lse->add_light[i])
+                                    old_lse->add_light[i] =
+                                        (tmp = old_lse->add_light[i] +
+                                               ne->d.lse->add_light[i])
                                         > theMaxLight ? theMaxLight : tmp;
                                 }
 
-                                ne = n->prev;
                                 FREE(ne->d.lse);
-                                unlistnode(&illum_cubes, ne);
-                                FREE(ne);
+                                POOLFREE(ne);
                             }
                             else {
-                                ne = n->prev;
-                                unlistnode(&illum_cubes, ne);
-                                listnode_tail(&effects, ne);
+                                listnode_tail(effects, ne);
+                                lsei_enter(effects_index, ne->d.lse);
                             }
                         }
                     }
@@ -663,33 +865,248 @@ void calcillumwall(struct node *c, int wall, int *light) {
         }
     }
 
+    lsei_clear(effects_index, effects);
+    FREE(nc);
+    FREE(nc_w);
+    prof_end(ps_illumwall, t);
+    return 1;
+}
+
+
+/* The effects of all lightsources of a level are in one array
+   (leveldata.packed_effects), the effects of each lightsource one after
+   the other. This is the only copy of them: the renderer switches the
+   flickering lights for every frame (render_switchlights), which is then
+   a walk through one piece of memory instead of a list of separately
+   allocated effects, and a level needs no list node and no memory block
+   for each effect. Where the effects are calculated or changed they are
+   made a list of ls_effects with getlseffects and put back with
+   setlseffects.
+   If the effects of a lightsource get more or are removed, their old
+   place in the array is left unused. The array is made again without the
+   unused effects if they are more than half of it or if the array is
+   full. */
+
+/* make the array of ld again without the unused effects and with room
+   for at least num new effects */
+static void repackeffects(struct leveldata *ld, int num) {
+    struct packed_effect *packed;
+    struct node *n;
+    int num_packed = 0, max;
+
+
+    max = (ld->num_packed_effects - ld->num_unused_effects + num) * 2;
+
+    if (max < 16) {
+        max = 16;
+    }
+
+    checkmem( packed = MALLOC(sizeof(struct packed_effect) * max) );
+
+    for (n = ld->lightsources.head; n->next != NULL; n = n->next) {
+        if (n->d.ls->pe_num > 0) {
+            memcpy( packed + num_packed,
+                   ld->packed_effects + n->d.ls->pe_start,
+                   sizeof(struct packed_effect) * n->d.ls->pe_num );
+        }
+
+        n->d.ls->pe_start = num_packed;
+        num_packed += n->d.ls->pe_num;
+    }
+
+    if (ld->packed_effects != NULL) {
+        FREE(ld->packed_effects);
+    }
+
+    ld->packed_effects = packed;
+    ld->num_packed_effects = num_packed;
+    ld->num_unused_effects = 0;
+    ld->max_packed_effects = max;
+}
+
+
+/* init the list effects with the effects of ls as ls_effects */
+void getlseffects(struct lightsource *ls, struct list *effects) {
+    struct packed_effect *pe, *end;
+    struct ls_effect *lse;
+    int i;
+
+
+    initlist(effects);
+
+    for (pe = ls->ld->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+         pe < end; pe++) {
+        checkmem( lse = MALLOC( sizeof(struct ls_effect) ) );
+        lse->cube = pe->cube;
+        memcpy( lse->add_light, pe->add_light, sizeof(lse->add_light) );
+
+        for (i = 0; i < 24; i++) {
+            lse->smoothed[i] = (pe->smoothed & (1UL << i)) != 0;
+        }
+
+        checkmem( addnode(effects, -1, lse) );
+    }
+}
+
+
+/* make the ls_effects in the list effects the effects of ls and free the
+   list. ls must be in the list of lightsources of ls->ld. The light of
+   the corners is not changed. */
+void setlseffects(struct lightsource *ls, struct list *effects) {
+    struct leveldata *ld = ls->ld;
+    struct packed_effect *pe;
+    struct node *n;
+    int i;
+
+
+    if (effects->size <= ls->pe_num) {
+        ld->num_unused_effects += ls->pe_num - effects->size;
+    }
+    else {
+        ld->num_unused_effects += ls->pe_num;
+        ls->pe_num = 0;
+
+        if ( ld->num_packed_effects + effects->size > ld->max_packed_effects
+            || ld->num_unused_effects * 2 > ld->num_packed_effects ) {
+            repackeffects(ld, effects->size);
+        }
+
+        ls->pe_start = ld->num_packed_effects;
+        ld->num_packed_effects += effects->size;
+    }
+
+    ls->pe_num = effects->size;
+
+    for (n = effects->head, pe = ld->packed_effects + ls->pe_start;
+         n->next != NULL; n = n->next, pe++) {
+        pe->cube = n->d.lse->cube;
+        memcpy( pe->add_light, n->d.lse->add_light, sizeof(pe->add_light) );
+
+        for (i = 0, pe->smoothed = 0; i < 24; i++) {
+            if (n->d.lse->smoothed[i]) {
+                pe->smoothed |= 1UL << i;
+            }
+        }
+    }
+
+    freelist(effects, free);
+}
+
+
+/* subtract the light of the effects of ls from the corners and remove
+   the effects */
+void removelseffects(struct lightsource *ls) {
+    struct leveldata *ld = ls->ld;
+    struct packed_effect *pe, *end;
+    struct wall *wall;
+    long overflow;
+    int w, c;
+
+
+    for (pe = ld->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+         pe < end; pe++) {
+        for (w = 0; w < 6; w++) {
+            if ( ( wall = pe->cube->d.c->walls[w] ) == NULL ) {
+                continue;
+            }
+
+            for (c = 0; c < 4; c++) {
+                overflow = (long)wall->corners[c].light -
+                           pe->add_light[w * 4 + c];
+                wall->corners[c].light = overflow < view.illum_minvalue ?
+                                         view.illum_minvalue : overflow;
+            }
+        }
+    }
+
+    ld->num_unused_effects += ls->pe_num;
+    ls->pe_num = 0;
+
+    if (ld->num_unused_effects * 2 > ld->num_packed_effects) {
+        repackeffects(ld, 0);
+    }
+}
+
+
+/* make the lightsource for side c,wall with the effects calculated by
+   calcillumwall and add it to the level */
+void addillumlightsource(struct node *c, int wall, struct list *effects) {
+    struct lightsource *ls;
+    struct packed_effect *pe, *end;
+    int i;
+
+
     checkmem( ls = MALLOC( sizeof(struct lightsource) ) );
-    copylisthead(&ls->effects, &effects);
     ls->cube = c;
     ls->w = wall;
     ls->fl = NULL;
+    ls->ld = l;
+    ls->pe_start = ls->pe_num = 0;
     my_assert(c->d.c->walls[wall] != NULL)
     checkmem( c->d.c->walls[wall]->ls = addnode(&l->lightsources, -1, ls) );
+    setlseffects(ls, effects);
 
     if (init_test & 4) {
         fprintf(errf, "Light from wall %d %d\n", ls->cube->no, ls->w);
 
-        for (n = ls->effects.head; n->next != NULL; n = n->next) {
-            fprintf(errf, " Cube %d:", n->d.lse->cube->no);
+        for (pe = l->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+             pe < end; pe++) {
+            fprintf(errf, " Cube %d:", pe->cube->no);
 
             for (i = 0; i < 24; i++) {
-                if (n->d.lse->add_light[i] != 0) {
+                if (pe->add_light[i] != 0) {
                     fprintf(errf, " %d,%d:%d", i / 4, i % 4,
-                            n->d.lse->add_light[i]);
+                            pe->add_light[i]);
                 }
             }
 
             fprintf(errf, "\n");
         }
     }
+}
 
-    FREE(nc);
-    FREE(nc_w);
+
+/* add (on!=0) the light add_light of an effect to the corners of cube
+   or subtract it (on==0) */
+static void switcheffect(struct cube *cube,
+                         const unsigned short *add_light, int on) {
+    struct wall *wall;
+    long light;
+    int w, c;
+
+
+    for (w = 0; w < 6; w++) {
+        if ( ( wall = cube->walls[w] ) == NULL ) {
+            continue;
+        }
+
+        for (c = 0; c < 4; c++) {
+            if (add_light[w * 4 + c] == 0) {
+                continue;
+            }
+
+            if (on) {
+                light = (long)wall->corners[c].light + add_light[w * 4 + c];
+                wall->corners[c].light = light > theMaxLight ?
+                                         theMaxLight : light;
+            }
+            else {
+                light = (long)wall->corners[c].light - add_light[w * 4 + c];
+                wall->corners[c].light = light < 0 ? 0 : light;
+            }
+        }
+    }
+}
+
+
+void switchlight(struct leveldata *ld, struct lightsource *ls, int on) {
+    struct packed_effect *pe, *end;
+
+
+    for (pe = ld->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+         pe < end; pe++) {
+        switcheffect(pe->cube->d.c, pe->add_light, on);
+    }
 }
 
 
@@ -828,158 +1245,167 @@ int getnbcorners(struct smoothcorner *nbcorners, struct node *c, int w,
 }
 
 
-void smoothlight(void) {
-    struct node *nls, *nlse, *nlse2;
-    int progress, last_progress = -1, num_nbs, w, p, sum_light, num_light, i,
-        j;
-    struct list new_effects;
+/* smooth the effects of the lightsource nls over the edges between the
+   sides. Corners which are already smoothed are not changed. */
+void smoothlightsource(struct node *nls) {
+    struct node *nlse;
+    int num_nbs, w, p, sum_light, num_light, i, j;
+    struct list effects, new_effects;
     struct ls_effect *lse;
     struct smoothcorner nbcorners[MAX_CORNERNB];
+    struct lse_index ei;
 
 
-    for (nls = l->lightsources.head; nls->next != NULL; nls = nls->next) {
-        if ( (progress = (nls->no * 100 / l->lightsources.size) / 5 * 5) !=
-            last_progress ) {
-            printmsg(TXT_SMOOTHINGLIGHT, progress);
-            last_progress = progress;
-        }
+    getlseffects(nls->d.ls, &effects);
+    initlist(&new_effects);
+    lsei_init(&ei);
 
-        initlist(&new_effects);
+    for (nlse = effects.head; nlse->next != NULL; nlse = nlse->next) {
+        lsei_enter(&ei, nlse->d.lse);
+    }
 
-        for (nlse = nls->d.ls->effects.head; nlse->next != NULL;
-             nlse = nlse->next) {
-            for (w = 0; w < 6; w++) {
-                for (p = 0; p < 4; p++) {
-                    if (!nlse->d.lse->smoothed[w * 4 + p] &&
-                        nlse->d.lse->add_light[w * 4 + p]) {
+    for (nlse = effects.head; nlse->next != NULL;
+         nlse = nlse->next) {
+        for (w = 0; w < 6; w++) {
+            for (p = 0; p < 4; p++) {
+                if (!nlse->d.lse->smoothed[w * 4 + p] &&
+                    nlse->d.lse->add_light[w * 4 + p]) {
+                    if (init_test & 4) {
+                        fprintf(
+                            errf,
+                            "Smoothing cube %d,wall %d,corner %d (light %d)\n",
+                            nlse->d.lse->cube->no, w, p,
+                            nlse->d.lse->add_light[w * 4 + p]);
+                    }
+
+                    num_nbs =
+                        getnbcorners(nbcorners, nlse->d.lse->cube, w,
+                                     p);
+
+                    for (i = 0, sum_light = 0, num_light = 0; i < num_nbs;
+                         i++) {
                         if (init_test & 4) {
                             fprintf(
                                 errf,
-                                "Smoothing cube %d,wall %d,corner %d (light %d)\n",
-                                nlse->d.lse->cube->no, w, p,
-                                nlse->d.lse->add_light[w * 4 + p]);
+                                "%d. NB_corner: cube %d w %d,%d,%d c %d,%d,%d s %d,%d,%d\n",
+                                i,
+                                nbcorners[i].cube->no,
+                                nbcorners[i].w[0], nbcorners[i].w[1],
+                                nbcorners[i].w[2], nbcorners[i].c[0],
+                                nbcorners[i].c[1],
+                                nbcorners[i].c[2],
+                                nbcorners[i].smooth[0],
+                                nbcorners[i].smooth[1],
+                                nbcorners[i].smooth[2]);
                         }
 
-                        num_nbs =
-                            getnbcorners(nbcorners, nlse->d.lse->cube, w,
-                                         p);
-
-                        for (i = 0, sum_light = 0, num_light = 0; i < num_nbs;
-                             i++) {
-                            if (init_test & 4) {
-                                fprintf(
-                                    errf,
-                                    "%d. NB_corner: cube %d w %d,%d,%d c %d,%d,%d s %d,%d,%d\n",
-                                    i,
-                                    nbcorners[i].cube->no,
-                                    nbcorners[i].w[0], nbcorners[i].w[1],
-                                    nbcorners[i].w[2], nbcorners[i].c[0],
-                                    nbcorners[i].c[1],
-                                    nbcorners[i].c[2],
-                                    nbcorners[i].smooth[0],
-                                    nbcorners[i].smooth[1],
-                                    nbcorners[i].smooth[2]);
-                            }
+                        nbcorners[i].lse = lsei_find(&ei, nbcorners[i].cube);
 
-                            nbcorners[i].lse = NULL;
+                        if (nbcorners[i].lse == NULL) {
+                            checkmem( lse =
+                                         MALLOC( sizeof(struct ls_effect) ) );
+                            checkmem( addnode(&new_effects, -1, lse) );
+                            lse->cube = nbcorners[i].cube;
 
-                            if (nbcorners[i].cube == nlse->d.lse->cube) {
-                                nbcorners[i].lse = nlse->d.lse;
-                            }
-                            else {
-                                for (nlse2 = nls->d.ls->effects.head;
-                                     nlse2->next != NULL;
-                                     nlse2 = nlse2->next) {
-                                    if (nlse2->d.lse->cube ==
-                                        nbcorners[i].cube) {
-                                        nbcorners[i].lse = nlse2->d.lse;
-                                    }
-                                }
+                            for (j = 0; j < 24; j++) {
+                                lse->add_light[j] = 0;
+                                lse->smoothed[j] = 0;
                             }
 
-                            if (nbcorners[i].lse == NULL) {
-                                checkmem( lse =
-                                             MALLOC( sizeof(struct ls_effect) ) );
-                                checkmem( addnode(&new_effects, -1, lse) );
-                                lse->cube = nbcorners[i].cube;
+                            nbcorners[i].lse = lse;
+                        }
 
-                                for (j = 0; j < 24; j++) {
-                                    lse->add_light[j] = 0;
-                                    lse->smoothed[j] = 0;
-                                }
-
-                                nbcorners[i].lse = lse;
-                            }
-
-                            for (j = 0; j < 3; j++) {
-                                if (nbcorners[i].smooth[j]
-                                   && nbcorners[i].cube->d.c->walls[nbcorners
-                                                                    [i].w[j]])
-                                {
-                                    sum_light +=
-                                        nbcorners[i].lse->add_light[nbcorners
-                                                                    [i].w
-                                                                    [j] * 4 +
-                                                                    nbcorners
-                                                                    [i].c[j]];
-                                    num_light++;
-                                }
+                        for (j = 0; j < 3; j++) {
+                            if (nbcorners[i].smooth[j]
+                               && nbcorners[i].cube->d.c->walls[nbcorners
+                                                                [i].w[j]])
+                            {
+                                sum_light +=
+                                    nbcorners[i].lse->add_light[nbcorners
+                                                                [i].w
+                                                                [j] * 4 +
+                                                                nbcorners
+                                                                [i].c[j]];
+                                num_light++;
                             }
                         }
+                    }
 
-                        if (num_light > 1) {
-                            sum_light /= num_light;
+                    if (num_light > 1) {
+                        sum_light /= num_light;
+
+                        for (i = 0; i < num_nbs; i++) {
+                            if (nbcorners[i].lse) {
+                                for (j = 0; j < 3; j++) {
+                                    if (nbcorners[i].smooth[j]
+                                       && nbcorners[i].cube->d.c->walls[
+                                            nbcorners[i].w[j]]) {
+                                        nbcorners[i].lse->smoothed[
+                                            nbcorners[i].w[j] * 4 +
+                                            nbcorners
+                                            [i].c[j]] = 1;
+
+                                        if (nbcorners[i].cube->d.c->walls
+                                            [nbcorners[i].w[j]]) {
+                                            if (init_test & 4) {
+                                                fprintf(
+                                                    errf,
+                                                    "Smoothing with cube %d(==%d) wall %d corner %d\n",
+                                                    nbcorners[i].lse
+                                                    ->cube->no,
+                                                    nbcorners[i].cube->no,
+                                                    nbcorners[i].w[j],
+                                                    nbcorners[i].c[j]);
+                                            }
 
-                            for (i = 0; i < num_nbs; i++) {
-                                if (nbcorners[i].lse) {
-                                    for (j = 0; j < 3; j++) {
-                                        if (nbcorners[i].smooth[j]
-                                           && nbcorners[i].cube->d.c->walls[
-                                                nbcorners[i].w[j]]) {
-                                            nbcorners[i].lse->smoothed[
+                                            nbcorners[i].lse->add_light[
                                                 nbcorners[i].w[j] * 4 +
                                                 nbcorners
-                                                [i].c[j]] = 1;
-
-                                            if (nbcorners[i].cube->d.c->walls
-                                                [nbcorners[i].w[j]]) {
-                                                if (init_test & 4) {
-                                                    fprintf(
-                                                        errf,
-                                                        "Smoothing with cube %d(==%d) wall %d corner %d\n",
-                                                        nbcorners[i].lse
-                                                        ->cube->no,
-                                                        nbcorners[i].cube->no,
-                                                        nbcorners[i].w[j],
-                                                        nbcorners[i].c[j]);
-                                                }
-
-                                                nbcorners[i].lse->add_light[
-                                                    nbcorners[i].w[j] * 4 +
-                                                    nbcorners
-                                                    [i].c[j]] = sum_light;
-                                            }
+                                                [i].c[j]] = sum_light;
                                         }
                                     }
                                 }
                             }
                         }
-                        else if (init_test & 4) {
-                            fprintf(errf, "No Smoothing.\n");
-                        }
+                    }
+                    else if (init_test & 4) {
+                        fprintf(errf, "No Smoothing.\n");
                     }
                 }
             }
         }
+    }
+
+    if (new_effects.head->next) {
+        new_effects.head->prev = effects.tail;
+        new_effects.tail->next = effects.tail->next;
+        effects.tail->next = new_effects.head;
+        effects.tail = new_effects.tail;
+        effects.size += new_effects.size;
+    }
+
+    lsei_free(&ei);
+    setlseffects(nls->d.ls, &effects);
+}
+
+
+void smoothlight(void) {
+    struct node *nls;
+    int progress, last_progress = -1;
+    double t = prof_start();
+
 
-        if (new_effects.head->next) {
-            new_effects.head->prev = nls->d.ls->effects.tail;
-            new_effects.tail->next = nls->d.ls->effects.tail->next;
-            nls->d.ls->effects.tail->next = new_effects.head;
-            nls->d.ls->effects.tail = new_effects.tail;
-            nls->d.ls->effects.size += new_effects.size;
+    for (nls = l->lightsources.head; nls->next != NULL; nls = nls->next) {
+        if ( (progress = (nls->no * 100 / l->lightsources.size) / 5 * 5) !=
+            last_progress ) {
+            printmsg(TXT_SMOOTHINGLIGHT, progress);
+            last_progress = progress;
         }
+
+        smoothlightsource(nls);
     }
+
+    prof_end(ps_smoothlight, t);
 }
 
 
@@ -1015,132 +1441,324 @@ int read_lightsources(void) {
 }
 
 
-void calccornerlight(int withsmooth) {
-    struct node *ntc, *nlse;
-    int ldrawn, per, w, c, i, j, x, y, light[ILLUM_GRIDSIZE * ILLUM_GRIDSIZE],
-        overall;
-    clock_t time1;
-    struct ws_event ws;
-    struct flickering_light fl;
+/* one side of a tagged cube for calccornerlight. The jobs are made and
+   merged in the main thread, only calcillumwall runs in the worker threads */
+struct illumjob {
+    struct node *cube;
+    int wall, overall, valid;
+    int light[ILLUM_GRIDSIZE * ILLUM_GRIDSIZE];
+    struct list effects;
+};
+struct illumjobs {
+    struct illumjob *jobs;
+    int num_jobs;
+    double time1;
+    int ldrawn;
+    /* the indexes for calcillumwall, two for each thread. The free ones
+       are in freeindexes[0..num_free-1] */
+    struct lse_index *indexes, **freeindexes;
+    int num_indexes, num_free;
+};
 
 
-    sortlist(&l->cubes, 0);
+/* make the indexes for calcillumwall once for all jobs of ij */
+static void illum_initindexes(struct illumjobs *ij) {
+    int i;
 
-    /* read the lightsource file */
-    if ( !read_lightsources() ) {
+
+    ij->num_indexes = ij->num_free = thr_numthreads();
+    checkmem( ij->indexes = MALLOC(sizeof(struct lse_index) * 2 *
+                                   ij->num_indexes) );
+    checkmem( ij->freeindexes = MALLOC(sizeof(struct lse_index *) *
+                                       ij->num_indexes) );
+
+    for (i = 0; i < ij->num_indexes; i++) {
+        lsei_init(&ij->indexes[i * 2]);
+        lsei_init(&ij->indexes[i * 2 + 1]);
+        ij->freeindexes[i] = &ij->indexes[i * 2];
+    }
+}
+
+
+static void illum_freeindexes(struct illumjobs *ij) {
+    int i;
+
+
+    for (i = 0; i < ij->num_indexes * 2; i++) {
+        lsei_free(&ij->indexes[i]);
+    }
+
+    FREE(ij->indexes);
+    FREE(ij->freeindexes);
+}
+
+
+static void illum_dojob(void *data, int job) {
+    struct illumjobs *ij = data;
+    struct illumjob *j = &ij->jobs[job];
+    struct lse_index *ei;
+
+
+    initlist(&j->effects);
+
+    if (j->overall <= 0) {
+        j->valid = 1;
         return;
     }
 
-    /* Set all lights to the default values */
-    time1 = clock();
+    /* not more jobs than threads run at the same time */
+    thr_lock();
+    my_assert(ij->num_free > 0);
+    ei = ij->freeindexes[--ij->num_free];
+    thr_unlock();
+    j->valid = calcillumwall(j->cube, j->wall, j->light, &j->effects, ei);
+    thr_lock();
+    ij->freeindexes[ij->num_free++] = ei;
+    thr_unlock();
+}
+
+
+static int illum_poll(void *data, int done) {
+    struct illumjobs *ij = data;
+    struct ws_event ws;
+
+
+    if (thr_walltime() - ij->time1 > ij->ldrawn) {
+        ws.key = 0;
+        ws_getevent(&ws, 0);
+        printmsg(TXT_CALCLIGHT, ij->jobs[done < ij->num_jobs ? done : 0].
+                 cube->no, (done * 100) / (float)ij->num_jobs,
+                 thr_walltime() - ij->time1, init.lightname);
+        ij->ldrawn = thr_walltime() - ij->time1;
+
+        if (ws.key == 27) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* get the light emitted from side c,w out of the textures. Returns the
+   sum of all values in light */
+static int getwalllight(struct wall *wall, int *light) {
+    int i, j, x, y, overall = 0;
+
+
+    if (wall->texture1 < pig.num_rdltxts
+       && pig.rdl_txts[wall->texture1].pig != NULL) {
+        for (i = 0; i < ILLUM_GRIDSIZE * ILLUM_GRIDSIZE; i++) {
+            overall += (light[i] = pig.rdl_txts[wall->texture1].my_light[i]);
+        }
+    }
+
+    if (wall->texture2 < pig.num_rdltxts
+       && pig.rdl_txts[wall->texture2].pig != NULL
+       && wall->texture2 != 0) {
+        for (i = 0; i < ILLUM_GRIDSIZE; i++) {
+            for (j = 0; j < ILLUM_GRIDSIZE; j++) {
+                switch (wall->txt2_direction) {
+                    case 0:
+                        y = i;
+                        x = j;
+                        break;
+
+                    case 1:
+                        y = ILLUM_GRIDSIZE - 1 - j;
+                        x = i;
+                        break;
+
+                    case 2:
+                        y = ILLUM_GRIDSIZE - 1 - i;
+                        x = ILLUM_GRIDSIZE - 1 - j;
+                        break;
+
+                    case 3:
+                        y = j;
+                        x = ILLUM_GRIDSIZE - 1 - i;
+                        break;
+
+                    default:
+                        y = i;
+                        x = j;
+                        break;
+                }
+
+                overall += (light[y * ILLUM_GRIDSIZE + x] +=
+                                pig.rdl_txts[wall->texture2].my_light[
+                                    i * ILLUM_GRIDSIZE + j]);
+            }
+        }
+    }
+
+    return overall;
+}
+
+
+/* the pre-calculated values for calcillumwall */
+static void illum_setup(void) {
     sqr_qw_mw =
         (view.illum_quarterway - MINWAY) * (view.illum_quarterway - MINWAY);
     qw_2mw = view.illum_quarterway - 2 * MINWAY;
     maxdepth = ( view.illum_quarterway / (10 * 65536.0) ) *
                ( view.illum_quarterway / (10 * 65536.0) ) + 4.5;
+}
 
-    /* reset the tagged edges */
-    for (ntc = l->tagged[tt_cube].head, per = 0, ldrawn = -10;
-         ntc->next != NULL;
-         ntc = ntc->next, per++) {
-        if ( (clock() - time1) / CLOCKS_PER_SEC > ldrawn ) {
-            ws_getevent(&ws, 0);
-            printmsg(TXT_CALCLIGHT, ntc->d.n->no,
-                     (per * 100) / (float)l->tagged[tt_cube].size,
-                     (clock() - time1) /
-                     (float)CLOCKS_PER_SEC, init.lightname);
-            ldrawn = (clock() - time1) / CLOCKS_PER_SEC;
-
-            if (ws.key == 27) {
-                break;
+
+/* replace the old lightsources of the calculated jobs with the new ones
+   in the order of the jobs, so the result doesn't depend on the number
+   of threads. Sides which were not calculated (ESC) keep their old
+   lightsource. */
+static void illum_replacels(struct illumjobs *ij, unsigned char *done) {
+    struct illumjob *job;
+    struct flickering_light fl;
+    int i;
+
+
+    for (i = 0, job = ij->jobs; i < ij->num_jobs; i++, job++) {
+        if (!done[i]) {
+            continue;
+        }
+
+        fl.delay = 0;
+
+        if (job->cube->d.c->walls[job->wall]->ls) { /* an old lightsource.
+                                                      Delete it but keep the
+                                                      fl */
+            if (job->cube->d.c->walls[job->wall]->ls->d.ls->fl) {
+                fl = *job->cube->d.c->walls[job->wall]->ls->d.ls->fl;
             }
+
+            freenode(&l->lightsources, job->cube->d.c->walls[job->wall]->ls,
+                     freelightsource);
         }
 
-        for (w = 0; w < 6; w++) {
-            if (ntc->d.n->d.c->walls[w] != NULL) {
-                fl.delay = 0;
+        job->cube->d.c->walls[job->wall]->ls = NULL;
 
-                if (ntc->d.n->d.c->walls[w]->ls) { /* an old lightsource. Delete
-                                                     it but keep the fl */
-                    if (ntc->d.n->d.c->walls[w]->ls->d.ls->fl) {
-                        fl = *ntc->d.n->d.c->walls[w]->ls->d.ls->fl;
-                    }
+        if (job->overall <= 0) {
+            continue;
+        }
 
-                    freenode(&l->lightsources, ntc->d.n->d.c->walls[w]->ls,
-                             freelightsource);
-                }
+        if (!job->valid) {
+            waitmsg(TXT_CANTCALCLIGHT, job->cube->no, job->wall);
+            continue;
+        }
 
-                ntc->d.n->d.c->walls[w]->ls = NULL;
-                overall = 0;
+        addillumlightsource(job->cube, job->wall, &job->effects);
 
-                if (ntc->d.n->d.c->walls[w]->texture1 < pig.num_rdltxts
-                   && pig.rdl_txts[ntc->d.n->d.c->walls[w]->texture1].pig !=
-                    NULL) {
-                    for (i = 0; i < ILLUM_GRIDSIZE * ILLUM_GRIDSIZE; i++) {
-                        overall += (light[i] =
-                                        pig.rdl_txts[ntc->d.n->d.c->walls[w]
-                                                     ->texture1].my_light[i]);
-                    }
-                }
+        if (fl.delay > 0) {
+            checkmem( job->cube->d.c->walls[job->wall]->ls->d.ls->fl =
+                         MALLOC( sizeof(struct flickering_light) ) );
+            *job->cube->d.c->walls[job->wall]->ls->d.ls->fl = fl;
+            job->cube->d.c->walls[job->wall]->ls->d.ls->fl->ls =
+                job->cube->d.c->walls[job->wall]->ls;
+        }
+    }
+}
 
-                if (ntc->d.n->d.c->walls[w]->texture2 < pig.num_rdltxts
-                   && pig.rdl_txts[ntc->d.n->d.c->walls[w]->texture2].pig !=
-                    NULL
-                   && ntc->d.n->d.c->walls[w]->texture2 != 0) {
-                    for (i = 0; i < ILLUM_GRIDSIZE; i++) {
-                        for (j = 0; j < ILLUM_GRIDSIZE; j++) {
-                            switch (ntc->d.n->d.c->walls[w]->txt2_direction)
-                            {
-                                case 0:
-                                    y = i;
-                                    x = j;
-                                    break;
-
-                                case 1:
-                                    y = ILLUM_GRIDSIZE - 1 - j;
-                                    x = i;
-                                    break;
-
-                                case 2:
-                                    y = ILLUM_GRIDSIZE - 1 - i;
-                                    x = ILLUM_GRIDSIZE - 1 - j;
-                                    break;
-
-                                case 3:
-                                    y = j;
-                                    x = ILLUM_GRIDSIZE - 1 - i;
-                                    break;
-
-                                default:
-                                    y = i;
-                                    x = j;
-                                    break;
-                            }
 
-                            overall += (light[y * ILLUM_GRIDSIZE + x] +=
-                                            pig.rdl_txts[ntc->d.n->d.c->walls
-                                                         [w]->texture2].
-                                            my_light[
-                                                i * ILLUM_GRIDSIZE + j]);
-                        }
+/* add the light of ls in the cube of pe to the corners (if setlight) and
+   ls to the flickering lights of the cube */
+static void illum_addeffect(struct lightsource *ls,
+                            const struct packed_effect *pe, int setlight) {
+    int i, j, overall;
+
+
+    for (i = 0; i < 6; i++) {
+        if (pe->cube->d.c->walls[i]) {
+            for (j = 0; j < 4; j++) {
+                if ( (overall = pe->add_light[i * 4 + j]) != 0 ) {
+                    if (init_test & 4) {
+                        fprintf(errf, " %d,%d,%d:%d", pe->cube->no, i, j,
+                                overall);
                     }
-                }
 
-                if (overall > 0) {
-                    calcillumwall(ntc->d.n, w, light);
+                    if (setlight) {
+                        overall += pe->cube->d.c->walls[i]->corners[j].light;
+                        pe->cube->d.c->walls[i]->corners[j].light =
+                            overall > theMaxLight ? theMaxLight : overall;
+                    }
 
-                    if (fl.delay > 0 && ntc->d.n->d.c->walls[w]->ls) {
-                        checkmem(
-                             ntc->d.n->d.c->walls[w]->ls->d.ls->fl = MALLOC(
-                                sizeof(struct flickering_light) ) );
-                        *ntc->d.n->d.c->walls[w]->ls->d.ls->fl = fl;
-                        ntc->d.n->d.c->walls[w]->ls->d.ls->fl->ls =
-                            ntc->d.n->d.c->walls[w]->ls;
+                    if (ls->fl != NULL) {
+                        checkmem( addnode(&pe->cube->d.c->fl_lights, -1,
+                                          ls->fl) );
                     }
                 }
             }
         }
     }
+}
+
+
+void calccornerlight(int withsmooth) {
+    struct node *ntc;
+    struct packed_effect *pe, *end;
+    int w, c;
+    struct illumjobs ij;
+    struct illumjob *job;
+    unsigned char *done;
+
+
+    sortlist(&l->cubes, 0);
+
+    /* read the lightsource file */
+    if ( !read_lightsources() ) {
+        return;
+    }
+
+    /* Set all lights to the default values */
+    ij.time1 = thr_walltime();
+    ij.ldrawn = -10;
+    illum_setup();
+
+    /* make a job for each side of the tagged cubes */
+    for (ntc = l->tagged[tt_cube].head, ij.num_jobs = 0; ntc->next != NULL;
+         ntc = ntc->next) {
+        for (w = 0; w < 6; w++) {
+            if (ntc->d.n->d.c->walls[w] != NULL) {
+                ij.num_jobs++;
+            }
+        }
+    }
+
+    if (ij.num_jobs == 0) {
+        ij.jobs = NULL;
+        done = NULL;
+    }
+    else {
+        checkmem( ij.jobs = MALLOC(sizeof(struct illumjob) * ij.num_jobs) );
+        checkmem( done = MALLOC(ij.num_jobs) );
+    }
+
+    for (ntc = l->tagged[tt_cube].head, job = ij.jobs; ntc->next != NULL;
+         ntc = ntc->next) {
+        for (w = 0; w < 6; w++) {
+            if (ntc->d.n->d.c->walls[w] != NULL) {
+                job->cube = ntc->d.n;
+                job->wall = w;
+                job->overall = getwalllight(ntc->d.n->d.c->walls[w],
+                                            job->light);
+                job++;
+            }
+        }
+    }
+
+    /* calculate the effects of all lightsources */
+    illum_makesides();
+    illum_initindexes(&ij);
+    thr_runjobs(ij.num_jobs, illum_dojob, illum_poll, &ij, done);
+    illum_freeindexes(&ij);
+    illum_freesides();
+
+    /* and replace the old lightsources with the new ones in the same order
+       as the sides were tagged */
+    illum_replacels(&ij, done);
+
+    if (ij.jobs) {
+        FREE(ij.jobs);
+        FREE(done);
+    }
 
     l->levelillum = 1;
 
@@ -1170,42 +1788,36 @@ void calccornerlight(int withsmooth) {
                     ntc->d.ls->w);
         }
 
-        for (nlse = ntc->d.ls->effects.head; nlse->next != NULL;
-             nlse = nlse->next) {
-            for (i = 0; i < 6; i++) {
-                if (nlse->d.lse->cube->d.c->walls[i]) {
-                    for (j = 0; j < 4; j++) {
-                        if ( (overall = nlse->d.lse->add_light[i * 4 + j]) !=
-                            0 ) {
-                            if (init_test & 4) {
-                                fprintf(errf, " %d,%d,%d:%d",
-                                        nlse->d.lse->cube->no,
-                                        i, j,
-                                        overall);
-                            }
+        for (pe = l->packed_effects + ntc->d.ls->pe_start,
+             end = pe + ntc->d.ls->pe_num; pe < end; pe++) {
+            illum_addeffect(ntc->d.ls, pe,
+                            ntc->d.ls->cube->d.c->tagged != NULL);
+        }
+    }
+}
 
-                            if (ntc->d.ls->cube->d.c->tagged) {
-                                overall +=
-                                    nlse->d.lse->cube->d.c->walls[i]->corners
-                                    [j].
-                                    light;
-                                nlse->d.lse->cube->d.c->walls[i]->corners[j].
-                                light =
-                                    overall >
-                                    theMaxLight ? theMaxLight : overall;
-                            }
 
-                            if (ntc->d.ls->fl != NULL) {
-                                checkmem( addnode(&nlse->d.lse->cube->d.c->
-                                                  fl_lights, -1,
-                                                  ntc->d.ls->fl) );
-                            }
-                        }
-                    }
-                }
+/* set the light of the cube to the average of its corners. Returns 0 if
+   the cube has no sides. */
+static int setavgcubelight(struct cube *c) {
+    int overall = 0, i = 0, w, k;
+
+
+    for (w = 0; w < 6; w++) {
+        if (c->walls[w] != NULL) {
+            i += 4;
+
+            for (k = 0; k < 4; k++) {
+                overall += c->walls[w]->corners[k].light;
             }
         }
     }
+
+    if (i > 0) {
+        c->light = overall / i;
+    }
+
+    return i > 0;
 }
 
 
@@ -1215,22 +1827,7 @@ void setinnercubelight(void) {
 
 
     for (ntc = l->tagged[tt_cube].head->next; ntc != NULL; ntc = ntc->next) {
-        overall = 0;
-        i = 0;
-
-        for (w = 0; w < 6; w++) {
-            if (ntc->prev->d.n->d.c->walls[w] != NULL) {
-                i += 4;
-
-                for (c = 0; c < 4; c++) {
-                    overall +=
-                        ntc->prev->d.n->d.c->walls[w]->corners[c].light;
-                }
-            }
-        }
-
-        if (i > 0) {
-            ntc->prev->d.n->d.c->light = overall / i;
+        if ( setavgcubelight(ntc->prev->d.n->d.c) ) {
             untag(tt_cube, ntc->prev->d.n);
         }
     }
@@ -1259,9 +1856,219 @@ void setinnercubelight(void) {
     }
 }
 
+/* the bits in cube.lightdirty */
+#define LD_CHANGED 1 /* the cube was changed, calculate the light of its sides
+                        and of all lightsources shining into it again */
+#define LD_TOUCHED 2 /* sum up the light of the corners again */
+
+/* cube c was changed (its points moved, its textures or doors changed or
+   it was inserted or deleted). Marks c and its neighbours, so the light
+   is calculated again by relightdirty. */
+void setlightdirty(struct node *c) {
+    int w;
+
+
+    if (!isAutoRelighting || c == NULL) {
+        return;
+    }
+
+    c->d.c->lightdirty |= LD_CHANGED;
+
+    for (w = 0; w < 6; w++) {
+        if (c->d.c->nc[w] != NULL) {
+            c->d.c->nc[w]->d.c->lightdirty |= LD_CHANGED;
+        }
+    }
+}
+
+
+/* the effects of ls are removed. Marks all cubes it shines into, so their
+   light is summed up again by relightdirty */
+void setlsdirty(struct lightsource *ls) {
+    struct packed_effect *pe, *end;
+
+
+    if (!isAutoRelighting || ls == NULL) {
+        return;
+    }
+
+    for (pe = ls->ld->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+         pe < end; pe++) {
+        pe->cube->d.c->lightdirty |= LD_TOUCHED;
+    }
+}
+
+
+/* 1 if the lightsource ls shines into a changed cube */
+static int lsinchangedcube(struct lightsource *ls) {
+    struct packed_effect *pe, *end;
+
+
+    for (pe = ls->ld->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+         pe < end; pe++) {
+        if (pe->cube->d.c->lightdirty & LD_CHANGED) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* 1 if side c,w must be calculated again */
+static int relightside(struct cube *c, int w) {
+    return c->walls[w] != NULL && ( (c->lightdirty & LD_CHANGED) ||
+                                   ( c->walls[w]->ls != NULL &&
+                                    lsinchangedcube(c->walls[w]->ls->d.ls) ) );
+}
+
+
+static void touchlseffects(struct lightsource *ls) {
+    struct packed_effect *pe, *end;
+
+
+    for (pe = ls->ld->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+         pe < end; pe++) {
+        pe->cube->d.c->lightdirty |= LD_TOUCHED;
+    }
+}
+
+
+/* calculate the light after an edit: only the sides of the changed cubes
+   and the lightsources which shine into them (found via the cubes in their
+   effect lists) are calculated again, then the light of all cubes these
+   lightsources shone or shine into is summed up from the effects of all
+   lightsources. Levels without lightsources (never illuminated) are not
+   changed. Returns the number of recalculated sides. */
+int relightdirty(void) {
+    struct node *n;
+    struct packed_effect *pe, *end;
+    struct illumjobs ij;
+    struct illumjob *job;
+    unsigned char *done;
+    int w, c, lit, num_dirty = 0;
+
+
+    if (l == NULL || !isAutoRelighting) {
+        return 0;
+    }
+
+    for (n = l->cubes.head; n->next != NULL; n = n->next) {
+        if (n->d.c->lightdirty) {
+            num_dirty++;
+        }
+    }
+
+    if (num_dirty == 0) {
+        return 0;
+    }
+
+    ij.num_jobs = 0;
+    lit = l->lightsources.size > 0;
+
+    if ( lit && read_lightsources() ) {
+        /* make a job for each side of the changed cubes and for each
+           lightsource shining into them */
+        for (n = l->cubes.head; n->next != NULL; n = n->next) {
+            for (w = 0; w < 6; w++) {
+                if ( relightside(n->d.c, w) ) {
+                    ij.num_jobs++;
+                }
+            }
+        }
+    }
+    else if (lit) {
+        isAutoRelighting = 0; /* don't read the file after each edit */
+    }
+
+    if (ij.num_jobs > 0) {
+        checkmem( ij.jobs = MALLOC(sizeof(struct illumjob) * ij.num_jobs) );
+        checkmem( done = MALLOC(ij.num_jobs) );
+        job = ij.jobs;
+
+        for (n = l->cubes.head; n->next != NULL; n = n->next) {
+            for (w = 0; w < 6; w++) {
+                if ( relightside(n->d.c, w) ) {
+                    job->cube = n;
+                    job->wall = w;
+                    job->overall = getwalllight(n->d.c->walls[w],
+                                                job->light);
+                    job++;
+                }
+            }
+        }
+
+        /* the cubes the old lightsources shone into */
+        for (job = ij.jobs; job < ij.jobs + ij.num_jobs; job++) {
+            if (job->cube->d.c->walls[job->wall]->ls != NULL) {
+                touchlseffects(job->cube->d.c->walls[job->wall]->ls->d.ls);
+            }
+        }
+
+        ij.time1 = thr_walltime();
+        ij.ldrawn = 1; /* only show a message if it takes longer */
+        illum_setup();
+        illum_makesides();
+        illum_initindexes(&ij);
+        thr_runjobs(ij.num_jobs, illum_dojob, illum_poll, &ij, done);
+        illum_freeindexes(&ij);
+        illum_freesides();
+        illum_replacels(&ij, done);
+
+        /* and the cubes the new lightsources shine into */
+        for (job = ij.jobs; job < ij.jobs + ij.num_jobs; job++) {
+            if (job->cube->d.c->walls[job->wall]->ls != NULL) {
+                if (isAlwaysSmoothing) {
+                    smoothlightsource(job->cube->d.c->walls[job->wall]->ls);
+                }
+
+                touchlseffects(job->cube->d.c->walls[job->wall]->ls->d.ls);
+            }
+        }
+
+        FREE(ij.jobs);
+        FREE(done);
+    }
+
+    /* sum up the light of all marked cubes again */
+    for (n = l->cubes.head; n->next != NULL; n = n->next) {
+        if (n->d.c->lightdirty && lit) {
+            for (w = 0; w < 6; w++) {
+                if (n->d.c->walls[w] != NULL) {
+                    for (c = 0; c < 4; c++) {
+                        n->d.c->walls[w]->corners[c].light =
+                            view.illum_minvalue;
+                    }
+                }
+            }
+
+            freelist(&n->d.c->fl_lights, NULL);
+        }
+    }
+
+    for (n = l->lightsources.head; n->next != NULL; n = n->next) {
+        for (pe = l->packed_effects + n->d.ls->pe_start,
+             end = pe + n->d.ls->pe_num; pe < end; pe++) {
+            if (pe->cube->d.c->lightdirty) {
+                illum_addeffect(n->d.ls, pe, 1);
+            }
+        }
+    }
+
+    for (n = l->cubes.head; n->next != NULL; n = n->next) {
+        if (n->d.c->lightdirty && lit) {
+            setavgcubelight(n->d.c);
+        }
+
+        n->d.c->lightdirty = 0;
+    }
+
+    return ij.num_jobs;
+}
+
 
 void dec_setcornerlight(int ec) {
-    clock_t time1;
+    double time1;
 
 
     if (l == NULL) {
@@ -1274,12 +2081,12 @@ void dec_setcornerlight(int ec) {
         return;
     }
 
-    time1 = clock();
+    time1 = thr_walltime();
     calccornerlight(ec == ec_mineillumsmooth);
     l->levelsaved = 0;
     drawopts();
     plotlevel();
-    printmsg(TXT_ENDSETCORNERLIGHT, (clock() - time1) / (float)CLOCKS_PER_SEC);
+    printmsg(TXT_ENDSETCORNERLIGHT, thr_walltime() - time1);
 }
 
 
@@ -1303,7 +2110,7 @@ void dec_setinnercubelight(int ec) {
 
 
 void dec_mineillum(int ec) {
-    clock_t time1;
+    double time1;
 
 
     if (l == NULL) {
@@ -1316,14 +2123,14 @@ void dec_mineillum(int ec) {
         return;
     }
 
-    time1 = clock();
+    time1 = thr_walltime();
     calccornerlight(isAlwaysSmoothing);
     setinnercubelight();
     l->levelsaved = 0;
     l->levelillum = 1;
     drawopts();
     plotlevel();
-    printmsg(TXT_ENDCALCLIGHT, (clock() - time1) / (float)CLOCKS_PER_SEC);
+    printmsg(TXT_ENDCALCLIGHT, thr_walltime() - time1);
 }
 
 
@@ -1361,63 +2168,30 @@ void dec_setlsfile(int ec) {
 
 
 void start_adjustlight(struct wall *wall) {
-    struct node *n, *nl;
-    int w, c, sum;
+    struct node *nl;
 
 
     my_assert(l != NULL && wall != NULL && wall->ls != NULL);
 
     for (nl = l->lightsources.head; nl->next != NULL; nl = nl->next) {
-        for (n = nl->d.ls->effects.head; n->next != NULL; n = n->next) {
-            my_assert(n->d.lse->cube != NULL);
-
-            for (w = 0; w < 6; w++) {
-                if (n->d.lse->cube->d.c->walls[w]) {
-                    for (c = 0; c < 4; c++) {
-                        if ( (sum = -n->d.lse->add_light[w * 4 + c]) != 0 ) {
-                            sum +=
-                                n->d.lse->cube->d.c->walls[w]->corners[c].
-                                light;
-                            n->d.lse->cube->d.c->walls[w]->corners[c].light =
-                                sum < 0 ? 0 : sum;
-                        }
-                    }
-                }
-            }
-        }
+        switchlight(l, nl->d.ls, 0);
     }
 
-    for (n = wall->ls->d.ls->effects.head; n->next != NULL; n = n->next) {
-        my_assert(n->d.lse->cube != NULL);
-
-        for (w = 0; w < 6; w++) {
-            if (n->d.lse->cube->d.c->walls[w]) {
-                for (c = 0; c < 4; c++) {
-                    if ( (sum = n->d.lse->add_light[w * 4 + c]) != 0 ) {
-                        sum +=
-                            n->d.lse->cube->d.c->walls[w]->corners[c].light;
-                        n->d.lse->cube->d.c->walls[w]->corners[c].light =
-                            sum > theMaxLight ?
-                            theMaxLight
-                            : sum;
-                    }
-                }
-            }
-        }
-    }
+    switchlight(l, wall->ls->d.ls, 1);
 }
 
 
 void end_adjustlight(struct wall *wall, int save) {
     struct node *n, *nl;
+    struct list effects;
     struct ls_effect *lse;
-    int w, c, sum;
+    int w, c;
 
 
     my_assert(l != NULL && wall != NULL && wall->ls != NULL);
 
     if (save) {
-        freelist(&wall->ls->d.ls->effects, free);
+        initlist(&effects);
 
         for (n = l->cubes.head; n->next != NULL; n = n->next) {
             lse = NULL;
@@ -1429,8 +2203,8 @@ void end_adjustlight(struct wall *wall, int save) {
                             if (!lse) {
                                 checkmem( lse =
                                              MALLOC( sizeof(struct ls_effect) ) );
-                                checkmem( addnode(&wall->ls->d.ls->effects,
-                                                  -1, lse) );
+                                memset( lse, 0, sizeof(struct ls_effect) );
+                                checkmem( addnode(&effects, -1, lse) );
                             }
 
                             lse->cube = n;
@@ -1443,29 +2217,11 @@ void end_adjustlight(struct wall *wall, int save) {
                 }
             }
         }
+
+        setlseffects(wall->ls->d.ls, &effects);
     }
 
     for (nl = l->lightsources.head; nl->next != NULL; nl = nl->next) {
-        for (n = nl->d.ls->effects.head; n->next != NULL; n = n->next) {
-            my_assert(n->d.lse->cube != NULL);
-
-            for (w = 0; w < 6; w++) {
-                if (n->d.lse->cube->d.c->walls[w]) {
-                    for (c = 0; c < 4; c++) {
-                        if ( (sum = n->d.lse->add_light[w * 4 + c]) != 0 ) {
-                            sum +=
-                                n->d.lse->cube->d.c->walls[w]->corners[c].
-                                light;
-                            n->d.lse->cube->d.c->walls[w]->corners[c].light =
-                                sum > theMaxLight ?
-                                theMaxLight
-                                : sum;
-                        }
-                    }
-                }
-            }
-        }
+        switchlight(l, nl->d.ls, 1);
     }
 }
-
-
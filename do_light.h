@@ -7,6 +7,15 @@ void dec_setcornerlight(int ec);
 void dec_setinnercubelight(int ec);
 void dec_setlsfile(int ec);
 int read_lightsources(void);
+void calccornerlight(int withsmooth);
+void setinnercubelight(void);
 void end_adjustlight(struct wall *w, int save);
 void start_adjustlight(struct wall *w);
+void setlightdirty(struct node *c);
+void setlsdirty(struct lightsource *ls);
+int relightdirty(void);
+void getlseffects(struct lightsource *ls, struct list *effects);
+void setlseffects(struct lightsource *ls, struct list *effects);
+void removelseffects(struct lightsource *ls);
+void switchlight(struct leveldata *ld, struct lightsource *ls, int on);
 
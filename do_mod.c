@@ -28,6 +28,9 @@
 #include "click.h"
 #include "do_move.h"
 #include "do_mod.h"
+#include "cubegrid.h"
+#include "edgetab.h"
+#include "pvs.h"
 
 void dec_enlargeshrink(int ec) {
     int cubepnts[9], i;
@@ -998,6 +1001,12 @@ void change_cube_list(struct node *n, struct list *lc1, struct list *lp1,
     int i;
 
 
+    if (lc1 == &l->cubes) {
+        cg_deletecube(l, n);
+        et_deletecube(l, n);
+        pvs_cubeschanged(l);
+    }
+
     unlistnode(lc1, n);
     listnode_tail(lc2, n);
 
@@ -1005,6 +1014,12 @@ void change_cube_list(struct node *n, struct list *lc1, struct list *lp1,
         unlistnode(lp1, n->d.c->p[i]);
         listnode_tail(lp2, n->d.c->p[i]);
     }
+
+    if (lc2 == &l->cubes) {
+        cg_insertcube(l, n);
+        et_insertcube(l, n);
+        pvs_cubeschanged(l);
+    }
 }
 
 
@@ -1037,6 +1052,8 @@ void make_start_cubes(struct corridor *c, struct node *cube, int wall,
             for (j = 0; j < 3; j++) {
                 cube->d.c->p[wallpts[wall][i]]->d.p->x[j] -= f * nv->x[j];
             }
+
+            cg_updatepnt(l, cube->d.c->p[wallpts[wall][i]]);
         }
     }
 
@@ -1163,7 +1180,7 @@ void delete_corridor(struct corridor *c) {
         FREE(n->prev->d.ce->rel_pnts);
         FREE(n->prev->d.ce->cubes);
         FREE(n->prev->d.ce);
-        FREE(n->prev);
+        POOLFREE(n->prev);
     }
 
     freelist(&c->tracking, free);
@@ -1188,8 +1205,12 @@ void finish_corridor(struct corridor *c) {
     for (n = c->cubes.head->next; n != NULL; n = n->next) {
         unlistnode(&c->cubes, np = n->prev);
         listnode_tail(&l->cubes, np);
+        cg_insertcube(l, np);
+        et_insertcube(l, np);
     }
 
+    pvs_cubeschanged(l);
+
     for (n = c->points.head->next; n != NULL; n = n->next) {
         unlistnode(&c->points, np = n->prev);
         listnode_tail(&l->pts, np);
@@ -1688,7 +1709,6 @@ void dec_makecorridor(int ec) {
     struct corridor *c;
     struct track *st, *et;
     struct node *n;
-    struct point ref_coords[2];
 
 
     if (!l || !view.pcurrcube) {
@@ -1762,8 +1782,6 @@ void dec_makecorridor(int ec) {
         c->e[i] = et->coords[i] = st->coords[i];
     }
 
-    ref_coords[0] = st->coords[0];
-    ref_coords[1] = st->coords[1];
     st->old_twist = et->old_twist = 0.0;
 
     for (n = c->elements.head; n->next != NULL; n = n->next) {
@@ -32,6 +32,9 @@
 #include "do_opts.h"
 #include "do_mod.h"
 #include "do_move.h"
+#include "cubegrid.h"
+#include "pvs.h"
+#include "do_light.h"
 
 #define MOUSESTART_HILIGHT 1
 #define MOUSEMOVE_HILIGHT 2
@@ -1210,6 +1213,14 @@ int movepnt(struct point *add, union move_params *params) {
             }
         }
 
+        cg_updatecubes(l, cube_list);
+        pvs_cubeschanged(l);
+
+        for (n = cube_list->head; n->next != NULL; n = n->next) {
+            setlightdirty(n->d.n);
+            updatedescmap(n->d.n);
+        }
+
         /* is this is side/cube movement reinit the moved side */
         if (nc != NULL) {
             if (wall >= 0) {
@@ -1367,6 +1378,14 @@ int rotatepnt(struct point *turn, float fx, float fy, int with_left,
             }
         }
 
+        cg_updatecubes(l, cube_list);
+        pvs_cubeschanged(l);
+
+        for (n = cube_list->head; n->next != NULL; n = n->next) {
+            setlightdirty(n->d.n);
+            updatedescmap(n->d.n);
+        }
+
         /* is this is side/cube movement reinit the moved side */
         if (nc != NULL) {
             if (wall >= 0) {
@@ -2549,7 +2568,7 @@ void init_rendercube(void) {
     }
 
     initcoordsystem(0, &e0, er, &x0);
-    c = findpntcube(&l->cubes, &e0);
+    c = findpntcube(l, &e0);
 
     if (c != NULL) {
         l->rendercube = c;
@@ -450,7 +450,7 @@ void b_r_adjustlight(struct w_button *b) {
 
 
 void b_refreshtagno(enum infos what) {
-    if (what >= tt_number) {
+    if ( (int)what >= tt_number ) {
         return;
     }
 
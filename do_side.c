@@ -26,6 +26,7 @@
 #include "plottxt.h"
 #include "do_move.h"
 #include "do_side.h"
+#include "do_light.h"
 
 int dsc_cubetype(struct infoitem *i, void *d, struct node *n, int wallno,
                  int pntno,
@@ -422,6 +423,7 @@ int dsc_walltype(struct infoitem *i, void *d, struct node *n, int wallno,
         changedoortype(n->d.d->d, no, tagged);
     }
 
+    setlightdirty(n->d.d->c);
     plotlevel();
     return ok;
 }
@@ -472,6 +474,8 @@ int dsc_dooranim(struct infoitem *i, void *d, struct node *n, int wallno,
     }
 
     n->d.d->animtxt = n->d.d->d->d.d->animtxt = no;
+    setlightdirty(n->d.d->c);
+    setlightdirty(n->d.d->d->d.d->c);
 
     if ( !tagged
        && (n->d.d->w == view.pcurrwall || n->d.d->d->d.d->w ==
@@ -803,7 +807,8 @@ int dsc_fl_delay(struct infoitem *i, void *d, struct node *n, int wallno,
 {
     int delay = *(long *)d;
     struct flickering_light *fl;
-    struct node *nc;
+    struct lightsource *ls;
+    struct packed_effect *pe, *end;
 
 
     if (!l || !n || !n->d.c->walls[wallno] || !n->d.c->walls[wallno]->ls) {
@@ -838,10 +843,11 @@ int dsc_fl_delay(struct infoitem *i, void *d, struct node *n, int wallno,
         fl->state = 1;
         fl->calculated = 0;
 
-        for (nc = n->d.c->walls[wallno]->ls->d.ls->effects.head;
-             nc->next != NULL;
-             nc = nc->next) {
-            checkmem( addnode(&nc->d.lse->cube->d.c->fl_lights, -1, fl) );
+        ls = n->d.c->walls[wallno]->ls->d.ls;
+
+        for (pe = l->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+             pe < end; pe++) {
+            checkmem( addnode(&pe->cube->d.c->fl_lights, -1, fl) );
         }
     }
     else {
@@ -0,0 +1,452 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    edgetab.c - the edges of the walls of a level
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+#include "structs.h"
+#include "tools.h"
+#include "edgetab.h"
+
+/* Every edge of a cube is once in the table, with the list of the walls
+   it belongs to and the number of cubes with it. The edges are found with
+   a hash table of their two points. Each edge belongs to one cube which
+   draws it in the wireframe (cube->wire_edges), so no line is drawn twice.
+   The table is made by et_gettable. When a cube is inserted or deleted,
+   a wall is inserted or deleted or a point of a cube is replaced, only
+   the edges of this cube are changed in the table of its level
+   (et_insertcube, et_deletecube, et_insertwall, et_deletewall). Moving
+   points doesn't change the table. */
+struct edgetable {
+    unsigned long id; /* cube->edges_id of all cubes in this table */
+    struct edge *edges;
+    int num_edges, max_edges;
+    int *index; /* the hash table, mask+1 entries */
+    unsigned int mask;
+};
+
+/* the last id of a table */
+static unsigned long et_ids = 0;
+
+
+static unsigned long et_hash(struct node *s, struct node *e) {
+    const unsigned char *d;
+    unsigned long h = 2166136261UL;
+    size_t i;
+
+
+    for (d = (const unsigned char *)&s, i = 0; i < sizeof(s); i++) {
+        h = (h ^ d[i]) * 16777619UL;
+    }
+
+    for (d = (const unsigned char *)&e, i = 0; i < sizeof(e); i++) {
+        h = (h ^ d[i]) * 16777619UL;
+    }
+
+    return h;
+}
+
+
+void et_freetable(struct leveldata *ld) {
+    int i;
+
+
+    if (ld->edges == NULL) {
+        return;
+    }
+
+    for (i = 0; i < ld->edges->num_edges; i++) {
+        FREE(ld->edges->edges[i].walls);
+    }
+
+    FREE(ld->edges->edges);
+    FREE(ld->edges->index);
+    FREE(ld->edges);
+    ld->edges = NULL;
+}
+
+
+/* the entry in the hash table for the edge between s and e (s<e). It's
+   -1 if the edge is not in the table. */
+static int *et_lookup(struct edgetable *t, struct node *s, struct node *e) {
+    unsigned int k;
+    struct edge *ed;
+
+
+    for (k = et_hash(s, e) & t->mask; t->index[k] >= 0;
+         k = (k + 1) & t->mask) {
+        ed = &t->edges[t->index[k]];
+
+        if (ed->s == s && ed->e == e) {
+            break;
+        }
+    }
+
+    return &t->index[k];
+}
+
+
+/* make the hash table for all edges. It has at least two entries for
+   each edge the array can hold. */
+static void et_makeindex(struct edgetable *t) {
+    unsigned int size;
+    int i;
+
+
+    for (size = 16; size < (unsigned int)t->max_edges * 2; size *= 2) {
+    }
+
+    FREE(t->index);
+    t->mask = size - 1;
+    checkmem( t->index = MALLOC(sizeof(int) * size) );
+
+    for (i = 0; i < (int)size; i++) {
+        t->index[i] = -1;
+    }
+
+    for (i = 0; i < t->num_edges; i++) {
+        *et_lookup(t, t->edges[i].s, t->edges[i].e) = i;
+    }
+}
+
+
+/* the edges of a cube in the order of the bits of cube->wire_edges */
+static const int cubeedges[12][2] = {
+    { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 }, { 4, 5 }, { 5, 6 }, { 6, 7 },
+    { 7, 4 }, { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+};
+
+
+/* the edge between the points p1 and p2 of cube nc. If it's not in the
+   table it's inserted and *isnew is set to 1. */
+static struct edge *et_addedge(struct edgetable *t, struct node *nc, int p1,
+                               int p2, int *isnew) {
+    struct node *s, *e;
+    struct edge *ed;
+    int *k;
+
+
+    s = nc->d.c->p[p1];
+    e = nc->d.c->p[p2];
+
+    if (s > e) {
+        s = e;
+        e = nc->d.c->p[p1];
+    }
+
+    *isnew = *( k = et_lookup(t, s, e) ) < 0;
+
+    if (!*isnew) {
+        return &t->edges[*k];
+    }
+
+    if (t->num_edges == t->max_edges) {
+        t->max_edges *= 2;
+        checkmem( t->edges = REALLOC(t->edges,
+                                     sizeof(struct edge) * t->max_edges) );
+        et_makeindex(t);
+        k = et_lookup(t, s, e);
+    }
+
+    *k = t->num_edges;
+    ed = &t->edges[t->num_edges++];
+    ed->s = s;
+    ed->e = e;
+    ed->line = NULL;
+    ed->walls = NULL;
+    ed->num_walls = ed->max_walls = ed->num_cubes = 0;
+    return ed;
+}
+
+
+/* the edge between the points p1 and p2 of the cube c. It must be in the
+   table. */
+static struct edge *et_cubeedge(struct edgetable *t, struct cube *c, int p1,
+                                int p2) {
+    int k;
+
+
+    k = c->p[p1] < c->p[p2] ? *et_lookup(t, c->p[p1], c->p[p2]) :
+        *et_lookup(t, c->p[p2], c->p[p1]);
+    my_assert(k >= 0);
+    return &t->edges[k];
+}
+
+
+/* delete edge ed and its line in the map of ld. The last edge is moved to
+   its place in the array. */
+static void et_deledge(struct leveldata *ld, struct edge *ed) {
+    struct edgetable *t = ld->edges;
+    unsigned int i, j, h;
+    int *k;
+
+
+    if (ed->line != NULL) {
+        freenode(&ld->lines, ed->line, free);
+    }
+
+    FREE(ed->walls);
+    /* close the gap in the hash table: move the following entries of the
+       chain back if their place is not between the gap and them */
+    i = et_lookup(t, ed->s, ed->e) - t->index;
+
+    for (j = (i + 1) & t->mask; t->index[j] >= 0; j = (j + 1) & t->mask) {
+        h = et_hash(t->edges[t->index[j]].s, t->edges[t->index[j]].e) &
+            t->mask;
+
+        if ( ( (j - h) & t->mask ) >= ( (j - i) & t->mask ) ) {
+            t->index[i] = t->index[j];
+            i = j;
+        }
+    }
+
+    t->index[i] = -1;
+
+    if ( ed != &t->edges[--t->num_edges] ) {
+        k = et_lookup(t, t->edges[t->num_edges].s,
+                      t->edges[t->num_edges].e);
+        *k = ed - t->edges;
+        *ed = t->edges[t->num_edges];
+    }
+}
+
+
+static void et_addwall(struct edgetable *t, struct node *nc, int w, int j) {
+    struct edge *ed;
+
+
+    ed = et_cubeedge(t, nc->d.c, wallpts[w][j], wallpts[w][(j + 1) & 3]);
+
+    if (ed->num_walls == ed->max_walls) {
+        ed->max_walls = ed->max_walls ? ed->max_walls * 2 : 2;
+        checkmem( ed->walls = REALLOC(ed->walls,
+                                      sizeof(struct et_wall) *
+                                      ed->max_walls) );
+    }
+
+    ed->walls[ed->num_walls].cube = nc;
+    ed->walls[ed->num_walls].wall = w;
+    ed->walls[ed->num_walls++].edge = j;
+}
+
+
+/* delete wall w of cube c from the edges of the wall. If an edge has no
+   walls left, its line in the map of ld is deleted. */
+static void et_delwall(struct leveldata *ld, struct cube *c, int w) {
+    struct edge *ed;
+    int i, j;
+
+
+    for (j = 0; j < 4; j++) {
+        ed = et_cubeedge(ld->edges, c, wallpts[w][j], wallpts[w][(j + 1) & 3]);
+
+        for (i = 0; i < ed->num_walls; i++) {
+            if (ed->walls[i].cube->d.c == c && ed->walls[i].wall == w) {
+                ed->walls[i] = ed->walls[--ed->num_walls];
+                break;
+            }
+        }
+
+        if (ed->num_walls == 0 && ed->line != NULL) {
+            freenode(&ld->lines, ed->line, free);
+            ed->line = NULL;
+        }
+    }
+}
+
+
+/* insert the edges and walls of cube nc in the table. Its new edges are
+   drawn with it in the wireframe. */
+static void et_entercube(struct edgetable *t, struct node *nc) {
+    struct cube *c = nc->d.c;
+    int i, j, isnew;
+
+
+    c->edges_id = t->id;
+    c->wire_edges = 0;
+
+    for (j = 0; j < 12; j++) {
+        et_addedge(t, nc, cubeedges[j][0], cubeedges[j][1],
+                   &isnew)->num_cubes++;
+        c->wire_edges |= isnew << j;
+    }
+
+    for (i = 0; i < 6; i++) {
+        if (c->walls[i] != NULL) {
+            for (j = 0; j < 4; j++) {
+                et_addwall(t, nc, i, j);
+            }
+        }
+    }
+}
+
+
+/* ed was drawn with a cube which is deleted: draw it with another cube
+   of the table which has this edge */
+static void et_passedge(struct edgetable *t, struct edge *ed) {
+    struct node *n;
+    struct cube *c;
+    int j;
+
+
+    for (n = ed->s->d.lp->c.head; n->next != NULL; n = n->next) {
+        c = n->d.n->d.c;
+
+        if (c->edges_id != t->id) {
+            continue;
+        }
+
+        for (j = 0; j < 12; j++) {
+            if ( ( c->p[cubeedges[j][0]] == ed->s
+                  && c->p[cubeedges[j][1]] == ed->e )
+                || ( c->p[cubeedges[j][0]] == ed->e
+                    && c->p[cubeedges[j][1]] == ed->s ) ) {
+                c->wire_edges |= 1 << j;
+                return;
+            }
+        }
+    }
+}
+
+
+/* delete the walls and edges of cube nc from the table of ld. The edges
+   which are still in other cubes are kept. */
+static void et_removecube(struct leveldata *ld, struct node *nc) {
+    struct edgetable *t = ld->edges;
+    struct cube *c = nc->d.c;
+    struct edge *ed;
+    int i, j;
+
+
+    for (i = 0; i < 6; i++) {
+        if (c->walls[i] != NULL) {
+            et_delwall(ld, c, i);
+        }
+    }
+
+    c->edges_id = 0;
+
+    for (j = 0; j < 12; j++) {
+        ed = et_cubeedge(t, c, cubeedges[j][0], cubeedges[j][1]);
+
+        if (--ed->num_cubes == 0) {
+            et_deledge(ld, ed);
+        }
+        else if ( (c->wire_edges & (1 << j) ) != 0 ) {
+            et_passedge(t, ed);
+        }
+    }
+
+    c->wire_edges = 0;
+}
+
+
+static void et_maketable(struct leveldata *ld) {
+    struct edgetable *t;
+    struct node *n;
+
+
+    et_freetable(ld);
+    checkmem( t = MALLOC( sizeof(struct edgetable) ) );
+    t->id = ++et_ids;
+    t->num_edges = 0;
+    t->max_edges = ld->cubes.size * 12 + 16;
+    t->index = NULL;
+    checkmem( t->edges = MALLOC(sizeof(struct edge) * t->max_edges) );
+    et_makeindex(t);
+
+    /* each edge belongs to the first cube with it */
+    for (n = ld->cubes.head; n->next != NULL; n = n->next) {
+        et_entercube(t, n);
+    }
+
+    ld->edges = t;
+}
+
+
+/* cube nc was inserted in ld->cubes (or its points were replaced) */
+void et_insertcube(struct leveldata *ld, struct node *nc) {
+    if ( ld != NULL && ld->edges != NULL
+        && nc->d.c->edges_id != ld->edges->id ) {
+        et_entercube(ld->edges, nc);
+    }
+}
+
+
+/* cube nc will be deleted from ld->cubes (or its points will be
+   replaced) */
+void et_deletecube(struct leveldata *ld, struct node *nc) {
+    if ( ld != NULL && ld->edges != NULL
+        && nc->d.c->edges_id == ld->edges->id ) {
+        et_removecube(ld, nc);
+    }
+}
+
+
+/* wall w of cube nc in ld was inserted */
+void et_insertwall(struct leveldata *ld, struct node *nc, int w) {
+    int j;
+
+
+    if ( ld != NULL && ld->edges != NULL
+        && nc->d.c->edges_id == ld->edges->id ) {
+        for (j = 0; j < 4; j++) {
+            et_addwall(ld->edges, nc, w, j);
+        }
+    }
+}
+
+
+/* wall w of cube c in ld will be deleted */
+void et_deletewall(struct leveldata *ld, struct cube *c, int w) {
+    if (ld != NULL && ld->edges != NULL && c->edges_id == ld->edges->id) {
+        et_delwall(ld, c, w);
+    }
+}
+
+
+/* is the table of ld made? */
+int et_valid(struct leveldata *ld) {
+    return ld->edges != NULL;
+}
+
+
+/* makes the table of ld if it's not made yet. *edges is set to the array
+   of all edges, the number of edges is returned. */
+int et_gettable(struct leveldata *ld, struct edge **edges) {
+    if ( !et_valid(ld) ) {
+        et_maketable(ld);
+    }
+
+    *edges = ld->edges->edges;
+    return ld->edges->num_edges;
+}
+
+
+/* the edge between the points p1 and p2 or NULL if there's no cube with
+   this edge or the table is not made */
+struct edge *et_findedge(struct leveldata *ld, struct node *p1,
+                         struct node *p2) {
+    int k;
+
+
+    if ( !et_valid(ld) ) {
+        return NULL;
+    }
+
+    k = p1 < p2 ? *et_lookup(ld->edges, p1, p2) :
+        *et_lookup(ld->edges, p2, p1);
+    return k < 0 ? NULL : &ld->edges->edges[k];
+}
@@ -0,0 +1,28 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+    Further info see .c-files. */
+
+/* a wall with the edge from its point edge to point edge+1 */
+struct et_wall {
+    struct node *cube;
+    int wall, edge;
+};
+/* an edge of a cube between the points s and e (s<e) and all walls with
+   this edge */
+struct edge {
+    struct node *s, *e;
+    struct node *line; /* the line of the edge in the map or NULL */
+    struct et_wall *walls;
+    int num_walls, max_walls;
+    int num_cubes; /* the number of cubes with this edge */
+};
+
+void et_insertcube(struct leveldata *ld, struct node *nc);
+void et_deletecube(struct leveldata *ld, struct node *nc);
+void et_insertwall(struct leveldata *ld, struct node *nc, int w);
+void et_deletewall(struct leveldata *ld, struct cube *c, int w);
+void et_freetable(struct leveldata *ld);
+int et_valid(struct leveldata *ld);
+int et_gettable(struct leveldata *ld, struct edge **edges);
+struct edge *et_findedge(struct leveldata *ld, struct node *p1,
+                         struct node *p2);
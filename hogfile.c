@@ -0,0 +1,279 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    hogfile.c - reading and writing hog-files
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+#define _GNU_SOURCE /* copy_file_range */
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include "structs.h"
+#include "tools.h"
+#include "userio.h"
+#include "hogfile.h"
+
+/* A hog-file is "DHF" followed by the files in it, each one with 13 bytes
+   for the name, 4 bytes for the size (little endian) and the data.
+   The hog-file is mapped into memory and the entries are read from there
+   once. To find a file by its name there's a hash table of the entries.
+   The data is copied between hog-files and levels by the kernel
+   (copy_file_range or sendfile), without reading it into memory. */
+#define HOG_HEADSIZE 17
+
+
+static unsigned long hog_hash(const char *name) {
+    unsigned long h = 2166136261UL;
+
+
+    for (; *name != 0; name++) {
+        h = ( h ^ (unsigned char)toupper(*name) ) * 16777619UL;
+    }
+
+    return h;
+}
+
+
+static int hog_samename(const char *n1, const char *n2) {
+    for (; *n1 != 0 && toupper(*n1) == toupper(*n2); n1++, n2++) {
+    }
+
+    return *n1 == 0 && *n2 == 0;
+}
+
+
+static void hog_makeindex(struct hog_file *h) {
+    int i, k;
+
+
+    for (h->indexsize = 16; h->indexsize < h->num_entries * 2;
+         h->indexsize *= 2) {
+    }
+
+    checkmem( h->index = MALLOC(sizeof(int) * h->indexsize) );
+
+    for (i = 0; i < h->indexsize; i++) {
+        h->index[i] = -1;
+    }
+
+    for (i = 0; i < h->num_entries; i++) {
+        for (k = hog_hash(h->entries[i].name) & (h->indexsize - 1);
+             h->index[k] >= 0; k = (k + 1) & (h->indexsize - 1)) {
+        }
+
+        h->index[k] = i;
+    }
+}
+
+
+/* open the hog-file fname. Returns NULL if it can't be opened or is no
+   hog-file. */
+struct hog_file *hog_open(const char *fname) {
+    struct hog_file *h;
+    struct hog_entry *e;
+    struct stat st;
+    const unsigned char *d;
+    unsigned long pos;
+    int fd, max_entries, i;
+
+
+    if ( ( fd = open(fname, O_RDONLY) ) < 0 ) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < 3) {
+        close(fd);
+        waitmsg(TXT_NOHOGSIGNATURE);
+        return NULL;
+    }
+
+    checkmem( h = MALLOC( sizeof(struct hog_file) ) );
+    h->fd = fd;
+    h->size = st.st_size;
+    h->data = mmap(NULL, h->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (h->data == MAP_FAILED || memcmp(h->data, "DHF", 3) != 0) {
+        if (h->data != MAP_FAILED) {
+            munmap( (void *)h->data, h->size );
+        }
+
+        close(fd);
+        FREE(h);
+        waitmsg(TXT_NOHOGSIGNATURE);
+        return NULL;
+    }
+
+    /* each entry has at least its head */
+    max_entries = (h->size - 3) / HOG_HEADSIZE;
+    checkmem( h->entries = MALLOC(sizeof(struct hog_entry) *
+                                  (max_entries + 1) ) );
+
+    for (pos = 3, h->num_entries = 0; pos + HOG_HEADSIZE <= h->size;
+         pos += HOG_HEADSIZE + e->size) {
+        d = h->data + pos;
+        e = &h->entries[h->num_entries];
+
+        for (i = 0; i < 13 && d[i] != 0; i++) {
+            e->name[i] = toupper(d[i]);
+        }
+
+        e->name[i] = 0;
+        e->pos = pos + HOG_HEADSIZE;
+        e->size = d[13] | (d[14] << 8) | (d[15] << 16) |
+                  ( (unsigned long)d[16] << 24 );
+
+        if (e->size > h->size - e->pos) {
+            break;
+        }
+
+        h->num_entries++;
+    }
+
+    hog_makeindex(h);
+    return h;
+}
+
+
+void hog_close(struct hog_file *h) {
+    if (h == NULL) {
+        return;
+    }
+
+    munmap( (void *)h->data, h->size );
+    close(h->fd);
+    FREE(h->index);
+    FREE(h->entries);
+    FREE(h);
+}
+
+
+/* the number of the entry with the name (not case sensitive) or -1 */
+int hog_find(struct hog_file *h, const char *name) {
+    int k;
+
+
+    for (k = hog_hash(name) & (h->indexsize - 1); h->index[k] >= 0;
+         k = (k + 1) & (h->indexsize - 1)) {
+        if ( hog_samename(h->entries[h->index[k]].name, name) ) {
+            return h->index[k];
+        }
+    }
+
+    return -1;
+}
+
+
+/* copy size bytes from pos in src_fd to the current position of dst_fd.
+   Returns 0 if not all bytes could be copied. */
+static int hog_copy(int dst_fd, int src_fd, unsigned long pos,
+                    unsigned long size) {
+    char buffer[65536];
+    off_t in = pos;
+    ssize_t n, w, k;
+
+
+    while (size > 0 && ( n = copy_file_range(src_fd, &in, dst_fd, NULL,
+                                             size, 0) ) > 0) {
+        size -= n;
+    }
+
+    /* copy_file_range doesn't work between all file systems */
+    while (size > 0 && ( n = sendfile(dst_fd, src_fd, &in, size) ) > 0) {
+        size -= n;
+    }
+
+    while (size > 0) {
+        if ( ( n = pread(src_fd, buffer, size < sizeof(buffer) ? size :
+                         sizeof(buffer), in) ) <= 0 ) {
+            return 0;
+        }
+
+        for (w = 0; w < n; w += k) {
+            if ( ( k = write(dst_fd, buffer + w, n - w) ) <= 0 ) {
+                return 0;
+            }
+        }
+
+        in += n;
+        size -= n;
+    }
+
+    return 1;
+}
+
+
+/* copy size bytes from pos in src_fd to the end of the file f (which
+   must be opened for writing). Returns 0 if it fails. */
+int hog_copytofile(FILE *f, int src_fd, unsigned long pos,
+                   unsigned long size) {
+    int ok;
+
+
+    if (fflush(f) != 0) {
+        return 0;
+    }
+
+    ok = hog_copy(fileno(f), src_fd, pos, size);
+    /* the data was written past the buffer of f */
+    return fseek(f, 0, SEEK_END) == 0 && ok;
+}
+
+
+/* write an entry for size bytes from pos in src_fd with the name to the
+   hog-file f. Returns 0 if it fails. */
+int hog_writeentry(FILE *f, const char *name, int src_fd, unsigned long pos,
+                   unsigned long size) {
+    unsigned char head[HOG_HEADSIZE];
+    int i;
+
+
+    memset(head, 0, 13);
+
+    for (i = 0; i < 13 && name[i] != 0; i++) {
+        head[i] = name[i];
+    }
+
+    for (i = 0; i < 4; i++) {
+        head[13 + i] = (size >> (i * 8) ) & 0xff;
+    }
+
+    return fwrite(head, 1, HOG_HEADSIZE, f) == HOG_HEADSIZE
+           && hog_copytofile(f, src_fd, pos, size);
+}
+
+
+/* write an entry with the whole file fname to the hog-file f. Returns -1
+   if fname can't be read, 0 if the entry can't be written. */
+int hog_writefile(FILE *f, const char *name, const char *fname) {
+    struct stat st;
+    int fd, ok;
+
+
+    if ( ( fd = open(fname, O_RDONLY) ) < 0 ) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    ok = hog_writeentry(f, name, fd, 0, st.st_size);
+    close(fd);
+    return ok;
+}
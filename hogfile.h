@@ -0,0 +1,26 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+    Further info see .c-files. */
+
+/* a file in a hog-file. name is in capital letters. */
+struct hog_entry {
+    char name[14];
+    unsigned long pos, size; /* the data of the file in the hog-file */
+};
+struct hog_file {
+    int fd;
+    const unsigned char *data; /* the hog-file mapped into memory */
+    unsigned long size;
+    struct hog_entry *entries;
+    int num_entries;
+    int *index, indexsize; /* hash table of the names (see hog_find) */
+};
+
+struct hog_file *hog_open(const char *fname);
+void hog_close(struct hog_file *h);
+int hog_find(struct hog_file *h, const char *name);
+int hog_copytofile(FILE *f, int src_fd, unsigned long pos,
+                   unsigned long size);
+int hog_writeentry(FILE *f, const char *name, int src_fd, unsigned long pos,
+                   unsigned long size);
+int hog_writefile(FILE *f, const char *name, const char *fname);
@@ -7,6 +7,13 @@ int in_getpixelcoords(struct point *p, struct pixel *pix);
 int getscreencoords(int lr, struct point *sp, struct point *ep,
                     struct pixel *spix, struct pixel *epix,
                     int checkdist);
+struct viewcache *vc_get(void);
+void vc_getpnt(struct viewcache *vc, struct node *np, float *v);
+void in_getviewdir(struct point *d, float *v);
+int in_getviewpixelcoords(float *v, struct pixel *pix);
+int getpntscreencoords(int lr, struct viewcache *vc, struct node *sp,
+                       struct node *ep, struct pixel *spix,
+                       struct pixel *epix, int checkdist);
 void in_plotwall(int w, struct cube *c, int wno, int hilight, int xor);
 void in_plottagwall(int w, struct cube *c, int wallno, int hilight, int xor);
 void in_plotthing(int w, struct thing *t, int hilight);
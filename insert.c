@@ -22,6 +22,10 @@
 #include "tag.h"
 #include "calctxt.h"
 #include "insert.h"
+#include "cubegrid.h"
+#include "pvs.h"
+#include "edgetab.h"
+#include "do_light.h"
 #include "stdtypes.h"
 
 void fittogrid(struct point *p) {
@@ -84,7 +88,7 @@ struct wall *insertwall(struct node *c, int wallnum, int txt1, int txt2,
     my_assert(c != NULL);
 
     if (c->d.c->walls[wallnum] == NULL) {
-        checkmem( w = MALLOC( sizeof(struct wall) ) );
+        checkmem( w = w_poolalloc( l->wallpool, sizeof(struct wall) ) );
     }
     else {
         w = c->d.c->walls[wallnum];
@@ -124,6 +128,8 @@ struct wall *insertwall(struct node *c, int wallnum, int txt1, int txt2,
 
     c->d.c->walls[wallnum] = w;
     recalcwall(c->d.c, wallnum);
+    et_insertwall(l, c, wallnum);
+    pvs_cubeschanged(l);
 
     if (view.currwall == wallnum && view.pcurrcube != NULL
        && view.pcurrcube->no == c->no) {
@@ -206,6 +212,7 @@ struct node *insertsingledoor(struct node *c, struct node *pd, int wallnum) {
     }
 
     c->d.c->d[wallnum] = n;
+    setlightdirty(c);
     return n;
 }
 
@@ -264,7 +271,8 @@ void floatpnt(struct node *c, int pn) {
     struct node *np;
 
 
-    checkmem( lp = MALLOC( sizeof(struct listpoint) ) );
+    et_deletecube(l, c);
+    checkmem( lp = w_poolalloc( l->pntpool, sizeof(struct listpoint) ) );
 
     for (np = olp->c.head; np->next != NULL; np = np->next) {
         if (np->d.n->no == c->no) {
@@ -284,6 +292,8 @@ void floatpnt(struct node *c, int pn) {
     for (j = 0; j < 3; j++) {
         c->d.c->walls[wallno[pn][0][j]]->p[wallno[pn][1][j]] = np;
     }
+
+    et_insertcube(l, c);
 }
 
 
@@ -453,6 +463,7 @@ void deletesingledoor(struct node *n) {
 
 
     my_assert(n != NULL && n->d.d->c != NULL);
+    setlightdirty(n->d.d->c);
     n->d.d->c->d.c->d[n->d.d->wallnum] = NULL;
 
     if (n->d.d->c->d.c->nc[n->d.d->wallnum]) {
@@ -530,12 +541,9 @@ void deletelistpnt(struct list *pts, struct node *nlp) {
 /* Delete all lightsources referencing the cube */
 void delete_ref_ls(struct node* c) {
     struct node* p;
-    struct node* pe;
-    struct node* nlse;
+    struct packed_effect* pe, * end;
     struct lightsource* ls;
     int flag;
-    int w, co;
-    long overflow;
 
 
     for (p = l->lightsources.head; p->next != NULL; p = p->next) {
@@ -543,37 +551,17 @@ void delete_ref_ls(struct node* c) {
             ls = p->d.ls;
             flag = 0;
 
-            for (pe = ls->effects.head; pe != NULL; pe = pe->next) {
-                if (pe->d.lse != NULL) {
-                    if (pe->d.lse->cube == c) {
-                        flag = 1;
-                    }
+            for (pe = ls->ld->packed_effects + ls->pe_start,
+                 end = pe + ls->pe_num; pe < end; pe++) {
+                if (pe->cube == c) {
+                    flag = 1;
                 }
             }
 
             if (flag) {
-                for (nlse = ls->effects.head->next; nlse != NULL;
-                     nlse = nlse->next) {
-                    for (w = 0; w < 6; w++) {
-                        if (nlse->prev->d.lse->cube->d.c->walls[w]) {
-                            for (co = 0; co < 4; co++) {
-                                overflow =
-                                    nlse->prev->d.lse->cube->d.c->walls[w]->
-                                    corners[co].light -
-                                    nlse->prev->d.lse->add_light[w *
-                                                                 4 + co];
-                                nlse->prev->d.lse->cube->d.c->walls[w]->
-                                corners[co].light =
-                                    overflow <
-                                    view.illum_minvalue ? view.illum_minvalue
-                                    :
-                                    overflow;
-                            }
-                        }
-                    }
-
-                    freenode(&ls->effects, nlse->prev, free);
-                }
+                setlsdirty(ls);
+                setlightdirty(ls->cube);
+                removelseffects(ls);
             }
         }
     }
@@ -653,11 +641,16 @@ void deletecube(struct list *pcubes, struct list *ppts, struct node *n) {
         } while (k < 8);
     }
 
+    setlightdirty(n);
     delete_ref_ls(n);
+    cg_deletecube(l, n);
+    et_deletecube(l, n);
+    pvs_cubeschanged(l);
 
     for (k = 0; k < 6; k++) {
         if (c->walls[k] != NULL && c->walls[k]->ls != NULL) {
             my_assert(pcubes == NULL && ppts == NULL);
+            setlsdirty(c->walls[k]->ls->d.ls);
             freenode(&l->lightsources, c->walls[k]->ls, freelightsource);
         }
 
@@ -730,6 +723,7 @@ int changepnt(struct node *oldp, struct node *newp, struct node *sn) {
          cn = cn->next) {
         n = cn->d.n;
         pn = cn->no;
+        et_deletecube(l, n);
         n->d.c->p[pn] = newp;
 
         if (addnode(&newp->d.lp->c, cn->no, n) == NULL) {
@@ -743,6 +737,9 @@ int changepnt(struct node *oldp, struct node *newp, struct node *sn) {
 
             n->d.c->recalc_polygons[wallno[pn][0][i]] = 1;
         }
+
+        et_insertcube(l, n);
+        cg_updatecube(l, n);
     }
 
     for (cn = ( (sn == NULL) ? oldp->d.lp->c.head : sn->next )->next;
@@ -1066,6 +1063,8 @@ int initcube(struct node *n) {
     initlist(&c->sdoors);
     initlist(&c->things);
     initlist(&c->fl_lights);
+    c->grid_id = c->grid_query = c->edges_id = 0;
+    c->lightdirty = 0;
 
     for (j = 0; j < 8; j++) {
         if ( ( c->p[j] = findnode(&l->pts, (int)c->pts[j]) ) == NULL ) {
@@ -1147,6 +1146,9 @@ int initcube(struct node *n) {
         c->cp = NULL;
     }
 
+    cg_insertcube(l, n);
+    et_insertcube(l, n);
+    pvs_cubeschanged(l);
     return 1;
 }
 
@@ -1290,52 +1292,75 @@ int testpnt(struct node *np) {
 }
 
 
+/* the side of cube cn nearest to the side n,i. If the sum of the
+   distances of its corners is smaller than *min_d, *min_d, *sn and *found
+   are set to the side. */
+static void nearestside(struct node *n, int i, struct node *cn, float *min_d,
+                        struct node **sn, int *found) {
+    struct point d;
+    int j, k, m, wallnum;
+    float nd;
+
+
+    for (wallnum = 0; wallnum < 6; wallnum++) {
+        if (!cn->d.c->nc[wallnum]) {
+            for (m = 0; m < 4; m++) {
+                for (j = 0, nd = 0.0; j < 4; j++) {
+                    for (k = 0; k < 3; k++) {
+                        d.x[k] =
+                            cn->d.c->p[wallpts[wallnum][3 - j]]->d.p->x[k] -
+                            n->d.c->p[wallpts[i][(j + m) & 3]]->d.p->x[k];
+                    }
+
+                    nd += LENGTH(&d);
+
+                    if (nd >= *min_d) {
+                        break;
+                    }
+                }
+
+                if (nd < *min_d) {
+                    *sn = cn;
+                    *found = wallnum;
+                    *min_d = nd;
+                }
+            }
+        }
+    }
+}
+
+
 /* n=cube node. i=wallnum. Searches a side which is near the side
    n,i and connects it with n,i. Returns 0 if connectcubes is not successful,
    1 is returned if the cubes are connected. -1 is returned if no
    corresponding side is found. */
 int connectsides(struct node *n, int i) {
-    struct node *sn, *cn;
-    int j, k, m, wallnum, found = -1;
-    struct point d;
-    float min_d, nd;
+    struct node *sn = NULL, **cubes;
+    int j, k, found = -1, c, num_cubes;
+    struct point d, min, max;
+    float min_d = view.maxconndist * 4.0;
 
 
     my_assert(i >= 0 && i < 6 && n != NULL && n->d.c->nc[i] == NULL);
 
-    for (cn = l->cubes.head, sn = NULL, min_d = view.maxconndist * 4.0;
-         cn->next != NULL;
-         cn = cn->next) {
-        if (cn == n) {
-            continue;
+    /* the sum of the distances of the four corners must be smaller than
+       4*maxconndist, so the centers of the sides are nearer than
+       maxconndist. The center of the other side is in the box of its cube,
+       so only the cubes touching the box around n,i are checked */
+    for (k = 0; k < 3; k++) {
+        for (j = 0, d.x[k] = 0.0; j < 4; j++) {
+            d.x[k] += n->d.c->p[wallpts[i][j]]->d.p->x[k] / 4.0;
         }
 
-        for (wallnum = 0; wallnum < 6; wallnum++) {
-            if (!cn->d.c->nc[wallnum]) {
-                for (m = 0; m < 4; m++) {
-                    for (j = 0, nd = 0.0; j < 4; j++) {
-                        for (k = 0; k < 3; k++) {
-                            d.x[k] =
-                                cn->d.c->p[wallpts[wallnum][3 -
-                                                            j]]->d.p->x[k] -
-                                n->d.c->p[wallpts[i][(j +
-                                                      m) & 3]]->d.p->x[k];
-                        }
-
-                        nd += LENGTH(&d);
+        min.x[k] = d.x[k] - view.maxconndist;
+        max.x[k] = d.x[k] + view.maxconndist;
+    }
 
-                        if (nd >= min_d) {
-                            break;
-                        }
-                    }
+    num_cubes = cg_getcubes(l, &min, &max, &cubes);
 
-                    if (nd < min_d) {
-                        sn = cn;
-                        found = wallnum;
-                        min_d = nd;
-                    }
-                }
-            }
+    for (c = 0; c < num_cubes; c++) {
+        if (cubes[c] != n) {
+            nearestside(n, i, cubes[c], &min_d, &sn, &found);
         }
     }
 
@@ -1343,18 +1368,18 @@ int connectsides(struct node *n, int i) {
 }
 
 
-int move_pntlist(struct list *l, struct point *r) {
+int move_pntlist(struct list *pnts, struct point *r) {
     struct point *save, *p;
     struct node *n, *sn;
     int i;
 
 
-    if ( ( save = MALLOC(sizeof(struct point) * l->size) ) == NULL ) {
+    if ( ( save = MALLOC(sizeof(struct point) * pnts->size) ) == NULL ) {
         printmsg(TXT_NOMEMFOROLDCOORDS);
         return 1;
     }
 
-    for (sn = l->head, p = save; sn->next != NULL; sn = sn->next, p++) {
+    for (sn = pnts->head, p = save; sn->next != NULL; sn = sn->next, p++) {
         n = sn->d.n;
         *p = *n->d.p;
 
@@ -1365,7 +1390,7 @@ int move_pntlist(struct list *l, struct point *r) {
         fittogrid(n->d.p);
     }
 
-    for (sn = l->head, i = 0; sn->next != NULL; sn = sn->next) {
+    for (sn = pnts->head, i = 0; sn->next != NULL; sn = sn->next) {
         if ( !testpnt(sn->d.n) ) {
             i = 1;
             break;
@@ -1373,14 +1398,15 @@ int move_pntlist(struct list *l, struct point *r) {
     }
 
     if (i) {
-        for (n = l->head, p = save; p - save < l->size; n = n->next, p++) {
+        for (n = pnts->head, p = save; p - save < pnts->size;
+             n = n->next, p++) {
             *n->d.n->d.p = *p;
         }
 
         return 1;
     }
     else {
-        for (n = l->head; n->next != NULL; n = n->next) {
+        for (n = pnts->head; n->next != NULL; n = n->next) {
             newcorners(n->d.n);
         }
     }
@@ -1450,7 +1476,7 @@ struct node *newcube(struct leveldata *ld) {
     struct leveldata *ol;
 
 
-    checkmem( nc = MALLOC( sizeof(struct cube) ) );
+    checkmem( nc = w_poolalloc( ld->cubepool, sizeof(struct cube) ) );
     /* do the init stuff for the cube */
     nc->type = 0;
     nc->prodnum = -1;
@@ -1471,7 +1497,8 @@ struct node *newcube(struct leveldata *ld) {
     checkmem( nnc = addnode(&ld->cubes, -1, nc) );
 
     for (j = 0; j < 8; j++) {
-        checkmem( lp = MALLOC( sizeof(struct listpoint) ) );
+        checkmem( lp = w_poolalloc( ld->pntpool,
+                                    sizeof(struct listpoint) ) );
         checkmem( nlp = addnode(&ld->pts, -1, lp) );
         initlist(&lp->c);
         lp->tagged = NULL;
@@ -1483,7 +1510,8 @@ struct node *newcube(struct leveldata *ld) {
 
     /* and now make the walls */
     for (i = 0; i < 6; i++) {
-        checkmem( nc->walls[i] = MALLOC( sizeof(struct wall) ) );
+        checkmem( nc->walls[i] = w_poolalloc( ld->wallpool,
+                                              sizeof(struct wall) ) );
         nc->walls[i]->texture1 = nc->walls[i]->texture2 = 0;
         nc->walls[i]->txt2_direction = 0;
 
@@ -1507,18 +1535,20 @@ struct node *newcube(struct leveldata *ld) {
 
 
 void delflickeringlight(struct lightsource *ls) {
-    struct node *ne, *nfl;
+    struct packed_effect *pe, *end;
+    struct node *nfl;
 
 
     if (ls->fl == NULL) {
         return;
     }
 
-    for (ne = ls->effects.head; ne->next != NULL; ne = ne->next) {
-        for (nfl = ne->d.lse->cube->d.c->fl_lights.head->next; nfl != NULL;
+    for (pe = ls->ld->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+         pe < end; pe++) {
+        for (nfl = pe->cube->d.c->fl_lights.head->next; nfl != NULL;
              nfl = nfl->next) {
             if (nfl->prev->d.fl == ls->fl) {
-                freenode(&ne->d.lse->cube->d.c->fl_lights, nfl->prev, NULL);
+                freenode(&pe->cube->d.c->fl_lights, nfl->prev, NULL);
             }
         }
     }
@@ -1532,6 +1562,8 @@ void freewall(struct leveldata *ld, struct cube *c, int w) {
     my_assert(c->walls[w] != NULL && c->nc[w] != NULL);
 
     if (c->walls[w]->ls) {
+        setlsdirty(c->walls[w]->ls->d.ls);
+
         if (ld) {
             freenode(&ld->lightsources, c->walls[w]->ls, freelightsource);
         }
@@ -1540,7 +1572,9 @@ void freewall(struct leveldata *ld, struct cube *c, int w) {
         }
     }
 
-    FREE(c->walls[w]);
+    et_deletewall(ld != NULL ? ld : l, c, w);
+    pvs_cubeschanged(ld != NULL ? ld : l);
+    POOLFREE(c->walls[w]);
     c->walls[w] = NULL;
 }
 
@@ -1568,7 +1602,7 @@ struct node *insertcube(struct list *cubes, struct list *pts, struct node *c,
         pts = &l->pts;
     }
 
-    checkmem( nc = MALLOC( sizeof(struct cube) ) );
+    checkmem( nc = w_poolalloc( l->cubepool, sizeof(struct cube) ) );
     /* do the init stuff for the cube */
     nc->type = 0;
     nc->prodnum = -1;
@@ -1587,6 +1621,8 @@ struct node *insertcube(struct list *cubes, struct list *pts, struct node *c,
         nc->recalc_polygons[j] = 1;
     }
 
+    nc->grid_id = nc->grid_query = nc->edges_id = 0;
+    nc->lightdirty = 0;
     checkmem( nnc = addnode(cubes, -1, nc) );
 
     /* Calculate the 'depth'-vector for the new cube */
@@ -1643,7 +1679,7 @@ struct node *insertcube(struct list *cubes, struct list *pts, struct node *c,
                                          i]] = c->d.c->p[wallpts[wallnum][i]];
         checkmem( addnode(&c->d.c->p[wallpts[wallnum][i]]->d.lp->c,
                           wallpts[oppwalls[wallnum]][3 - i], nnc) );
-        checkmem( lp = MALLOC( sizeof(struct listpoint) ) );
+        checkmem( lp = w_poolalloc( l->pntpool, sizeof(struct listpoint) ) );
         checkmem( nlp = addnode(pts, -1, lp) );
         initlist(&lp->c);
         lp->tagged = NULL;
@@ -1663,7 +1699,8 @@ struct node *insertcube(struct list *cubes, struct list *pts, struct node *c,
             continue;
         }
 
-        checkmem( nc->walls[i] = MALLOC( sizeof(struct wall) ) );
+        checkmem( nc->walls[i] = w_poolalloc( l->wallpool,
+                                              sizeof(struct wall) ) );
         w = c->d.c->walls[i] != NULL && c->d.c->d[i] == NULL ?
             c->d.c->walls[i] : (view.pdefcube == NULL ? NULL :
                                 view.pdefcube->d.c->walls[view.defwall]);
@@ -1684,9 +1721,16 @@ struct node *insertcube(struct list *cubes, struct list *pts, struct node *c,
         recalcwall(nc, i);
     }
 
+    if (cubes == &l->cubes) {
+        cg_insertcube(l, nnc);
+        et_insertcube(l, nnc);
+        pvs_cubeschanged(l);
+    }
+
     /* and know kill the wall in the other cube */
     c->d.c->nc[wallnum] = nnc;
     nc->nc[oppwalls[wallnum]] = c;
+    setlightdirty(nnc);
     freewall(pts == NULL && cubes == NULL ? l : NULL, c->d.c, wallnum);
 
     if (cubes == NULL && pts == NULL) {
@@ -31,5 +31,5 @@ int connectsides(struct node *cube, int wallnum);
 int testcube(struct node *nc, int withmsg);
 int testpnt(struct node *np);
 void growshrink(struct node **ps, int *pntnos, int groworshrink);
-int move_pntlist(struct list *l, struct point *r);
+int move_pntlist(struct list *pnts, struct point *r);
 void makesidestdshape(struct cube *c, int w);
@@ -10,6 +10,11 @@ int isAlwaysSmoothing = 0;
 int theMinDeltaLight = 0;
 int theMaxLight = 65535;
 int changeCubeEnabled = 1;
+int theNumThreads = 0;
+int isAutoRelighting = 0;
+int isUsingPVS = 0;
+int theRenderBands = 0;
+int isProfiling = 0;
 
 
 char* lac_find_value(char* s) {
@@ -125,6 +130,75 @@ void lac_read_cfg(void) {
                 }
 
             }
+            else if ( ( p = strstr(s, "threads") ) ) {
+                if ( ( p = lac_find_value(p) ) ) {
+                    sscanf(p, "%d", &theNumThreads);
+
+                    if (theNumThreads < 0) {
+                        theNumThreads = 0;
+                    }
+
+                    fprintf(stderr, "Threads = %d\n", theNumThreads);
+                }
+
+            }
+            else if ( ( p = strstr(s, "autorelight") ) ) {
+                if ( ( p = lac_find_value(p) ) ) {
+                    sscanf(p, "%d", &isAutoRelighting);
+
+                    if (isAutoRelighting != 0) {
+                        isAutoRelighting = 1;
+                    }
+                    else {
+                        isAutoRelighting = 0;
+                    }
+
+                    fprintf(stderr, "AutoRelight = %d\n", isAutoRelighting);
+                }
+
+            }
+            else if ( ( p = strstr(s, "usepvs") ) ) {
+                if ( ( p = lac_find_value(p) ) ) {
+                    sscanf(p, "%d", &isUsingPVS);
+
+                    if (isUsingPVS != 0) {
+                        isUsingPVS = 1;
+                    }
+                    else {
+                        isUsingPVS = 0;
+                    }
+
+                    fprintf(stderr, "UsePVS = %d\n", isUsingPVS);
+                }
+
+            }
+            else if ( ( p = strstr(s, "renderbands") ) ) {
+                if ( ( p = lac_find_value(p) ) ) {
+                    sscanf(p, "%d", &theRenderBands);
+
+                    if (theRenderBands < 0) {
+                        theRenderBands = 0;
+                    }
+
+                    fprintf(stderr, "RenderBands = %d\n", theRenderBands);
+                }
+
+            }
+            else if ( ( p = strstr(s, "profile") ) ) {
+                if ( ( p = lac_find_value(p) ) ) {
+                    sscanf(p, "%d", &isProfiling);
+
+                    if (isProfiling != 0) {
+                        isProfiling = 1;
+                    }
+                    else {
+                        isProfiling = 0;
+                    }
+
+                    fprintf(stderr, "Profile = %d\n", isProfiling);
+                }
+
+            }
         }
     }
     else {
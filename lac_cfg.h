@@ -6,6 +6,14 @@
     extern int theMinDeltaLight;
     extern int theMaxLight;
     extern int changeCubeEnabled;
+    extern int theNumThreads; /* 0 = one thread for every processor */
+    extern int isAutoRelighting;
+    extern int isUsingPVS;
+    /* 0 = one band for every thread, 1 = the renderer uses one thread
+       (the two displays are rendered one after the other, too) */
+    extern int theRenderBands;
+    /* measure the time of parts of Devil (see profile.c) */
+    extern int isProfiling;
 
     void lac_read_cfg(void);
 
@@ -24,6 +24,7 @@
 #include "readlvl.h"
 #include "tag.h"
 #include "macros.h"
+#include "do_light.h"
 
 /* make a coordsystem naxis out of cube c in the following way:
    x-axis: vector from point pnt to point (pnt+1)&0x3 of wall.
@@ -68,6 +69,7 @@ void copy_lightsource(struct leveldata *insertinto, struct node **cubes,
 {
     struct lightsource *ls;
     struct ls_effect *lse;
+    struct list effects;
     struct node *sn, *nls;
 
 
@@ -77,8 +79,9 @@ void copy_lightsource(struct leveldata *insertinto, struct node **cubes,
     ls->cube = cubes[sls->cube->no];
     ls->w = sls->w;
     ls->fl = NULL;
+    ls->ld = insertinto;
+    ls->pe_start = ls->pe_num = 0;
     my_assert(ls->cube != NULL && ls->cube->d.c->walls[(int)ls->w] != NULL);
-    initlist(&ls->effects);
     checkmem( nls = addnode(&insertinto->lightsources, -1, ls) );
     ls->cube->d.c->walls[(int)ls->w]->ls = nls;
 
@@ -88,21 +91,26 @@ void copy_lightsource(struct leveldata *insertinto, struct node **cubes,
         ls->fl->ls = nls;
     }
 
-    for (sn = sls->effects.head; sn->next != NULL; sn = sn->next) {
-        if (!checktagged || sn->d.lse->cube->d.c->tagged) {
-            checkmem( lse = MALLOC( sizeof(struct ls_effect) ) );
-            *lse = *sn->d.lse;
-            my_assert(
-                sn->d.lse->cube->no >= 0 && sn->d.lse->cube->no < cubessize
-                     && cubes[sn->d.lse->cube->no] != NULL);
-            lse->cube = cubes[sn->d.lse->cube->no];
-            checkmem( addnode(&ls->effects, -1, lse) );
-
-            if (ls->fl != NULL) {
-                checkmem( addnode(&lse->cube->d.c->fl_lights, -1, ls->fl) );
-            }
+    getlseffects(sls, &effects);
+
+    for (sn = effects.head->next; sn != NULL; sn = sn->next) {
+        lse = sn->prev->d.lse;
+
+        if (checktagged && !lse->cube->d.c->tagged) {
+            freenode(&effects, sn->prev, free);
+            continue;
+        }
+
+        my_assert(lse->cube->no >= 0 && lse->cube->no < cubessize
+                 && cubes[lse->cube->no] != NULL);
+        lse->cube = cubes[lse->cube->no];
+
+        if (ls->fl != NULL) {
+            checkmem( addnode(&lse->cube->d.c->fl_lights, -1, ls->fl) );
         }
     }
+
+    setlseffects(ls, &effects);
 }
 
 
@@ -134,12 +142,13 @@ struct leveldata *buildmacro(struct leveldata *ld) {
     /* first make lists */
     for (tn = l->head; tn->next != NULL; tn = tn->next) {
         n = tn->d.n;
-        checkmem( c = MALLOC( sizeof(struct cube) ) );
+        checkmem( c = w_poolalloc( m->cubepool, sizeof(struct cube) ) );
         checkmem( nn = addnode(&m->cubes, n->no, c) );
         my_assert(n->no >= 0 && n->no < ld->cubes.size);
         cubes[n->no] = nn;
         *c = *n->d.c;
         c->tagged = NULL;
+        c->grid_id = c->edges_id = 0;
         initlist(&c->things);
 
         for (j = 0; j < 6; j++) {
@@ -156,7 +165,8 @@ struct leveldata *buildmacro(struct leveldata *ld) {
 
         for (j = 0; j < 8; j++) {
             if ( ( sn = findnode(&m->pts, n->d.c->p[j]->no) ) == NULL ) {
-                checkmem( lp = MALLOC( sizeof(struct listpoint) ) );
+                checkmem( lp = w_poolalloc( m->pntpool,
+                                            sizeof(struct listpoint) ) );
                 lp->p = n->d.c->p[j]->d.lp->p;
                 initlist(&lp->c);
                 lp->tagged = NULL;
@@ -173,7 +183,8 @@ struct leveldata *buildmacro(struct leveldata *ld) {
 
         for (j = 0; j < 6; j++) {
             if (n->d.c->walls[j] != NULL) {
-                checkmem( c->walls[j] = MALLOC( sizeof(struct wall) ) );
+                checkmem( c->walls[j] = w_poolalloc( m->wallpool,
+                                                      sizeof(struct wall) ) );
                 *c->walls[j] = *n->d.c->walls[j];
 
                 for (i = 0; i < 4; i++) {
@@ -430,7 +441,7 @@ int insertmacro(struct leveldata *m, int connectnow, float scaling) {
 
     /* inserting the points */
     for (n = m->pts.head; n->next != NULL; n = n->next) {
-        checkmem( lp = MALLOC( sizeof(struct listpoint) ) );
+        checkmem( lp = w_poolalloc( l->pntpool, sizeof(struct listpoint) ) );
 
         /* rotating points */
         for (i = 0; i < 3; i++) {
@@ -512,7 +523,7 @@ int insertmacro(struct leveldata *m, int connectnow, float scaling) {
 
     /* now insert all cubes */
     for (n = m->cubes.tail; n->prev != NULL; n = n->prev) {
-        checkmem( c = MALLOC( sizeof(struct cube) ) );
+        checkmem( c = w_poolalloc( l->cubepool, sizeof(struct cube) ) );
         *c = *n->d.c;
         c->tagged = NULL;
 
@@ -533,7 +544,8 @@ int insertmacro(struct leveldata *m, int connectnow, float scaling) {
             }
 
             if (n->d.c->walls[j] != NULL) {
-                checkmem( c->walls[j] = MALLOC( sizeof(struct wall) ) );
+                checkmem( c->walls[j] = w_poolalloc( l->wallpool,
+                                                      sizeof(struct wall) ) );
                 *c->walls[j] = *n->d.c->walls[j];
                 c->walls[j]->ls = NULL;
             }
@@ -216,7 +216,7 @@ void initdisplay(struct txt_list_win *tlw) {
     checkmem( tlw->marked_txts = CALLOC(sizeof(unsigned char), tlw->maxnum) );
 
     if ( rdl_curtxt == 0 &&
-        (tlw->type == txt2_normal || tlw->type == txt2_wall) ) {
+        ( (int)tlw->type == txt2_normal || (int)tlw->type == txt2_wall ) ) {
         i = 0;
     }
     else {
@@ -1578,7 +1578,7 @@ void b_selecttexture(struct w_button *b, int withtagged) {
     }
 
     if ( rdlno == 0 &&
-        (tlw->type == txt2_normal || tlw->type == txt2_wall) ) {
+        ( (int)tlw->type == txt2_normal || (int)tlw->type == txt2_wall ) ) {
         txtno = 1;
     }
     else {
@@ -28,6 +28,7 @@
 #include "readtxt.h"
 #include "opt_txt.h"
 #include "options.h"
+#include "do_light.h"
 
 #include "lac_cfg.h"
 
@@ -258,6 +259,19 @@ void changedata(struct infoitem *i, int withtagged, void *data) {
                     i->sidefuncnr);
         }
     }
+
+    /* texture1, texture2 or the direction of texture2 of a side changed:
+       the light the side emits changed */
+    if ( i->infonr == ds_wall && ( i->sidefuncnr == sc_sett2direction ||
+                                  ( i->offset >= 0 && i->offset <
+                                   2 * (int)sizeof(short int) ) ) ) {
+        for (n = l->tagged[i->tagnr].head; withtagged && n->next != NULL;
+             n = n->next) {
+            setlightdirty(n->d.n);
+        }
+
+        setlightdirty(view.pcurrcube);
+    }
 }
 
 
@@ -1058,7 +1072,7 @@ void b_clickoptwin(struct w_window *w, void *d, struct w_event *we) {
         return;
     }
 
-    if (i->tagnr < tt_number && view.currmode != i->tagnr) {
+    if ( (int)i->tagnr < tt_number && (int)view.currmode != i->tagnr ) {
         changecurrmode(i->tagnr);
     }
 }
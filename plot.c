@@ -33,6 +33,18 @@
 #include "plotsys.h"
 #include "plottxt.h"
 #include "plot.h"
+#include "edgetab.h"
+#include "plotlist.h"
+#include "lac_cfg.h"
+#include "profile.h"
+
+/* Compile with -DPSYS_SCALAR to make the view cache with plain C even if
+   the processor has SSE2 (like the span mapper in plotsys.c). */
+#if defined(__SSE2__) && !defined(PSYS_SCALAR)
+#define VC_SSE2
+#include <emmintrin.h>
+#endif
+
 #define COLORNUM2(d, min) ( ( (d) >= view.maxvisibility ) ? (min) : \
                            (d <=\
                             0.0) ? GRAYSCALE : ( (int)( (GRAYSCALE - \
@@ -103,6 +115,7 @@ float xviewphi = 0.5, yviewphi = 0.5, z_dist; /* viewphi is the cos(view angle)
 struct point x0, m0; /* x0 viewpoint, m0 line viewpoint-center of screen */
 int max_xcoord, max_ycoord; /* (scr_xysize-1)/2 */
 int scr_xsize, scr_ysize;
+unsigned long plot_drawings; /* counts the calls of cont_plotlevel */
 
 float FABS(float x) {
     return x < 0.0 ? -x : x;
@@ -199,11 +212,28 @@ void makeview(int lr) {
 }
 
 
-/* return the coords of point p on the screen plane in pix. Return a
-   1 if the point is visible, a zero otherwise. */
-int in_getpixelcoords(struct point *p, struct pixel *pix) {
-    struct point d, x, y;
-    float fx, fy;
+/* The view coords of all points of the current level for one view: x and
+   y along er[0],er[1], the depth along er[2] and the square of the
+   distance to x0. They are made in one pass for all points when the view
+   or the level changes (see vc_get). A point which has moved since
+   then (or isn't a point in the list of the level, like the points of
+   macros) is recognized in vc_getpnt, so nobody has to tell the cache
+   about changes. There are two of them for the left and right display. */
+struct viewcache {
+    struct leveldata *ld;
+    struct point x0, er[3];
+    int num;
+    struct point **pt; /* the point the coords of no are made of */
+    float *px, *py, *pz; /* and where it was then */
+    float *x, *y, *d, *l2;
+};
+static struct viewcache viewcaches[2];
+static int vc_last;
+
+
+/* view coords of p (see struct viewcache) in v[0..3] */
+static void viewcoords(struct point *p, float *v) {
+    struct point d;
     int i;
 
 
@@ -211,29 +241,218 @@ int in_getpixelcoords(struct point *p, struct pixel *pix) {
         d.x[i] = p->x[i] - x0.x[i];
     }
 
-    pix->d = SCALAR(&d, &er[2]);
-    fx = SCALAR(&d, &er[0]);
-    fy = SCALAR(&d, &er[1]);
+    v[0] = SCALAR(&d, &er[0]);
+    v[1] = SCALAR(&d, &er[1]);
+    v[2] = SCALAR(&d, &er[2]);
+    v[3] = SCALAR(&d, &d);
+}
 
-    if (pix->d < z_dist) {
-        return 0;            /* point behind me */
+
+static int vc_isview(struct viewcache *vc) {
+    int i;
+
+
+    if (vc->ld != l || vc->num != l->pts.maxnum + 1) {
+        return 0;
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (vc->x0.x[i] != x0.x[i] || vc->er[0].x[i] != er[0].x[i]
+           || vc->er[1].x[i] != er[1].x[i] || vc->er[2].x[i] != er[2].x[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* calculate the view coords of the points px,py,pz in vc */
+static void vc_project(struct viewcache *vc) {
+    struct point d;
+    int i = 0;
+
+
+#ifdef VC_SSE2
+    __m128 o0 = _mm_set1_ps(x0.x[0]), o1 = _mm_set1_ps(x0.x[1]),
+           o2 = _mm_set1_ps(x0.x[2]), e[3][3], dx, dy, dz;
+    int j, k;
+
+
+    for (j = 0; j < 3; j++) {
+        for (k = 0; k < 3; k++) {
+            e[j][k] = _mm_set1_ps(er[j].x[k]);
+        }
+    }
+
+    for (; i + 4 <= vc->num; i += 4) {
+        dx = _mm_sub_ps(_mm_loadu_ps(vc->px + i), o0);
+        dy = _mm_sub_ps(_mm_loadu_ps(vc->py + i), o1);
+        dz = _mm_sub_ps(_mm_loadu_ps(vc->pz + i), o2);
+        _mm_storeu_ps( vc->x + i,
+                      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, e[0][0]),
+                                            _mm_mul_ps(dy, e[0][1]) ),
+                                 _mm_mul_ps(dz, e[0][2]) ) );
+        _mm_storeu_ps( vc->y + i,
+                      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, e[1][0]),
+                                            _mm_mul_ps(dy, e[1][1]) ),
+                                 _mm_mul_ps(dz, e[1][2]) ) );
+        _mm_storeu_ps( vc->d + i,
+                      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, e[2][0]),
+                                            _mm_mul_ps(dy, e[2][1]) ),
+                                 _mm_mul_ps(dz, e[2][2]) ) );
+        _mm_storeu_ps( vc->l2 + i,
+                      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                            _mm_mul_ps(dy, dy) ),
+                                 _mm_mul_ps(dz, dz) ) );
+    }
+#endif
+
+    for (; i < vc->num; i++) {
+        d.x[0] = vc->px[i] - x0.x[0];
+        d.x[1] = vc->py[i] - x0.x[1];
+        d.x[2] = vc->pz[i] - x0.x[2];
+        vc->x[i] = SCALAR(&d, &er[0]);
+        vc->y[i] = SCALAR(&d, &er[1]);
+        vc->d[i] = SCALAR(&d, &er[2]);
+        vc->l2[i] = SCALAR(&d, &d);
+    }
+}
+
+
+/* the view cache for the current view (set with makeview or
+   initcoordsystem) of the current level. If there is none, it is made. */
+struct viewcache *vc_get(void) {
+    struct viewcache *vc;
+    struct node *n;
+    int i;
+
+
+    if (l == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if ( vc_isview(&viewcaches[i]) ) {
+            vc_last = i;
+            return &viewcaches[i];
+        }
     }
 
+    vc = &viewcaches[vc_last = 1 - vc_last];
+
+    if (vc->num != l->pts.maxnum + 1) {
+        FREE(vc->pt);
+        FREE(vc->px);
+        vc->num = l->pts.maxnum + 1;
+        checkmem( vc->pt = MALLOC(sizeof(struct point *) * vc->num) );
+        /* px,py,pz,x,y,d,l2 in one block */
+        checkmem( vc->px = MALLOC(sizeof(float) * 7 * vc->num) );
+        vc->py = vc->px + vc->num;
+        vc->pz = vc->py + vc->num;
+        vc->x = vc->pz + vc->num;
+        vc->y = vc->x + vc->num;
+        vc->d = vc->y + vc->num;
+        vc->l2 = vc->d + vc->num;
+    }
+
+    vc->ld = l;
+    vc->x0 = x0;
+
     for (i = 0; i < 3; i++) {
-        x.x[i] = d.x[i] - fy * er[1].x[i];
-        y.x[i] = d.x[i] - fx * er[0].x[i];
+        vc->er[i] = er[i];
+    }
+
+    for (i = 0; i < vc->num; i++) {
+        vc->pt[i] = NULL;
+        vc->px[i] = vc->py[i] = vc->pz[i] = 0.0;
+    }
+
+    for (n = l->pts.head; n->next != NULL; n = n->next) {
+        if (n->no >= 0 && n->no < vc->num) {
+            vc->pt[n->no] = n->d.p;
+            vc->px[n->no] = n->d.p->x[0];
+            vc->py[n->no] = n->d.p->x[1];
+            vc->pz[n->no] = n->d.p->x[2];
+        }
+    }
+
+    vc_project(vc);
+    return vc;
+}
+
+
+/* the view coords (see struct viewcache) of the point in node np in
+   v[0..3]. vc is the cache from vc_get for the current view or NULL. */
+void vc_getpnt(struct viewcache *vc, struct node *np, float *v) {
+    struct point *p = np->d.p;
+    int no = np->no;
+
+
+    if (vc == NULL || no < 0 || no >= vc->num || vc->pt[no] != p) {
+        viewcoords(p, v);
+        return;
+    }
+
+    if (vc->px[no] != p->x[0] || vc->py[no] != p->x[1]
+       || vc->pz[no] != p->x[2]) {
+        viewcoords(p, v);
+        vc->px[no] = p->x[0];
+        vc->py[no] = p->x[1];
+        vc->pz[no] = p->x[2];
+        vc->x[no] = v[0];
+        vc->y[no] = v[1];
+        vc->d[no] = v[2];
+        vc->l2[no] = v[3];
+        return;
+    }
+
+    v[0] = vc->x[no];
+    v[1] = vc->y[no];
+    v[2] = vc->d[no];
+    v[3] = vc->l2[no];
+}
+
+
+/* the coords of the direction d in the view (without the distance) in
+   v[0..2] */
+void in_getviewdir(struct point *d, float *v) {
+    v[0] = SCALAR(d, &er[0]);
+    v[1] = SCALAR(d, &er[1]);
+    v[2] = SCALAR(d, &er[2]);
+}
+
+
+/* like in_getpixelcoords for the view coords v[0..2] of a point */
+int in_getviewpixelcoords(float *v, struct pixel *pix) {
+    pix->d = v[2];
+
+    if (pix->d < z_dist) {
+        return 0;            /* point behind me */
     }
 
-    if (SCALAR(&x, &er[2]) < xviewphi || SCALAR(&y, &er[2]) < yviewphi) {
+    if (v[2] - v[1] * SCALAR(&er[1], &er[2]) < xviewphi
+       || v[2] - v[0] * SCALAR(&er[0], &er[2]) < yviewphi) {
         return 0;
     }
 
-    pix->x = fx * z_dist / pix->d + 0.5;
-    pix->y = fy * z_dist / pix->d + 0.5;
+    pix->x = v[0] * z_dist / pix->d + 0.5;
+    pix->y = v[1] * z_dist / pix->d + 0.5;
     return 1;
 }
 
 
+/* return the coords of point p on the screen plane in pix. Return a
+   1 if the point is visible, a zero otherwise. */
+int in_getpixelcoords(struct point *p, struct pixel *pix) {
+    float v[4];
+
+
+    viewcoords(p, v);
+    return in_getviewpixelcoords(v, pix);
+}
+
+
 /* returns the coords of point p in pix. lr==0 for left display, lr==1
    for right display */
 int getpixelcoords(int lr, struct point *p, struct pixel *pix) {
@@ -260,66 +479,42 @@ int calchit(float *r, float ax, float ay, float ex, float ey, float dx,
 }
 
 
-/* get the (clipped) screen coords for line sp->ep (lr==0 on left,==1 on right
-    display) and return them in spix,epix. If the line is not visible, return
-   a 0,otherwise a 1. if checkdist==1 then check if the line is too
-   far away */
-int getscreencoords(int lr, struct point *sp, struct point *ep,
-                    struct pixel *spix, struct pixel *epix,
-                    int checkdist)
+/* get the (clipped) screen coords for the line from the point with the
+   view coords s to the one with e (see struct viewcache). The rest like
+   getscreencoords. */
+static int clipscreencoords(int lr, float *s_s, float *e_s,
+                            struct pixel *spix, struct pixel *epix,
+                            int checkdist)
 {
-    struct point e_d, s_d, d, p;
-    float f1, f2, s_s[3], e_s[3], l2_e, l2_s;
+    float f1, *h;
     struct point_2d sp2d, ep2d;
-    int i;
 
 
     /* clip the line against the viewplane */
-    for (i = 0; i < 3; i++) {
-        e_d.x[i] = ep->x[i] - x0.x[i];
-        s_d.x[i] = sp->x[i] - x0.x[i];
-        d.x[i] = ep->x[i] - sp->x[i];
-    }
-
-    f1 = SCALAR(&s_d, &er[2]);
-    f2 = SCALAR(&e_d, &er[2]);
-
-    if (f1 < z_dist && f2 < z_dist) {
+    if (s_s[2] < z_dist && e_s[2] < z_dist) {
         return 0;                     /* point behind me */
     }
 
-    if (checkdist && f1 > view.maxvisibility && f2 > view.maxvisibility) {
+    if (checkdist && s_s[2] > view.maxvisibility
+       && e_s[2] > view.maxvisibility) {
         return 0;
     }
 
     /* point too far away */
-    if (f1 >= z_dist && f2 < z_dist) {
-        s_s[2] = f2;
-        e_s[2] = f1;
-        p = e_d;
-        e_d = s_d;
-        s_d = p;
-    }
-    else {
-        s_s[2] = f1;
-        e_s[2] = f2;
+    if (s_s[2] >= z_dist && e_s[2] < z_dist) {
+        h = e_s;
+        e_s = s_s;
+        s_s = h;
     }
 
-    s_s[0] = SCALAR(&s_d, &er[0]);
-    e_s[0] = SCALAR(&e_d, &er[0]);
-    s_s[1] = SCALAR(&s_d, &er[1]);
-    e_s[1] = SCALAR(&e_d, &er[1]);
-    l2_s = SCALAR(&s_d, &s_d);
-    l2_e = SCALAR(&e_d, &e_d);
-
     if ( ( (s_s[0] > 0.0 && e_s[0] > 0.0) || (s_s[0] < 0.0 && e_s[0] < 0.0) )
-       && s_s[0] * s_s[0] > l2_s * xviewphi && e_s[0] * e_s[0] > l2_e *
+       && s_s[0] * s_s[0] > s_s[3] * xviewphi && e_s[0] * e_s[0] > e_s[3] *
         xviewphi ) {
         return 0;
     }
 
     if ( ( (s_s[1] > 0.0 && e_s[1] > 0.0) || (s_s[1] < 0.0 && e_s[1] < 0.0) )
-       && s_s[1] * s_s[1] > l2_e * yviewphi && e_s[1] * e_s[1] > l2_e *
+       && s_s[1] * s_s[1] > e_s[3] * yviewphi && e_s[1] * e_s[1] > e_s[3] *
         yviewphi ) {
         return 0;
     }
@@ -436,6 +631,38 @@ int getscreencoords(int lr, struct point *sp, struct point *ep,
 }
 
 
+/* get the (clipped) screen coords for line sp->ep (lr==0 on left,==1 on right
+    display) and return them in spix,epix. If the line is not visible, return
+   a 0,otherwise a 1. if checkdist==1 then check if the line is too
+   far away */
+int getscreencoords(int lr, struct point *sp, struct point *ep,
+                    struct pixel *spix, struct pixel *epix,
+                    int checkdist)
+{
+    float s[4], e[4];
+
+
+    viewcoords(sp, s);
+    viewcoords(ep, e);
+    return clipscreencoords(lr, s, e, spix, epix, checkdist);
+}
+
+
+/* like getscreencoords for the points in the nodes sp,ep. vc is the cache
+   from vc_get for the current view or NULL */
+int getpntscreencoords(int lr, struct viewcache *vc, struct node *sp,
+                       struct node *ep, struct pixel *spix,
+                       struct pixel *epix, int checkdist)
+{
+    float s[4], e[4];
+
+
+    vc_getpnt(vc, sp, s);
+    vc_getpnt(vc, ep, e);
+    return clipscreencoords(lr, s, e, spix, epix, checkdist);
+}
+
+
 void in_plot3dline(int lr, struct point *sp, struct point *ep, int color,
                    int xor,
                    int checkdist)
@@ -593,7 +820,10 @@ void plotdoor(struct node *n, int hilight, int xor) {
    hilight==256: black
    withdoors==1: draw doors that switch this cube
    withdoors==-1: undraw doors ....
-   withdoors==0: only draw cube */
+   withdoors==0: only draw cube
+   withalllines==0: not the lines of sides with neighbours with lower numbers
+   withalllines==-1: only the lines which belong to this cube in the edge
+   table (c->wire_edges, see edgetab.c) */
 void in_plotcube(int w, struct node *n, int hilight, int withdoors, int xor,
                  int withalllines,
                  int withlockedsides)
@@ -602,6 +832,8 @@ void in_plotcube(int w, struct node *n, int hilight, int withdoors, int xor,
     int j, next, testdist;
     struct cube *c = n->d.c;
     struct node *sdn;
+    struct viewcache *vc;
+    float v[8][4];
 
 
     testdist = (hilight == 0);
@@ -644,7 +876,12 @@ void in_plotcube(int w, struct node *n, int hilight, int withdoors, int xor,
 
     next = 0xffff;
 
-    if (!withalllines) {
+    if (withalllines < 0) {
+        if ( ( next = c->wire_edges ) == 0 ) {
+            return;
+        }
+    }
+    else if (!withalllines) {
         for (j = 0; j < 6; j++) {
             if (c->nc[j] != NULL && c->nc[j]->no < n->no) {
                 switch (j) {
@@ -680,26 +917,30 @@ void in_plotcube(int w, struct node *n, int hilight, int withdoors, int xor,
         }
     }
 
+    vc = vc_get();
+
+    for (j = 0; j < 8; j++) {
+        vc_getpnt(vc, c->p[j], v[j]);
+    }
+
     for (j = 0; j < 4; j++) {
         if ( ( next & (1 << j) ) != 0
-           && getscreencoords(w, c->p[j]->d.p, c->p[j == 3 ? 0 : j + 1]->d.p,
-                              &spix, &epix,
-                              testdist) ) {
+           && clipscreencoords(w, v[j], v[j == 3 ? 0 : j + 1], &spix, &epix,
+                               testdist) ) {
             plotline(spix.x, spix.y, epix.x, epix.y,
                      WCOLORNUM( (spix.d + epix.d) / 2, hilight ), xor);
         }
 
         if ( ( next & (0x10 << j) ) != 0
-           && getscreencoords(w, c->p[j + 4]->d.p,
-                              c->p[j == 3 ? 4 : j + 5]->d.p, &spix, &epix,
-                              testdist) ) {
+           && clipscreencoords(w, v[j + 4], v[j == 3 ? 4 : j + 5], &spix,
+                               &epix, testdist) ) {
             plotline(spix.x, spix.y, epix.x, epix.y,
                      WCOLORNUM( (spix.d + epix.d) / 2, hilight ), xor);
         }
 
         if ( ( next & (0x100 << j) ) != 0
-           && getscreencoords(w, c->p[j]->d.p, c->p[j + 4]->d.p, &spix, &epix,
-                              testdist) ) {
+           && clipscreencoords(w, v[j], v[j + 4], &spix, &epix,
+                               testdist) ) {
             plotline(spix.x, spix.y, epix.x, epix.y,
                      WCOLORNUM( (spix.d + epix.d) / 2, hilight ), xor);
         }
@@ -781,13 +1022,18 @@ void plotthing(struct thing *t, int hilight) {
    hilight==256: black */
 void in_plotwall(int w, struct cube *c, int wno, int hilight, int xor) {
     struct pixel spix, epix;
+    struct viewcache *vc = vc_get();
+    float v[4][4];
     int j;
 
 
     for (j = 0; j < 4; j++) {
-        if ( getscreencoords(w, c->p[wallpts[wno][j]]->d.p,
-                             c->p[wallpts[wno][(j + 1) & 3]]->d.p, &spix,
-                             &epix, hilight == 0) ) {
+        vc_getpnt(vc, c->p[wallpts[wno][j]], v[j]);
+    }
+
+    for (j = 0; j < 4; j++) {
+        if ( clipscreencoords(w, v[j], v[(j + 1) & 3], &spix, &epix,
+                              hilight == 0) ) {
             plotline(spix.x, spix.y, epix.x, epix.y,
                      WCOLORNUM( (spix.d + epix.d) / 2.0,
                                ( (j == 0 || j ==
@@ -1119,31 +1365,230 @@ void plotpnt(struct node *n, int w, int c, int hilight) {
 /* plot current level l. */
 void plotlevel(void) {
     struct lightsource *ls;
+
+
     cont_plotlevel(&ls);
 }
 
 
-unsigned long cont_plotlevel(struct lightsource **ls) {
+/* the signatures for the items of cont_plotlevel in the list of drawn
+   lines (see plotlist.c). They contain everything the drawing of the
+   item depends on besides framesig. */
+static unsigned long linesig(struct line *ln) {
+    unsigned long h;
+
+
+    h = dl_hash(0, ln->s->d.p, sizeof(struct point));
+    h = dl_hash(h, ln->e->d.p, sizeof(struct point));
+    return dl_hash( h, &ln->color, sizeof(int) );
+}
+
+
+static unsigned long cubesig(struct node *n) {
+    struct cube *c = n->d.c;
+    unsigned long h;
+    int i, k[3];
+
+
+    h = dl_hash( 0, &n->no, sizeof(int) );
+    h = dl_hash( h, &c->type, sizeof(c->type) );
+
+    if ( et_valid(l) ) {
+        h = dl_hash( h, &c->wire_edges, sizeof(c->wire_edges) );
+    }
+
+    for (i = 0; i < 8; i++) {
+        h = dl_hash(h, c->p[i]->d.p, sizeof(struct point));
+    }
+
+    for (i = 0; i < 6; i++) {
+        k[0] = c->nc[i] != NULL ? c->nc[i]->no : -1;
+        k[1] = c->walls[i] != NULL && c->walls[i]->locked;
+        k[2] = c->tagged_walls[i] != NULL;
+        h = dl_hash( h, k, sizeof(k) );
+    }
+
+    return h;
+}
+
+
+static unsigned long thingsig(struct thing *t) {
+    unsigned long h;
+    int k[3];
+
+
+    k[0] = t->tagged != NULL;
+    k[1] = t->type1;
+    k[2] = t->color;
+    h = dl_hash( 0, k, sizeof(k) );
+    return dl_hash(h, &t->p[1], sizeof(struct point) * 10);
+}
+
+
+/* the signature of the frame for dl_start: the window, the options for
+   drawing and the views of the displays */
+static unsigned long framesig(void) {
+    unsigned long h;
+    int lr, k[7];
+
+
+    k[0] = w_xwinincoord(l->w, 0);
+    k[1] = w_ywinincoord(l->w, 0);
+    k[2] = w_xwininsize(l->w);
+    k[3] = w_ywininsize(l->w);
+    k[4] = l->whichdisplay;
+    k[5] = view.whichdisplay;
+    k[6] = view.drawwhat;
+    h = dl_hash( 0, k, sizeof(k) );
+    h = dl_hash( h, &view.maxvisibility, sizeof(float) );
+    h = dl_hash( h, &view.tsize, sizeof(float) );
+    h = dl_hash( h, view.color, sizeof(view.color) );
+
+    for (lr = 0; lr <= l->whichdisplay; lr++) {
+        makeview(lr);
+        h = dl_hash( h, &x0, sizeof(struct point) );
+        h = dl_hash(h, er, sizeof(struct point) * 3);
+        h = dl_hash( h, &z_dist, sizeof(float) );
+    }
+
+    return h;
+}
+
+
+/* draw the lines of the level (the map or all lines of the cubes) in the
+   display lr */
+static void plotmaplines(int lr, int retained) {
     struct node *n;
-    int lr, i;
+    int i;
     struct point d;
+    struct pixel spix, epix;
+    struct viewcache *vc;
+    struct edge *edges;
+
+
+    if ( (view.drawwhat & DW_CUBES) != 0 ||
+        (!l->inside && view.render > 1) ) {
+        if ( (view.drawwhat & DW_ALLLINES) == 0 ) {
+            vc = vc_get();
+
+            for (n = l->lines.head; n->next != NULL; n = n->next) {
+                if ( retained
+                    && !dl_item( lr, dls_line, n, linesig(n->d.l) ) ) {
+                    continue;
+                }
+
+                if ( !getpntscreencoords(lr, vc, n->d.l->s, n->d.l->e,
+                                         &spix, &epix, 1) ) {
+                    continue;
+                }
+
+                for (i = 0; i < 3; i++) {
+                    d.x[i] = (n->d.l->s->d.p->x[i] +
+                              n->d.l->e->d.p->x[i]) / 2.0 - x0.x[i];
+                }
+
+                plotline(spix.x, spix.y, epix.x, epix.y,
+                         WCOLORNUM(LENGTH(&d), n->d.l->color), 0);
+            }
+        }
+        else {
+            /* draw each line only once */
+            et_gettable(l, &edges);
+
+            for (n = l->cubes.head; n->next != NULL; n = n->next) {
+                if (n->d.c->tagged != NULL) {
+                    continue;
+                }
+
+                if ( !retained || dl_item( lr, dls_cube, n, cubesig(n) ) ) {
+                    in_plotcube(lr, n, 0, 0, 0, -1, 1);
+                }
+            }
+        }
+    }
+}
+
+
+/* show the number of calls and the median and the 99th percentile of the
+   times of the measured parts in the upper left corner of the level
+   window */
+static void plotprofile(void) {
+    struct prof_stats st;
+    char buffer[80];
+    int i, y;
+
+
+    for (i = 0, y = 0; i < ps_num_of_scopes; i++) {
+        if ( !prof_getstats(i, &st) ) {
+            continue;
+        }
+
+        if ( y + w_titlebarheight() > w_ywininsize(l->w) ) {
+            break;
+        }
+
+        sprintf(buffer, "%-14s %8lu p50 %8.3f p99 %8.3f ms", st.name,
+                st.count, st.p50, st.p99);
+        ws_drawtext(w_xwinincoord(l->w, 2), w_ywinincoord(l->w, y),
+                    w_xwininsize(l->w) - 4, buffer, view.color[WHITE],
+                    view.color[BLACK]);
+        y += w_titlebarheight();
+    }
+}
+
+
+/* Without textures everything is drawn into the list of plotlist.c and
+   each cube, line or thing is an item there, so only the parts of the
+   window which have changed are drawn again. */
+unsigned long cont_plotlevel(struct lightsource **ls) {
+    struct node *n;
+    int lr, i, retained, concurrent;
     long dt = -1;
+    double t;
 
 
     if (l == NULL || l->w == NULL || l->w->shrunk) {
         return 0;
     }
 
+    t = prof_start();
+
+    plot_drawings++;
     w_refreshstart(l->w);
-    /* kill oldpicture */
-    clearlevelwin();
+    retained = (view.render == 0);
+
+    if (retained) {
+        dl_start( framesig() );
+    }
+    else {
+        /* kill oldpicture */
+        clearlevelwin();
+    }
+
     oldpcurrcube = oldpcurrthing = oldpcurrdoor = oldpcurrpnt = NULL;
     oldcurrwall = oldcurredge = -1;
     killoldmacro = 0;
+    /* the textures of both displays are rendered at the same time unless
+       the renderer is set to one thread. The lines are under the
+       textures, so they are drawn before in both displays. */
+    concurrent = l->whichdisplay && view.render >= 1 && theRenderBands != 1;
+
+    if (concurrent) {
+        for (lr = 0; lr <= 1; lr++) {
+            makeview(lr);
+            plotmaplines(lr, retained);
+        }
+
+        dt = render_views(l, view.pcurrcube, view.render == 1 ? 1 : 0);
+    }
 
     for (lr = 0; lr <= l->whichdisplay; lr++) {
         makeview(lr);
 
+        if (retained) {
+            dl_item(lr, dls_divider, NULL, 0);
+        }
+
         if (lr) {
             plotline(w_xwininsize(l->w) / 2, 0, w_xwininsize(l->w) / 2,
                      w_ywininsize(l->w) - 1, view.color[WHITE], 0);
@@ -1157,39 +1602,21 @@ unsigned long cont_plotlevel(struct lightsource **ls) {
                               view.pcurrcube, view.drawwhat, 0);
         }
         else {
-            if ( (view.drawwhat & DW_CUBES) != 0 ||
-                (!l->inside && view.render > 1) ) {
-                if ( (view.drawwhat & DW_ALLLINES) == 0 ) {
-                    for (n = l->lines.head; n->next != NULL; n = n->next) {
-                        for (i = 0; i < 3; i++) {
-                            d.x[i] =
-                                (n->d.l->s->d.p->x[i] +
-                                 n->d.l->e->d.p->x[i]) / 2.0 - x0.x[i];
-                        }
+            if (!concurrent) {
+                plotmaplines(lr, retained);
 
-                        in_plot3dline(lr, n->d.l->s->d.p, n->d.l->e->d.p,
-                                      WCOLORNUM(LENGTH(
-                                                    &d), n->d.l->color), 0, 1);
-                    }
-                }
-                else {
-                    for (n = l->cubes.head; n->next != NULL; n =
-                             n->next)              {
-                        if (n->d.c->tagged == NULL) {
-                            in_plotcube(lr, n, 0, 0, 0, 0, 1);
-                        }
-                    }
+                if (view.render >= 1) {
+                    dt = render_level(lr, l, view.pcurrcube, 0,
+                                      view.render == 1 ? 1 : 0);
                 }
             }
 
-            if (view.render >= 1) {
-                dt = render_level(lr, l, view.pcurrcube, 0,
-                                  view.render == 1 ? 1 : 0);
-            }
-
             if ( (view.drawwhat & DW_THINGS) != 0 ) {
                 for (n = l->things.head; n->next != NULL; n = n->next) {
-                    if (!n->d.t->tagged) {
+                    if ( !n->d.t->tagged && ( !retained
+                                             || dl_item( lr, dls_thing, n,
+                                                        thingsig(n->d.t) ) ) )
+                    {
                         in_plotthing(lr, n->d.t, 0);
                     }
                 }
@@ -1197,18 +1624,28 @@ unsigned long cont_plotlevel(struct lightsource **ls) {
 
             if ( (view.drawwhat & DW_DOORS) != 0 ) {
                 for (n = l->doors.head; n->next != NULL; n = n->next) {
-                    if (!n->d.d->tagged) {
+                    if ( !n->d.d->tagged && ( !retained
+                                             || dl_item(lr, dls_door, n,
+                                                        0) ) ) {
                         in_plotdoor(lr, n, 0, 0, 0);
                     }
                 }
             }
 
+            if (retained) {
+                dl_item(lr, dls_exit, NULL, 0);
+            }
+
             if (l->exitcube) {
                 in_plottagwall(lr, l->exitcube->d.c, l->exitwall, 2, 0);
                 in_plotmarker(
                     lr, l->exitcube->d.c->p[wallpts[l->exitwall][0]]->d.p, 2);
             }
 
+            if (retained) {
+                dl_item(lr, dls_corridor, NULL, 0);
+            }
+
             if (l->cur_corr) {
                 in_plotcorridor(lr, l->cur_corr);
             }
@@ -1216,11 +1653,17 @@ unsigned long cont_plotlevel(struct lightsource **ls) {
 
         /* now plot tagged things */
         for (n = l->cubes.head; n->next != NULL; n = n->next) {
-            if (n->d.c->tagged != NULL) {
+            if ( n->d.c->tagged != NULL && ( !retained
+                                            || dl_item( lr, dls_tagcube, n,
+                                                       cubesig(n) ) ) ) {
                 in_plotcube(lr, n, 3, 0, 0, 1, 1);
             }
         }
 
+        if (retained) {
+            dl_item(lr, dls_xtagged, NULL, 0);
+        }
+
         if ( (view.drawwhat & DW_XTAGGED) != 0 ) {
             for (n = l->tagged[tt_cube].head; n->next != NULL; n = n->next) {
                 for (i = 0; i < 6; i++) {
@@ -1229,33 +1672,72 @@ unsigned long cont_plotlevel(struct lightsource **ls) {
             }
         }
 
+        if (retained) {
+            dl_item(lr, dls_tagwalls, NULL, 0);
+        }
+
         for (n = l->tagged[tt_wall].head; n->next != NULL; n = n->next) {
             in_plottagwall(lr, n->d.n->d.c, n->no % 6,
                            n->d.n->d.c->walls[n->no % 6] != NULL
                           && n->d.n->d.c->walls[n->no % 6]->locked ? 4 : 3, 0);
         }
 
+        if (retained) {
+            dl_item(lr, dls_tagpnts, NULL, 0);
+        }
+
         for (n = l->tagged[tt_pnt].head; n->next != NULL; n = n->next) {
             in_plotmarker(lr, n->d.n->d.p, 3);
         }
 
+        if (retained) {
+            dl_item(lr, dls_tagthings, NULL, 0);
+        }
+
         for (n = l->tagged[tt_thing].head; n->next != NULL; n = n->next) {
             in_plotthing(lr, n->d.n->d.t, 0);
         }
 
+        if (retained) {
+            dl_item(lr, dls_tagdoors, NULL, 0);
+        }
+
         for (n = l->tagged[tt_door].head; n->next != NULL; n = n->next) {
             in_plotdoor(lr, n->d.n, 3, 0, 0);
         }
 
+        if (retained) {
+            dl_item(lr, dls_tagedges, NULL, 0);
+        }
+
         for (n = l->tagged[tt_edge].head; n->next != NULL; n = n->next) {
             in_plotpnt(lr, n->d.n, (n->no % 24) / 4, (n->no % 24) % 4, 3);
         }
 
+        if (retained) {
+            dl_item(lr, dls_current, NULL, 0);
+        }
+
         in_plotcurrent(lr);
+
+        if (retained) {
+            dl_item(lr, dls_axis, NULL, 0);
+        }
+
         in_plotcoordaxis(lr);
     }
 
-    copytoscreen();
+    if (retained) {
+        dl_finish();
+    }
+    else {
+        copytoscreen();
+    }
+
+    if (isProfiling) {
+        plotprofile();
+    }
+
     oldpcurrthing = view.pcurrthing;
     oldpcurrdoor = view.pcurrdoor;
     oldpcurrcube = view.pcurrcube;
@@ -1278,47 +1760,103 @@ unsigned long cont_plotlevel(struct lightsource **ls) {
         }
     }
 
+    prof_end(ps_plotlevel, t);
     return *ls == NULL ? 0 : dt;
 }
 
 
 /* #include "plotfill.c" */
 
-void addline(struct node *c, int s, int e) {
-    struct node *sp, *ep;
-    struct line *li;
-    struct node *n;
+/* is the edge j of wall i of cube n a line in the descent-like map? */
+static int ismapline(struct node *n, int i, int j) {
+    int k, a, cn1, wno;
+    struct wall *w;
+    struct point t, c0, c1, c2;
+    float x1, x2;
 
 
-    if (c->d.c->p[s] < c->d.c->p[e]) {
-        sp = c->d.c->p[s];
-        ep = c->d.c->p[e];
+/*     cn1=findnbcubetoline(i,j,(j+1)&3); */
+    cn1 = nb_sides[i][j];
+
+    if (n->d.c->nc[cn1] == NULL) {
+        return 1;
     }
-    else {
-        sp = c->d.c->p[e];
-        ep = c->d.c->p[s];
+
+    /* ok, wall is there, neighbour cube is also there. Let's have a
+       look if there's a wall in the neighbourcube */
+    wno = findnbwalltoline(n, n->d.c->nc[cn1]->d.c, i, j, (j + 1) & 3);
+
+    if (wno == -1 || (w = n->d.c->nc[cn1]->d.c->walls[wno]) == NULL) {
+        return 1;
     }
 
-    for (n = l->lines.tail; n->prev != NULL; n = n->prev) {
-        if (n->d.l->s->no == sp->no && n->d.l->e->no == ep->no) {
-            return;
+    /* Calculate angle between walls */
+    for (k = 0; k < 3; k++) {
+        c1.x[k] = 0;
+        c2.x[k] = 0;
+
+        for (a = 0; a < 4; a++) {
+            c1.x[k] += n->d.c->walls[i]->p[a]->d.p->x[k];
+            c2.x[k] += w->p[a]->d.p->x[k];
         }
+
+        c0.x[k] = (n->d.c->walls[i]->p[j]->d.p->x[k] +
+                   n->d.c->walls[i]->p[(j + 1) & 3]->d.p->x[k]) / 2.0;
+        t.x[k] = (n->d.c->walls[i]->p[j]->d.p->x[k] -
+                  n->d.c->walls[i]->p[(j + 1) & 3]->d.p->x[k]);
+        c1.x[k] = c1.x[k] / 4.0 - c0.x[k];
+        c2.x[k] = c2.x[k] / 4.0 - c0.x[k];
     }
 
-    checkmem( li = malloc( sizeof(struct line) ) );
-    addnode(&l->lines, c->no, li);
-    li->s = sp;
-    li->e = ep;
-    li->color = 0;
+    /* make both vectors orthgonal to c0 */
+    normalize(&t);
+    x1 = SCALAR(&c1, &t);
+    x2 = SCALAR(&c2, &t);
+
+    for (k = 0; k < 3; k++) {
+        c1.x[k] -= x1 * t.x[k];
+        c2.x[k] -= x2 * t.x[k];
+    }
+
+    normalize(&c1);
+    normalize(&c2);
+    return SCALAR(&c1, &c2) > view.mapangle;
 }
 
 
+/* insert or delete the line of the edge ed in the map */
+static void setmapline(struct edge *ed) {
+    struct line *li;
+    int k;
+
+
+    for (k = 0; k < ed->num_walls; k++) {
+        if ( ismapline(ed->walls[k].cube, ed->walls[k].wall,
+                       ed->walls[k].edge) ) {
+            break;
+        }
+    }
+
+    if (k < ed->num_walls && ed->line == NULL) {
+        checkmem( li = malloc( sizeof(struct line) ) );
+        checkmem( ed->line = addnode(&l->lines, ed->walls[0].cube->no, li) );
+        li->s = ed->s;
+        li->e = ed->e;
+        li->color = 0;
+    }
+    else if (k == ed->num_walls && ed->line != NULL) {
+        freenode(&l->lines, ed->line, free);
+        ed->line = NULL;
+    }
+}
+
+
+/* make the descent-like map: every edge of a wall is a line if there's
+   no wall on the other side or the angle between the walls is large
+   enough. */
 void initdescmap(void) {
-    struct node *n;
-    int i, j, k, a, cn1, wno;
-    struct wall *w;
-    struct point t, c0, c1, c2;
-    float x1, x2;
+    struct edge *edges;
+    int i, num_edges;
 
 
     if (!l) {
@@ -1327,70 +1865,33 @@ void initdescmap(void) {
     }
 
     freelist(&l->lines, free);
+    num_edges = et_gettable(l, &edges);
 
-    for (n = l->cubes.head; n->next != NULL; n = n->next) {
-        for (i = 0; i < 6; i++) {
-            if (n->d.c->walls[i] != NULL) {
-                for (j = 0; j < 4; j++) {
-/*     cn1=findnbcubetoline(i,j,(j+1)&3); */
-                    cn1 = nb_sides[i][j];
-
-                    if (n->d.c->nc[cn1] == NULL) {
-                        addline(n, wallpts[i][j], wallpts[i][(j + 1) & 3]);
-                    }
-                    else {
-                        /* ok, wall is there, neighbour cube is also there. Let's
-                           have a
-                           look if there's a wall in the neighbourcube */
-                        wno =
-                            findnbwalltoline(n, n->d.c->nc[cn1]->d.c, i, j,
-                                             (j + 1) & 3);
-
-                        if (wno == -1 ||
-                            (w = n->d.c->nc[cn1]->d.c->walls[wno]) == NULL) {
-                            addline(n, wallpts[i][j], wallpts[i][(j + 1) & 3]);
-                            continue;
-                        }
-
-                        /* Calculate angle between walls */
-                        for (k = 0; k < 3; k++) {
-                            c1.x[k] = 0;
-                            c2.x[k] = 0;
-
-                            for (a = 0; a < 4; a++) {
-                                c1.x[k] += n->d.c->walls[i]->p[a]->d.p->x[k];
-                                c2.x[k] += w->p[a]->d.p->x[k];
-                            }
+    for (i = 0; i < num_edges; i++) {
+        edges[i].line = NULL;
+        setmapline(&edges[i]);
+    }
+}
 
-                            c0.x[k] = (n->d.c->walls[i]->p[j]->d.p->x[k] +
-                                       n->d.c->walls[i]->p[(j +
-                                                            1) &
-                                                           3]->d.p->x[k]) /
-                                      2.0;
-                            t.x[k] = (n->d.c->walls[i]->p[j]->d.p->x[k] -
-                                      n->d.c->walls[i]->p[(j +
-                                                           1) & 3]->d.p->x[k]);
-                            c1.x[k] = c1.x[k] / 4.0 - c0.x[k];
-                            c2.x[k] = c2.x[k] / 4.0 - c0.x[k];
-                        }
 
-                        /* make both vectors orthgonal to c0 */
-                        normalize(&t);
-                        x1 = SCALAR(&c1, &t);
-                        x2 = SCALAR(&c2, &t);
+/* the points of cube nc were moved: update the lines of the edges of its
+   walls in the map (if the map is drawn) */
+void updatedescmap(struct node *nc) {
+    struct edge *ed;
+    int i, j;
 
-                        for (k = 0; k < 3; k++) {
-                            c1.x[k] -= x1 * t.x[k];
-                            c2.x[k] -= x2 * t.x[k];
-                        }
 
-                        normalize(&c1);
-                        normalize(&c2);
+    if ( !l || (view.drawwhat & DW_ALLLINES) != 0 || !et_valid(l) ) {
+        return;
+    }
 
-                        if (SCALAR(&c1, &c2) > view.mapangle) {
-                            addline(n, wallpts[i][j], wallpts[i][(j + 1) & 3]);
-                        }
-                    }
+    for (i = 0; i < 6; i++) {
+        if (nc->d.c->walls[i] != NULL) {
+            for (j = 0; j < 4; j++) {
+                if ( ( ed = et_findedge(l, nc->d.c->p[wallpts[i][j]],
+                                        nc->d.c->p[wallpts[i][(j + 1) & 3]]) )
+                    != NULL ) {
+                    setmapline(ed);
                 }
             }
         }
@@ -1485,8 +1986,8 @@ void dec_frames(int ec) {
     sys_copytoscreen(0,0,drawbuffer); n2++; } */
     ws_restorebitmap(scr);
     ws_displaymouse();
-    waitmsg("Frames per sec: without BitBlt %g with BitBlt %g\n",
-            n1 / 10.0, n2 / 10.0);
+    waitmsg("Frames per sec: without BitBlt %g with BitBlt %g\n"
+            "Span mapper: %s\n", n1 / 10.0, n2 / 10.0, psys_spanmapper);
 }
 
 
@@ -1,6 +1,7 @@
 /*  DEVIL - Descent Editor for Vertices, Items and Levels at all
     Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
     Further info see .c-files. */
+extern unsigned long plot_drawings; /* how often the level was drawn */
 void initcoordsystem(int lr, struct point *e0, struct point *er,
                      struct point *x0);
 void makeview(int lr);
@@ -21,5 +22,6 @@ void plotlevel(void);
 unsigned long cont_plotlevel(struct lightsource **ls);
 void copytoscreen(void);
 void initdescmap(void);
+void updatedescmap(struct node *nc);
 void dec_frames(int ec);
 void move_user(struct point *new_pos);
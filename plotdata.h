@@ -40,3 +40,13 @@ extern float xviewphi, yviewphi, z_dist; /* this is the cos(view angle) */
 extern struct point x0; /* x0 viewpoint, m0 line viewpoint-center of screen */
 extern int max_xcoord, max_ycoord; /* (scr_xysize-1)/2 */
 extern int scr_xsize, scr_ysize; /* always a uneven number */
+
+/* the variables above for one display as makeview has set them. The
+   textures are rendered with a copy of them, so both displays can be
+   rendered at the same time (see render_views). */
+struct render_view {
+    int lr;
+    struct point x0, er[3];
+    float xviewphi, yviewphi, z_dist;
+    int max_xcoord, max_ycoord, scr_xsize, scr_ysize;
+};
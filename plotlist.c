@@ -0,0 +1,471 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    plotlist.c - the list of the lines drawn in the level window
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+#include "structs.h"
+#include "tools.h"
+#include "plotdata.h"
+#include "plotsys.h"
+#include "plotlist.h"
+
+/* Without textures the level is kept as a list of the lines drawn in the
+   level window (display list). The lines are grouped in items, one for
+   each cube, line, thing and so on (see dl_item). When the level is drawn
+   again, an item with the same signature as in the old list is taken
+   from the old list without calculating anything. The other items are
+   drawn again. If their lines are not the same, the rectangles around
+   the old and the new lines are damaged. Only the damaged rectangles are
+   cleared, drawn from the list and copied to the screen.
+   This only works if nothing else has drawn into the level window since
+   the list was made: dl_addline (called by plotline) notices other
+   drawings, a refresh of the window must call dl_invalidate. */
+
+struct dl_seg {
+    short x1, y1, x2, y2; /* window coords */
+    unsigned char color, xor;
+};
+struct dl_item {
+    int lr, site;
+    const void *obj;
+    unsigned long sig; /* 0 if the item must always be drawn again */
+    int first, num; /* the lines in segs */
+    int box[4]; /* x1,y1,x2,y2 around the lines */
+};
+struct dl_list {
+    struct dl_item *items;
+    int num_items, max_items;
+    struct dl_seg *segs;
+    int num_segs, max_segs;
+};
+
+#define DL_MAXRECTS 8
+
+static struct dl_list dl_lists[2], *dl_old = &dl_lists[0],
+*dl_new = &dl_lists[1];
+static int dl_recording, dl_valid, dl_full;
+static unsigned long dl_frame; /* see dl_start */
+static struct leveldata *dl_level;
+/* the open item in dl_new (or -1) and the item in dl_old it replaces
+   (or -1) */
+static int dl_cur = -1, dl_curold = -1, dl_curmoved;
+/* to find the items of dl_old: they are usually in the same order, so
+   first the item after the last one found is checked, otherwise the
+   table is used. */
+static int dl_next, dl_last, *dl_table, dl_tablesize, dl_tablemade;
+static unsigned char *dl_used;
+static int dl_rects[DL_MAXRECTS][4], dl_num_rects;
+
+
+/* FNV-1a hash of size bytes at data, continuing h (start with 0) */
+unsigned long dl_hash(unsigned long h, const void *data, size_t size) {
+    const unsigned char *c = data;
+
+
+    if (h == 0) {
+        h = 2166136261UL;
+    }
+
+    while (size-- > 0) {
+        h = (h ^ *c++) * 16777619UL;
+    }
+
+    return h;
+}
+
+
+/* the picture in the level window is not the one in the list any more */
+void dl_invalidate(void) {
+    dl_valid = 0;
+}
+
+
+static int dl_keyhash(int lr, int site, const void *obj) {
+    return (unsigned long)( ( (size_t)obj >> 3 ) * 31 + site * 2 + lr ) %
+           dl_tablesize;
+}
+
+
+static void dl_maketable(void) {
+    int i, h;
+
+
+    FREE(dl_table);
+    dl_tablesize = dl_old->num_items * 2 + 1;
+    checkmem( dl_table = MALLOC(sizeof(int) * dl_tablesize) );
+
+    for (i = 0; i < dl_tablesize; i++) {
+        dl_table[i] = -1;
+    }
+
+    for (i = 0; i < dl_old->num_items; i++) {
+        for (h = dl_keyhash(dl_old->items[i].lr, dl_old->items[i].site,
+                            dl_old->items[i].obj); dl_table[h] >= 0;
+             h = (h + 1) % dl_tablesize) {
+        }
+
+        dl_table[h] = i;
+    }
+
+    dl_tablemade = 1;
+}
+
+
+/* the first item in dl_old for lr,site,obj which wasn't found before, or
+   -1 */
+static int dl_findold(int lr, int site, const void *obj) {
+    struct dl_item *it;
+    int h;
+
+
+    if (dl_next < dl_old->num_items && !dl_used[dl_next]) {
+        it = &dl_old->items[dl_next];
+
+        if (it->lr == lr && it->site == site && it->obj == obj) {
+            return dl_next++;
+        }
+    }
+
+    if (!dl_tablemade) {
+        dl_maketable();
+    }
+
+    for (h = dl_keyhash(lr, site, obj); dl_table[h] >= 0;
+         h = (h + 1) % dl_tablesize) {
+        it = &dl_old->items[dl_table[h]];
+
+        if (!dl_used[dl_table[h]] && it->lr == lr && it->site == site
+           && it->obj == obj) {
+            dl_next = dl_table[h] + 1;
+            return dl_table[h];
+        }
+    }
+
+    return -1;
+}
+
+
+/* add the rectangle x1,y1,x2,y2 (window coords) to the damaged ones */
+static void dl_damage(const int *box) {
+    int r[4], j[4], i, k, best, a, best_a;
+
+
+    if (box[0] > box[2]) {
+        return; /* no lines */
+    }
+
+    for (i = 0; i < 4; i++) {
+        r[i] = box[i];
+    }
+
+    /* rectangles which touch are joined */
+    for (i = 0; i < dl_num_rects; i++) {
+        if (r[0] <= dl_rects[i][2] + 1 && r[2] >= dl_rects[i][0] - 1
+           && r[1] <= dl_rects[i][3] + 1 && r[3] >= dl_rects[i][1] - 1) {
+            r[0] = r[0] < dl_rects[i][0] ? r[0] : dl_rects[i][0];
+            r[1] = r[1] < dl_rects[i][1] ? r[1] : dl_rects[i][1];
+            r[2] = r[2] > dl_rects[i][2] ? r[2] : dl_rects[i][2];
+            r[3] = r[3] > dl_rects[i][3] ? r[3] : dl_rects[i][3];
+
+            for (k = 0; k < 4; k++) {
+                dl_rects[i][k] = dl_rects[dl_num_rects - 1][k];
+            }
+
+            dl_num_rects--;
+            i = -1; /* the bigger one may touch others now */
+        }
+    }
+
+    if (dl_num_rects == DL_MAXRECTS) {
+        /* join it with the one which gets the smallest */
+        for (i = 0, best = 0, best_a = -1; i < dl_num_rects; i++) {
+            a = ( (r[2] > dl_rects[i][2] ? r[2] : dl_rects[i][2]) -
+                 (r[0] < dl_rects[i][0] ? r[0] : dl_rects[i][0]) + 1 ) *
+                ( (r[3] > dl_rects[i][3] ? r[3] : dl_rects[i][3]) -
+                 (r[1] < dl_rects[i][1] ? r[1] : dl_rects[i][1]) + 1 );
+
+            if (best_a < 0 || a < best_a) {
+                best_a = a;
+                best = i;
+            }
+        }
+
+        for (k = 0; k < 4; k++) {
+            j[k] = k < 2 ? (r[k] < dl_rects[best][k] ? r[k] :
+                            dl_rects[best][k]) :
+                   (r[k] > dl_rects[best][k] ? r[k] : dl_rects[best][k]);
+            dl_rects[best][k] = dl_rects[dl_num_rects - 1][k];
+        }
+
+        dl_num_rects--;
+        dl_damage(j);
+        return;
+    }
+
+    for (k = 0; k < 4; k++) {
+        dl_rects[dl_num_rects][k] = r[k];
+    }
+
+    dl_num_rects++;
+}
+
+
+/* start a new drawing of the level l. frame is a signature of everything
+   the drawing depends on which isn't in the signatures of the items (the
+   view, the window, the colors...). */
+void dl_start(unsigned long frame) {
+    my_assert(!dl_recording);
+    dl_full = !dl_valid || dl_level != l || dl_frame != frame;
+    dl_frame = frame;
+    dl_level = l;
+    dl_recording = 1;
+    dl_new->num_items = dl_new->num_segs = 0;
+    dl_cur = dl_curold = -1;
+    dl_next = dl_tablemade = 0;
+    dl_last = -1;
+    dl_num_rects = 0;
+    FREE(dl_used);
+    checkmem( dl_used = CALLOC(dl_old->num_items + 1, 1) );
+}
+
+
+static void dl_closeitem(void) {
+    struct dl_item *it, *old;
+    struct dl_seg *s;
+    int i;
+
+
+    if (dl_cur < 0) {
+        return;
+    }
+
+    it = &dl_new->items[dl_cur];
+    it->box[0] = it->box[1] = 0x7fff;
+    it->box[2] = it->box[3] = -0x7fff;
+
+    for (i = 0, s = &dl_new->segs[it->first]; i < it->num; i++, s++) {
+        it->box[0] = s->x1 < it->box[0] ? s->x1 : it->box[0];
+        it->box[0] = s->x2 < it->box[0] ? s->x2 : it->box[0];
+        it->box[1] = s->y1 < it->box[1] ? s->y1 : it->box[1];
+        it->box[1] = s->y2 < it->box[1] ? s->y2 : it->box[1];
+        it->box[2] = s->x1 > it->box[2] ? s->x1 : it->box[2];
+        it->box[2] = s->x2 > it->box[2] ? s->x2 : it->box[2];
+        it->box[3] = s->y1 > it->box[3] ? s->y1 : it->box[3];
+        it->box[3] = s->y2 > it->box[3] ? s->y2 : it->box[3];
+    }
+
+    if (!dl_full) {
+        if (dl_curold < 0) {
+            dl_damage(it->box);
+        }
+        else {
+            old = &dl_old->items[dl_curold];
+
+            if ( dl_curmoved || old->num != it->num
+                || memcmp( &dl_old->segs[old->first],
+                          &dl_new->segs[it->first],
+                          sizeof(struct dl_seg) * it->num ) != 0 ) {
+                dl_damage(old->box);
+                dl_damage(it->box);
+            }
+        }
+    }
+
+    dl_cur = dl_curold = -1;
+}
+
+
+static struct dl_item *dl_newitem(int lr, int site, const void *obj,
+                                  unsigned long sig) {
+    struct dl_item *it;
+
+
+    if (dl_new->num_items == dl_new->max_items) {
+        dl_new->max_items = dl_new->max_items * 2 + 256;
+        checkmem( dl_new->items = REALLOC(dl_new->items,
+                                          sizeof(struct dl_item) *
+                                          dl_new->max_items) );
+    }
+
+    it = &dl_new->items[dl_new->num_items++];
+    it->lr = lr;
+    it->site = site;
+    it->obj = obj;
+    it->sig = sig;
+    it->first = dl_new->num_segs;
+    it->num = 0;
+    return it;
+}
+
+
+static struct dl_seg *dl_newsegs(int num) {
+    if (dl_new->num_segs + num > dl_new->max_segs) {
+        dl_new->max_segs = (dl_new->num_segs + num) * 2 + 1024;
+        checkmem( dl_new->segs = REALLOC(dl_new->segs,
+                                         sizeof(struct dl_seg) *
+                                         dl_new->max_segs) );
+    }
+
+    dl_new->num_segs += num;
+    return &dl_new->segs[dl_new->num_segs - num];
+}
+
+
+/* start an item for the object obj drawn at site on display lr. All lines
+   until the next item belong to it. sig is a signature of everything the
+   lines of the item depend on (besides the frame, see dl_start) or 0.
+   If the old list has an item with the same signature, it's taken and a
+   0 is returned, the object must not be drawn then. Otherwise a 1 is
+   returned and the object must be drawn. */
+int dl_item(int lr, int site, const void *obj, unsigned long sig) {
+    struct dl_item *it, *old;
+    int o, moved;
+
+
+    my_assert(dl_recording);
+    dl_closeitem();
+    it = dl_newitem(lr, site, obj, sig);
+
+    if (dl_full || ( o = dl_findold(lr, site, obj) ) < 0) {
+        dl_cur = dl_new->num_items - 1;
+        return 1;
+    }
+
+    dl_used[o] = 1;
+    /* if the items are in another order, the lines may overlap in
+       another way */
+    moved = o < dl_last;
+    dl_last = o > dl_last ? o : dl_last;
+    old = &dl_old->items[o];
+
+    if (sig == 0 || old->sig != sig) {
+        dl_cur = dl_new->num_items - 1;
+        dl_curold = o;
+        dl_curmoved = moved;
+        return 1;
+    }
+
+    memcpy( dl_newsegs(old->num), &dl_old->segs[old->first],
+           sizeof(struct dl_seg) * old->num );
+    it->num = old->num;
+    memcpy( it->box, old->box, sizeof(it->box) );
+
+    if (moved) {
+        dl_damage(it->box);
+    }
+
+    return 0;
+}
+
+
+/* called by plotline with window coords. Returns a 1 if the line is put
+   into the list, a 0 if it must be drawn. */
+int dl_addline(int x1, int y1, int x2, int y2, int color, int xor) {
+    struct dl_seg *s;
+
+
+    if (!dl_recording) {
+        dl_valid = 0;
+        return 0;
+    }
+
+    if (dl_cur < 0) {
+        dl_item(-1, -1, NULL, 0);
+    }
+
+    s = dl_newsegs(1);
+    s->x1 = x1;
+    s->y1 = y1;
+    s->x2 = x2;
+    s->y2 = y2;
+    s->color = color;
+    s->xor = xor != 0;
+    dl_new->items[dl_cur].num++;
+    return 1;
+}
+
+
+/* draw the part r (window coords) of the level window from dl_new */
+static void dl_drawrect(int *r) {
+    struct dl_item *it;
+    struct dl_seg *s;
+    int i, j, xo = w_xwinincoord(l->w, 0), yo = w_ywinincoord(l->w, 0);
+
+
+    psys_cleararea(xo + r[0], yo + r[1], r[2] - r[0] + 1, r[3] - r[1] + 1);
+
+    for (i = 0, it = dl_new->items; i < dl_new->num_items; i++, it++) {
+        if (it->box[0] > r[2] || it->box[2] < r[0] || it->box[1] > r[3]
+           || it->box[3] < r[1]) {
+            continue;
+        }
+
+        for (j = 0, s = &dl_new->segs[it->first]; j < it->num; j++, s++) {
+            psys_plotlineclip(xo + s->x1, yo + s->y1, xo + s->x2,
+                              yo + s->y2, s->color, s->xor, xo + r[0],
+                              yo + r[1], xo + r[2], yo + r[3]);
+        }
+    }
+}
+
+
+/* the drawing started with dl_start is finished: draw the damaged parts
+   and copy them to the screen */
+void dl_finish(void) {
+    struct dl_list *h;
+    int i, r[4], xo = w_xwinincoord(l->w, 0), yo = w_ywinincoord(l->w, 0);
+
+
+    my_assert(dl_recording);
+    dl_closeitem();
+
+    if (!dl_full) {
+        for (i = 0; i < dl_old->num_items; i++) {
+            if (!dl_used[i]) {
+                dl_damage(dl_old->items[i].box);
+            }
+        }
+    }
+    else {
+        dl_num_rects = 1;
+        dl_rects[0][0] = dl_rects[0][1] = 0;
+        dl_rects[0][2] = w_xwininsize(l->w) - 1;
+        dl_rects[0][3] = w_ywininsize(l->w) - 1;
+    }
+
+    for (i = 0; i < dl_num_rects; i++) {
+        r[0] = dl_rects[i][0] < 0 ? 0 : dl_rects[i][0];
+        r[1] = dl_rects[i][1] < 0 ? 0 : dl_rects[i][1];
+        r[2] = dl_rects[i][2] >= w_xwininsize(l->w) ?
+               w_xwininsize(l->w) - 1 : dl_rects[i][2];
+        r[3] = dl_rects[i][3] >= w_ywininsize(l->w) ?
+               w_ywininsize(l->w) - 1 : dl_rects[i][3];
+
+        if (r[0] > r[2] || r[1] > r[3]) {
+            continue;
+        }
+
+        dl_drawrect(r);
+        psys_copytoscreen(xo + r[0], yo + r[1], xo + r[0], yo + r[1],
+                          r[2] - r[0] + 1, r[3] - r[1] + 1);
+    }
+
+    h = dl_old;
+    dl_old = dl_new;
+    dl_new = h;
+    dl_recording = 0;
+    dl_valid = 1;
+}
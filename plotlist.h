@@ -0,0 +1,17 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+    Further info see .c-files. */
+
+/* what is drawn in an item (see dl_item) */
+enum dl_sites {
+    dls_divider, dls_line, dls_cube, dls_thing, dls_door, dls_exit,
+    dls_corridor, dls_tagcube, dls_xtagged, dls_tagwalls, dls_tagpnts,
+    dls_tagthings, dls_tagdoors, dls_tagedges, dls_current, dls_axis
+};
+
+unsigned long dl_hash(unsigned long h, const void *data, size_t size);
+void dl_invalidate(void);
+void dl_start(unsigned long frame);
+int dl_item(int lr, int site, const void *obj, unsigned long sig);
+int dl_addline(int x1, int y1, int x2, int y2, int color, int xor);
+void dl_finish(void);
@@ -2,7 +2,7 @@
     ( (a)->x[0] * (b)->x[0] + (a)->x[1] * (b)->x[1] + (a)->x[2] * (b)->x[2] )
 #define SCALAR_2D(a, b) \
     ( (a)->x[0] * (b)->x[0] + (a)->x[1] * (b)->x[1] )
-struct point *ADD_3D(struct point *e, struct point *a,
+static inline struct point *ADD_3D(struct point *e, struct point *a,
                                    struct point *b)
 {
     (e)->x[0] = (a)->x[0] + (b)->x[0];
@@ -12,7 +12,7 @@ struct point *ADD_3D(struct point *e, struct point *a,
 }
 
 
-struct point *SUB_3D(struct point *e, struct point *a,
+static inline struct point *SUB_3D(struct point *e, struct point *a,
                                    struct point *b)
 {
     (e)->x[0] = (a)->x[0] - (b)->x[0];
@@ -22,7 +22,7 @@ struct point *SUB_3D(struct point *e, struct point *a,
 }
 
 
-struct point_2d *ADD_2D(struct point_2d *e, struct point_2d *a,
+static inline struct point_2d *ADD_2D(struct point_2d *e, struct point_2d *a,
                                       struct point_2d *b)
 {
     (e)->x[0] = (a)->x[0] + (b)->x[0];
@@ -31,7 +31,7 @@ struct point_2d *ADD_2D(struct point_2d *e, struct point_2d *a,
 }
 
 
-struct point_2d *SUB_2D(struct point_2d *e, struct point_2d *a,
+static inline struct point_2d *SUB_2D(struct point_2d *e, struct point_2d *a,
                                       struct point_2d *b)
 {
     (e)->x[0] = (a)->x[0] - (b)->x[0];
@@ -9,13 +9,27 @@
     for V2.2i commercially. The changes made in V2.2i are only performance
     (some routines were coded in assembler and such things...), so you may
     want to optimize this routines by yourself... */
+#ifdef HEADLESS
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+#endif
 #include "structs.h"
+#ifndef HEADLESS
 #include <allegro.h>
+#endif
 #include "plotdata.h"
 #include "plotsys.h"
 
 #include "plotmath.c"
 
+/* Compile with -DPSYS_SCALAR to use the plain C span mapper even if the
+   processor has SSE2. */
+#if defined(__SSE2__) && !defined(PSYS_SCALAR)
+#define PSYS_SSE2
+#include <string.h>
+#include <emmintrin.h>
+#endif
+
 #define LIN_PIXELS 16
 #define TRANSPARENT_COLOR 0xfe
 
@@ -23,6 +37,65 @@ static unsigned char *drawbuffer;
 struct ws_bitmap *drawbitmap;
 static unsigned char fp_buffer[1000] __attribute__( (unused) );
 
+#ifdef PSYS_SSE2
+const char *psys_spanmapper = "SSE2";
+#else
+const char *psys_spanmapper = "C";
+#endif
+
+
+/* plot num pixels of a scanline to dest. u/v are the texture coords
+   (fixed point, 8 bit fraction) of the first pixel and are increased by
+   add_u/add_v for each pixel, the texel is mapped with colors. With SSE2
+   four texture offsets are calculated at once and the four pixels are
+   written with one store; the rest is done pixel by pixel. Both ways
+   give exactly the same pixels because only the lowest 20 bits of u/v
+   are used. Lit spans don't use this, their light table may change after
+   each pixel (see SYS_LIGHTSCANLINE). */
+static void psys_span(unsigned char *dest, const unsigned char *txt_data,
+                      const unsigned char *colors, long u, long v,
+                      long add_u, long add_v, long num) {
+#ifdef PSYS_SSE2
+    __m128i vu, vv, add_vu, add_vv, mask_u, mask_v;
+    int offs[4];
+    unsigned int pixels;
+
+
+    if (num >= 4) {
+        vu = _mm_setr_epi32(u, u + add_u, u + 2 * add_u, u + 3 * add_u);
+        vv = _mm_setr_epi32(v, v + add_v, v + 2 * add_v, v + 3 * add_v);
+        add_vu = _mm_set1_epi32(add_u * 4);
+        add_vv = _mm_set1_epi32(add_v * 4);
+        mask_u = _mm_set1_epi32(0x3f);
+        mask_v = _mm_set1_epi32(0x3f * TXTSIZE);
+
+        for (; num >= 4; num -= 4, dest += 4) {
+            _mm_storeu_si128( (__m128i *)offs,
+                             _mm_add_epi32(
+                                 _mm_and_si128(_mm_srai_epi32(vu, 8), mask_u),
+                                 _mm_and_si128(_mm_srai_epi32(vv, 8),
+                                               mask_v) ) );
+            pixels = colors[txt_data[offs[0]]] |
+                     colors[txt_data[offs[1]]] << 8 |
+                     colors[txt_data[offs[2]]] << 16 |
+                     (unsigned int)colors[txt_data[offs[3]]] << 24;
+            memcpy(dest, &pixels, 4);
+            vu = _mm_add_epi32(vu, add_vu);
+            vv = _mm_add_epi32(vv, add_vv);
+            u += add_u * 4;
+            v += add_v * 4;
+        }
+    }
+
+#endif
+
+    for (; num > 0; num--, u += add_u, v += add_v) {
+        *(dest++) = colors[ txt_data[ ( (u >> 8) & 0x3f ) +
+                                      ( (v >> 8) & (0x3f * TXTSIZE) ) ] ];
+    }
+}
+
+
 #define SYS_LIGHTSCANLINE(NUM_PIXELS, ADD_F1, ADD_F2, ADD_F3) {\
         txt_u = n_txt_u; txt_v = n_txt_v; \
         run_f1 += ADD_F1; f1 = 1.0 / run_f1; \
@@ -87,15 +160,8 @@ static unsigned char fp_buffer[1000] __attribute__( (unused) );
         n_txt_v = p->a_txt.x[1] + (f1 * p->r_txt.x[1]) + (f2 * p->s_txt.x[1]); \
         add_txt_u = (n_txt_u - txt_u) / (NUM_PIXELS); \
         add_txt_v = (n_txt_v - txt_v) / (NUM_PIXELS); \
-        for (cur_pos = cur_line + ps_x, i = (NUM_PIXELS); i > 0; i--) \
-        {\
-            *(cur_pos++) = *( colors + \
-                             *( txt_data +\
-                               ( (txt_u >>\
-                                  8) &\
-                                0x3f ) + ( (txt_v >> 8) & (0x3f * TXTSIZE) ) ) ); \
-            txt_u += add_txt_u; txt_v += add_txt_v; \
-        }   \
+        psys_span(cur_line + ps_x, txt_data, colors, txt_u, txt_v, add_txt_u, \
+                  add_txt_v, NUM_PIXELS); \
         ps_x += (NUM_PIXELS); \
 }
 
@@ -111,16 +177,8 @@ static unsigned char fp_buffer[1000] __attribute__( (unused) );
                            er_rXd.x[0] * (e_rest), er_dXs.x[0] * (e_rest) ) } \
             else if (e_rest != 0) \
             {\
-                txt_u = n_txt_u; txt_v = n_txt_v; \
-                for (cur_pos = cur_line + e_r_ps_x, i = e_rest; i > 0; i--) \
-                { \
-                    *(cur_pos++) = *( colors + \
-                                     *( txt_data +\
-                                       ( (txt_u >>\
-                                          8) &\
-                                        0x3f ) + ( (txt_v >> 8) & (0x3f * TXTSIZE) ) ) ); \
-                    txt_u += add_txt_u; txt_v += add_txt_v; \
-                } \
+                psys_span(cur_line + e_r_ps_x, txt_data, colors, n_txt_u, \
+                          n_txt_v, add_txt_u, add_txt_v, e_rest); \
             } \
         } \
         else \
@@ -130,7 +188,8 @@ static unsigned char fp_buffer[1000] __attribute__( (unused) );
 
 
 /* The plottxt functions use the y-coord with negative sign.!!!! */
-void psys_256_plottxt(struct polygon *p, struct render_point *start,
+void psys_256_plottxt(struct render_view *v, struct polygon *p,
+                      struct render_point *start,
                       unsigned long offset,
                       unsigned char *txt_data)
 {
@@ -161,14 +220,14 @@ void psys_256_plottxt(struct polygon *p, struct render_point *start,
 
     dest = drawbuffer + offset;
     xsize = init.xres;
-    SUB_3D(&d, &p->a_3d, &x0);
+    SUB_3D(&d, &p->a_3d, &v->x0);
     VECTOR(&rXd, &p->r_3d, &d);
     VECTOR(&dXs, &d, &p->s_3d);
 
     for (i = 0; i < 3; i++) {
-        er_n_3d.x[i] = SCALAR_3D(&p->n_3d, &er[i]);
-        er_rXd.x[i] = SCALAR_3D(&rXd, &er[i]);
-        er_dXs.x[i] = SCALAR_3D(&dXs, &er[i]);
+        er_n_3d.x[i] = SCALAR_3D(&p->n_3d, &v->er[i]);
+        er_rXd.x[i] = SCALAR_3D(&rXd, &v->er[i]);
+        er_dXs.x[i] = SCALAR_3D(&dXs, &v->er[i]);
     }
 
     add_f1 = er_n_3d.x[0] * LIN_PIXELS;
@@ -177,10 +236,10 @@ void psys_256_plottxt(struct polygon *p, struct render_point *start,
     ppl = ppr = start;
     ps_y = start->x[1];
     next_lr = 0;
-    cur_line = dest + (-ps_y + max_ycoord) * xsize + max_xcoord;
-    run_line1 = ps_y * er_n_3d.x[1] + z_dist * er_n_3d.x[2];
-    run_line2 = ps_y * er_rXd.x[1] + z_dist * er_rXd.x[2];
-    run_line3 = ps_y * er_dXs.x[1] + z_dist * er_dXs.x[2];
+    cur_line = dest + (-ps_y + v->max_ycoord) * xsize + v->max_xcoord;
+    run_line1 = ps_y * er_n_3d.x[1] + v->z_dist * er_n_3d.x[2];
+    run_line2 = ps_y * er_rXd.x[1] + v->z_dist * er_rXd.x[2];
+    run_line3 = ps_y * er_dXs.x[1] + v->z_dist * er_dXs.x[2];
 
     do {
         if (next_lr >= 0) {
@@ -393,7 +452,8 @@ void psys_256_plottxt(struct polygon *p, struct render_point *start,
 
 
 /* The plottxt functions use the y-coord with negative sign.!!!! */
-void psys_256_transparent_plottxt(struct polygon *p,
+void psys_256_transparent_plottxt(struct render_view *v,
+                                  struct polygon *p,
                                   struct render_point *start,
                                   unsigned long offset,
                                   unsigned char *txt_data)
@@ -426,14 +486,14 @@ void psys_256_transparent_plottxt(struct polygon *p,
 
     dest = drawbuffer + offset;
     xsize = init.xres;
-    SUB_3D(&d, &p->a_3d, &x0);
+    SUB_3D(&d, &p->a_3d, &v->x0);
     VECTOR(&rXd, &p->r_3d, &d);
     VECTOR(&dXs, &d, &p->s_3d);
 
     for (i = 0; i < 3; i++) {
-        er_n_3d.x[i] = SCALAR_3D(&p->n_3d, &er[i]);
-        er_rXd.x[i] = SCALAR_3D(&rXd, &er[i]);
-        er_dXs.x[i] = SCALAR_3D(&dXs, &er[i]);
+        er_n_3d.x[i] = SCALAR_3D(&p->n_3d, &v->er[i]);
+        er_rXd.x[i] = SCALAR_3D(&rXd, &v->er[i]);
+        er_dXs.x[i] = SCALAR_3D(&dXs, &v->er[i]);
     }
 
     add_f1 = er_n_3d.x[0] * LIN_PIXELS;
@@ -442,10 +502,10 @@ void psys_256_transparent_plottxt(struct polygon *p,
     ppl = ppr = start;
     ps_y = start->x[1];
     next_lr = 0;
-    cur_line = dest + (-ps_y + max_ycoord) * xsize + max_xcoord;
-    run_line1 = ps_y * er_n_3d.x[1] + z_dist * er_n_3d.x[2];
-    run_line2 = ps_y * er_rXd.x[1] + z_dist * er_rXd.x[2];
-    run_line3 = ps_y * er_dXs.x[1] + z_dist * er_dXs.x[2];
+    cur_line = dest + (-ps_y + v->max_ycoord) * xsize + v->max_xcoord;
+    run_line1 = ps_y * er_n_3d.x[1] + v->z_dist * er_n_3d.x[2];
+    run_line2 = ps_y * er_rXd.x[1] + v->z_dist * er_rXd.x[2];
+    run_line3 = ps_y * er_dXs.x[1] + v->z_dist * er_dXs.x[2];
 
     do {
         if (next_lr >= 0) {
@@ -656,6 +716,122 @@ void psys_plotline(int o_x1, int o_y1, int o_x2, int o_y2, int color,
 }
 
 
+/* psys_plotline, but only the pixels in the rectangle cx1,cy1-cx2,cy2
+   (inclusive) are drawn. The pixels are exactly the ones psys_plotline
+   would draw, so a part of a picture can be drawn again. */
+void psys_plotlineclip(int o_x1, int o_y1, int o_x2, int o_y2, int color,
+                       int xor, int cx1, int cy1, int cx2, int cy2)
+{
+    int x, y, dx, dy, x1, y1, x2, y2, end, px, py, add, l_dy, l_end;
+    unsigned char *b;
+
+
+    if ( (o_x1 < o_x2 ? o_x1 : o_x2) >= cx1 && (o_x1 > o_x2 ? o_x1 : o_x2)
+        <= cx2 && (o_y1 < o_y2 ? o_y1 : o_y2) >= cy1
+       && (o_y1 > o_y2 ? o_y1 : o_y2) <= cy2 ) {
+        psys_plotline(o_x1, o_y1, o_x2, o_y2, color, xor);
+        return;
+    }
+
+    if ( (o_x1 < o_x2 ? o_x1 : o_x2) > cx2 || (o_x1 > o_x2 ? o_x1 : o_x2)
+        < cx1 || (o_y1 < o_y2 ? o_y1 : o_y2) > cy2
+       || (o_y1 > o_y2 ? o_y1 : o_y2) < cy1 ) {
+        return;
+    }
+
+    /* the same as psys_plotline with coordinates instead of a pointer */
+    if (o_y1 < o_y2 || (o_y1 == o_y2 && o_x1 < o_x2) ) {
+        x1 = o_x1;
+        x2 = o_x2;
+        y1 = o_y1;
+        y2 = o_y2;
+    }
+    else {
+        x1 = o_x2;
+        x2 = o_x1;
+        y1 = o_y2;
+        y2 = o_y1;
+    }
+
+    dy = x2 - x1;
+    dx = y2 - y1;
+    end = dy * dx;
+    px = x1;
+    py = y1;
+    x = y = 0;
+
+#define CLIPPIXEL(cx, cy) \
+    if ( (cx) >= cx1 && (cx) <= cx2 && (cy) >= cy1 && (cy) <= cy2 ) { \
+        b = drawbuffer + (cy) * init.xres + (cx); \
+        *b = xor ? *b ^ color : color; \
+    }
+
+    if (dx == 0) {
+        for (px = x1; px <= x2; px++) {
+            CLIPPIXEL(px, py)
+        }
+    }
+    else if (dy == 0) {
+        for (py = y1; py < y2; py++) {
+            CLIPPIXEL(px, py)
+        }
+    }
+    else {
+        add = dy > 0 ? 1 : -1;
+        l_dy = dy > 0 ? dy : -dy;
+        l_end = dy > 0 ? end : -end;
+
+        if (l_dy > dx) {
+            for (x = 0, y = 0; x != l_end; px += add, x += dx) {
+                CLIPPIXEL(px, py)
+
+                if (x > y) {
+                    py++;
+                    y += l_dy;
+                }
+            }
+        }
+        else {
+            for (x = 0, y = 0; y != l_end; py++, y += l_dy) {
+                CLIPPIXEL(px, py)
+
+                if (x < y) {
+                    px += add;
+                    x += dx;
+                }
+            }
+        }
+    }
+
+#undef CLIPPIXEL
+}
+
+
+#ifdef HEADLESS
+/* without Allegro the monotonic clock of the system is used */
+void psys_inittimer(void) {
+}
+
+
+double psys_seconds(void) {
+    struct timespec ts;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+unsigned long psys_gettime(void) {
+    return psys_seconds() * (1 << TIMER_DIGITS_POW_2);
+}
+
+
+void psys_releasetimer(void) {
+}
+
+
+#else
 volatile unsigned long timer_count = 0;
 
 void inc_timer(void) {
@@ -674,6 +850,12 @@ void psys_inittimer(void) {
 }
 
 
+/* seconds since the timer was initialized */
+double psys_seconds(void) {
+    return timer_count / 1000.0;
+}
+
+
 unsigned long psys_gettime(void) {
     return timer_count / 1000.0 * (1 << TIMER_DIGITS_POW_2);
 }
@@ -684,3 +866,6 @@ void psys_releasetimer(void) {
 }
 
 
+#endif
+
+
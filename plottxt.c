@@ -19,12 +19,18 @@
 #include <math.h>
 
 #include "structs.h"
+#include "tools.h"
 #include "plotdata.h"
 #include "plotsys.h"
 #include "readtxt.h"
 #include "userio.h"
 #include "in_plot.h"
 #include "plottxt.h"
+#include "do_light.h"
+#include "pvs.h"
+#include "plotlist.h"
+#include "threads.h"
+#include "profile.h"
 
 #include "lac_cfg.h"
 
@@ -42,26 +48,47 @@ void releasetimer(void) {
 }
 
 
-void plottxt(int lr, struct polygon *p, struct render_point *start,
+/* if not NULL, render_level adds the time spent in its stages here */
+struct render_stats *render_stats = NULL;
+
+
+/* the time is added to stats if it's not NULL */
+void plottxt(struct render_view *v, struct polygon *p,
+             struct render_point *start,
              unsigned char *txt,
-             int transparent)
+             int transparent, struct render_stats *stats)
 {
+    unsigned long offset;
+    double t = 0.0;
+
+
+    if (stats != NULL) {
+        t = thr_walltime();
+    }
+
+    /* without level window (headless) the whole drawbuffer is used */
+    offset = l->w == NULL ? 0 : w_ywinincoord(l->w, 0) * init.xres +
+             w_xwinincoord(l->w, v->lr ? w_xwininsize(l->w) / 2 + 1 : 0);
+
     if (transparent) {
-        psys_256_transparent_plottxt(p, start, w_ywinincoord(l->w,
-                                                             0) * init.xres +
-                                     w_xwinincoord(l->w,
-                                                   lr ? w_xwininsize(l->w) /
-                                                   2 + 1 : 0), txt);
+        psys_256_transparent_plottxt(v, p, start, offset, txt);
     }
     else {
-        psys_256_plottxt(p, start, w_ywinincoord(l->w, 0) * init.xres +
-                         w_xwinincoord(l->w, lr ? w_xwininsize(l->w) / 2 +
-                                       1 : 0), txt);
+        psys_256_plottxt(v, p, start, offset, txt);
+    }
+
+    if (stats != NULL) {
+        stats->fill += thr_walltime() - t;
+        stats->polygons++;
     }
 }
 
 
 void plotline(int o_x1, int o_y1, int o_x2, int o_y2, int color, int xor) {
+    if ( dl_addline(o_x1, o_y1, o_x2, o_y2, color, xor) ) {
+        return;
+    }
+
     psys_plotline(w_xwinincoord(l->w, o_x1), w_ywinincoord(l->w, o_y1),
                   w_xwinincoord(l->w, o_x2), w_ywinincoord(l->w,
                                                            o_y2), color, xor);
@@ -199,12 +226,13 @@ int clipline(struct point_2d *sp, struct point_2d *ep, struct point_2d *sb,
 /* Calculate screen coords of the polygon p, clip it and return the
    point with the lowest y-coord. Store the new points in render_pnts.
    Render_pnts is of size MAX_RENDERPNTS */
-struct render_point *pol_clip_pnts(struct polygon *p,
+struct render_point *pol_clip_pnts(struct render_view *v,
+                                   struct polygon *p,
                                    struct render_point *render_pnts,
-                                   struct render_point *bounds, int xsize,
-                                   int ysize)
+                                   struct render_point *bounds)
 {
-    float f1, f2, xs = xsize / 2.0, ys = ysize / 2.0, v_s0[MAX_RENDERPNTS],
+    float f1, f2, xs = v->scr_xsize / 2.0, ys = v->scr_ysize / 2.0,
+          v_s0[MAX_RENDERPNTS],
           v_s1[MAX_RENDERPNTS], v_s2[MAX_RENDERPNTS];
     long ls, le;
     struct point v_p[MAX_RENDERPNTS];
@@ -220,10 +248,10 @@ struct render_point *pol_clip_pnts(struct polygon *p,
     for (i = 0, vis = 0, pp = &p->pnts[0], rp = render_pnts; i < p->num_pnts;
          i++, pp = pp->next,
          rp++) {
-        SUB_3D(&v_p[i], pp->p_3d, &x0);
-        v_s2[i] = SCALAR_3D(&v_p[i], &er[2]);
+        SUB_3D(&v_p[i], pp->p_3d, &v->x0);
+        v_s2[i] = SCALAR_3D(&v_p[i], &v->er[2]);
 
-        if (v_s2[i] > z_dist) {
+        if (v_s2[i] > v->z_dist) {
             vis = 1;
         }
 
@@ -236,8 +264,8 @@ struct render_point *pol_clip_pnts(struct polygon *p,
     }
 
     for (i = 0; i < p->num_pnts; i++) {
-        v_s0[i] = SCALAR_3D(&v_p[i], &er[0]);
-        v_s1[i] = SCALAR_3D(&v_p[i], &er[1]);
+        v_s0[i] = SCALAR_3D(&v_p[i], &v->er[0]);
+        v_s1[i] = SCALAR_3D(&v_p[i], &v->er[1]);
     }
 
     num_rp = cur_rp = p->num_pnts;
@@ -257,11 +285,11 @@ struct render_point *pol_clip_pnts(struct polygon *p,
                 p->num_pnts, (long)(rp - render_pnts),
                 (long)(rp->prev - render_pnts),
                 (long)(rp->next - render_pnts),
-                z_dist, v_s0[old_i], v_s1[old_i], v_s2[old_i], v_s0[i],
+                v->z_dist, v_s0[old_i], v_s1[old_i], v_s2[old_i], v_s0[i],
                 v_s1[i], v_s2[i]);
         }
 
-        if (v_s2[i] <= z_dist && v_s2[old_i] <= z_dist) {
+        if (v_s2[i] <= v->z_dist && v_s2[old_i] <= v->z_dist) {
             rp->prev->next = rp->next;
             rp->next->prev = rp->prev;
             num_rp--;
@@ -275,7 +303,7 @@ struct render_point *pol_clip_pnts(struct polygon *p,
             }
         }
         else { /* at least one point is before the plane */
-            if (v_s2[old_i] <= z_dist) {
+            if (v_s2[old_i] <= v->z_dist) {
                 /* clip start point against viewplane */
                 /* Insert a new point */
                 my_assert(cur_rp < MAX_RENDERPNTS);
@@ -285,7 +313,7 @@ struct render_point *pol_clip_pnts(struct polygon *p,
                 num_rp++;
                 rp->prev->next = rp;
                 rp->next->prev = rp;
-                f1 = (z_dist - v_s2[old_i]) / (v_s2[i] - v_s2[old_i]);
+                f1 = (v->z_dist - v_s2[old_i]) / (v_s2[i] - v_s2[old_i]);
                 rp->x[0] = v_s0[old_i] + (v_s0[i] - v_s0[old_i]) * f1;
                 rp->x[1] = v_s1[old_i] + (v_s1[i] - v_s1[old_i]) * f1;
 
@@ -314,9 +342,9 @@ struct render_point *pol_clip_pnts(struct polygon *p,
                 rp = rp->next;
             }
 
-            if (v_s2[i] <= z_dist) { /* clip the endpoint against the viewplane
-                                       */
-                f1 = (z_dist - v_s2[i]) / (v_s2[old_i] - v_s2[i]);
+            /* clip the endpoint against the viewplane */
+            if (v_s2[i] <= v->z_dist) {
+                f1 = (v->z_dist - v_s2[i]) / (v_s2[old_i] - v_s2[i]);
                 rp->x[0] = v_s0[i] + (v_s0[old_i] - v_s0[i]) * f1;
                 rp->x[1] = v_s1[i] + (v_s1[old_i] - v_s1[i]) * f1;
 
@@ -341,8 +369,8 @@ struct render_point *pol_clip_pnts(struct polygon *p,
                 }
             }
             else {
-                rp->x[0] = z_dist * v_s0[i] / v_s2[i];
-                rp->x[1] = z_dist * v_s1[i] / v_s2[i];
+                rp->x[0] = v->z_dist * v_s0[i] / v_s2[i];
+                rp->x[1] = v->z_dist * v_s1[i] / v_s2[i];
 
                 if (pp->corner) {
                     rp->light = ( (long)pp->corner->light << 6 ) - 1;
@@ -530,9 +558,10 @@ void clearlevelwin(void) {
 }
 
 
-void render_filled_polygon(int lr, struct polygon *p, struct render_point *rp,
+void render_filled_polygon(struct render_view *v, struct polygon *p,
+                           struct render_point *rp,
                            unsigned char *texture, int transparent,
-                           int sublight)
+                           int sublight, struct render_stats *stats)
 {
     int i, j;
     struct point d;
@@ -540,14 +569,14 @@ void render_filled_polygon(int lr, struct polygon *p, struct render_point *rp,
     long maxlight;
 
 
-    if ( SCALAR(&p->n_3d,
-                &er[2]) >= (xviewphi > yviewphi ? xviewphi : yviewphi) ) {
+    if ( SCALAR(&p->n_3d, &v->er[2]) >= (v->xviewphi > v->yviewphi ?
+                                         v->xviewphi : v->yviewphi) ) {
         return;
     }
 
     for (i = 0; i < p->num_pnts; i++) {
         for (j = 0; j < 3; j++) {
-            d.x[j] = p->pnts[i].p_3d->x[j] - x0.x[j];
+            d.x[j] = p->pnts[i].p_3d->x[j] - v->x0.x[j];
         }
 
         if (SCALAR(&p->n_3d, &d) < -LENGTH(&d) * 0.01) {
@@ -643,9 +672,10 @@ void render_filled_polygon(int lr, struct polygon *p, struct render_point *rp,
             fprintf(errf, " %g,%g,%lx", db_rp->x[0], db_rp->x[1],
                     db_rp->light);
             my_assert(
-                db_rp->x[0] >= -max_xcoord && db_rp->x[0] <= max_xcoord
-                     && db_rp->x[1] >= -max_ycoord && db_rp->x[1] <=
-                max_ycoord);
+                db_rp->x[0] >= -v->max_xcoord
+                && db_rp->x[0] <= v->max_xcoord
+                && db_rp->x[1] >= -v->max_ycoord
+                && db_rp->x[1] <= v->max_ycoord);
             db_rp = db_rp->next;
         } while (db_rp != rp);
 
@@ -653,7 +683,7 @@ void render_filled_polygon(int lr, struct polygon *p, struct render_point *rp,
         fflush(errf);
     }
 
-    plottxt(lr, p, rp, texture, transparent);
+    plottxt(v, p, rp, texture, transparent, stats);
 }
 
 
@@ -768,11 +798,9 @@ unsigned char *gettexture(int rdlno, char txt1or2) {
             memset(unknown_t2, 0xff, 64 * 64);
 
             for (i = 0; i < 64; i++) {
-                unknown_t2[i * 64 + 31] = unknown_t2[i * 64 + 31] =
-                                              unknown_t2[31 * 64 +
-                                                         i] =
-                                                  unknown_t2[32 * 64 +
-                                                             i] = view.color[HILIGHTCOLORS];
+                unknown_t2[i * 64 + 31] = unknown_t2[i * 64 + 32] =
+                    unknown_t2[31 * 64 + i] = unknown_t2[32 * 64 + i] =
+                        view.color[HILIGHTCOLORS];
             }
 
             return unknown_t2;
@@ -803,92 +831,284 @@ void render_disablelights(void) {
 }
 
 
-/* I think I have some trouble with too big stacks, so I make as much
-   variables as possible static and/or global */
-static struct render_point render_pnts[MAX_RENDERDEPTH][MAX_RENDERPNTS];
-static unsigned char buffer[64 * 64];
-static int renderdepth = MAX_RENDERDEPTH, render_drawwhat, render_lr;
-static unsigned long timestamp;
-void render_cube(int depth, struct node *from, struct node *cube,
-                 struct render_point *bounds,
-                 int sublight)
-{
-    unsigned int w, j, x, y;
-    static struct render_point *render_start;
-    static struct render_point *rp;
-    static struct point_2d m1, m2;
-    static unsigned char *txt1, *txt2, *txt; /* static because I need to
-                                           save mem on the stack */
-    struct node *n, *ne;
-    static struct wall *wall;
-    static long overflow;
-    static int curpos;
-
-
-    if (depth >= renderdepth) {
-        return;
-    }
+/* Cache for the textures of walls with a texture2: texture1 with texture2
+   on top in the direction of the wall. If it's full, the entry which
+   wasn't used for the longest time is replaced. Everything is thrown away
+   when a texture is read again (see txt_changes in readtxt.c).
+   While render_level draws bands at the same time, the entries used
+   since the start of the picture (after combinedtxts_keep) are not
+   replaced because other bands may still draw them. */
+#define NUM_COMBINEDTXTS 128
+static struct combinedtxt {
+    short int t1, t2, dir;
+    unsigned long used;
+    unsigned char txt[64 * 64];
+} combinedtxts[NUM_COMBINEDTXTS];
+static int num_combinedtxts = 0;
+static unsigned long combinedtxts_used = 0, combinedtxts_changes = 0,
+                     combinedtxts_keep = (unsigned long)-1;
+
+
+static void combinetxts(unsigned char *txt, unsigned char *txt1,
+                        unsigned char *txt2, int dir) {
+    int x, y;
+
+
+    switch (dir) {
+        case 0:
+
+            for (y = 0; y < 64; y++) {
+                for (x = 0; x < 64; x++) {
+                    txt[y * 64 + x] = (txt2[y * 64 + x] >= 0xff ?
+                                       txt1[y * 64 + x] : txt2[y * 64 + x]);
+                }
+            }
 
-    if (view.blinkinglightson && lightsenabled) {
-        for (n = cube->d.c->fl_lights.head; n->next != NULL; n = n->next) {
-            if (!n->d.fl->calculated) {
-                n->d.fl->calculated = 1;
-                curpos = (unsigned long)(timestamp / n->d.fl->delay) & 0x1f;
-                j = ( (n->d.fl->mask >> curpos) & 1 );
-
-                if (j != n->d.fl->state) {
-                    n->d.fl->state = j;
-
-                    if (j) {
-                        for (ne = n->d.fl->ls->d.ls->effects.head;
-                             ne->next != NULL; ne = ne->next) {
-                            for (w = 0; w < 6; w++) {
-                                if ( (wall =
-                                          ne->d.lse->cube->d.c->walls[w]) !=
-                                    NULL ) {
-                                    for (x = 0; x < 4; x++) {
-                                        overflow =
-                                            (long)wall->corners[x].light +
-                                            ne->d.lse->add_light[w * 4 + x];
-                                        wall->corners[x].light = overflow >
-                                                                 theMaxLight
-                                                                 ?
-                                                                 theMaxLight : overflow;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    else {
-                        for (ne = n->d.fl->ls->d.ls->effects.head;
-                             ne->next != NULL; ne = ne->next) {
-                            for (w = 0; w < 6; w++) {
-                                if ( (wall =
-                                          ne->d.lse->cube->d.c->walls[w]) !=
-                                    NULL ) {
-                                    for (x = 0; x < 4; x++) {
-                                        overflow =
-                                            (long)wall->corners[x].light -
-                                            ne->d.lse->add_light[w * 4 + x];
-                                        wall->corners[x].light = overflow <
-                                                                 0 ? 0 :
-                                                                 overflow;
-                                    }
-                                }
-                            }
-                        }
-                    }
+            break;
+
+        case 1:
+
+            for (y = 0; y < 64; y++) {
+                for (x = 0; x < 64; x++) {
+                    txt[y * 64 + x] = (txt2[x * 64 + 63 - y] >= 0xff ?
+                                       txt1[y * 64 + x] :
+                                       txt2[x * 64 + 63 - y]);
                 }
             }
+
+            break;
+
+        case 2:
+
+            for (y = 0; y < 64; y++) {
+                for (x = 0; x < 64; x++) {
+                    txt[y * 64 + x] = (txt2[(63 - y) * 64 + 63 - x] >= 0xff ?
+                                       txt1[y * 64 + x] :
+                                       txt2[(63 - y) * 64 + 63 - x]);
+                }
+            }
+
+            break;
+
+        case 3:
+
+            for (y = 0; y < 64; y++) {
+                for (x = 0; x < 64; x++) {
+                    txt[y * 64 + x] = (txt2[(63 - x) * 64 + y] >= 0xff ?
+                                       txt1[y * 64 + x] :
+                                       txt2[(63 - x) * 64 + y]);
+                }
+            }
+
+            break;
+
+        default:
+            my_assert(0);
+    }
+}
+
+
+/* the texture of no entry is the same as before */
+static void forgetcombinedtxts(void) {
+    int i;
+
+
+    for (i = 0; i < num_combinedtxts; i++) {
+        combinedtxts[i].dir = -1;
+    }
+
+    combinedtxts_changes = txt_changes;
+}
+
+
+/* texture1 with texture2 of wall w on top. If no entry can be replaced,
+   it's made in own (64*64 bytes). */
+static unsigned char *getcombinedtxt(struct wall *w, unsigned char *own) {
+    struct combinedtxt *ct, *oldest;
+    unsigned char *txt1, *txt2;
+    int i;
+
+
+    if (combinedtxts_changes != txt_changes) {
+        forgetcombinedtxts();
+    }
+
+    for (i = 0, ct = combinedtxts, oldest = NULL; i < num_combinedtxts;
+         i++, ct++) {
+        if (ct->t1 == w->texture1 && ct->t2 == w->texture2 &&
+            ct->dir == w->txt2_direction) {
+            ct->used = ++combinedtxts_used;
+            return ct->txt;
+        }
+
+        if ( ct->used <= combinedtxts_keep
+            && (oldest == NULL || ct->used < oldest->used) ) {
+            oldest = ct;
+        }
+    }
+
+    ct = num_combinedtxts < NUM_COMBINEDTXTS ?
+         &combinedtxts[num_combinedtxts++] : oldest;
+    txt1 = gettexture(w->texture1, 1);
+    txt2 = gettexture(w->texture2, 2);
+
+    /* gettexture may have read a texture and so thrown away the cache */
+    if (combinedtxts_changes != txt_changes) {
+        forgetcombinedtxts();
+        txt1 = gettexture(w->texture1, 1);
+        txt2 = gettexture(w->texture2, 2);
+    }
+
+    if (ct == NULL) {
+        combinetxts(own, txt1, txt2, w->txt2_direction);
+        return own;
+    }
+
+    combinetxts(ct->txt, txt1, txt2, w->txt2_direction);
+    ct->t1 = w->texture1;
+    ct->t2 = w->texture2;
+    ct->dir = w->txt2_direction;
+    ct->used = ++combinedtxts_used;
+    return ct->txt;
+}
+
+
+/* The picture is made by render_cube, starting in the cube with the
+   viewpoint and going through the open sides into the neighbour cubes,
+   with the side clipped to the bounds as bounds for the neighbour.
+   The screen may be split into horizontal bands which are rendered by
+   several threads at the same time (see render_level). Each band has its
+   own bounds, points and statistics, everything else which is changed
+   while rendering is done before the bands are started (the polygons of
+   the sides and the flickering lights) or is locked (the textures). The
+   bands are clipped at whole lines of pixels and plottxt draws only the
+   lines from the top to one above the bottom of a polygon, so no pixel is
+   drawn by two bands. */
+struct render_frame {
+    struct leveldata *ld; /* the level of render_level */
+    /* the cubes which may be seen from the viewpoint or NULL (see pvs.c) */
+    unsigned long *pvs;
+    unsigned long timestamp;
+    struct render_view v; /* the display the frame is drawn in */
+    int depth, drawwhat;
+    int num_bands;
+    int shared; /* 1 if the bands are rendered at the same time */
+    /* 1 if the bands measure their times (for render_stats or the
+       profiler) */
+    int timed;
+    struct node *start_cube;
+};
+struct render_band {
+    struct render_frame *frame;
+    struct render_point pnts[MAX_RENDERDEPTH][MAX_RENDERPNTS];
+    struct render_point bounds[4];
+    struct render_stats stats; /* added to render_stats at the end */
+    unsigned char combined[64 * 64]; /* see getcombinedtxt */
+};
+
+
+/* pol_clip_pnts with the time added to the statistics of b */
+static struct render_point *render_clip(struct render_band *b,
+                                        struct polygon *p,
+                                        struct render_point *rp,
+                                        struct render_point *bounds) {
+    struct render_point *start;
+    double t;
+
+
+    if (!b->frame->timed) {
+        return pol_clip_pnts(&b->frame->v, p, rp, bounds);
+    }
+
+    t = thr_walltime();
+    start = pol_clip_pnts(&b->frame->v, p, rp, bounds);
+    b->stats.clip += thr_walltime() - t;
+    return start;
+}
+
+
+/* the texture of wall w */
+static unsigned char *render_texture(struct render_band *b, struct wall *w) {
+    unsigned char *txt;
+
+
+    if (b->frame->shared) {
+        thr_lock();
+    }
+
+    if (w->texture2 != 0) {
+        txt = getcombinedtxt(w, b->combined);
+    }
+    else {
+        txt = gettexture(w->texture1, 1);
+    }
+
+    if (b->frame->shared) {
+        thr_unlock();
+    }
+
+    return txt;
+}
+
+
+/* switch the flickering lights of cube c as they are at the time of the
+   picture */
+static void render_switchlights(struct render_frame *f, struct cube *c) {
+    struct node *n;
+    unsigned int on;
+    int pos;
+
+
+    for (n = c->fl_lights.head; n->next != NULL; n = n->next) {
+        if (!n->d.fl->calculated) {
+            n->d.fl->calculated = 1;
+            pos = (unsigned long)(f->timestamp / n->d.fl->delay) & 0x1f;
+            on = ( (n->d.fl->mask >> pos) & 1 );
+
+            if (on != n->d.fl->state) {
+                n->d.fl->state = on;
+
+                switchlight(f->ld, n->d.fl->ls->d.ls, on);
+            }
         }
     }
+}
+
+
+static void render_cube(struct render_band *b, int depth, struct node *from,
+                        struct node *cube, struct render_point *bounds,
+                        int sublight)
+{
+    struct render_frame *f = b->frame;
+    unsigned int w, j;
+    struct render_point *render_start;
+    struct render_point *rp;
+    struct point_2d m1, m2;
+    unsigned char *txt;
+    struct node *n;
+
+
+    if (depth >= f->depth) {
+        return;
+    }
+
+    if (f->timed) {
+        b->stats.cubes++;
+    }
+
+    if (view.blinkinglightson && lightsenabled && !f->shared) {
+        render_switchlights(f, cube->d.c);
+    }
 
     for (w = 0; w < 6; w++) {
-        if (!cube->d.c->polygons[w * 2] || cube->d.c->recalc_polygons[w]) {
+        if ( !f->shared && ( !cube->d.c->polygons[w * 2]
+                            || cube->d.c->recalc_polygons[w] ) ) {
             initfilledside(cube->d.c, w);
         }
 
-        if (cube->d.c->nc[w] != NULL && cube->d.c->nc[w] != from) {
+        if ( cube->d.c->nc[w] != NULL && cube->d.c->nc[w] != from &&
+            ( f->pvs == NULL ||
+             PVS_TEST(f->pvs, cube->d.c->nc[w]->no) ) ) {
             for (j = 0; j < 2; j++) {
                 if (DEBUG) {
                     fprintf(errf, "** %d Clipping&Recursion %d %d %d (%p)\n",
@@ -900,10 +1120,9 @@ void render_cube(int depth, struct node *from, struct node *cube,
 
                 if (cube->d.c->polygons[w * 2 + j]
                    && ( render_start =
-                           pol_clip_pnts(cube->d.c->polygons[w * 2 + j],
-                                         render_pnts[depth],
-                                         bounds, scr_xsize,
-                                         scr_ysize) ) != NULL) {
+                           render_clip(b, cube->d.c->polygons[w * 2 + j],
+                                       b->pnts[depth],
+                                       bounds) ) != NULL) {
                     /* Eliminate parallel pnts */
                     rp = render_start;
 
@@ -952,7 +1171,7 @@ void render_cube(int depth, struct node *from, struct node *cube,
 
                     if (render_start->next != render_start->prev) {
                         render_cube(
-                            depth + 1, cube, cube->d.c->nc[w], render_start,
+                            b, depth + 1, cube, cube->d.c->nc[w], render_start,
                             cube->d.c->d[w] != NULL &&
                             cube->d.c->d[w]->d.d->type1 == door1_cloaked
                             ? sublight -
@@ -967,76 +1186,7 @@ void render_cube(int depth, struct node *from, struct node *cube,
                                         door1_onlyswitch
                                        && cube->d.c->d[w]->d.d->type1 !=
                                         door1_cloaked) ) ) {
-            if (cube->d.c->walls[w]->texture2 != 0) {
-                txt = buffer;
-                txt1 = gettexture(cube->d.c->walls[w]->texture1, 1);
-                txt2 = gettexture(cube->d.c->walls[w]->texture2, 2);
-
-                switch (cube->d.c->walls[w]->txt2_direction) {
-                    case 0:
-
-                        for (y = 0; y < 64; y++) {
-                            for (x = 0; x < 64; x++) {
-                                txt[y * 64 +
-                                    x] =
-                                    (txt2[y * 64 + x] >=
-                                     0xff ? txt1[y * 64 + x] : txt2[y * 64 +
-                                                                    x]);
-                            }
-                        }
-
-                        break;
-
-                    case 1:
-
-                        for (y = 0; y < 64; y++) {
-                            for (x = 0; x < 64; x++) {
-                                txt[y * 64 +
-                                    x] =
-                                    (txt2[x * 64 + 63 - y] >=
-                                     0xff ? txt1[y * 64 + x] : txt2[x * 64 +
-                                                                    63 - y]);
-                            }
-                        }
-
-                        break;
-
-                    case 2:
-
-                        for (y = 0; y < 64; y++) {
-                            for (x = 0; x < 64; x++) {
-                                txt[y * 64 +
-                                    x] =
-                                    (txt2[(63 - y) * 64 + 63 - x] >=
-                                     0xff ? txt1[y * 64 + x] :
-                                     txt2[(63 -
-                                           y) * 64 + 63 - x]);
-                            }
-                        }
-
-                        break;
-
-                    case 3:
-
-                        for (y = 0; y < 64; y++) {
-                            for (x = 0; x < 64; x++) {
-                                txt[y * 64 +
-                                    x] =
-                                    (txt2[(63 - x) * 64 + y] >=
-                                     0xff ? txt1[y * 64 + x] :
-                                     txt2[(63 - x) * 64 + y]);
-                            }
-                        }
-
-                        break;
-
-                    default:
-                        my_assert(0);
-                }
-            }
-            else {
-                txt = gettexture(cube->d.c->walls[w]->texture1, 1);
-            }
+            txt = render_texture(b, cube->d.c->walls[w]);
 
             for (j = 0; j < 2; j++) {
                 if (DEBUG) {
@@ -1049,121 +1199,272 @@ void render_cube(int depth, struct node *from, struct node *cube,
 
                 if (cube->d.c->polygons[w * 2 + j]
                    && ( render_start =
-                           pol_clip_pnts(cube->d.c->polygons[w * 2 + j],
-                                         render_pnts[depth],
-                                         bounds, scr_xsize,
-                                         scr_ysize) ) != NULL) {
-                    render_filled_polygon(render_lr,
+                           render_clip(b, cube->d.c->polygons[w * 2 + j],
+                                       b->pnts[depth],
+                                       bounds) ) != NULL) {
+                    render_filled_polygon(&f->v,
                                           cube->d.c->polygons[w * 2 + j],
                                           render_start, txt,
-                                          cube->d.c->nc[w] != NULL,
-                                          sublight);
+                                          cube->d.c->nc[w] != NULL, sublight,
+                                          f->timed ? &b->stats : NULL);
                 }
             }
         }
     }
 
     /* Now check if we should draw more than the textures */
-    if ( (render_drawwhat & DW_CUBES) != 0 ) {
-        in_plotcube(render_lr, cube, 0, 0, 0, 1, 1);
+    if ( (f->drawwhat & DW_CUBES) != 0 ) {
+        in_plotcube(f->v.lr, cube, 0, 0, 0, 1, 1);
     }
 
-    if ( (render_drawwhat & DW_DOORS) != 0 ) {
+    if ( (f->drawwhat & DW_DOORS) != 0 ) {
         for (w = 0; w < 6; w++) {
             if (cube->d.c->d[w]) {
-                in_plotdoor(render_lr, cube->d.c->d[w], 0, 0, 0);
+                in_plotdoor(f->v.lr, cube->d.c->d[w], 0, 0, 0);
             }
         }
     }
 
-    if ( (render_drawwhat & DW_THINGS) != 0 ) {
+    if ( (f->drawwhat & DW_THINGS) != 0 ) {
         for (n = cube->d.c->things.head; n->next != NULL; n = n->next) {
-            in_plotthing(render_lr, n->d.t, 0);
+            in_plotthing(f->v.lr, n->d.t, 0);
         }
     }
 }
 
 
 void render_resetlights(struct leveldata *ld) {
-    struct node *n, *ne;
-    int w, c;
-    long overflow;
-    struct flickering_light *fl;
+    struct node *n;
 
 
     for (n = ld->lightsources.head; n->next != NULL; n = n->next) {
-        if (n->d.ls->fl != NULL) {
-            fl = n->d.ls->fl;
-
-            if (!fl->state) {
-                fl->state = 1;
-
-                for (ne = n->d.ls->effects.head; ne->next != NULL;
-                     ne = ne->next) {
-                    my_assert(ne->d.lse->cube != NULL);
-
-                    for (w = 0; w < 6; w++) {
-                        if (ne->d.lse->cube->d.c->walls[w]) {
-                            for (c = 0; c < 4; c++) {
-                                overflow =
-                                    (long)ne->d.lse->cube->d.c->walls[w]->
-                                    corners[
-                                        c].light +
-                                    ne->d.lse->add_light[w * 4 + c];
-                                ne->d.lse->cube->d.c->walls[w]->corners[c].
-                                light = overflow > theMaxLight ?
-                                        theMaxLight
-                                        : overflow;
-                            }
-                        }
-                    }
+        if (n->d.ls->fl != NULL && !n->d.ls->fl->state) {
+            n->d.ls->fl->state = 1;
+            switchlight(ld, n->d.ls, 1);
+        }
+    }
+}
+
+
+static void render_bandjob(void *data, int job) {
+    struct render_band *b = (struct render_band *)data + job;
+    double t = 0.0;
+
+
+    if (b->frame->timed) {
+        t = thr_walltime();
+    }
+
+    render_cube(b, 0, b->frame->start_cube, b->frame->start_cube, b->bounds,
+                0);
+
+    if (b->frame->timed) {
+        b->stats.cpu = thr_walltime() - t;
+        /* the profiler gets the times of the whole band. Adding each cube
+           or polygon would take its lock in all bands all the time. */
+        prof_add(ps_rendercubes, b->stats.cpu);
+        prof_add(ps_clip, b->stats.clip);
+        prof_add(ps_fill, b->stats.fill);
+    }
+}
+
+
+/* the number of bands the display of f is split into if num_frames
+   displays are rendered at the same time */
+static int render_numbands(struct render_frame *f, int num_frames) {
+    int n = theRenderBands > 0 ? theRenderBands : thr_numthreads();
+
+
+    /* the lines are drawn by in_plotcube etc. which can't run in several
+       threads at once */
+    if ( (f->drawwhat & (DW_CUBES | DW_DOORS | DW_THINGS) ) != 0 ) {
+        return 1;
+    }
+
+    n = (n + num_frames - 1) / num_frames;
+    return n > f->v.max_ycoord ? f->v.max_ycoord : (n < 1 ? 1 : n);
+}
+
+
+/* make the frame f for the display lr with the view set by makeview */
+static void render_initframe(struct render_frame *f, int lr,
+                             struct leveldata *ld, struct node *start_cube,
+                             int drawwhat, int depth,
+                             unsigned long timestamp)
+{
+    int i;
+
+
+    f->ld = ld;
+    f->drawwhat = drawwhat;
+    f->depth = depth < 1 ? MAX_RENDERDEPTH : depth;
+    f->start_cube = start_cube;
+    f->timestamp = timestamp;
+    f->timed = render_stats != NULL || isProfiling;
+    f->v.lr = lr;
+    f->v.x0 = x0;
+
+    for (i = 0; i < 3; i++) {
+        f->v.er[i] = er[i];
+    }
+
+    f->v.xviewphi = xviewphi;
+    f->v.yviewphi = yviewphi;
+    f->v.z_dist = z_dist;
+    f->v.max_xcoord = max_xcoord;
+    f->v.max_ycoord = max_ycoord;
+    f->v.scr_xsize = scr_xsize;
+    f->v.scr_ysize = scr_ysize;
+    /* the pvs is made for viewpoints in the cube */
+    f->pvs = checkpntcube(start_cube, &x0) ? pvs_getrow(ld, start_cube) :
+             NULL;
+}
+
+
+/* render the frames f[0..num_frames-1], which must be drawn into
+   different parts of the drawbuffer. The bands of all frames are
+   rendered at the same time. */
+static void render_frames(struct render_frame *f, int num_frames) {
+    struct render_band *bands, *b;
+    struct node *n;
+    int i, k, w, num_bands, y1, y2, max_x, max_y;
+
+
+    for (i = 0, num_bands = 0; i < num_frames; i++) {
+        num_bands += f[i].num_bands = render_numbands(&f[i], num_frames);
+    }
+
+    checkmem( bands = MALLOC(sizeof(struct render_band) * num_bands) );
+
+    for (i = 0, b = bands; i < num_frames; i++) {
+        f[i].shared = num_bands > 1;
+        max_x = f[i].v.max_xcoord;
+        max_y = f[i].v.max_ycoord;
+
+        for (k = 0; k < f[i].num_bands; k++, b++) {
+            b->frame = &f[i];
+            memset( &b->stats, 0, sizeof(struct render_stats) );
+            /* whole lines of pixels from top to bottom */
+            y1 = -max_y + 2 * max_y * k / f[i].num_bands;
+            y2 = -max_y + 2 * max_y * (k + 1) / f[i].num_bands;
+            b->bounds[0].x[0] = -max_x;
+            b->bounds[0].x[1] = y1;
+            b->bounds[1].x[0] = -max_x;
+            b->bounds[1].x[1] = y2;
+            b->bounds[2].x[0] = max_x;
+            b->bounds[2].x[1] = y2;
+            b->bounds[3].x[0] = max_x;
+            b->bounds[3].x[1] = y1;
+
+            for (w = 0; w < 4; w++) {
+                b->bounds[w].light = 0.0;
+                b->bounds[w].prev = &b->bounds[w == 0 ? 3 : w - 1];
+                b->bounds[w].next = &b->bounds[w == 3 ? 0 : w + 1];
+            }
+        }
+    }
+
+    if (num_bands > 1) {
+        /* done here for all cubes which may be seen in one of the frames,
+           because the bands can't do it at the same time */
+        for (n = f->ld->cubes.head; n->next != NULL; n = n->next) {
+            for (i = 0; i < num_frames && f[i].pvs != NULL &&
+                 !PVS_TEST(f[i].pvs, n->no); i++) {
+            }
+
+            if (i == num_frames) {
+                continue;
+            }
+
+            for (w = 0; w < 6; w++) {
+                if (!n->d.c->polygons[w * 2] || n->d.c->recalc_polygons[w]) {
+                    initfilledside(n->d.c, w);
                 }
             }
+
+            if (view.blinkinglightson && lightsenabled) {
+                render_switchlights(f, n->d.c);
+            }
         }
+
+        combinedtxts_keep = combinedtxts_used;
+        thr_runjobs(num_bands, render_bandjob, NULL, bands, NULL);
+        combinedtxts_keep = (unsigned long)-1;
+    }
+    else {
+        render_bandjob(bands, 0);
     }
+
+    for (k = 0, b = bands; render_stats != NULL && k < num_bands; k++, b++) {
+        render_stats->cpu += b->stats.cpu;
+        render_stats->clip += b->stats.clip;
+        render_stats->fill += b->stats.fill;
+        render_stats->cubes += b->stats.cubes;
+        render_stats->polygons += b->stats.polygons;
+        render_stats->bands++;
+    }
+
+    FREE(bands);
 }
 
 
+/* render the level ld from the cube start_cube on (the viewpoint must be
+   set with makeview). Returns the time it took. */
 unsigned long render_level(int lr, struct leveldata *ld,
                            struct node *start_cube, int drawwhat,
                            int depth)
 {
-    struct render_point screen_bounds[4];
-    int i;
+    struct render_frame f;
+    unsigned long timestamp;
+    double t = prof_start();
+
 
+    dl_invalidate();
 
     if (start_cube == NULL) {
         return 0;
     }
 
-    renderdepth = depth < 1 ? MAX_RENDERDEPTH : depth;
-
     if (DEBUG) {
         fprintf(errf, "\n\n*******RENDER LEVEL START********\n\n");
     }
 
     timestamp = psys_gettime() << (16 - TIMER_DIGITS_POW_2);
-    screen_bounds[0].x[0] = -max_xcoord;
-    screen_bounds[0].x[1] = -max_ycoord;
-    screen_bounds[0].light = 0.0;
-    screen_bounds[1].x[0] = -max_xcoord;
-    screen_bounds[1].x[1] = max_ycoord;
-    screen_bounds[1].light = 0.0;
-    screen_bounds[2].x[0] = max_xcoord;
-    screen_bounds[2].x[1] = max_ycoord;
-    screen_bounds[2].light = 0.0;
-    screen_bounds[3].x[0] = max_xcoord;
-    screen_bounds[3].x[1] = -max_ycoord;
-    screen_bounds[3].light = 0.0;
+    render_initframe(&f, lr, ld, start_cube, drawwhat, depth, timestamp);
+    render_frames(&f, 1);
+    prof_end(ps_renderlevel, t);
+    return ( psys_gettime() << (16 - TIMER_DIGITS_POW_2) ) - timestamp;
+}
 
-    for (i = 0; i < 4; i++) {
-        screen_bounds[i].prev = &screen_bounds[i == 0 ? 3 : i - 1];
-        screen_bounds[i].next = &screen_bounds[i == 3 ? 0 : i + 1];
+
+/* render the textures of the level ld from the cube start_cube on in the
+   left and the right display at the same time. The view is set with
+   makeview for each display, afterwards it's the one of the right
+   display. Returns the time it took. */
+unsigned long render_views(struct leveldata *ld, struct node *start_cube,
+                           int depth)
+{
+    struct render_frame f[2];
+    unsigned long timestamp;
+    double t = prof_start();
+    int lr;
+
+
+    dl_invalidate();
+
+    if (start_cube == NULL) {
+        return 0;
+    }
+
+    timestamp = psys_gettime() << (16 - TIMER_DIGITS_POW_2);
+
+    for (lr = 0; lr < 2; lr++) {
+        makeview(lr);
+        render_initframe(&f[lr], lr, ld, start_cube, 0, depth, timestamp);
     }
 
-    render_drawwhat = drawwhat;
-    render_lr = lr;
-    render_cube(0, start_cube, start_cube, screen_bounds, 0);
+    render_frames(f, 2);
+    prof_end(ps_renderlevel, t);
     return ( psys_gettime() << (16 - TIMER_DIGITS_POW_2) ) - timestamp;
 }
 
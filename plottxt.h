@@ -1,12 +1,25 @@
 /*  DEVIL - Descent Editor for Vertices, Items and Levels at all
     Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
     Further info see .c-files. */
+/* seconds spent in the stages of render_level */
+/* The times in s are summed over the bands of the picture. If the bands
+   are rendered at the same time, this is the time of all threads (more
+   than the time the picture took). clip and fill are parts of cpu. */
+struct render_stats {
+    double cpu, clip, fill;
+    unsigned long cubes, polygons, bands;
+};
+extern struct render_stats *render_stats;
+
+
 void plotline(int o_x1, int o_y1, int o_x2, int o_y2, int color, int xor);
 void clearlevelwin(void);
 void init_txtgrfx(void);
 unsigned long render_level(int lr, struct leveldata *ld,
                            struct node *start_cube, int drawwhat,
                            int depth);
+unsigned long render_views(struct leveldata *ld, struct node *start_cube,
+                           int depth);
 void render_resetlights(struct leveldata *ld);
 void render_enablelights();
 void render_disablelights();
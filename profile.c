@@ -0,0 +1,174 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    profile.c - measuring the time spent in parts of Devil
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+/* With Profile=1 in devilx.ini (or rbench -p) each call of the parts in
+   enum prof_scopes is measured with the monotonic clock of the system
+   (thr_walltime, the timer of Allegro counts only milliseconds). For
+   each part the number of calls, the sum and the maximum of the times
+   and the times of the last PROF_SAMPLES calls are kept. The median and
+   the 99th percentile are taken from these, so they show the recent
+   behaviour. The parts may be measured in several threads at the same
+   time (the bands of the renderer, the illumination), so the times are
+   added under a lock. The renderer sums the times of the cubes, of
+   pol_clip_pnts and of the span mapper in each band and adds them once
+   for the band (see render_bandjob), so its threads don't wait for the
+   lock. Without Profile nothing is measured and prof_start and prof_end
+   only check the flag. */
+#include <pthread.h>
+#include "structs.h"
+#include "tools.h"
+#include "threads.h"
+#include "lac_cfg.h"
+#include "profile.h"
+
+#define PROF_SAMPLES 4096
+/* where Devil writes the times when it ends (see prof_atexit) */
+#define PROF_FILE "devilprof.csv"
+
+struct prof_scope {
+    unsigned long count;
+    double total, max;
+    float samples[PROF_SAMPLES]; /* the last times in s, count%PROF_SAMPLES
+                                    is the next one */
+};
+
+static const char *prof_names[ps_num_of_scopes] = {
+    "cont_plotlevel", "render_level", "render_cube", "pol_clip_pnts",
+    "span_fill", "calcillumwall", "smoothlight", "readlvldata", "savelevel"
+};
+static struct prof_scope prof_scopes[ps_num_of_scopes];
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* the start of a measurement for prof_end. 0.0 if nothing is measured. */
+double prof_start(void) {
+    return isProfiling ? thr_walltime() : 0.0;
+}
+
+
+/* add the time since start (from prof_start) to scope */
+void prof_end(int scope, double start) {
+    if (start > 0.0) {
+        prof_add(scope, thr_walltime() - start);
+    }
+}
+
+
+/* add a call of scope which took seconds */
+void prof_add(int scope, double seconds) {
+    struct prof_scope *s = &prof_scopes[scope];
+
+
+    if (!isProfiling) {
+        return;
+    }
+
+    my_assert(scope >= 0 && scope < ps_num_of_scopes);
+    pthread_mutex_lock(&prof_lock);
+    s->samples[s->count % PROF_SAMPLES] = seconds;
+    s->count++;
+    s->total += seconds;
+
+    if (seconds > s->max) {
+        s->max = seconds;
+    }
+
+    pthread_mutex_unlock(&prof_lock);
+}
+
+
+void prof_reset(void) {
+    pthread_mutex_lock(&prof_lock);
+    memset( prof_scopes, 0, sizeof(prof_scopes) );
+    pthread_mutex_unlock(&prof_lock);
+}
+
+
+static int qs_compfloats(const void *f1, const void *f2) {
+    return *(const float *)f1 < *(const float *)f2 ? -1 :
+           *(const float *)f1 > *(const float *)f2;
+}
+
+
+/* the value below which p percent of the n sorted values are */
+static double prof_percentile(const float *sorted, int n, double p) {
+    return sorted[(int)(p / 100.0 * (n - 1) + 0.5)];
+}
+
+
+/* get the times of scope in st. Returns 0 if it wasn't called yet. */
+int prof_getstats(int scope, struct prof_stats *st) {
+    struct prof_scope *s = &prof_scopes[scope];
+    float *sorted;
+    int n;
+
+
+    my_assert(scope >= 0 && scope < ps_num_of_scopes);
+    memset( st, 0, sizeof(struct prof_stats) );
+    st->name = prof_names[scope];
+    checkmem( sorted = MALLOC(sizeof(float) * PROF_SAMPLES) );
+    pthread_mutex_lock(&prof_lock);
+    st->count = s->count;
+    st->total = s->total * 1000.0;
+    st->max = s->max * 1000.0;
+    n = s->count < PROF_SAMPLES ? s->count : PROF_SAMPLES;
+    memcpy(sorted, s->samples, sizeof(float) * n);
+    pthread_mutex_unlock(&prof_lock);
+
+    if (n > 0) {
+        qsort(sorted, n, sizeof(float), qs_compfloats);
+        st->mean = st->total / st->count;
+        st->p50 = prof_percentile(sorted, n, 50) * 1000.0;
+        st->p99 = prof_percentile(sorted, n, 99) * 1000.0;
+    }
+
+    FREE(sorted);
+    return n > 0;
+}
+
+
+/* write the times of all scopes to the file fname, one line for each
+   scope. Returns 0 if the file can't be written. */
+int prof_writecsv(const char *fname) {
+    struct prof_stats st;
+    FILE *f;
+    int i;
+
+
+    if ( ( f = fopen(fname, "w") ) == NULL ) {
+        return 0;
+    }
+
+    fprintf(f, "scope,count,total_ms,mean_ms,p50_ms,p99_ms,max_ms\n");
+
+    for (i = 0; i < ps_num_of_scopes; i++) {
+        prof_getstats(i, &st);
+        fprintf(f, "%s,%lu,%.4f,%.4f,%.4f,%.4f,%.4f\n", st.name, st.count,
+                st.total, st.mean, st.p50, st.p99, st.max);
+    }
+
+    return fclose(f) == 0;
+}
+
+
+/* for atexit: write the times to PROF_FILE */
+void prof_atexit(void) {
+    if ( isProfiling && !prof_writecsv(PROF_FILE) ) {
+        fprintf(errf, "Can't write the profile to %s\n", PROF_FILE);
+    }
+}
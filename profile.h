@@ -0,0 +1,25 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+    Further info see .c-files. */
+
+/* the parts of Devil which are measured (see prof_start) */
+enum prof_scopes {
+    ps_plotlevel, ps_renderlevel, ps_rendercubes, ps_clip, ps_fill,
+    ps_illumwall, ps_smoothlight, ps_readlevel, ps_savelevel,
+    ps_num_of_scopes
+};
+/* the times of a scope in ms. p50 and p99 are taken from the last calls
+   only (see profile.c). */
+struct prof_stats {
+    const char *name;
+    unsigned long count;
+    double total, mean, p50, p99, max;
+};
+
+double prof_start(void);
+void prof_end(int scope, double start);
+void prof_add(int scope, double seconds);
+void prof_reset(void);
+int prof_getstats(int scope, struct prof_stats *st);
+int prof_writecsv(const char *fname);
+void prof_atexit(void);
@@ -0,0 +1,813 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    pvs.c - the cubes which may be seen from a cube
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+#include "structs.h"
+#include "tools.h"
+#include "plotdata.h"
+#include "lac_cfg.h"
+#include "threads.h"
+#include "pvs.h"
+
+/* For every cube the set of cubes which can be seen from any point in
+   it (the potentially visible set). render_level doesn't go into cubes
+   which are not in the set of the cube with the viewpoint.
+   The open sides of the cubes are the portals. A cube can be seen from
+   cube c if there's a line from a side of c through all sides on the way
+   to the cube. The lines through the first side (source) and the last
+   side (pass) can only go through the part of the next side (target) on
+   the side of pass of the planes through an edge of source and a corner
+   of pass (or the other way round) which have source and pass on
+   different sides. The target is clipped to these planes and becomes the
+   next pass, if something is left (like the vis of Quake).
+   All planes are moved a bit (side.eps) to the side which is kept, so
+   the set is always a bit too big, even if the sides are not plane.
+   To make this faster for each side the cubes which may be seen through
+   the side are calculated first (mightsee). A way through a side is
+   not followed if it can't lead to new cubes. If there are still too
+   many ways (in big rooms), all cubes in mightsee of the first side are
+   taken.
+   The sets are calculated in the main loop of the editor when there's
+   nothing to do (pvs_idle) on all threads. When cubes are inserted or
+   deleted, points are moved or cubes are connected, ld->pvs_changes is
+   incremented (pvs_cubeschanged). Then the next time the sets are needed
+   a signature of the corners and neighbours of all cubes is checked. The
+   sets with a changed cube in it are calculated again. */
+#define PVS_EPSILON 65536.0
+#define PVS_TINY 1e-3
+#define PVS_MAXPNTS 32
+#define PVS_MAXSTEPS 2000
+#define PVS_FREECUBES 64
+#define PVS_TIMESLICE 0.02
+
+/* side w of cube no, index no*6+w. The normal points out of the cube */
+struct pvs_side {
+    double p[4][3], normal[3], dist, eps;
+};
+struct pvs_winding {
+    int num;
+    double p[PVS_MAXPNTS][3];
+};
+struct pvs {
+    int num; /* cube->no<num for all cubes */
+    int words; /* unsigned longs in one set of cubes */
+    unsigned long *rows; /* the cubes seen from cube no: rows+no*words */
+    unsigned long *mightsee; /* the cubes maybe seen through side w of
+                                cube no: mightsee+(no*6+w)*words */
+    unsigned char *rowvalid, *msvalid;
+    unsigned long *sigs; /* the signatures of the cubes (see cubesig) */
+    unsigned char *present; /* is there a cube with this number? */
+    unsigned long changes; /* ld->pvs_changes when the cubes were checked */
+    /* for pvs_checkcubes: the changed cubes and present for the next check */
+    unsigned long *changed;
+    unsigned char *newpresent;
+    /* only while pvs_work is running: */
+    struct node **cubes; /* the cube with the number no */
+    struct pvs_side *sides;
+};
+struct pvs_jobs {
+    struct pvs *pvs;
+    int *todo; /* the number of the row or the side of each job */
+    double end; /* thr_walltime when no more jobs should be started */
+};
+/* the memory of one job which calculates a row */
+struct pvs_flow {
+    struct pvs *pvs;
+    unsigned long *row, *mightsee; /* mightsee for each depth */
+    struct pvs_winding *pass; /* for each depth */
+    int steps;
+};
+
+
+static double dot3(const double *a, const double *b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+
+static void cross3(double *c, const double *a, const double *b) {
+    c[0] = a[1] * b[2] - a[2] * b[1];
+    c[1] = a[2] * b[0] - a[0] * b[2];
+    c[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+
+static void setbit(unsigned long *row, int no) {
+    row[no / PVS_BITS] |= 1UL << (no % PVS_BITS);
+}
+
+
+/* a number which changes if a corner or a neighbour of the cube is
+   changed */
+static unsigned long cubesig(struct node *n) {
+    unsigned long h = 2166136261UL;
+    unsigned int u;
+    int i, j;
+
+
+    for (i = 0; i < 8; i++) {
+        for (j = 0; j < 3; j++) {
+            memcpy(&u, &n->d.c->p[i]->d.p->x[j], sizeof(unsigned int));
+            h = (h ^ u) * 16777619UL;
+        }
+    }
+
+    for (i = 0; i < 6; i++) {
+        h = ( h ^ (n->d.c->nc[i] != NULL ? n->d.c->nc[i]->no : -1) ) *
+            16777619UL;
+    }
+
+    return h;
+}
+
+
+/* cubes of ld were inserted, deleted, moved or connected, so the sets
+   must be checked */
+void pvs_cubeschanged(struct leveldata *ld) {
+    if (ld != NULL) {
+        ld->pvs_changes++;
+    }
+}
+
+
+void pvs_free(struct leveldata *ld) {
+    struct pvs *pvs = ld->pvs;
+
+
+    if (pvs == NULL) {
+        return;
+    }
+
+    FREE(pvs->rows);
+    FREE(pvs->mightsee);
+    FREE(pvs->rowvalid);
+    FREE(pvs->msvalid);
+    FREE(pvs->sigs);
+    FREE(pvs->present);
+    FREE(pvs->changed);
+    FREE(pvs->newpresent);
+    FREE(ld->pvs);
+}
+
+
+/* make an empty pvs for ld. Nothing is valid, so everything is
+   calculated by pvs_work */
+static void pvs_make(struct leveldata *ld) {
+    struct pvs *pvs;
+    struct node *n;
+
+
+    pvs_free(ld);
+    checkmem( pvs = MALLOC( sizeof(struct pvs) ) );
+    pvs->num = ld->cubes.maxnum + PVS_FREECUBES;
+    pvs->words = (pvs->num + PVS_BITS - 1) / PVS_BITS;
+    checkmem( pvs->rows = CALLOC(pvs->num * pvs->words,
+                                 sizeof(unsigned long) ) );
+    checkmem( pvs->mightsee = CALLOC(pvs->num * 6 * pvs->words,
+                                     sizeof(unsigned long) ) );
+    checkmem( pvs->rowvalid = CALLOC(pvs->num, 1) );
+    checkmem( pvs->msvalid = CALLOC(pvs->num * 6, 1) );
+    checkmem( pvs->sigs = CALLOC( pvs->num, sizeof(unsigned long) ) );
+    checkmem( pvs->present = CALLOC(pvs->num, 1) );
+    checkmem( pvs->changed = MALLOC(sizeof(unsigned long) * pvs->words) );
+    checkmem( pvs->newpresent = MALLOC(pvs->num) );
+    pvs->changes = ld->pvs_changes;
+    pvs->cubes = NULL;
+    pvs->sides = NULL;
+
+    for (n = ld->cubes.head; n->next != NULL; n = n->next) {
+        my_assert(n->no >= 0 && n->no < pvs->num);
+        pvs->present[n->no] = 1;
+        pvs->sigs[n->no] = cubesig(n);
+    }
+
+    ld->pvs = pvs;
+}
+
+
+/* if cubes were changed since the last check, check the signatures of
+   all cubes. All sets with changed cubes in it and the sets of the
+   changed cubes are marked as invalid. If there are too many cubes, the
+   pvs is thrown away. */
+static void pvs_checkcubes(struct leveldata *ld) {
+    struct pvs *pvs = ld->pvs;
+    struct node *n;
+    unsigned long *changed, sig, *set;
+    unsigned char *present;
+    int i, k, any = 0;
+
+
+    if (pvs == NULL || pvs->changes == ld->pvs_changes) {
+        return;
+    }
+
+    if (ld->cubes.maxnum > pvs->num) {
+        pvs_free(ld);
+        return;
+    }
+
+    pvs->changes = ld->pvs_changes;
+    changed = pvs->changed;
+    present = pvs->newpresent;
+    memset( changed, 0, sizeof(unsigned long) * pvs->words );
+    memset(present, 0, pvs->num);
+
+    for (n = ld->cubes.head; n->next != NULL; n = n->next) {
+        if (n->no < 0 || n->no >= pvs->num) {
+            pvs_free(ld);
+            return;
+        }
+
+        present[n->no] = 1;
+        sig = cubesig(n);
+
+        if (!pvs->present[n->no] || sig != pvs->sigs[n->no]) {
+            pvs->sigs[n->no] = sig;
+            setbit(changed, n->no);
+            any = 1;
+        }
+    }
+
+    for (i = 0; i < pvs->num; i++) {
+        if (pvs->present[i] && !present[i]) {
+            setbit(changed, i);
+            any = 1;
+        }
+    }
+
+    pvs->newpresent = pvs->present;
+    pvs->present = present;
+
+    if (!any) {
+        return;
+    }
+
+    for (i = 0; i < pvs->num; i++) {
+        if ( !pvs->rowvalid[i] || PVS_TEST(changed, i) ) {
+            pvs->rowvalid[i] = 0;
+            continue;
+        }
+
+        for (k = 0, set = pvs->rows + i * pvs->words; k < pvs->words; k++) {
+            if (set[k] & changed[k]) {
+                pvs->rowvalid[i] = 0;
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < pvs->num * 6; i++) {
+        if ( !pvs->msvalid[i] || PVS_TEST(changed, i / 6) ) {
+            pvs->msvalid[i] = 0;
+            continue;
+        }
+
+        for (k = 0, set = pvs->mightsee + i * pvs->words; k < pvs->words;
+             k++) {
+            if (set[k] & changed[k]) {
+                pvs->msvalid[i] = 0;
+                break;
+            }
+        }
+    }
+}
+
+
+/* the planes of all open sides and the cubes for their numbers */
+static void pvs_makesides(struct leveldata *ld, struct pvs *pvs) {
+    struct node *n;
+    struct pvs_side *s;
+    double c[3], sc[3], a[3], b[3], l, d;
+    int w, i, j;
+
+
+    checkmem( pvs->cubes = CALLOC( pvs->num, sizeof(struct node *) ) );
+    checkmem( pvs->sides = MALLOC(sizeof(struct pvs_side) * pvs->num * 6) );
+
+    for (n = ld->cubes.head; n->next != NULL; n = n->next) {
+        pvs->cubes[n->no] = n;
+
+        for (j = 0; j < 3; j++) {
+            for (i = 0, c[j] = 0.0; i < 8; i++) {
+                c[j] += n->d.c->p[i]->d.p->x[j] / 8.0;
+            }
+        }
+
+        for (w = 0; w < 6; w++) {
+            if (n->d.c->nc[w] == NULL) {
+                continue;
+            }
+
+            s = &pvs->sides[n->no * 6 + w];
+
+            for (i = 0; i < 4; i++) {
+                for (j = 0; j < 3; j++) {
+                    s->p[i][j] = n->d.c->p[wallpts[w][i]]->d.p->x[j];
+                }
+            }
+
+            for (j = 0; j < 3; j++) {
+                sc[j] = (s->p[0][j] + s->p[1][j] + s->p[2][j] + s->p[3][j]) /
+                        4.0;
+                a[j] = s->p[2][j] - s->p[0][j];
+                b[j] = s->p[3][j] - s->p[1][j];
+            }
+
+            cross3(s->normal, a, b);
+            l = sqrt( dot3(s->normal, s->normal) );
+
+            for (j = 0; j < 3; j++) {
+                s->normal[j] = l > PVS_TINY ? s->normal[j] / l : 0.0;
+                a[j] = sc[j] - c[j];
+            }
+
+            if (dot3(s->normal, a) < 0.0) {
+                for (j = 0; j < 3; j++) {
+                    s->normal[j] = -s->normal[j];
+                }
+            }
+
+            s->dist = dot3(s->normal, sc);
+
+            /* a degenerated side is no plane, everything is on it */
+            for (i = 0, s->eps = l > PVS_TINY ? PVS_EPSILON : HUGE_VAL;
+                 i < 4; i++) {
+                d = fabs(dot3(s->normal, s->p[i]) - s->dist);
+
+                if (l > PVS_TINY && d + PVS_EPSILON > s->eps) {
+                    s->eps = d + PVS_EPSILON;
+                }
+            }
+        }
+    }
+}
+
+
+static void pvs_freesides(struct pvs *pvs) {
+    FREE(pvs->cubes);
+    FREE(pvs->sides);
+}
+
+
+static void pvs_getwinding(struct pvs_side *s, struct pvs_winding *wi) {
+    int i, j;
+
+
+    wi->num = 4;
+
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 3; j++) {
+            wi->p[i][j] = s->p[i][j];
+        }
+    }
+}
+
+
+/* keep the part of wi which is on the side of normal of the plane moved
+   by eps to the other side. Returns the number of points left. If there
+   are too many points, wi is not clipped (so it's a bit too big). */
+static int pvs_clip(struct pvs_winding *wi, const double *normal,
+                    double dist, double eps) {
+    struct pvs_winding out;
+    double d[PVS_MAXPNTS], t;
+    int i, j, next, front = 0;
+
+
+    for (i = 0; i < wi->num; i++) {
+        d[i] = dot3(normal, wi->p[i]) - dist + eps;
+        front += d[i] >= 0.0;
+    }
+
+    if (front == wi->num) {
+        return wi->num;
+    }
+
+    if (front == 0) {
+        return wi->num = 0;
+    }
+
+    for (i = 0, out.num = 0; i < wi->num; i++) {
+        if (out.num + 2 > PVS_MAXPNTS) {
+            return wi->num;
+        }
+
+        next = (i + 1) % wi->num;
+
+        if (d[i] >= 0.0) {
+            for (j = 0; j < 3; j++) {
+                out.p[out.num][j] = wi->p[i][j];
+            }
+
+            out.num++;
+        }
+
+        if ( (d[i] >= 0.0) != (d[next] >= 0.0) ) {
+            t = d[i] / (d[i] - d[next]);
+
+            for (j = 0; j < 3; j++) {
+                out.p[out.num][j] = wi->p[i][j] +
+                                    t * (wi->p[next][j] - wi->p[i][j]);
+            }
+
+            out.num++;
+        }
+    }
+
+    *wi = out;
+    return wi->num;
+}
+
+
+/* clip target with the planes through an edge of source and a point of
+   pass which have source on the one and pass on the other side. If flip
+   the part on the side of source is kept. Returns 0 if nothing is left. */
+static int pvs_separators(struct pvs_winding *source,
+                          struct pvs_winding *pass,
+                          struct pvs_winding *target,
+                          int flip,
+                          double eps)
+{
+    double v1[3], v2[3], normal[3], dist, l, d;
+    int i, next, j, k, j2, pos, neg;
+
+
+    for (i = 0; i < source->num; i++) {
+        next = (i + 1) % source->num;
+
+        for (j2 = 0; j2 < 3; j2++) {
+            v1[j2] = source->p[next][j2] - source->p[i][j2];
+        }
+
+        for (j = 0; j < pass->num; j++) {
+            for (j2 = 0; j2 < 3; j2++) {
+                v2[j2] = pass->p[j][j2] - source->p[i][j2];
+            }
+
+            cross3(normal, v1, v2);
+            l = sqrt( dot3(normal, normal) );
+
+            if (l <= PVS_TINY) {
+                continue;
+            }
+
+            for (j2 = 0; j2 < 3; j2++) {
+                normal[j2] /= l;
+            }
+
+            dist = dot3(normal, pass->p[j]);
+
+            /* all of source must be on one side */
+            for (k = 0, pos = neg = 0; k < source->num; k++) {
+                if (k != i && k != next) {
+                    d = dot3(normal, source->p[k]) - dist;
+                    pos += d > PVS_TINY;
+                    neg += d < -PVS_TINY;
+                }
+            }
+
+            if ( (pos && neg) || (!pos && !neg) ) {
+                continue;
+            }
+
+            if (pos) {
+                for (j2 = 0; j2 < 3; j2++) {
+                    normal[j2] = -normal[j2];
+                }
+
+                dist = -dist;
+            }
+
+            /* and all of pass on the other side */
+            for (k = 0, pos = neg = 0; k < pass->num; k++) {
+                if (k != j) {
+                    d = dot3(normal, pass->p[k]) - dist;
+                    pos += d > PVS_TINY;
+                    neg += d < -PVS_TINY;
+                }
+            }
+
+            if (neg || !pos) {
+                continue;
+            }
+
+            if (flip) {
+                for (j2 = 0; j2 < 3; j2++) {
+                    normal[j2] = -normal[j2];
+                }
+
+                dist = -dist;
+            }
+
+            if (pvs_clip(target, normal, dist, eps) == 0) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+/* the lines through the side src go through the sides to the cube c
+   (depth sides up to now, the last one is pass). Check all sides of c.
+   f->mightsee+(depth-1)*words are the cubes which may be seen. */
+static void pvs_flow(struct pvs_flow *f, struct node *c, struct node *from,
+                     struct pvs_winding *src, struct pvs_side *srcside,
+                     struct pvs_winding *pass, struct pvs_side *passside,
+                     int depth)
+{
+    struct pvs *pvs = f->pvs;
+    struct pvs_side *side;
+    struct pvs_winding *target;
+    unsigned long *m, *nm, *ms, more;
+    int w, i;
+
+
+    if (depth + 1 >= MAX_RENDERDEPTH) {
+        return;
+    }
+
+    m = f->mightsee + (depth - 1) * pvs->words;
+    nm = m + pvs->words;
+    target = &f->pass[depth];
+
+    for (w = 0; w < 6; w++) {
+        if (c->d.c->nc[w] == NULL || c->d.c->nc[w] == from) {
+            continue;
+        }
+
+        if (++f->steps > PVS_MAXSTEPS) {
+            return;
+        }
+
+        /* is there anything new behind this side? */
+        ms = pvs->msvalid[c->no * 6 + w] ?
+             pvs->mightsee + (c->no * 6 + w) * pvs->words : NULL;
+
+        for (i = 0, more = 0; i < pvs->words; i++) {
+            nm[i] = ms != NULL ? m[i] & ms[i] : m[i];
+            more |= nm[i] & ~f->row[i];
+        }
+
+        if (!more) {
+            continue;
+        }
+
+        side = &pvs->sides[c->no * 6 + w];
+        pvs_getwinding(side, target);
+
+        if (pvs_clip(target, srcside->normal, srcside->dist,
+                     srcside->eps + side->eps) == 0) {
+            continue;
+        }
+
+        if ( pass != NULL &&
+            (pvs_clip(target, passside->normal, passside->dist,
+                      passside->eps + side->eps) == 0
+            || !pvs_separators(src, pass, target, 0, side->eps)
+            || !pvs_separators(pass, src, target, 1, side->eps) ) ) {
+            continue;
+        }
+
+        setbit(f->row, c->d.c->nc[w]->no);
+        pvs_flow(f, c->d.c->nc[w], c, src, srcside, target, side,
+                 depth + 1);
+    }
+}
+
+
+static void pvs_rowjob(void *data, int job) {
+    struct pvs_jobs *j = data;
+    struct pvs *pvs = j->pvs;
+    struct pvs_flow f;
+    struct pvs_winding src;
+    struct node *c = pvs->cubes[j->todo[job]];
+    int w, i;
+
+
+    f.pvs = pvs;
+    f.row = pvs->rows + c->no * pvs->words;
+    checkmem( f.mightsee = MALLOC(sizeof(unsigned long) * pvs->words *
+                                  (MAX_RENDERDEPTH + 1) ) );
+    checkmem( f.pass = MALLOC(sizeof(struct pvs_winding) *
+                              (MAX_RENDERDEPTH + 1) ) );
+    memset( f.row, 0, sizeof(unsigned long) * pvs->words );
+    setbit(f.row, c->no);
+
+    for (w = 0; w < 6; w++) {
+        if (c->d.c->nc[w] != NULL) {
+            setbit(f.row, c->d.c->nc[w]->no);
+        }
+    }
+
+    for (w = 0; w < 6; w++) {
+        if (c->d.c->nc[w] == NULL) {
+            continue;
+        }
+
+        f.steps = 0;
+
+        for (i = 0; i < pvs->words; i++) {
+            f.mightsee[i] = pvs->msvalid[c->no * 6 + w] ?
+                            pvs->mightsee[(c->no * 6 + w) * pvs->words + i] :
+                            ~0UL;
+        }
+
+        pvs_getwinding(&pvs->sides[c->no * 6 + w], &src);
+        pvs_flow(&f, c->d.c->nc[w], c, &src, &pvs->sides[c->no * 6 + w],
+                 NULL, NULL, 1);
+
+        /* too much work: all cubes which may be seen through this side */
+        if (f.steps > PVS_MAXSTEPS) {
+            for (i = 0; i < pvs->words; i++) {
+                f.row[i] |= f.mightsee[i];
+            }
+        }
+    }
+
+    FREE(f.pass);
+    FREE(f.mightsee);
+}
+
+
+/* the cubes which may be seen through side w of cube c: all cubes which
+   can be reached through sides which are (at least a bit) in front of
+   side w and have side w (at least a bit) behind them */
+static void pvs_mightseejob(void *data, int job) {
+    struct pvs_jobs *j = data;
+    struct pvs *pvs = j->pvs;
+    struct pvs_side *q = &pvs->sides[j->todo[job]], *r;
+    struct node *c = pvs->cubes[j->todo[job] / 6], **stack, *x, *y;
+    unsigned long *set = pvs->mightsee + j->todo[job] * pvs->words;
+    int num = 0, w, i;
+
+
+    checkmem( stack = MALLOC(sizeof(struct node *) * pvs->num) );
+    memset( set, 0, sizeof(unsigned long) * pvs->words );
+    y = c->d.c->nc[j->todo[job] % 6];
+    setbit(set, y->no);
+    stack[num++] = y;
+
+    while (num > 0) {
+        x = stack[--num];
+
+        for (w = 0; w < 6; w++) {
+            if ( ( y = x->d.c->nc[w] ) == NULL || PVS_TEST(set, y->no) ) {
+                continue;
+            }
+
+            r = &pvs->sides[x->no * 6 + w];
+
+            for (i = 0; i < 4; i++) {
+                if (dot3(q->normal, r->p[i]) - q->dist >= -q->eps) {
+                    break;
+                }
+            }
+
+            if (i == 4) {
+                continue;
+            }
+
+            for (i = 0; i < 4; i++) {
+                if (dot3(r->normal, q->p[i]) - r->dist <= r->eps) {
+                    break;
+                }
+            }
+
+            if (i == 4) {
+                continue;
+            }
+
+            setbit(set, y->no);
+            stack[num++] = y;
+        }
+    }
+
+    FREE(stack);
+}
+
+
+static int pvs_poll(void *data, int done) {
+    struct pvs_jobs *j = data;
+
+
+    return j->end < 0.0 || thr_walltime() < j->end;
+}
+
+
+/* calculate the invalid sets of ld for about seconds (or until all is
+   done if seconds<0) on all threads. Returns 1 if all sets are valid. */
+int pvs_work(struct leveldata *ld, double seconds) {
+    struct pvs *pvs;
+    struct pvs_jobs j;
+    struct node *n;
+    unsigned char *done;
+    int num_ms, num_rows, i, w;
+
+
+    if (ld == NULL || !isUsingPVS) {
+        return 1;
+    }
+
+    pvs_checkcubes(ld);
+
+    if (ld->pvs == NULL) {
+        pvs_make(ld);
+    }
+
+    pvs = ld->pvs;
+    j.pvs = pvs;
+    j.end = seconds < 0.0 ? -1.0 : thr_walltime() + seconds;
+    checkmem( j.todo = MALLOC(sizeof(int) * pvs->num * 6) );
+    checkmem( done = MALLOC(pvs->num * 6) );
+
+    do {
+        /* first the sides, because they are used for the rows */
+        for (n = ld->cubes.head, num_ms = num_rows = 0; n->next != NULL;
+             n = n->next) {
+            for (w = 0; w < 6; w++) {
+                if (n->d.c->nc[w] != NULL && !pvs->msvalid[n->no * 6 + w]) {
+                    j.todo[num_ms++] = n->no * 6 + w;
+                }
+            }
+        }
+
+        if (num_ms == 0) {
+            for (n = ld->cubes.head; n->next != NULL; n = n->next) {
+                if (!pvs->rowvalid[n->no]) {
+                    j.todo[num_rows++] = n->no;
+                }
+            }
+        }
+
+        if (num_ms + num_rows == 0) {
+            break;
+        }
+
+        pvs_makesides(ld, pvs);
+
+        if (num_ms > 0) {
+            thr_runjobs(num_ms, pvs_mightseejob, pvs_poll, &j, done);
+
+            for (i = 0; i < num_ms; i++) {
+                pvs->msvalid[j.todo[i]] = done[i];
+            }
+        }
+        else {
+            thr_runjobs(num_rows, pvs_rowjob, pvs_poll, &j, done);
+
+            for (i = 0; i < num_rows; i++) {
+                pvs->rowvalid[j.todo[i]] = done[i];
+            }
+        }
+
+        pvs_freesides(pvs);
+    } while ( pvs_poll(&j, 0) );
+
+    FREE(done);
+    FREE(j.todo);
+    return num_ms + num_rows == 0;
+}
+
+
+/* called in the main loop of the editor (see w_setpermanentroutine) */
+void pvs_idle(void) {
+    if (l != NULL && view.render > 1 && l->inside) {
+        pvs_work(l, PVS_TIMESLICE);
+    }
+}
+
+
+/* the set of cubes which may be seen from the cube nc or NULL if it's
+   not calculated (yet) */
+unsigned long *pvs_getrow(struct leveldata *ld, struct node *nc) {
+    struct pvs *pvs;
+
+
+    if (!isUsingPVS || ld == NULL || ld->pvs == NULL) {
+        return NULL;
+    }
+
+    pvs_checkcubes(ld);
+    pvs = ld->pvs;
+
+    if (pvs == NULL || nc->no < 0 || nc->no >= pvs->num ||
+        !pvs->rowvalid[nc->no]) {
+        return NULL;
+    }
+
+    return pvs->rows + nc->no * pvs->words;
+}
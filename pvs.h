@@ -0,0 +1,14 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+    Further info see .c-files. */
+
+/* is cube no in the set of cubes row (see pvs_getrow)? */
+#define PVS_BITS (8 * sizeof(unsigned long))
+#define PVS_TEST(row, no) ( ( (row)[(no) / PVS_BITS] >> ( (no) % PVS_BITS ) ) \
+                            & 1 )
+
+void pvs_cubeschanged(struct leveldata *ld);
+void pvs_free(struct leveldata *ld);
+int pvs_work(struct leveldata *ld, double seconds);
+void pvs_idle(void);
+unsigned long *pvs_getrow(struct leveldata *ld, struct node *nc);
@@ -0,0 +1,327 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    rbench.c - render benchmark without display
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+/* rbench loads a level with the configuration of Devil and renders it
+   with render_level into the drawbuffer along a fixed camera path: first
+   one turn around the start position, then through the cubes of the
+   level in list order. It needs no display (it's compiled with -DHEADLESS,
+   see the Makefile), so renderer regressions can be found in scripts.
+
+   The result is printed as name=value lines to stdout, with -f the times
+   of each frame are written as CSV to a file. With -p the profiler (see
+   profile.c) is switched on and its times are written as CSV to a file,
+   together with loading the level. All times are in ms. "frame" is the
+   time render_level took. The picture may be rendered in several bands
+   at the same time (see RenderBands in devilx.ini), so the times of the
+   parts are summed over the bands and named "cpu": "cpu" is the time of
+   all bands, "clip_cpu" the time in pol_clip_pnts, "fill_cpu" the time in
+   the span mapper and "recursion_cpu" the rest of the bands (walking
+   through the cubes, lighting, textures, setting up the polygons). */
+#include "structs.h"
+#include "tools.h"
+#include "initio.h"
+#include "config.h"
+#include "readlvl.h"
+#include "readtxt.h"
+#include "plot.h"
+#include "plotdata.h"
+#include "plottxt.h"
+#include "plotsys.h"
+#include "lac_cfg.h"
+#include "pvs.h"
+#include "profile.h"
+
+#define DEFAULT_FRAMES 200
+#define PI 3.14159265358979
+
+struct frametime {
+    double total, cpu, clip, fill;
+    unsigned long cubes, polygons, bands;
+};
+
+
+static int qs_compdoubles(const void *d1, const void *d2) {
+    return *(const double *)d1 < *(const double *)d2 ? -1 :
+           *(const double *)d1 > *(const double *)d2;
+}
+
+
+/* the value below which p percent of the n sorted values are */
+static double percentile(const double *sorted, int n, double p) {
+    return sorted[(int)(p / 100.0 * (n - 1) + 0.5)];
+}
+
+
+static void centerofcube(struct cube *c, struct point *center) {
+    int i, j;
+
+
+    for (j = 0; j < 3; j++) {
+        center->x[j] = 0.0;
+
+        for (i = 0; i < 8; i++) {
+            center->x[j] += c->p[i]->d.p->x[j] / 8.0;
+        }
+    }
+}
+
+
+/* look from the center of cube n to the center of its first neighbour
+   (or to its side 0 if it has none) */
+static void lookthroughcube(struct node *n) {
+    struct point to, up = { { 0.0, 1.0, 0.0 } };
+    int w, i;
+
+
+    centerofcube(n->d.c, &view.e0);
+
+    for (w = 0; w < 6; w++) {
+        if (n->d.c->nc[w] != NULL) {
+            break;
+        }
+    }
+
+    if (w < 6) {
+        centerofcube(n->d.c->nc[w]->d.c, &to);
+    }
+    else {
+        for (i = 0; i < 3; i++) {
+            to.x[i] = n->d.c->p[wallpts[0][0]]->d.p->x[i] +
+                      n->d.c->p[wallpts[0][2]]->d.p->x[i] -
+                      view.e0.x[i];
+        }
+    }
+
+    for (i = 0; i < 3; i++) {
+        view.e[2].x[i] = to.x[i] - view.e0.x[i];
+    }
+
+    normalize(&view.e[2]);
+
+    if (fabs( SCALAR(&view.e[2], &up) ) > 0.9) {
+        up.x[0] = 1.0;
+        up.x[1] = 0.0;
+    }
+
+    VECTOR(&view.e[0], &up, &view.e[2]);
+    normalize(&view.e[0]);
+    VECTOR(&view.e[1], &view.e[2], &view.e[0]);
+}
+
+
+/* set the camera for frame i of num frames and return the cube it's in */
+static struct node *setcamera(struct leveldata *ld, struct node **cubes,
+                              int i, int num) {
+    struct node *c;
+    float a;
+    int half = num / 2, k;
+
+
+    if (i < half) {
+        a = 2 * PI * i / half;
+        view.e0 = ld->e0;
+
+        for (k = 0; k < 3; k++) {
+            view.e[0].x[k] = cos(a) * ld->e[0].x[k] - sin(a) * ld->e[2].x[k];
+            view.e[1].x[k] = ld->e[1].x[k];
+            view.e[2].x[k] = sin(a) * ld->e[0].x[k] + cos(a) * ld->e[2].x[k];
+        }
+
+        c = findpntcube(ld, &view.e0);
+        return c != NULL ? c : ld->cubes.head;
+    }
+
+    c = cubes[(long)(i - half) * ld->cubes.size / (num - half)];
+    lookthroughcube(c);
+    return c;
+}
+
+
+int main(int argn, char *argc[]) {
+    struct leveldata *ld;
+    struct render_stats rs;
+    struct frametime *ft;
+    struct node **cubes, *n;
+    double *sorted, t, sum[4], pvs_ms;
+    unsigned long sum_cubes = 0, sum_polygons = 0, sum_bands = 0;
+    int i, num_frames = DEFAULT_FRAMES, arg = 1;
+    char *pigname, *levelname, *profname = NULL;
+    FILE *csv = NULL;
+
+
+    if (sizeof(float) != 4 || sizeof(long int) != 4 || sizeof(short int) != 2
+       || sizeof(int) != 4 || sizeof(char) != 1) {
+        printf("Wrong float/int size. Check your compiler flags.\n");
+        exit(2);
+    }
+
+    errf = stderr;
+
+    for (; arg + 1 < argn && argc[arg][0] == '-'; arg += 2) {
+        if (strcmp(argc[arg], "-f") == 0) {
+            if ( ( csv = fopen(argc[arg + 1], "w") ) == NULL ) {
+                fprintf(errf, "Can't open %s\n", argc[arg + 1]);
+                exit(2);
+            }
+        }
+        else if (strcmp(argc[arg], "-p") == 0) {
+            profname = argc[arg + 1];
+        }
+        else {
+            break;
+        }
+    }
+
+    if (arg >= argn) {
+        fprintf(errf, "Usage: rbench [-f frames.csv] [-p profile.csv] level "
+                "[frames [xres yres]]\n");
+        exit(1);
+    }
+
+    levelname = argc[arg++];
+
+    if (arg < argn && ( num_frames = atoi(argc[arg++]) ) < 2) {
+        num_frames = 2;
+    }
+
+    initeditor(INIFILE, 0);
+
+    if ( !readconfig() ) {
+        fprintf(errf, "Can't read the configuration. Start Devil first.\n");
+        exit(2);
+    }
+
+    /* set after devilx.ini is read */
+    isProfiling = profname != NULL;
+
+    if (arg + 1 < argn) {
+        init.xres = atoi(argc[arg]);
+        init.yres = atoi(argc[arg + 1]);
+    }
+
+    inittimer();
+    pigname = pig.current_pigname;
+    pig.current_pigname = NULL;
+    newpigfile(pigname, NULL);
+    FREE(pigname);
+    init_txtgrfx();
+    checkmem( ld = emptylevel() );
+
+    if ( !readlvldata(levelname, ld) || !initlevel(ld) ||
+        ld->cubes.size == 0 ) {
+        fprintf(errf, "Can't read level %s\n", levelname);
+        exit(2);
+    }
+
+    ld->whichdisplay = 0;
+    in_changecurrentlevel(ld);
+    newpigfile(ld->pigname, pig.pogfile);
+    preloadtxts(ld);
+    checkmem( cubes = MALLOC(sizeof(struct node *) * ld->cubes.size) );
+
+    for (n = ld->cubes.head, i = 0; n->next != NULL; n = n->next) {
+        cubes[i++] = n;
+    }
+
+    checkmem( ft = MALLOC(sizeof(struct frametime) * num_frames) );
+    checkmem( sorted = MALLOC(sizeof(double) * num_frames) );
+    /* the pvs is made before the frames (if it's used, see devilx.ini) */
+    t = psys_seconds();
+    pvs_work(ld, -1.0);
+    pvs_ms = (psys_seconds() - t) * 1000.0;
+    render_stats = &rs;
+
+    if (csv != NULL) {
+        fprintf(csv, "frame,cube,total,cpu,clip_cpu,fill_cpu,recursion_cpu,"
+                "cubes,polygons,bands\n");
+    }
+
+    for (i = 0; i < num_frames; i++) {
+        view.pcurrcube = setcamera(ld, cubes, i, num_frames);
+        makeview(-1);
+        psys_cleararea(0, 0, init.xres, init.yres);
+        memset( &rs, 0, sizeof(struct render_stats) );
+        t = psys_seconds();
+        render_level(0, ld, view.pcurrcube, 0, 0);
+        ft[i].total = (psys_seconds() - t) * 1000.0;
+        ft[i].cpu = rs.cpu * 1000.0;
+        ft[i].clip = rs.clip * 1000.0;
+        ft[i].fill = rs.fill * 1000.0;
+        ft[i].cubes = rs.cubes;
+        ft[i].polygons = rs.polygons;
+        ft[i].bands = rs.bands;
+        sorted[i] = ft[i].total;
+
+        if (csv != NULL) {
+            fprintf(csv, "%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%lu,%lu,%lu\n", i,
+                    view.pcurrcube->no, ft[i].total, ft[i].cpu, ft[i].clip,
+                    ft[i].fill, ft[i].cpu - ft[i].clip - ft[i].fill,
+                    ft[i].cubes, ft[i].polygons, ft[i].bands);
+        }
+    }
+
+    render_stats = NULL;
+
+    if (csv != NULL) {
+        fclose(csv);
+    }
+
+    qsort(sorted, num_frames, sizeof(double), qs_compdoubles);
+    sum[0] = sum[1] = sum[2] = sum[3] = 0.0;
+
+    for (i = 0; i < num_frames; i++) {
+        sum[0] += ft[i].total;
+        sum[1] += ft[i].cpu;
+        sum[2] += ft[i].clip;
+        sum[3] += ft[i].fill;
+        sum_cubes += ft[i].cubes;
+        sum_polygons += ft[i].polygons;
+        sum_bands += ft[i].bands;
+    }
+
+    printf("level=%s\n", levelname);
+    printf("resolution=%dx%d\n", init.xres, init.yres);
+    printf("frames=%d\n", num_frames);
+    printf("span_mapper=%s\n", psys_spanmapper);
+    printf("pvs=%s\n", isUsingPVS ? "on" : "off");
+    printf("pvs_ms=%.4f\n", pvs_ms);
+    printf("frame_ms_mean=%.4f\n", sum[0] / num_frames);
+    printf("frame_ms_p50=%.4f\n", percentile(sorted, num_frames, 50));
+    printf("frame_ms_p90=%.4f\n", percentile(sorted, num_frames, 90));
+    printf("frame_ms_p99=%.4f\n", percentile(sorted, num_frames, 99));
+    printf("frame_ms_max=%.4f\n", sorted[num_frames - 1]);
+    printf("cpu_ms_mean=%.4f\n", sum[1] / num_frames);
+    printf("clip_cpu_ms_mean=%.4f\n", sum[2] / num_frames);
+    printf("fill_cpu_ms_mean=%.4f\n", sum[3] / num_frames);
+    printf("recursion_cpu_ms_mean=%.4f\n",
+           (sum[1] - sum[2] - sum[3]) / num_frames);
+    printf("bands_mean=%.1f\n", (double)sum_bands / num_frames);
+    printf("cubes_mean=%.1f\n", (double)sum_cubes / num_frames);
+    printf("polygons_mean=%.1f\n", (double)sum_polygons / num_frames);
+
+    if ( profname != NULL && !prof_writecsv(profname) ) {
+        fprintf(errf, "Can't write %s\n", profname);
+        exit(2);
+    }
+
+    FREE(sorted);
+    FREE(ft);
+    FREE(cubes);
+    releasetimer();
+    return 0;
+}
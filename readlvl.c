@@ -31,13 +31,19 @@
 #include "do_move.h"
 #include "do_mod.h"
 #include "do_light.h"
+#include "cubegrid.h"
+#include "pvs.h"
+#include "edgetab.h"
+#include "plotlist.h"
 #include "readtxt.h"
 #include "readlvl.h"
 
 #include "lac_cfg.h"
+#include "profile.h"
 #include "linux.h"
 
 enum descent loading_level_version;
+struct leveldata *loading_level = NULL;
 
 /* this structure should be Descent version independent */
 struct fileheadversion
@@ -182,6 +188,7 @@ void killallproducers(struct leveldata *ld) {
 
 
     freelist(&ld->producers, free);
+    indexlist(&ld->producers);
 
     for (n = ld->cubes.head; n->next != NULL; n = n->next) {
         n->d.c->prodnum = -1;
@@ -194,6 +201,7 @@ void killallswitches(struct leveldata *ld) {
 
 
     freelist(&ld->sdoors, free);
+    indexlist(&ld->sdoors);
 
     for (n = ld->doors.head; n->next != NULL; n = n->next) {
         n->d.d->sdoor = 0xff;
@@ -209,6 +217,7 @@ void killalldoors(struct leveldata *ld) {
 
 
     freelist(&ld->doors, free);
+    indexlist(&ld->doors);
 
     if (ld->edoors) {
         FREE(ld->edoors);
@@ -312,6 +321,7 @@ int D1_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
     struct D1_REG_levelfilehead lfh;
     struct D1_minedata md;
     struct D1_gamedata gd;
+    struct lvlbuf mine;
     char buffer[31];
     const char *palname;
 
@@ -320,17 +330,23 @@ int D1_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
         return 0;
     }
 
-    if (fread(&lfh.minedata_offset, sizeof(unsigned long), 2, lf) != 2) {
+    if ( !freadlongs(lf, &lfh.minedata_offset, 2) ) {
         fclose(lf);
         return 0;
     }
 
-    if ( fseek(lf, lfh.minedata_offset, SEEK_SET) ) {
+    /* the points and cubes are decoded from memory */
+    if ( fseek(lf, lfh.minedata_offset, SEEK_SET) ||
+        !lb_read(&mine, lf, (long)lfh.gamedata_offset -
+                 (long)lfh.minedata_offset) ) {
         fclose(lf);
         return 0;
     }
 
-    if (fread(&md, sizeof(struct D1_minedata), 1, lf) != 1) {
+    if ( !lb_getbytes(&mine, &md.version, 1) ||
+        !lb_getshorts(&mine, &md.numpts, 1) ||
+        !lb_getshorts(&mine, &md.numcubes, 1) ) {
+        lb_free(&mine);
         fclose(lf);
         return 0;
     }
@@ -345,7 +361,8 @@ int D1_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
         fprintf(errf, "%d points, %d cubes\n", md.numpts, md.numcubes);
     }
 
-    if ( !readlist(lf, &ld->pts, readpnt, md.numpts) ) {
+    if ( !lb_readlist(&mine, &ld->pts, readpnt, md.numpts) ) {
+        lb_free(&mine);
         fclose(lf);
         return 0;
     }
@@ -359,7 +376,8 @@ int D1_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
             fprintf(errf, "Reading cube %d/%d\n", i, md.numcubes);
         }
 
-        if ( ( d = D1_REG_readcube(lf) ) == NULL ) {
+        if ( ( d = D1_REG_readcube(&mine) ) == NULL ) {
+            lb_free(&mine);
             return 1;                         /* try to init level */
         }
 
@@ -374,6 +392,7 @@ int D1_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
         }
     }
 
+    lb_free(&mine);
     fseek(lf, lfh.gamedata_offset, SEEK_SET);
 
     if (fread(&gd, sizeof(struct D1_gamedata), 1, lf) != 1) {
@@ -457,6 +476,7 @@ void makelightsources(struct leveldata *ld, struct turnoff *to, int tonum,
     struct lightsource *ls;
     struct ls_effect *lse, **cubelse;
     struct flickering_light *nfl;
+    struct list effects;
     struct node **cubes, *n;
 
 
@@ -482,11 +502,13 @@ void makelightsources(struct leveldata *ld, struct turnoff *to, int tonum,
         checkmem( ls = MALLOC( sizeof(struct lightsource) ) );
         ls->cube = cubes[to[nto].cube];
         ls->w = to[nto].side;
-        initlist(&ls->effects);
         ls->fl = NULL;
+        ls->ld = ld;
+        ls->pe_start = ls->pe_num = 0;
         checkmem( ls->cube->d.c->walls[(int)ls->w]->ls =
                      addnode(&ld->lightsources, -1,
                              ls) );
+        initlist(&effects);
 
         for (ncl = to[nto].offset;
              ncl < to[nto].offset + to[nto].num_changed && ncl < clnum;
@@ -499,10 +521,10 @@ void makelightsources(struct leveldata *ld, struct turnoff *to, int tonum,
                 checkmem( cubelse[cl[ncl].cube] = lse =
                                                       MALLOC( sizeof(struct
                                                                      ls_effect) ) );
-                checkmem( addnode(&ls->effects, -1, lse) );
+                checkmem( addnode(&effects, -1, lse) );
                 lse->cube = cubes[cl[ncl].cube];
                 memset(lse->smoothed, 0, sizeof(unsigned char) * 24);
-                memset(lse->add_light, 0, sizeof(unsigned char) * 24);
+                memset( lse->add_light, 0, sizeof(lse->add_light) );
             }
 
             for (i = 0; i < 4; i++) {
@@ -517,6 +539,8 @@ void makelightsources(struct leveldata *ld, struct turnoff *to, int tonum,
                 cubelse[cl[ncl].cube] = NULL;
             }
         }
+
+        setlseffects(ls, &effects);
     }
 
     if (fl != NULL) {
@@ -552,13 +576,14 @@ int D2_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
     struct D2_REG_levelfilehead lfh;
     struct D2_minedata md;
     struct D2_gamedata gd;
+    struct lvlbuf mine;
     char buffer[31];
     struct turnoff *turnoffs, *to;
     struct changedlight *changedlights, *cl;
     struct flickering_light *fl_lights = NULL, *fl;
 
 
-    if (fread(&lfh.minedata_offset, sizeof(unsigned long), 2, lf) != 2) {
+    if ( !freadlongs(lf, &lfh.minedata_offset, 2) ) {
         fclose(lf);
         return 0;
     }
@@ -580,7 +605,7 @@ int D2_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
     checkmem( ld->pigname = MALLOC(strlen(buffer) + 1) );
     strcpy(ld->pigname, buffer);
 
-    if (fread(&lfh.reactor_time, sizeof(unsigned long), 2, lf) != 2) {
+    if ( !freadlongs(lf, &lfh.reactor_time, 2) ) {
         fclose(lf);
         return 0;
     }
@@ -589,8 +614,7 @@ int D2_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
     ld->reactor_strength = lfh.reactor_strength;
 
     if (version >= LEVVER_D2_11_REG) {
-        if (fread(&lfh.flickering_lights, sizeof(unsigned long), 1,
-                  lf) != 1) {
+        if ( !freadlongs(lf, &lfh.flickering_lights, 1) ) {
             fclose(lf);
             return 0;
         }
@@ -616,7 +640,7 @@ int D2_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
         lfh.flickering_lights = 0;
     }
 
-    if (fread(&lfh.secret_cubenum, sizeof(unsigned long), 10, lf) != 10) {
+    if ( !freadlongs(lf, &lfh.secret_cubenum, 10) ) {
         fclose(lf);
         return 0;
     }
@@ -627,12 +651,18 @@ int D2_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
         ld->secret_orient[j + 6] = lfh.secret_orient[j + 3];
     }
 
-    if ( fseek(lf, lfh.minedata_offset, SEEK_SET) ) {
+    /* the points and cubes are decoded from memory */
+    if ( fseek(lf, lfh.minedata_offset, SEEK_SET) ||
+        !lb_read(&mine, lf, (long)lfh.gamedata_offset -
+                 (long)lfh.minedata_offset) ) {
         fclose(lf);
         return 0;
     }
 
-    if (fread(&md, sizeof(struct D2_minedata), 1, lf) != 1) {
+    if ( !lb_getbytes(&mine, &md.version, 1) ||
+        !lb_getshorts(&mine, &md.numpts, 1) ||
+        !lb_getshorts(&mine, &md.numcubes, 1) ) {
+        lb_free(&mine);
         fclose(lf);
         return 0;
     }
@@ -643,7 +673,8 @@ int D2_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
         fprintf(errf, "%d points, %d cubes\n", md.numpts, md.numcubes);
     }
 
-    if ( !readlist(lf, &ld->pts, readpnt, md.numpts) ) {
+    if ( !lb_readlist(&mine, &ld->pts, readpnt, md.numpts) ) {
+        lb_free(&mine);
         fclose(lf);
         return 0;
     }
@@ -657,7 +688,8 @@ int D2_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
             fprintf(errf, "Reading cube %d/%d\n", i, md.numcubes);
         }
 
-        if ( ( d = D2_REG_readcube(lf) ) == NULL ) {
+        if ( ( d = D2_REG_readcube(&mine) ) == NULL ) {
+            lb_free(&mine);
             return 1;                         /* try to init level */
         }
 
@@ -677,11 +709,14 @@ int D2_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
     }
 
     for (n = ld->cubes.head; n->next != NULL; n = n->next) {
-        if ( !D2_REG_readcube2(lf, n) ) {
+        if ( !D2_REG_readcube2(&mine, n) ) {
+            lb_free(&mine);
             return 1;
         }
     }
 
+    lb_free(&mine);
+
     fseek(lf, lfh.gamedata_offset, SEEK_SET);
 
     if (fread(&gd, sizeof(struct D2_gamedata), 1, lf) != 1) {
@@ -809,9 +844,10 @@ int D2_REG_readlvldata(FILE *lf, struct leveldata *ld, int version) {
 }
 
 
-int readlvldata(char *filename, struct leveldata *ld) {
+static int in_readlvldata(char *filename, struct leveldata *ld) {
     FILE *lf;
     struct fileheadversion fhv;
+    int ok;
 
 
     if (filename == NULL || ld == NULL) {
@@ -839,26 +875,43 @@ int readlvldata(char *filename, struct leveldata *ld) {
         return 0;
     }
 
+    /* the cubes, walls and points are taken from the pools of ld */
+    loading_level = ld;
+    ok = 0;
+
     switch (fhv.version) {
         case LEVVER_D2_10_REG:
         case LEVVER_D2_11_REG:
             loading_level_version = fhv.version;
-            return D2_REG_readlvldata(lf, ld, fhv.version);
+            ok = D2_REG_readlvldata(lf, ld, fhv.version);
+            break;
 
         case LEVVER_D2_12_REG:
             waitmsg("Can't read levels from the Vertigo series.");
-            return 0;
+            break;
 
         case LEVVER_D1_REG:
             loading_level_version = d1_14_reg;
-            return D1_REG_readlvldata(lf, ld, fhv.version);
+            ok = D1_REG_readlvldata(lf, ld, fhv.version);
+            break;
 
         default:
             waitmsg("Unknown level version.");
-            return 0;
+            break;
     }
 
-    return 0;
+    loading_level = NULL;
+    return ok;
+}
+
+
+int readlvldata(char *filename, struct leveldata *ld) {
+    double t = prof_start();
+    int ok = in_readlvldata(filename, ld);
+
+
+    prof_end(ps_readlevel, t);
+    return ok;
 }
 
 
@@ -915,7 +968,8 @@ int readasciilevel(char *filename, struct leveldata *ld) {
 
 
 int initlevel(struct leveldata *ld) {
-    struct node *n, *n2;
+    struct node *n;
+    struct packed_effect *pe, *end;
     int i, found_start;
     struct thing *t;
     struct leveldata *oldl;
@@ -974,9 +1028,9 @@ int initlevel(struct leveldata *ld) {
     if (init.d_ver >= d2_11_reg) {
         for (n = ld->lightsources.head; n->next != NULL; n = n->next) {
             if (n->d.ls->fl != NULL) {
-                for (n2 = n->d.ls->effects.head; n2->next != NULL;
-                     n2 = n2->next) {
-                    checkmem( addnode(&n2->d.lse->cube->d.c->fl_lights, -1,
+                for (pe = ld->packed_effects + n->d.ls->pe_start,
+                     end = pe + n->d.ls->pe_num; pe < end; pe++) {
+                    checkmem( addnode(&pe->cube->d.c->fl_lights, -1,
                                       n->d.ls->fl) );
                 }
             }
@@ -1127,6 +1181,8 @@ void b_plotlevel(struct w_window *w, void *d) {
     lw->w = w;
     ld = l;
     in_changecurrentlevel(lw);
+    /* the window must be drawn completely */
+    dl_invalidate();
     plotlevel();
     in_changecurrentlevel(ld);
 }
@@ -1182,6 +1238,21 @@ struct leveldata *emptylevel(void) {
     initlist(&ld->producers);
     initlist(&ld->lines);
     initlist(&ld->lightsources);
+    checkmem( ld->nodepool = w_newpool(sizeof(struct node), 1024) );
+    checkmem( ld->cubepool = w_newpool(sizeof(struct cube), 256) );
+    checkmem( ld->wallpool = w_newpool(sizeof(struct wall), 1024) );
+    checkmem( ld->pntpool = w_newpool(sizeof(struct listpoint), 1024) );
+    ld->cubes.pool = ld->things.pool = ld->doors.pool = ld->pts.pool =
+        ld->sdoors.pool = ld->producers.pool = ld->lightsources.pool =
+            ld->nodepool;
+    /* level data is looked up by number all the time */
+    indexlist(&ld->cubes);
+    indexlist(&ld->things);
+    indexlist(&ld->doors);
+    indexlist(&ld->pts);
+    indexlist(&ld->sdoors);
+    indexlist(&ld->producers);
+    indexlist(&ld->lightsources);
     checkmem( ld->edoors = MALLOC( sizeof(struct edoor) ) );
     ld->edoors->num = 0;
 
@@ -1220,6 +1291,13 @@ struct leveldata *emptylevel(void) {
     ld->n = NULL;
     ld->whichdisplay = view.whichdisplay;
     ld->cur_corr = NULL;
+    ld->grid = NULL;
+    ld->pvs = NULL;
+    ld->pvs_changes = 0;
+    ld->edges = NULL;
+    ld->packed_effects = NULL;
+    ld->num_packed_effects = ld->num_unused_effects = 0;
+    ld->max_packed_effects = 0;
 
     for (i = 0; i < 3; i++) {
         ld->e0.x[i] = i == 2 ? -655360.0 : 0.0;
@@ -1445,6 +1523,7 @@ void changecurrentlevel(struct leveldata *ld) {
     w_drawbutton(view.levelbutton);
     w_refreshend(view.movewindow);
     newpigfile(ld != NULL ? ld->pigname : pig.default_pigname, pig.pogfile);
+    preloadtxts(ld);
     drawopts();
 }
 
@@ -1521,12 +1600,24 @@ int closelevel(struct leveldata *ld, int warn) {
 
     freelist(&ld->lightsources, freelightsource);
     freelist(&ld->lines, free);
-    freelist(&ld->pts, free);
+    freelist(&ld->pts, freelistpnt);
     freelist(&ld->cubes, freecube);
     freelist(&ld->things, free);
     freelist(&ld->doors, freedoor);
     freelist(&ld->sdoors, free);
     freelist(&ld->producers, free);
+    w_killpool(ld->nodepool);
+    w_killpool(ld->cubepool);
+    w_killpool(ld->wallpool);
+    w_killpool(ld->pntpool);
+    cg_freegrid(ld);
+    pvs_free(ld);
+    et_freetable(ld);
+
+    if (ld->packed_effects != NULL) {
+        FREE(ld->packed_effects);
+    }
+
     FREE(ld->edoors);
     FREE(ld->fullname);
     FREE(ld->filename);
@@ -1538,12 +1629,7 @@ int closelevel(struct leveldata *ld, int warn) {
         drawopt(in_cube);
 
         /* clear the complete texture cache.  */
-        for (i = 0; i < pig.num_pigtxts; i++) {
-            if (pig.pig_txts[i].data != NULL) {
-                FREE(pig.pig_txts[i].data);
-                pig.pig_txts[i].data = NULL;
-            }
-        }
+        freetxtcache();
     }
 
     return 1;
@@ -1653,12 +1739,7 @@ int checklvl(struct leveldata *ld, int testlevel, struct list *turnoffs,
         if (n->d.c->cp !=
             NULL)                                                          {
             n->d.c->value = no++;
-            n->d.c->cp->prev->next = n->d.c->cp->next;
-            n->d.c->cp->next->prev = n->d.c->cp->prev;
-            n->d.c->cp->next = ld->producers.tail->next;
-            n->d.c->cp->prev = ld->producers.tail;
-            n->d.c->cp->prev->next = n->d.c->cp;
-            n->d.c->cp->next->prev = n->d.c->cp;
+            movenode_tail(&ld->producers, n->d.c->cp);
         }
 
         if (n->d.c->type != 0) {
@@ -1753,7 +1834,7 @@ int checklvl(struct leveldata *ld, int testlevel, struct list *turnoffs,
                 n->d.t->pos[i] = n->d.t->p[0].x[i];
             }
 
-            if ( ( c = findpntcube(&ld->cubes, &n->d.t->p[0]) ) == NULL ) {
+            if ( ( c = findpntcube(ld, &n->d.t->p[0]) ) == NULL ) {
                 view.pcurrthing = n;
 
                 if ( view.warn_thingoutofbounds &&
@@ -2026,10 +2107,7 @@ int D1_REG_savelevel(FILE *f, struct leveldata *ld) {
     }
 
     if (ld->secretstart) {
-        ld->secretstart->next = ld->things.tail->next;
-        ld->secretstart->prev = ld->things.tail;
-        ld->things.tail->next = ld->secretstart;
-        ld->things.tail = ld->secretstart;
+        linknode_tail(&ld->things, ld->secretstart);
     }
 
     if ( !makedoors(ld) ) {
@@ -2093,6 +2171,7 @@ void createturnoff(struct leveldata *ld, struct lightsource *ls,
 {
     struct turnoff *to;
     struct changedlight *lc;
+    struct packed_effect *pe, *end;
     struct node *n;
     int i, j;
 
@@ -2131,26 +2210,23 @@ void createturnoff(struct leveldata *ld, struct lightsource *ls,
     checkmem( to = MALLOC( sizeof(struct turnoff) ) );
     to->cube = ls->cube->no;
     to->side = ls->w;
-    sortlist(&ls->effects, 0);
     to->offset = changedlights->size;
     checkmem( addnode(turnoffs, -1, to) );
 
-    for (n = ls->effects.head; n->next != NULL; n = n->next) {
+    for (pe = ld->packed_effects + ls->pe_start, end = pe + ls->pe_num;
+         pe < end; pe++) {
         for (i = 0; i < 6; i++) {
-            if ( (n->d.lse->add_light[i *
-                                      4] >>
-                  10) + (n->d.lse->add_light[i * 4 + 1] >> 10) +
-                (n->d.lse->add_light[i * 4 +
-                                     2] >>
-                 10) + (n->d.lse->add_light[i * 4 + 3] >> 10) >
-                theMinDeltaLight ) {
+            if ( (pe->add_light[i * 4] >> 10) +
+                (pe->add_light[i * 4 + 1] >> 10) +
+                (pe->add_light[i * 4 + 2] >> 10) +
+                (pe->add_light[i * 4 + 3] >> 10) > theMinDeltaLight ) {
                 checkmem( lc = MALLOC( sizeof(struct changedlight) ) );
-                lc->cube = n->d.lse->cube->no;
+                lc->cube = pe->cube->no;
                 lc->side = i;
                 lc->stuff = 0;
 
                 for (j = 0; j < 4; j++) {
-                    lc->sub[j] = n->d.lse->add_light[i * 4 + j] >> 10;
+                    lc->sub[j] = pe->add_light[i * 4 + j] >> 10;
                 }
 
                 checkmem( addnode(changedlights, -1, lc) );
@@ -2365,10 +2441,7 @@ int D2_REG_savelevel(FILE *f, struct leveldata *ld, struct list *turnoffs,
     }
 
     if (ld->secretstart) {
-        ld->secretstart->next = ld->things.tail->next;
-        ld->secretstart->prev = ld->things.tail;
-        ld->things.tail->next = ld->secretstart;
-        ld->things.tail = ld->secretstart;
+        linknode_tail(&ld->things, ld->secretstart);
     }
 
     if ( !makedoors(ld) ) {
@@ -2439,9 +2512,9 @@ int D2_REG_savelevel(FILE *f, struct leveldata *ld, struct list *turnoffs,
 }
 
 
-int savelevel(char *fname, struct leveldata *ld, int testlevel,
-              int changename, int descent_version,
-              int notalllightinfo)
+static int in_savelevel(char *fname, struct leveldata *ld, int testlevel,
+                        int changename, int descent_version,
+                        int notalllightinfo)
 {
     FILE *f;
     int ret;
@@ -2514,3 +2587,17 @@ int savelevel(char *fname, struct leveldata *ld, int testlevel,
 }
 
 
+int savelevel(char *fname, struct leveldata *ld, int testlevel,
+              int changename, int descent_version,
+              int notalllightinfo)
+{
+    double t = prof_start();
+    int ret = in_savelevel(fname, ld, testlevel, changename,
+                           descent_version, notalllightinfo);
+
+
+    prof_end(ps_savelevel, t);
+    return ret;
+}
+
+
@@ -6,10 +6,16 @@ void newlevelwin(struct leveldata *ld, int shrunk);
 struct leveldata *openlevel(char *filename);
 struct leveldata *readlevel(char *filename);
 struct leveldata *readdbbfile(char *filename);
+int readlvldata(char *filename, struct leveldata *ld);
 int initlevel(struct leveldata *ld);
 int savelevel(char *fname, struct leveldata *ld, int testlevel,
               int changename, int descent_version,
               int notalllightinfo);
+int checklvl(struct leveldata *ld, int testlevel, struct list *turnoffs,
+             struct list *changedlights);
+void makelights(struct leveldata *ld, struct list *turnoffs,
+                struct list *changedlights, struct list *fl_lights,
+                int notall);
 void in_changecurrentlevel(struct leveldata *ld);
 void changecurrentlevel(struct leveldata *ld);
 int closelevel(struct leveldata *ld, int warn);
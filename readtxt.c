@@ -22,6 +22,7 @@
 #include "tools.h"
 #include "initio.h"
 #include "readtxt.h"
+#include "threads.h"
 #include <strings.h>
 
 extern int init_test;
@@ -99,9 +100,7 @@ void readpogfile(FILE *f) {
         pt.data = NULL;
         pt.offset += head.num_textures * (18 + 2) + sizeof(struct POG_header);
 
-        if (pig.pig_txts[texture_index[i]].data) {
-            FREE(pig.pig_txts[texture_index[i]].data);
-        }
+        freetxtdata(&pig.pig_txts[texture_index[i]]);
 
         pig.pig_txts[texture_index[i]] = pt;
     }
@@ -111,6 +110,7 @@ void readpogfile(FILE *f) {
 
 
 int readcustomtxts(FILE *f);
+static void freeunusedtxtimages(void);
 
 
 struct D1_texture {
@@ -190,12 +190,7 @@ int readtxts(FILE *f) {
     newpig = (pig.pig_txts == NULL);
 
     if (!newpig) { /* kill the old textures */
-        for (i = 0; i < pig.num_pigtxts; i++) {
-            if (pig.pig_txts[i].data) {
-                FREE(pig.pig_txts[i].data);
-            }
-        }
-
+        freetxtcache();
         FREE(pig.pig_txts);
     }
 
@@ -354,15 +349,15 @@ int readcustomtxts(FILE *f) {
                 pig.pig_txts[j].ysize =
                     (unsigned short)pig.pig_txts[j].rysize;
 
-                if (pig.pig_txts[j].data) {
-                    FREE(pig.pig_txts[j].data);
-                }
+                freetxtdata(&pig.pig_txts[j]);
 
                 pig.pig_txts[j].f = f;
                 /*readbitmap((char*)pig.pig_txts[j].data,&pig.pig_txts[j], NULL,1);*/
                 /*pig.pig_txts[j].f=NULL;*/
             }
         }
+
+        freeunusedtxtimages();
     }
 
     return 1;
@@ -670,6 +665,7 @@ int newpigfile(char *pigname, FILE *pogfile) {
         }
 
         if (pogfile != pig.pogfile) {
+            freetxtimage(pig.pogfile);
             fclose(pig.pogfile);
         }
 
@@ -699,6 +695,7 @@ int newpigfile(char *pigname, FILE *pogfile) {
         strcpy(pig.current_pigname, pigname);
 
         if (pig.pigfile) {
+            freetxtimage(pig.pigfile);
             fclose(pig.pigfile);
         }
 
@@ -707,6 +704,7 @@ int newpigfile(char *pigname, FILE *pogfile) {
         view.lightcolors = &palettes[i].lighttables[256 * NUM_SECURITY];
         newpalette(palettes[i].palette);
         inittxts();
+        freeunusedtxtimages();
     }
 
     return 1;
@@ -714,52 +712,166 @@ int newpigfile(char *pigname, FILE *pogfile) {
 
 
 #define ANIM_ARROW_ANGLE M_PI / 4
-/* reads texture ham_sd from file specified in texture in direction dir.
-   if ham_sd==NULL, read pig_sd.
-   dir=0 -> normal (origin left upper corner x+ y+).
-   dir=1 -> 90ø   (origin right upper corner x- y+).
-   dir=2 -> 180ø   (origin right lower corner x- y-).
-   dir=3 -> 270ø    (origin left lower corner x+ y-). */
-void readbitmap(char *dest, struct pig_txt *pig_sd, struct ham_txt *ham_sd,
-                int dir)                                                    {
-    struct pig_txt *sd = ham_sd ? ham_sd->pig : pig_sd;
-    char *sbitmap, bitmap[64 * 64], *buffer, *fill, *nobytesinrow;
-    unsigned int size;
-    unsigned int i;
-    int startx, starty, endx, endy, addx, addy, mx, my, x, y;
-    float l, angle;
-    struct ws_bitmap *bm;
+/* the PIG/POG files in memory. The textures are decoded from here, so
+   no seeking in the files is necessary and several textures can be
+   decoded at the same time. */
+struct txtimage {
     FILE *f;
+    unsigned char *data;
+    long size;
+};
+static struct txtimage *txtimages = NULL;
+static int num_txtimages = 0;
 
+/* the blocks with the textures read by preloadtxts */
+static unsigned char **txtatlases = NULL;
+static int *txtatlas_sizes = NULL, num_txtatlases = 0;
 
-    my_assert(sd != NULL);
-    f = sd->f;
+/* counts the changes of the texture bitmaps, so caches of composed
+   textures know when they are outdated */
+unsigned long txt_changes = 0;
 
-    if (f == NULL) {
+
+static struct txtimage *findtxtimage(FILE *f) {
+    int i;
+
+
+    for (i = 0; i < num_txtimages; i++) {
+        if (txtimages[i].f == f) {
+            return &txtimages[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static struct txtimage *gettxtimage(FILE *f) {
+    struct txtimage *ti;
+    long size;
+
+
+    if ( ( ti = findtxtimage(f) ) != NULL ) {
+        return ti;
+    }
+
+    if ( fseek(f, 0, SEEK_END) || ( size = ftell(f) ) < 0 ||
+        fseek(f, 0, SEEK_SET) ) {
+        return NULL;
+    }
+
+    checkmem( txtimages = REALLOC( txtimages, sizeof(struct txtimage) *
+                                  (num_txtimages + 1) ) );
+    ti = &txtimages[num_txtimages];
+    checkmem( ti->data = MALLOC(size > 0 ? size : 1) );
+
+    if (fread(ti->data, 1, size, f) != size) {
+        FREE(ti->data);
+        return NULL;
+    }
+
+    ti->f = f;
+    ti->size = size;
+    num_txtimages++;
+    return ti;
+}
+
+
+/* call this before f is closed */
+void freetxtimage(FILE *f) {
+    struct txtimage *ti;
+
+
+    if ( f == NULL || ( ti = findtxtimage(f) ) == NULL ) {
         return;
     }
 
-    if (sd->pigno < 0) {
-        return;          /* Nothing or Default */
+    FREE(ti->data);
+    *ti = txtimages[--num_txtimages];
+}
+
+
+/* free the images of the files which are not used by any texture, like
+   the custom textures (pg1/dtx) of a level when they are replaced */
+static void freeunusedtxtimages(void) {
+    int i, j;
+
+
+    for (i = 0; i < num_txtimages; ) {
+        for (j = 0; j < pig.num_pigtxts; j++) {
+            if (pig.pig_txts[j].f == txtimages[i].f) {
+                break;
+            }
+        }
+
+        if ( j < pig.num_pigtxts || txtimages[i].f == pig.pigfile
+            || txtimages[i].f == pig.pogfile ) {
+            i++;
+        }
+        else {
+            FREE(txtimages[i].data);
+            txtimages[i] = txtimages[--num_txtimages];
+        }
     }
+}
 
-    fseek(f, (long)sd->offset, SEEK_SET);
 
-    if (sd->xsize != 64 || sd->ysize != 64) {
-        printmsg("Texture (rdl: %d pig: %d name: %s) of wrong size: %d %d",
-                 ham_sd ? ham_sd->rdlno : -1, sd->pigno, sd->name, sd->xsize,
-                 sd->ysize);
+/* free the bitmap of t */
+void freetxtdata(struct pig_txt *t) {
+    int i;
+
+
+    if (t->data == NULL) {
         return;
     }
 
-    switch (dir) {
-        case 0:
-            startx = starty = 0;
-            addx = addy = 1;
-            mx = 1;
-            my = 64;
-            break;
+    txt_changes++;
+
+    for (i = 0; i < num_txtatlases; i++) {
+        if ( t->data >= txtatlases[i] && t->data < txtatlases[i] +
+            txtatlas_sizes[i] ) {
+            t->data = NULL; /* is freed with the atlas */
+            return;
+        }
+    }
+
+    FREE(t->data);
+}
+
+
+/* free the bitmaps of all textures */
+void freetxtcache(void) {
+    int i;
+
+
+    txt_changes++;
+
+    for (i = 0; i < pig.num_pigtxts; i++) {
+        freetxtdata(&pig.pig_txts[i]);
+    }
 
+    for (i = 0; i < num_txtatlases; i++) {
+        FREE(txtatlases[i]);
+    }
+
+    FREE(txtatlases);
+    FREE(txtatlas_sizes);
+    num_txtatlases = 0;
+}
+
+
+/* decode the 64x64 texture sd from the file image ti in direction dir
+   (see readbitmap) to bitmap. returns an error message or NULL. Doesn't
+   use anything but its arguments, so it can run in several threads. */
+static const char *decodebitmap(char *bitmap, struct txtimage *ti,
+                                struct pig_txt *sd, int dir) {
+    const unsigned char *src, *end, *fill;
+    unsigned long size;
+    unsigned int i;
+    int startx, starty, endx, endy, addx, addy, mx, my, x, y;
+
+
+    switch (dir) {
         case 1:
             startx = 63;
             starty = 0;
@@ -786,7 +898,6 @@ void readbitmap(char *dest, struct pig_txt *pig_sd, struct ham_txt *ham_sd,
             break;
 
         default:
-            printmsg(TXT_READBMUNKNOWNDIR, dir);
             startx = starty = 0;
             addx = addy = 1;
             mx = 1;
@@ -796,8 +907,20 @@ void readbitmap(char *dest, struct pig_txt *pig_sd, struct ham_txt *ham_sd,
     endx = 63 - startx;
     endy = 63 - starty;
 
+    if (ti == NULL || (long)sd->offset > ti->size) {
+        return "Can't read bitmap.";
+    }
+
+    src = ti->data + sd->offset;
+    end = ti->data + ti->size;
+
     if ( (sd->type1 & 0x08) == 0 ) {
+        if (end - src < 64 * 64) {
+            return "Can't read uncompressed bitmap.";
+        }
+
         y = starty - addy;
+        fill = src;
 
         do {
             y += addy;
@@ -805,75 +928,69 @@ void readbitmap(char *dest, struct pig_txt *pig_sd, struct ham_txt *ham_sd,
 
             do {
                 x += addx;
-
-                if (fread(&bitmap[y * my + x * mx], 1, 1, f) != 1) {
-                    printmsg("Can't read uncompressed bitmap.");
-                    return;
-                }
+                bitmap[y * my + x * mx] = *(fill++);
             } while (x != endx);
         } while (y != endy);
+
+        return NULL;
     }
-    else {
-        if (fread(&size, sizeof(unsigned long int), (size_t)1, f) != 1) {
-            printmsg("Can't read size of compressed bitmap.");
-            return;
-        }
 
-        checkmem( nobytesinrow = MALLOC( (size_t)sd->ysize ) );
-        checkmem( buffer = MALLOC( (size_t)size - 4 - sd->ysize ) );
+    if (end - src < 4) {
+        return "Can't read size of compressed bitmap.";
+    }
 
-        if (fread(nobytesinrow, 1, (size_t)sd->ysize, f) != sd->ysize) {
-            printmsg("Can't read nobytesinrow.");
-            return;
-        }                                           /* no need for this */
+    size = le32(src);
 
-        if (fread(buffer, (int)size - 4 - sd->ysize, 1, f) != 1) {
-            printmsg("Can't read compressed bitmap.");
-            return;
-        }
+    if (size < 4 + sd->ysize || size > end - src) {
+        return "Can't read compressed bitmap.";
+    }
 
-        y = starty - addy;
-        fill = buffer;
+    /* the number of bytes in the rows isn't needed */
+    end = src + size;
+    fill = src + 4 + sd->ysize;
+    y = starty - addy;
+
+    do {
+        y += addy;
+        x = startx - addx;
 
         do {
-            y += addy;
-            x = startx - addx;
+            if (fill + 2 > end) {
+                return "Error reading compressed bitmap.";
+            }
 
-            do {
-                if ( (*fill & 0xe0) == 0xe0 ) {
-                    for (i = 0; i < (*fill & 0x1f); i++) {
-                        if (x == endx) {
-                            printmsg("Error reading compressed bitmap.");
-                            return;
-                        }
-
-                        x += addx;
-                        bitmap[y * my + x * mx] = *(fill + 1);
+            if ( (*fill & 0xe0) == 0xe0 ) {
+                for (i = 0; i < (*fill & 0x1f); i++) {
+                    if (x == endx) {
+                        return "Error reading compressed bitmap.";
                     }
 
-                    fill += 2;
-                }
-                else {
                     x += addx;
-                    bitmap[y * my + x * mx] = *(fill++);
+                    bitmap[y * my + x * mx] = *(fill + 1);
                 }
-            } while (x != endx);
 
-            fill++; /*0xe0*/
-        } while (y != endy);
+                fill += 2;
+            }
+            else {
+                x += addx;
+                bitmap[y * my + x * mx] = *(fill++);
+            }
+        } while (x != endx);
 
-        FREE(buffer);
-        FREE(nobytesinrow);
-    }
+        fill++; /*0xe0*/
+    } while (y != endy);
+
+    return NULL;
+}
+
+
+/* draw the lines for the moved textures */
+static void drawtxtarrows(char *dest, struct ham_txt *ham_sd, int dir) {
+    int startx, starty, endx, endy, addx, addy, mx, my, x, y, i, size;
+    float l, angle;
+    struct ws_bitmap *bm;
 
-    for (fill = bitmap, sbitmap = dest; fill - bitmap < 64 * 64; fill++,
-         sbitmap++) {
-        if (*( (unsigned char *)fill ) != 0xff) {
-            *sbitmap = *fill;
-        }
-    }
 
-    /* draw the lines for the moved textures */
     if ( ham_sd != NULL && (ham_sd->xspeed != 0 || ham_sd->yspeed != 0) ) {
         switch (dir) {
             case 2:
@@ -967,3 +1084,183 @@ void readbitmap(char *dest, struct pig_txt *pig_sd, struct ham_txt *ham_sd,
 }
 
 
+/* reads texture ham_sd from file specified in texture in direction dir.
+   if ham_sd==NULL, read pig_sd.
+   dir=0 -> normal (origin left upper corner x+ y+).
+   dir=1 -> 90ø   (origin right upper corner x- y+).
+   dir=2 -> 180ø   (origin right lower corner x- y-).
+   dir=3 -> 270ø    (origin left lower corner x+ y-). */
+void readbitmap(char *dest, struct pig_txt *pig_sd, struct ham_txt *ham_sd,
+                int dir)                                                    {
+    struct pig_txt *sd = ham_sd ? ham_sd->pig : pig_sd;
+    char bitmap[64 * 64], *fill, *sbitmap;
+    const char *error;
+
+
+    my_assert(sd != NULL);
+
+    if (sd->f == NULL) {
+        return;
+    }
+
+    if (sd->pigno < 0) {
+        return;          /* Nothing or Default */
+    }
+
+    if (sd->xsize != 64 || sd->ysize != 64) {
+        printmsg("Texture (rdl: %d pig: %d name: %s) of wrong size: %d %d",
+                 ham_sd ? ham_sd->rdlno : -1, sd->pigno, sd->name, sd->xsize,
+                 sd->ysize);
+        return;
+    }
+
+    if (dir < 0 || dir > 3) {
+        printmsg(TXT_READBMUNKNOWNDIR, dir);
+    }
+
+    if ( ( error = decodebitmap(bitmap, gettxtimage(sd->f), sd, dir) ) !=
+        NULL ) {
+        printmsg(error);
+        return;
+    }
+
+    for (fill = bitmap, sbitmap = dest; fill - bitmap < 64 * 64; fill++,
+         sbitmap++) {
+        if (*( (unsigned char *)fill ) != 0xff) {
+            *sbitmap = *fill;
+        }
+    }
+
+    drawtxtarrows(dest, ham_sd, dir);
+}
+
+
+struct txtjob {
+    struct ham_txt *txt;
+    struct txtimage *ti;
+    unsigned char *data, fill;
+    const char *error; /* from decodebitmap */
+};
+
+
+static void txt_dojob(void *data, int job) {
+    struct txtjob *j = (struct txtjob *)data + job;
+    char bitmap[64 * 64];
+    int i;
+
+
+    memset(j->data, j->fill, 64 * 64);
+
+    if ( ( j->error = decodebitmap(bitmap, j->ti, j->txt->pig, 0) ) == NULL ) {
+        for (i = 0; i < 64 * 64; i++) {
+            if ( (unsigned char)bitmap[i] != 0xff ) {
+                j->data[i] = bitmap[i];
+            }
+        }
+    }
+}
+
+
+/* decode all textures on the sides of ld which aren't decoded yet, so
+   gettexture doesn't have to read them while drawing. The bitmaps are
+   put in one block and decoded with several threads. The bitmaps are set
+   in the textures when they are complete. Textures which can't be decoded
+   are left to readbitmap, which reports the error when they are drawn. */
+void preloadtxts(struct leveldata *ld) {
+    struct node *n;
+    struct wall *wall;
+    struct pig_txt *pt;
+    struct txtjob *jobs;
+    unsigned char *atlas, *done;
+    int w, t, i, rdlno, num_jobs = 0, *jobno;
+    double start = thr_walltime();
+
+
+    if (ld == NULL || pig.rdl_txts == NULL || pig.num_pigtxts <= 0) {
+        return;
+    }
+
+    checkmem( jobno = MALLOC(sizeof(int) * pig.num_pigtxts) );
+    checkmem( jobs = MALLOC(sizeof(struct txtjob) * pig.num_pigtxts) );
+
+    for (i = 0; i < pig.num_pigtxts; i++) {
+        jobno[i] = -1;
+    }
+
+    for (n = ld->cubes.head; n->next != NULL; n = n->next) {
+        for (w = 0; w < 6; w++) {
+            if ( ( wall = n->d.c->walls[w] ) == NULL ) {
+                continue;
+            }
+
+            for (t = 1; t <= 2; t++) {
+                rdlno = t == 1 ? wall->texture1 : wall->texture2;
+
+                if ( (t == 2 && rdlno == 0) || rdlno < 0 ||
+                    rdlno >= pig.num_rdltxts ||
+                    ( pt = pig.rdl_txts[rdlno].pig ) == NULL ||
+                    pt->data != NULL || pt->f == NULL || pt->pigno < 0 ||
+                    pt->xsize != 64 || pt->ysize != 64 ) {
+                    continue;
+                }
+
+                i = pt - pig.pig_txts;
+
+                if (jobno[i] >= 0) {
+                    if (t == 1) {
+                        jobs[jobno[i]].fill = 0xfe;
+                    }
+
+                    continue;
+                }
+
+                if ( ( jobs[num_jobs].ti = gettxtimage(pt->f) ) == NULL ) {
+                    continue;
+                }
+
+                jobs[num_jobs].txt = &pig.rdl_txts[rdlno];
+                jobs[num_jobs].fill = t == 1 ? 0xfe : 0xff;
+                jobno[i] = num_jobs++;
+            }
+        }
+    }
+
+    FREE(jobno);
+
+    if (num_jobs == 0) {
+        FREE(jobs);
+        return;
+    }
+
+    checkmem( atlas = MALLOC(num_jobs * 64 * 64) );
+    checkmem( done = MALLOC(num_jobs) );
+
+    for (i = 0; i < num_jobs; i++) {
+        jobs[i].data = atlas + i * 64 * 64;
+    }
+
+    thr_runjobs(num_jobs, txt_dojob, NULL, jobs, done);
+
+    /* the arrows are drawn with the graphics system, so not in the jobs */
+    for (i = 0; i < num_jobs; i++) {
+        if (done[i] && jobs[i].error == NULL) {
+            drawtxtarrows( (char *)jobs[i].data, jobs[i].txt, 0 );
+            jobs[i].txt->pig->data = jobs[i].data;
+        }
+    }
+
+    checkmem( txtatlases = REALLOC( txtatlases, sizeof(unsigned char *) *
+                                   (num_txtatlases + 1) ) );
+    checkmem( txtatlas_sizes = REALLOC( txtatlas_sizes, sizeof(int) *
+                                       (num_txtatlases + 1) ) );
+    txtatlases[num_txtatlases] = atlas;
+    txtatlas_sizes[num_txtatlases++] = num_jobs * 64 * 64;
+
+    if (init_test & 1) {
+        fprintf(errf, "Decoded %d textures in %.3fs\n", num_jobs,
+                thr_walltime() - start);
+    }
+
+    FREE(done);
+    FREE(jobs);
+}
@@ -7,3 +7,10 @@ void readbitmap(char *dest, struct pig_txt *ptxt, struct ham_txt *txt,
                 int dir);
 int cmp_txts(const void *t1, const void *t2);
 int readcustomtxts(FILE* pg1file);
+void preloadtxts(struct leveldata *ld);
+void freetxtdata(struct pig_txt *t);
+void freetxtcache(void);
+void freetxtimage(FILE *f);
+
+
+extern unsigned long txt_changes;
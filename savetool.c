@@ -23,37 +23,137 @@
 
 extern int init_test;
 extern enum descent loading_level_version;
+extern struct leveldata *loading_level;
 
-struct wall *readwall(FILE *lf, int no) {
-    struct wall *w;
+/* the pool p of the level which is read at the moment */
+#define LOADPOOL(p) (loading_level != NULL ? loading_level->p : NULL)
 
+/* the mine data (points and cubes) is read in one piece and then decoded
+   from memory. All numbers in the file are little endian. */
+int lb_read(struct lvlbuf *b, FILE *f, long size) {
+    long start, end;
 
-    checkmem( w = MALLOC( sizeof(struct wall) ) );
 
-    if (fread(&w->texture1, sizeof(short int), 1, lf) != 1) {
-        FREE(w);
-        return NULL;
+    b->data = NULL;
+    b->size = b->pos = 0;
+
+    if ( ( start = ftell(f) ) < 0 || fseek(f, 0, SEEK_END) ||
+        ( end = ftell(f) ) < start || fseek(f, start, SEEK_SET) ) {
+        return 0;
     }
 
-    if ( (w->texture1 & 0x8000) != 0 ) {
-        if (fread(&w->texture2, sizeof(short int), 1, lf) != 1) {
-            FREE(w);
-            return NULL;
+    if (size <= 0 || size > end - start) {
+        size = end - start;
+    }
+
+    checkmem( b->data = MALLOC(size > 0 ? size : 1) );
+
+    if (fread(b->data, 1, size, f) != size) {
+        FREE(b->data);
+        return 0;
+    }
+
+    b->size = size;
+    return 1;
+}
+
+
+void lb_free(struct lvlbuf *b) {
+    FREE(b->data);
+    b->size = b->pos = 0;
+}
+
+
+int lb_getbytes(struct lvlbuf *b, unsigned char *x, int n) {
+    if (b->pos + n > b->size) {
+        return 0;
+    }
+
+    memcpy(x, b->data + b->pos, n);
+    b->pos += n;
+    return 1;
+}
+
+
+int lb_getshorts(struct lvlbuf *b, unsigned short *x, int n) {
+    int i;
+
+
+    if (b->pos + 2 * n > b->size) {
+        return 0;
+    }
+
+    for (i = 0; i < n; i++, b->pos += 2) {
+        x[i] = le16(b->data + b->pos);
+    }
+
+    return 1;
+}
+
+
+int lb_getlongs(struct lvlbuf *b, unsigned long *x, int n) {
+    int i;
+
+
+    if (b->pos + 4 * n > b->size) {
+        return 0;
+    }
+
+    for (i = 0; i < n; i++, b->pos += 4) {
+        x[i] = le32(b->data + b->pos);
+    }
+
+    return 1;
+}
+
+
+/* read n 32 bit numbers from f. Don't use fread with sizeof(long) for
+   this, long has 64 bits on some systems. */
+int freadlongs(FILE *f, unsigned long *x, int n) {
+    unsigned char b[4];
+    int i;
+
+
+    for (i = 0; i < n; i++) {
+        if (fread(b, 1, 4, f) != 4) {
+            return 0;
         }
 
-        w->txt2_direction = (w->texture2 >> 14) & 3;
-        w->texture2 &= 0x3fff;
+        x[i] = le32(b);
+    }
+
+    return 1;
+}
+
+
+struct wall *readwall(struct lvlbuf *b, int no) {
+    struct wall *w;
+    unsigned short t[2], corners[12];
+    int i;
+
+
+    if ( !lb_getshorts(b, &t[0], 1) ||
+        ( (t[0] & 0x8000) != 0 && !lb_getshorts(b, &t[1], 1) ) ||
+        !lb_getshorts(b, corners, 12) ) {
+        return NULL;
+    }
+
+    checkmem( w = w_poolalloc( LOADPOOL(wallpool), sizeof(struct wall) ) );
+    w->texture1 = t[0] & 0x3fff;
+
+    if ( (t[0] & 0x8000) != 0 ) {
+        w->txt2_direction = (t[1] >> 14) & 3;
+        w->texture2 = t[1] & 0x3fff;
     }
     else {
         w->texture2 = 0;
         w->txt2_direction = 0;
     }
 
-    w->texture1 &= 0x3fff;
-
-    if (fread(&w->corners[0], sizeof(struct corner), 4, lf) != 4) {
-        FREE(w);
-        return NULL;
+    for (i = 0; i < 4; i++) {
+        w->corners[i].x[0] = (short)corners[i * 3];
+        w->corners[i].x[1] = (short)corners[i * 3 + 1];
+        w->corners[i].light = corners[i * 3 + 2];
     }
 
     w->locked = 0;
@@ -583,19 +683,20 @@ struct edoor *readedoors(FILE *f, unsigned long num, unsigned long size) {
 }
 
 
-void *readpnt(FILE *lf) {
-    long int coords[3];
+void *readpnt(struct lvlbuf *b) {
+    unsigned char coords[12];
     struct listpoint *p;
 
 
-    if (fread(coords, sizeof(long int), 3, lf) != 3) {
+    if ( !lb_getbytes(b, coords, 12) ) {
         return NULL;
     }
 
-    checkmem( p = MALLOC( sizeof(struct listpoint) ) );
-    p->p.x[0] = coords[0];
-    p->p.x[1] = coords[1];
-    p->p.x[2] = coords[2];
+    checkmem( p = w_poolalloc( LOADPOOL(pntpool),
+                              sizeof(struct listpoint) ) );
+    p->p.x[0] = sle32(coords);
+    p->p.x[1] = sle32(coords + 4);
+    p->p.x[2] = sle32(coords + 8);
     p->tagged = NULL;
     initlist(&p->c);
 
@@ -727,53 +828,96 @@ void *readchangedlight(FILE *lf) {
 }
 
 
-void *D1_REG_readcube(FILE *lf) {
-    struct cube *c;
+/* read the sides of c which are walls and init the rest of c */
+static void readcubewalls(struct lvlbuf *b, struct cube *c) {
     int j;
-    unsigned char controlbyte;
 
 
-    checkmem( c = MALLOC( sizeof(struct cube) ) );
+    for (j = 0; j < 6; j++) {
+        c->walls[j] = (c->nextcubes[j] == 0xffff || c->doors[j] != 0xff) ?
+                      readwall(b, j) : NULL;
+    }
 
-    if (fread(&controlbyte, sizeof(unsigned char), 1, lf) != 1) {
-        FREE(c);
-        return NULL;
+    initlist(&c->sdoors);
+    initlist(&c->things);
+
+    for (j = 0; j < 8; j++) {
+        c->p[j] = NULL;
     }
 
-    if (init_test & 2) {
-        fprintf(errf, "Read cube (%lx): %x ", ftell(lf),
-                (int)controlbyte);
+    for (j = 0; j < 6; j++) {
+        c->nc[j] = NULL;
+        c->d[j] = NULL;
+        c->tagged_walls[j] = NULL;
     }
 
+    c->cp = NULL;
+}
+
+
+/* read the neighbours (the bits in controlbyte) or the doors (doors!=0) */
+static int readcubesides(struct lvlbuf *b, struct cube *c,
+                         unsigned char controlbyte, int doors) {
+    int j;
+
+
     for (j = 0; j < 6; j++) {
-        if ( ( controlbyte & (1 << j) ) != 0 ) {
-            if (fread(&c->nextcubes[j], sizeof(unsigned short int), 1,
-                      lf) != 1) {
-                FREE(c);
-                return NULL;
+        if (doors) {
+            c->doors[j] = 0xff;
+
+            if ( ( controlbyte & (1 << j) ) != 0 &&
+                !lb_getbytes(b, &c->doors[j], 1) ) {
+                return 0;
             }
         }
         else {
             c->nextcubes[j] = 0xffff;
+
+            if ( ( controlbyte & (1 << j) ) != 0 &&
+                !lb_getshorts(b, &c->nextcubes[j], 1) ) {
+                return 0;
+            }
         }
     }
 
-    if (fread(&c->pts[0], sizeof(short int), 8, lf) != 8) {
-        FREE(c);
+    return 1;
+}
+
+
+void *D1_REG_readcube(struct lvlbuf *b) {
+    struct cube *c;
+    unsigned char controlbyte;
+
+
+    checkmem( c = w_poolalloc( LOADPOOL(cubepool), sizeof(struct cube) ) );
+
+    if ( !lb_getbytes(b, &controlbyte, 1) ) {
+        POOLFREE(c);
+        return NULL;
+    }
+
+    if (init_test & 2) {
+        fprintf(errf, "Read cube (%lx): %x ", b->pos, (int)controlbyte);
+    }
+
+    if ( !readcubesides(b, c, controlbyte, 0) ||
+        !lb_getshorts(b, c->pts, 8) ) {
+        POOLFREE(c);
         return NULL;
     }
 
     if ( ( controlbyte & (1 << 6) ) != 0 ) {
-        if (fread(&c->type, sizeof(char), 4, lf) != 4 || fread(&c->light,
-                                                               sizeof(short),
-                                                               1, lf) != 1) {
-            FREE(c);
+        if ( !lb_getbytes(b, &c->type, 1) ||
+            !lb_getbytes(b, (unsigned char *)&c->prodnum, 1) ||
+            !lb_getbytes(b, &c->value, 1) || !lb_getbytes(b, &c->flags, 1) ||
+            !lb_getshorts(b, &c->light, 1) ) {
+            POOLFREE(c);
             return NULL;
         }
     }
     else {
-        if (fread(&c->light, sizeof(short int), 1, lf) != 1)           {
-            FREE(c);
+        if ( !lb_getshorts(b, &c->light, 1) ) {
+            POOLFREE(c);
             return NULL;
         }
 
@@ -782,8 +926,8 @@ void *D1_REG_readcube(FILE *lf) {
         c->type = 0;
     }
 
-    if (fread(&controlbyte, sizeof(unsigned char), 1, lf) != 1) {
-        FREE(c);
+    if ( !lb_getbytes(b, &controlbyte, 1) ) {
+        POOLFREE(c);
         return NULL;
     }
 
@@ -796,74 +940,36 @@ void *D1_REG_readcube(FILE *lf) {
                 c->pts[7]);
     }
 
-    for (j = 0; j < 6; j++) {
-        if ( ( controlbyte & (1 << j) ) != 0 ) {
-            if (fread(&c->doors[j], sizeof(unsigned char), 1, lf) != 1) {
-                FREE(c);
-                return NULL;
-            }
-        }
-        else {
-            c->doors[j] = 0xff;
-        }
-    }
-
-    for (j = 0; j < 6; j++) {
-        c->walls[j] = (c->nextcubes[j] == 0xffff || c->doors[j] != 0xff) ?
-                      c->walls[j] = readwall(lf, j) : NULL;
-    }
-
-    initlist(&c->sdoors);
-    initlist(&c->things);
-
-    for (j = 0; j < 8; j++) {
-        c->p[j] = NULL;
-    }
-
-    for (j = 0; j < 6; j++) {
-        c->nc[j] = NULL;
-        c->d[j] = NULL;
-        c->tagged_walls[j] = NULL;
+    if ( !readcubesides(b, c, controlbyte, 1) ) {
+        POOLFREE(c);
+        return NULL;
     }
 
-    c->cp = NULL;
+    readcubewalls(b, c);
     return c;
 }
 
 
-void *D2_REG_readcube(FILE *lf) {
+void *D2_REG_readcube(struct lvlbuf *b) {
     struct cube *c;
-    int j;
     unsigned char controlbyte;
 
 
-    checkmem( c = MALLOC( sizeof(struct cube) ) );
+    checkmem( c = w_poolalloc( LOADPOOL(cubepool), sizeof(struct cube) ) );
 
-    if (fread(&controlbyte, sizeof(unsigned char), 1, lf) != 1) {
-        FREE(c);
+    if ( !lb_getbytes(b, &controlbyte, 1) ) {
+        POOLFREE(c);
         return NULL;
     }
 
     if (init_test & 2) {
-        fprintf(errf, "Offset %lx Read cube: %x ",
-                (long int)ftell(lf) - 1, (int)controlbyte);
-    }
-
-    for (j = 0; j < 6; j++) {
-        if ( ( controlbyte & (1 << j) ) != 0 ) {
-            if (fread(&c->nextcubes[j], sizeof(unsigned short int), 1,
-                      lf) != 1) {
-                FREE(c);
-                return NULL;
-            }
-        }
-        else {
-            c->nextcubes[j] = 0xffff;
-        }
+        fprintf(errf, "Offset %lx Read cube: %x ", b->pos - 1,
+                (int)controlbyte);
     }
 
-    if (fread(&c->pts[0], sizeof(short int), 8, lf) != 8) {
-        FREE(c);
+    if ( !readcubesides(b, c, controlbyte, 0) ||
+        !lb_getshorts(b, c->pts, 8) ) {
+        POOLFREE(c);
         return NULL;
     }
 
@@ -872,23 +978,12 @@ void *D2_REG_readcube(FILE *lf) {
     c->type = 0;
     c->light = 0xffff;
 
-    if (fread(&controlbyte, sizeof(unsigned char), 1, lf) != 1) {
-        FREE(c);
+    if ( !lb_getbytes(b, &controlbyte, 1) ||
+        !readcubesides(b, c, controlbyte, 1) ) {
+        POOLFREE(c);
         return NULL;
     }
 
-    for (j = 0; j < 6; j++) {
-        if ( ( controlbyte & (1 << j) ) != 0 ) {
-            if (fread(&c->doors[j], sizeof(unsigned char), 1, lf) != 1) {
-                FREE(c);
-                return NULL;
-            }
-        }
-        else {
-            c->doors[j] = 0xff;
-        }
-    }
-
     if (init_test & 2) {
         fprintf(errf, "%hx %hx %hx %hx %hx %hx\n", c->nextcubes[0],
                 c->nextcubes[1],
@@ -903,47 +998,35 @@ void *D2_REG_readcube(FILE *lf) {
                 c->doors[5]);
     }
 
-    for (j = 0; j < 6; j++) {
-        c->walls[j] = (c->nextcubes[j] == 0xffff || c->doors[j] != 0xff) ?
-                      c->walls[j] = readwall(lf, j) : NULL;
-    }
-
-    initlist(&c->sdoors);
-    initlist(&c->things);
-
-    for (j = 0; j < 8; j++) {
-        c->p[j] = NULL;
-    }
-
-    for (j = 0; j < 6; j++) {
-        c->nc[j] = NULL;
-        c->d[j] = NULL;
-        c->tagged_walls[j] = NULL;
-    }
-
-    c->cp = NULL;
+    readcubewalls(b, c);
     return c;
 }
 
 
-int D2_REG_readcube2(FILE *lf, struct node *n) {
-    int ret;
+int D2_REG_readcube2(struct lvlbuf *b, struct node *n) {
     unsigned long light;
+    struct cube *c = n->d.c;
 
 
-    ret = (fread(n->d.c, 1, 4, lf) == 4 && fread(&light, 4, 1, lf) == 1);
-    n->d.c->light = (light >> 5) & 0x7fff;
+    if ( !lb_getbytes(b, &c->type, 1) ||
+        !lb_getbytes(b, (unsigned char *)&c->prodnum, 1) ||
+        !lb_getbytes(b, &c->value, 1) || !lb_getbytes(b, &c->flags, 1) ||
+        !lb_getlongs(b, &light, 1) ) {
+        return 0;
+    }
+
+    c->light = (light >> 5) & 0x7fff;
 
     if (init_test & 2) {
         fprintf(
             errf,
             "Readcube2 %d: type=%x prodnum=%x value=%x flags=%x light=%lx-->l=%hx\n",
-            n->no, n->d.c->type, n->d.c->prodnum, n->d.c->value,
-            n->d.c->flags,
-            light, n->d.c->light);
+            n->no, c->type, c->prodnum, c->value,
+            c->flags,
+            light, c->light);
     }
 
-    return ret;
+    return 1;
 }
 
 
@@ -1000,15 +1083,37 @@ int readlist(FILE *f, struct list *l, void *(*readdata)(FILE *), int num) {
 }
 
 
+int lb_readlist(struct lvlbuf *b, struct list *l,
+                void *(*readdata)(struct lvlbuf *), int num) {
+    int i;
+    void *d;
+
+
+    for (i = 0; i < num; i++) {
+        if ( ( d = readdata(b) ) == NULL ) {
+            return 0;
+        }
+
+        checkmem( addnode(l, i, d) );
+    }
+
+    return 1;
+}
+
+
 int savepoint(FILE *f, struct node *n, va_list args) {
     struct point *p = n->d.p;
-    long coords[3];
+    unsigned char coords[12];
+    unsigned long x;
+    int i;
+
 
+    for (i = 0; i < 12; i++) {
+        x = (unsigned long)(long)p->x[i / 4];
+        coords[i] = (x >> (i % 4 * 8)) & 0xff;
+    }
 
-    coords[0] = p->x[0];
-    coords[1] = p->x[1];
-    coords[2] = p->x[2];
-    return (fwrite(coords, sizeof(long int), 3, f) == 3);
+    return (fwrite(coords, 1, 12, f) == 12);
 }
 
 
@@ -1417,7 +1522,7 @@ int readasciicube(struct leveldata *ld, FILE *f) {
         return 0;
     }
 
-    checkmem( c = MALLOC( sizeof(struct cube) ) );
+    checkmem( c = w_poolalloc( ld->cubepool, sizeof(struct cube) ) );
 
     for (i = 0; i < 8; i++) {
         for (n = ld->pts.head; n->next != NULL; n = n->next) {
@@ -1428,7 +1533,8 @@ int readasciicube(struct leveldata *ld, FILE *f) {
         }
 
         if (n->next == NULL) {
-            checkmem( lp = MALLOC( sizeof(struct listpoint) ) );
+            checkmem( lp = w_poolalloc( ld->pntpool,
+                                           sizeof(struct listpoint) ) );
             checkmem( n = addnode(&ld->pts, -1, lp) );
             lp->tagged = NULL;
             initlist(&lp->c);
@@ -1443,7 +1549,8 @@ int readasciicube(struct leveldata *ld, FILE *f) {
         c->doors[i] = 0xff;
 
         if (c->nextcubes[i] == 0xffff) {
-            checkmem( c->walls[i] = MALLOC( sizeof(struct wall) ) );
+            checkmem( c->walls[i] = w_poolalloc( ld->wallpool,
+                                                  sizeof(struct wall) ) );
             c->walls[i]->texture1 = t1 & 0x3fff;
             c->walls[i]->texture2 = t2 & 0x3fff;
             c->walls[i]->txt2_direction = (t2 >> 14) & 0x3;
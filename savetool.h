@@ -1,17 +1,30 @@
 /*  DEVIL - Descent Editor for Vertices, Items and Levels at all
     Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
     Further info see .c-files. */
+/* a part of a level file in memory */
+struct lvlbuf {
+    unsigned char *data;
+    long size, pos;
+};
+int lb_read(struct lvlbuf *b, FILE *f, long size);
+void lb_free(struct lvlbuf *b);
+int lb_getbytes(struct lvlbuf *b, unsigned char *x, int n);
+int lb_getshorts(struct lvlbuf *b, unsigned short *x, int n);
+int lb_getlongs(struct lvlbuf *b, unsigned long *x, int n);
+int lb_readlist(struct lvlbuf *b, struct list *l,
+                void *(*readdata)(struct lvlbuf *), int num);
+int freadlongs(FILE *f, unsigned long *x, int n);
 void *readdoor(FILE *f);
 void *D1_REG_readsdoor(FILE *lf);
 void *D2_REG_readsdoor(FILE *lf);
 void *readthing(FILE *lf);
-void *readpnt(FILE *lf);
+void *readpnt(struct lvlbuf *b);
 void *D1_REG_readproducer(FILE *lf);
 void *D2_REG_readproducer(FILE *lf);
-void *D1_REG_readcube(FILE *lf);
-void *D2_REG_readcube(FILE *lf);
+void *D1_REG_readcube(struct lvlbuf *b);
+void *D2_REG_readcube(struct lvlbuf *b);
 void *readflickeringlight(FILE *lf);
-int D2_REG_readcube2(FILE *lf, struct node *c);
+int D2_REG_readcube2(struct lvlbuf *b, struct node *c);
 void *readchangedlight(FILE *lf);
 void *readturnoff(FILE *lf);
 struct edoor *readedoors(FILE *f, unsigned long num, unsigned long size);
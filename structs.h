@@ -412,6 +412,15 @@ struct cube {
     struct list things NONANSI_FLAG;
     struct list fl_lights NONANSI_FLAG; /* list of f.l. lights that affect this
                                         cube */
+    /* for cubegrid.c: the grid the cube is in, the min. and max. cell in
+       this grid and the last query which found this cube */
+    unsigned long grid_id NONANSI_FLAG, grid_query NONANSI_FLAG;
+    int grid_box[6] NONANSI_FLAG;
+    /* for edgetab.c: the table the cube is in and the edges drawn with this
+       cube in the wireframe, the bits are the same as in in_plotcube */
+    unsigned long edges_id NONANSI_FLAG;
+    unsigned short wire_edges NONANSI_FLAG;
+    unsigned char lightdirty NONANSI_FLAG; /* see setlightdirty */
 };
 struct flickering_light {
     short int cube NONANSI_FLAG, wall NONANSI_FLAG;
@@ -434,6 +443,8 @@ struct changedlight {
     unsigned char sub[4] NONANSI_FLAG; /* between 0-32. 32 is dark,0 is bright
                                          */
 };
+/* an effect of a lightsource while the effects are calculated or changed
+   (see getlseffects) */
 struct ls_effect {
     struct node *cube; /* destination cube */
     unsigned short add_light[24];
@@ -442,8 +453,17 @@ struct ls_effect {
 struct lightsource {
     struct node *cube;
     char w; /* source cube and wall */
-    struct list effects; /* list of ls_effects */
     struct flickering_light *fl;
+    struct leveldata *ld; /* the level with the effects */
+    /* the effects are ld->packed_effects[pe_start..pe_start+pe_num-1] */
+    int pe_start, pe_num;
+};
+/* the effect of a lightsource on one cube (see setlseffects) */
+struct packed_effect {
+    struct node *cube;
+    unsigned short add_light[24];
+    unsigned long smoothed; /* bit w*4+c is set if corner c of side w is
+                               smoothed */
 };
 #define NUM_SAVED_POS 12
 struct saved_position {
@@ -477,6 +497,17 @@ struct leveldata {
     struct corridor *cur_corr;
     struct saved_position saved_pos[NUM_SAVED_POS];
     int x_size[2], y_size[2]; /* window size for single&double mode */
+    struct cubegrid *grid; /* to find the cube around a point (cubegrid.c) */
+    struct pvs *pvs; /* the cubes which may be seen from a cube (pvs.c) */
+    unsigned long pvs_changes; /* see pvs_cubeschanged */
+    struct edgetable *edges; /* the edges of the walls (edgetab.c) */
+    /* memory for the list nodes, cubes, walls and points of this level */
+    struct w_pool *nodepool, *cubepool, *wallpool, *pntpool;
+    /* the effects of all lightsources in one array (see setlseffects).
+       num_unused_effects of the num_packed_effects belong to no
+       lightsource, the array has room for max_packed_effects */
+    struct packed_effect *packed_effects;
+    int num_packed_effects, num_unused_effects, max_packed_effects;
 };
 struct objtype {
     int no;
@@ -19,6 +19,7 @@
 #include "structs.h"
 #include "userio.h"
 #include "plot.h"
+#include "in_plot.h"
 #include "calctxt.h"
 #include "options.h"
 #include "tools.h"
@@ -391,21 +392,50 @@ int tag_testfunc(int lr, struct point *p, int x1, int y1, int x2,
 }
 
 
+/* like tag_testfunc for the view coords v (see vc_getpnt) of a point in
+   the current view */
+static int tag_testview(float *v, int x1, int y1, int x2, int y2) {
+    struct pixel pix;
+
+
+    if (!in_getviewpixelcoords(v, &pix) || pix.d > view.maxvisibility * 1.1) {
+        return 0;
+    }
+
+    return (pix.x >= x1 && pix.x <= x2 && pix.y >= y1 && pix.y <= y2);
+}
+
+
+/* like tag_testview for the point in node np */
+static int tag_testpnt(struct viewcache *vc, struct node *np, int x1,
+                       int y1, int x2, int y2)
+{
+    float v[4];
+
+
+    vc_getpnt(vc, np, v);
+    return tag_testview(v, x1, y1, x2, y2);
+}
+
+
 void tagbox(int lr, int dx1, int dy1, int dx2, int dy2, int op) {
     struct node *n;
+    struct viewcache *vc;
     int i, j, k;
-    struct point c, p;
+    float c[3], p[3], v[4][4];
 
 
     my_assert(l != NULL);
+    makeview(lr);
+    vc = vc_get();
 
     switch (view.currmode) {
         case tt_cube:
 
             for (n = l->cubes.head; n->next != NULL; n = n->next) {
                 for (i = 0; i < 8; i++) {
-                    if ( !tag_testfunc(lr, n->d.c->p[i]->d.p, dx1, dy1, dx2,
-                                       dy2) ) {
+                    if ( !tag_testpnt(vc, n->d.c->p[i], dx1, dy1, dx2,
+                                      dy2) ) {
                         break;
                     }
                 }
@@ -427,8 +457,8 @@ void tagbox(int lr, int dx1, int dy1, int dx2, int dy2, int op) {
             for (n = l->cubes.head; n->next != NULL; n = n->next) {
                 for (j = 0; j < 6; j++) {
                     for (i = 0; i < 4; i++) {
-                        if ( !tag_testfunc(lr, n->d.c->p[wallpts[j][i]]->d.p,
-                                           dx1, dy1, dx2, dy2) ) {
+                        if ( !tag_testpnt(vc, n->d.c->p[wallpts[j][i]], dx1,
+                                          dy1, dx2, dy2) ) {
                             break;
                         }
                     }
@@ -450,25 +480,25 @@ void tagbox(int lr, int dx1, int dy1, int dx2, int dy2, int op) {
 
             for (n = l->cubes.head; n->next != NULL; n = n->next) {
                 for (j = 0; j < 6; j++) {
+                    for (i = 0; i < 4; i++) {
+                        vc_getpnt(vc, n->d.c->p[wallpts[j][i]], v[i]);
+                    }
+
                     for (k = 0; k < 3; k++) {
-                        c.x[k] = 0.0;
+                        c[k] = 0.0;
 
                         for (i = 0; i < 4; i++) {
-                            c.x[k] += n->d.c->p[wallpts[j][i]]->d.p->x[k] /
-                                      4.0;
+                            c[k] += v[i][k] / 4.0;
                         }
                     }
 
                     for (i = 0; i < 4; i++) {
                         for (k = 0; k < 3; k++) {
-                            p.x[k] = c.x[k] * 0.4 +
-                                     n->d.c->p[wallpts[j][i]]->d.p->x[k] *
-                                     0.6;
+                            p[k] = c[k] * 0.4 + v[i][k] * 0.6;
                         }
 
-                        if ( tag_testfunc(lr, &p, dx1, dy1, dx2, dy2)
-                           && tag_testfunc(lr, n->d.c->p[wallpts[j][i]]->d.p,
-                                           dx1, dy1, dx2, dy2) ) {
+                        if ( tag_testview(p, dx1, dy1, dx2, dy2)
+                           && tag_testview(v[i], dx1, dy1, dx2, dy2) ) {
                             if (op) {
                                 tag(view.currmode, n, j, i);
                             }
@@ -485,7 +515,7 @@ void tagbox(int lr, int dx1, int dy1, int dx2, int dy2, int op) {
         case tt_pnt:
 
             for (n = l->pts.head; n->next != NULL; n = n->next) {
-                if ( tag_testfunc(lr, n->d.p, dx1, dy1, dx2, dy2) ) {
+                if ( tag_testpnt(vc, n, dx1, dy1, dx2, dy2) ) {
                     if (op) {
                         tag(view.currmode, n);
                     }
@@ -717,13 +747,13 @@ void tagfilter(struct infoitem *i, int op, void *data) {
 
     my_assert(i != NULL && data != NULL);
 
-    if (i->tagnr >= tt_number) {
+    if ( (int)i->tagnr >= tt_number ) {
         return;
     }
 
     if (i->type == it_cubelight || i->type == it_sidelight || i->type ==
         it_thingcoord
-       || i->tagnr == tt_pnt || i->tagnr == tt_edge) {
+       || (int)i->tagnr == tt_pnt || (int)i->tagnr == tt_edge) {
         printmsg(TXT_CANTUSETAGFILTER);
         return;
     }
@@ -732,7 +762,7 @@ void tagfilter(struct infoitem *i, int op, void *data) {
         case tt_cube:
         case tt_door:
 
-            for (n = i->tagnr == tt_cube ? l->cubes.head : l->doors.head,
+            for (n = (int)i->tagnr == tt_cube ? l->cubes.head : l->doors.head,
                  found = tagged = 0;
                  n->next != NULL; n = n->next) {
                 if ( comp_tagfilter(i, getdata(i->infonr, n), data) ) {
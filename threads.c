@@ -0,0 +1,175 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    threads.c - running independent jobs on several processors
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "lac_cfg.h"
+#include "threads.h"
+
+#define MAX_THREADS 64
+
+struct thr_jobs {
+    pthread_mutex_t lock;
+    thr_jobfunc *job;
+    void *data;
+    unsigned char *done;
+    int num_jobs, next_job, num_done, abort;
+};
+
+/* see thr_lock */
+static pthread_mutex_t thr_sharedlock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* the elapsed real time in seconds (clock() would count the time of all
+   threads) */
+double thr_walltime(void) {
+    struct timespec ts;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* the number of threads (including the main thread) which should work on
+   jobs. If it is not set in devilx.ini, one for every processor */
+int thr_numthreads(void) {
+    long n = theNumThreads;
+
+
+    if (n <= 0) {
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    return n < 1 ? 1 : (n > MAX_THREADS ? MAX_THREADS : n);
+}
+
+
+/* get the next job or -1 if all jobs are started. Job 'finished' is marked
+   as done (if it's >=0) */
+static int thr_nextjob(struct thr_jobs *j, int finished) {
+    int job;
+
+
+    pthread_mutex_lock(&j->lock);
+
+    if (finished >= 0) {
+        j->num_done++;
+
+        if (j->done) {
+            j->done[finished] = 1;
+        }
+    }
+
+    job = (j->abort || j->next_job >= j->num_jobs) ? -1 : j->next_job++;
+    pthread_mutex_unlock(&j->lock);
+    return job;
+}
+
+
+static void *thr_worker(void *data) {
+    struct thr_jobs *j = data;
+    int job;
+
+
+    for (job = thr_nextjob(j, -1); job >= 0; job = thr_nextjob(j, job)) {
+        j->job(j->data, job);
+    }
+
+    return NULL;
+}
+
+
+/* run the jobs 0..num_jobs-1 with the function job. The jobs must not
+   depend on each other and must not call any wins-functions, because they
+   run in parallel. The main thread works on the jobs too and calls poll
+   (if !=NULL) between two of its jobs. If done!=NULL, done[job] is set to 1
+   for every finished job (the rest is set to 0). Returns the number of
+   finished jobs which is num_jobs if poll didn't abort. */
+int thr_runjobs(int num_jobs, thr_jobfunc *job, thr_pollfunc *poll,
+                void *data, unsigned char *done)
+{
+    struct thr_jobs j;
+    pthread_t threads[MAX_THREADS];
+    int i, num_threads, n;
+
+
+    j.job = job;
+    j.data = data;
+    j.done = done;
+    j.num_jobs = num_jobs;
+    j.next_job = j.num_done = j.abort = 0;
+
+    for (i = 0; done && i < num_jobs; i++) {
+        done[i] = 0;
+    }
+
+    if ( pthread_mutex_init(&j.lock, NULL) != 0 ) {
+        return 0;
+    }
+
+    num_threads = thr_numthreads();
+
+    if (num_threads > num_jobs) {
+        num_threads = num_jobs;
+    }
+
+    /* if a thread can't be started the rest is done by the others */
+    for (i = 1; i < num_threads; i++) {
+        if ( pthread_create(&threads[i], NULL, thr_worker, &j) != 0 ) {
+            break;
+        }
+    }
+
+    num_threads = i;
+
+    for (n = thr_nextjob(&j, -1); n >= 0; n = thr_nextjob(&j, n)) {
+        job(data, n);
+
+        if ( poll && !poll(data, j.num_done) ) {
+            pthread_mutex_lock(&j.lock);
+            j.abort = 1;
+            pthread_mutex_unlock(&j.lock);
+        }
+    }
+
+    for (i = 1; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&j.lock);
+    return j.num_done;
+}
+
+
+/* jobs which use data shared with other jobs (for example caches) must
+   use it between thr_lock and thr_unlock. There's only one lock for all
+   data, so it should be held only for short times. */
+void thr_lock(void) {
+    pthread_mutex_lock(&thr_sharedlock);
+}
+
+
+void thr_unlock(void) {
+    pthread_mutex_unlock(&thr_sharedlock);
+}
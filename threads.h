@@ -0,0 +1,17 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+    Further info see .c-files. */
+
+/* a job function gets the data pointer given to thr_runjobs and the
+   number of the job (0..num_jobs-1) */
+typedef void thr_jobfunc(void *data, int job);
+/* called from the main thread between two jobs with the number of finished
+   jobs. Return 0 to abort (jobs not started yet are skipped then). */
+typedef int thr_pollfunc(void *data, int done);
+
+double thr_walltime(void);
+int thr_numthreads(void);
+int thr_runjobs(int num_jobs, thr_jobfunc *job, thr_pollfunc *poll,
+                void *data, unsigned char *done);
+void thr_lock(void);
+void thr_unlock(void);
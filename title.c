@@ -18,6 +18,14 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
 
 #include "structs.h"
+#ifdef HEADLESS
+/* there is no screen to show the title on */
+int titlescreen(void) {
+    return 0;
+}
+
+
+#else
 #include <grx20.h>
 #include <gif_lib.h>
 
@@ -140,3 +148,4 @@ int titlescreen(void) {
 }
 
 
+#endif
@@ -23,6 +23,8 @@
 #include "tag.h"
 #include "insert.h"
 #include "tools.h"
+#include "cubegrid.h"
+#include "do_light.h"
 
 char *makepath(const char *path, const char *fname) {
     char *lp;
@@ -292,18 +294,8 @@ int checkpntcube(struct node *nc, struct point *p) {
 
 
 /* find cube around position p. if there's no cube, return NULL */
-struct node *findpntcube(struct list *cl, struct point *p) {
-    struct node *n;
-
-
-    /* this is certainly not the fastest method doing this */
-    for (n = cl->head; n->next != NULL; n = n->next) {
-        if ( checkpntcube(n, p) ) {
-            return n;
-        }
-    }
-
-    return NULL;
+struct node *findpntcube(struct leveldata *ld, struct point *p) {
+    return cg_findpntcube(ld, p);
 }
 
 
@@ -419,7 +411,7 @@ void setthingcube(struct thing *t) {
 
     /* still no cube found? then brute force: Check all cubes */
     if (!t->nc) {
-        t->nc = findpntcube(&l->cubes, &t->p[0]);
+        t->nc = findpntcube(l, &t->p[0]);
     }
 
     /* if the thing is in a new cube add it to the list */
@@ -1011,7 +1003,7 @@ void freecube(void *n) {
 
     for (w = 0; w < 6; w++) {
         if (c->walls[w])                  {
-            FREE(c->walls[w]);
+            POOLFREE(c->walls[w]);
         }
 
         if (c->polygons[w * 2]) {
@@ -1024,7 +1016,7 @@ void freecube(void *n) {
     }
 
     freelist(&c->sdoors, NULL);
-    FREE(c);
+    POOLFREE(c);
 }
 
 
@@ -1042,46 +1034,26 @@ void freelistpnt(void *n) {
 
 
     freelist(&lp->c, NULL);
-    FREE(lp);
+    POOLFREE(lp);
 }
 
 
 void freelightsource(void *n) {
     struct lightsource *ls = n;
-    struct node *nlse;
-    int w, c;
-    long overflow;
 
 
     if (ls->fl) {
         delflickeringlight(ls);
     }
 
-    for (nlse = ls->effects.head->next; nlse != NULL; nlse = nlse->next) {
-        for (w = 0; w < 6; w++) {
-            if (nlse->prev->d.lse->cube->d.c->walls[w]) {
-                for (c = 0; c < 4; c++) {
-                    overflow =
-                        nlse->prev->d.lse->cube->d.c->walls[w]->corners[c].
-                        light -
-                        nlse->prev->d.lse->add_light[w * 4 + c];
-                    nlse->prev->d.lse->cube->d.c->walls[w]->corners[c].light
-                    =
-                        overflow <
-                        view.illum_minvalue ? view.illum_minvalue : overflow;
-                }
-            }
-        }
-
-        freenode(&ls->effects, nlse->prev, free);
-    }
-
+    removelseffects(ls);
     FREE(ls);
 }
 
 
 void freelist( struct list *l, void (*freeentry)(void *) ) {
     struct node *n;
+    struct w_pool *pool = l->pool;
 
 
     for (n = l->head->next; n != NULL; n = n->next) {
@@ -1089,7 +1061,9 @@ void freelist( struct list *l, void (*freeentry)(void *) ) {
     }
 
     l->size = 0;
+    unindexlist(l);
     initlist(l);
+    l->pool = pool;
 }
 
 
@@ -1100,7 +1074,7 @@ void freenode( struct list *l, struct node *n, void (*freeentry)(void *) ) {
         freeentry(n->d.v);
     }
 
-    FREE(n);
+    POOLFREE(n);
 }
 
 
@@ -1109,12 +1083,23 @@ void sortlist(struct list *l, int start) {
     int i;
 
 
+    /* the index keeps track of the numbering, so don't renumber lists
+       which are already in order */
+    if (l->index != NULL && l->ordered == start) {
+        return;
+    }
+
     for (n = l->head, i = 0; n->next != NULL; n = n->next, i++) {
         n->no = start + i;
     }
 
     l->size = i;
     l->maxnum = i + start;
+    l->ordered = start;
+
+    if (l->index != NULL) {
+        indexlist(l);
+    }
 }
 
 
@@ -1179,6 +1164,26 @@ int qs_compstrs(const void *s1, const void *s2) {
 }
 
 
+/* little endian numbers as they are in the Descent files */
+unsigned short le16(const unsigned char *p) {
+    return p[0] | (p[1] << 8);
+}
+
+
+unsigned long le32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | ( (unsigned long)p[2] << 16 ) |
+           ( (unsigned long)p[3] << 24 );
+}
+
+
+long sle32(const unsigned char *p) {
+    unsigned long x = le32(p);
+
+
+    return (x & 0x80000000UL) ? -(long)(~x & 0x7fffffffUL) - 1 : (long)x;
+}
+
+
 int isbinary(int x) {
     return x == '0' || x == '1';
 }
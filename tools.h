@@ -39,9 +39,12 @@ void makemarker(struct point *mp, struct point *np);
 void make_o_marker(struct point *offset, struct point *coords, float size,
                    struct point *pnts);
 int checkpntcube(struct node *nc, struct point *p);
-struct node *findpntcube(struct list *cubelist, struct point *p);
+struct node *findpntcube(struct leveldata *ld, struct point *p);
 enum sdoortypes getsdoortype(struct sdoor *sd);
 void setsdoortargets(struct sdoor *sd);
 int qs_compstrs(const void *s1, const void *s2);
 int compstrs(const char *s1, const char *s2);
 int isbinary(int x);
+unsigned short le16(const unsigned char *p);
+unsigned long le32(const unsigned char *p);
+long sle32(const unsigned char *p);
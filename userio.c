@@ -19,19 +19,31 @@
 #include "structs.h"
 #include "tools.h"
 #include "userio.h"
+#include "hogfile.h"
 
 #define MAX_MSNNAME_LEN 21
 #define FIRSTHOGFILE "DESCENT.TXB"
 #define MSNEXT (init.d_ver >= d2_10_sw ? "MN2" : "MSN")
 
+#ifdef HEADLESS
+unsigned long userio_questions; /* the messages which needed an answer */
+#endif
+
 int vprintmsg(const char *txt, va_list args, int wait) {
     char buffer[10240];
 
 
     vsprintf(buffer, txt, args);
+#ifdef HEADLESS
+    /* nobody to ask, so print it and take the first answer */
+    fprintf(errf, "%s\n", buffer);
+    userio_questions += (wait != 0);
+    return 1;
+#else
     return w_okcancel(buffer, wait ? TXT_OK : NULL, wait >
                       1 ? TXT_CANCEL : NULL,
                       NULL);
+#endif
 }
 
 
@@ -733,65 +745,44 @@ struct hoglevel {
     char name[14], fullpath[256];
     unsigned long pos, size;
     int secret;
+    int entry; /* in the hog-file or -1 if it's not in the hog-file */
 };
 
-/* Return all levels in 'hogfile'. The result is stored in hognames,
+/* Return all levels in the hog-file h. The result is stored in hognames,
    mem etc. is reserved by this function. Returned is the number of levels
    (negative if the hog-file is the original Descent.hog) */
-int uio_getallhoglevels(FILE *hogfile, struct hoglevel ***hognames) {
-    char signature[4], name[14];
-    unsigned long size;
-    int hognum = 0, i, origdescent = 0;
+int uio_getallhoglevels(struct hog_file *h, struct hoglevel ***hognames) {
+    struct hog_entry *e;
+    int hognum = 0, i;
 
 
     *hognames = NULL;
 
-    if (fread(signature, 1, 3, hogfile) != 3) {
-        waitmsg(TXT_NOHOGSIGNATURE);
-        return 0;
+    for (i = 0, e = h->entries; i < h->num_entries; i++, e++) {
+        hognum += strlen(e->name) >= 5 &&
+                  strstr(init.alllevelexts, &e->name[strlen(e->name) - 3]) !=
+                  NULL;
     }
 
-    signature[3] = 0;
-
-    if ( strcmp(signature, "DHF") ) {
-        waitmsg(TXT_NOHOGSIGNATURE);
-        return 0;
+    if (hognum > 0) {
+        checkmem( *hognames = MALLOC(sizeof(struct hoglevel *) * hognum) );
     }
 
-    while (fread(name, 1, 13, hogfile) == 13) {
-        name[13] = 0;
-
-        for (i = 0; i < strlen(name); i++) {
-            name[i] = toupper(name[i]);
-        }
-
-        if (strcmp(name, FIRSTHOGFILE) == 0) {
-            origdescent = 1;
-        }
-
-        if (fread(&size, 4, 1, hogfile) != 1) {
-            break;
-        }
-
-        if (strlen(name) >= 5 &&
-            strstr(init.alllevelexts, &name[strlen(name) - 3]) != NULL) {
-            checkmem( *hognames =
-                         REALLOC( *hognames, sizeof(struct hoglevel *)*
-                                 (++hognum) ) );
-            checkmem( (*hognames)[hognum -
-                                  1] = MALLOC( sizeof(struct hoglevel) ) );
-            strcpy( (*hognames)[hognum - 1]->name, name );
-            (*hognames)[hognum - 1]->pos = ftell(hogfile);
-            (*hognames)[hognum - 1]->size = size;
-            (*hognames)[hognum - 1]->secret = 0;
-        }
-
-        if ( fseek(hogfile, size, SEEK_CUR) ) {
-            break;
+    for (i = 0, e = h->entries, hognum = 0; i < h->num_entries; i++, e++) {
+        if (strlen(e->name) >= 5 &&
+            strstr(init.alllevelexts, &e->name[strlen(e->name) - 3]) != NULL) {
+            checkmem( (*hognames)[hognum] =
+                         MALLOC( sizeof(struct hoglevel) ) );
+            strcpy( (*hognames)[hognum]->name, e->name );
+            (*hognames)[hognum]->pos = e->pos;
+            (*hognames)[hognum]->size = e->size;
+            (*hognames)[hognum]->secret = 0;
+            (*hognames)[hognum]->entry = i;
+            hognum++;
         }
     }
 
-    return origdescent ? -hognum : hognum;
+    return hog_find(h, FIRSTHOGFILE) >= 0 ? -hognum : hognum;
 }
 
 
@@ -970,6 +961,7 @@ void uio_hogfile_addlev(struct w_button *b, int secret) {
             strcpy(hoglev_arr[startlev]->name, bf->strings[i]);
             hoglev_arr[startlev]->pos = hoglev_arr[startlev]->size = 0;
             hoglev_arr[startlev]->secret = secret;
+            hoglev_arr[startlev]->entry = -1;
             strcpy(hoglev_arr[startlev]->fullpath, current_path);
             strcat(hoglev_arr[startlev]->fullpath, "/");
             strcat(hoglev_arr[startlev]->fullpath, bf->strings[i]);
@@ -1015,9 +1007,10 @@ void uio_hogfile_secret(struct w_button *b) {
 void uio_hogfile_extract(struct w_button *b) {
     struct w_b_strlist *bh = ( (struct w_button **)b->data )[11]->d.sls,
     *bf = ( (struct w_button **)b->data )[5]->d.sls;
-    char fullpath[255], *levdat;
-    int i;
+    char fullpath[255];
+    int i, ok;
     FILE *f;
+    struct hog_file *h = NULL;
 
 
     for (i = 0; i < bh->no_strings; i++) {
@@ -1032,6 +1025,7 @@ void uio_hogfile_extract(struct w_button *b) {
                             "rb") ) != NULL &&
                 !yesnomsg(TXT_OVERWRITEFILE, fullpath) ) {
                 fclose(f);
+                hog_close(h);
                 return;
             }
 
@@ -1039,50 +1033,37 @@ void uio_hogfile_extract(struct w_button *b) {
                 fclose(f);
             }
 
-            if ( ( f = fopen(hogfilename, "rb") ) == NULL ) {
+            if ( h == NULL && ( h = hog_open(hogfilename) ) == NULL ) {
                 waitmsg(TXT_CANTOPENHOGFILE, hogfilename);
                 return;
             }
 
-            if ( fseek(f, hoglev_arr[i]->pos, SEEK_SET) ) {
+            if (hoglev_arr[i]->pos + hoglev_arr[i]->size > h->size) {
                 waitmsg(TXT_CANTFINDLEVINHOG, hoglev_arr[i]->name,
                         hogfilename);
-                fclose(f);
+                hog_close(h);
                 return;
             }
 
-            checkmem( levdat = MALLOC(hoglev_arr[i]->size) );
-
-            if (fread(levdat, 1, hoglev_arr[i]->size,
-                      f) != hoglev_arr[i]->size) {
-                waitmsg(TXT_CANTFINDLEVINHOG, hoglev_arr[i]->name,
-                        hogfilename);
-                fclose(f);
-                FREE(levdat);
-                return;
-            }
-
-            fclose(f);
-
             if ( ( f = fopen(fullpath, "wb") ) == NULL ) {
                 waitmsg(TXT_CANTWRITEHOGLEV, hoglev_arr[i]->name, fullpath);
-                FREE(levdat);
+                hog_close(h);
                 return;
             }
 
-            if (fwrite(levdat, 1, hoglev_arr[i]->size,
-                       f) != hoglev_arr[i]->size) {
+            ok = hog_copytofile(f, h->fd, hoglev_arr[i]->pos,
+                                hoglev_arr[i]->size);
+
+            if (fclose(f) != 0 || !ok) {
                 waitmsg(TXT_CANTWRITEHOGLEV, hoglev_arr[i]->name, fullpath);
-                FREE(levdat);
-                fclose(f);
+                hog_close(h);
                 return;
             }
-
-            FREE(levdat);
-            fclose(f);
         }
     }
 
+    hog_close(h);
+
     for (i = 0; i < bf->no_strings; i++) {
         FREE(bf->strings[i]);
     }
@@ -1106,10 +1087,11 @@ void uio_hogfile_extract(struct w_button *b) {
 
 
 void uio_hogfile_write(struct w_button *b) {
-    int i, j, samefile = 0, num_secrets;
-    FILE *sf = NULL, *df, *lf, *mf;
-    char *newhogname, *levdat = NULL, msnfname[256], buffer[1024], ext[4];
+    int i, samefile = 0, num_secrets, ok;
+    FILE *df, *mf;
+    char *newhogname, msnfname[256], buffer[1024], ext[4];
     struct w_button **b_arr = b->data;
+    struct hog_file *sh = NULL;
 
 
     if (hoglevnum <= 0) {
@@ -1196,7 +1178,7 @@ void uio_hogfile_write(struct w_button *b) {
         if (hoglev_arr[i]->size > 0) {
             my_assert(hogfilename != NULL);
 
-            if (sf == NULL && ( sf = fopen(hogfilename, "rb") ) == NULL) {
+            if ( sh == NULL && ( sh = hog_open(hogfilename) ) == NULL ) {
                 waitmsg(TXT_CANTOPENHOGFILE, hogfilename);
                 fclose(df);
                 FREE(newhogname);
@@ -1204,86 +1186,42 @@ void uio_hogfile_write(struct w_button *b) {
                 return;
             }
 
-            if ( fseek(sf, hoglev_arr[i]->pos, SEEK_SET) ) {
+            if (hoglev_arr[i]->pos + hoglev_arr[i]->size > sh->size) {
                 waitmsg(TXT_CANTFINDLEVINHOG, hoglev_arr[i]->name,
                         hogfilename);
+                continue;
             }
-            else {
-                checkmem( levdat = MALLOC(hoglev_arr[i]->size) );
-
-                if (fread(levdat, 1, hoglev_arr[i]->size,
-                          sf) != hoglev_arr[i]->size) {
-                    waitmsg(TXT_CANTREADLEVFROMHOG, hoglev_arr[i]->name,
-                            hogfilename);
-                    FREE(levdat);
-                    levdat = NULL;
-                }
-            }
+
+            /* the data is copied without reading it */
+            ok = hog_writeentry(df, hoglev_arr[i]->name, sh->fd,
+                                hoglev_arr[i]->pos, hoglev_arr[i]->size);
         }
         else {
             my_assert(hoglev_arr[i]->fullpath);
 
-            if ( ( lf = fopen(hoglev_arr[i]->fullpath, "rb") ) == NULL ) {
+            if ( ( ok = hog_writefile(df, hoglev_arr[i]->name,
+                                      hoglev_arr[i]->fullpath) ) < 0 ) {
                 waitmsg(TXT_CANTREADLEVEL, hoglev_arr[i]->fullpath);
-            }
-            else {
-                if ( fseek(lf, 0, SEEK_END) ) {
-                    waitmsg(TXT_CANTREADLEVEL, hoglev_arr[i]->fullpath);
-                }
-                else {
-                    hoglev_arr[i]->size = ftell(lf);
-
-                    if ( fseek(lf, 0, SEEK_SET) ) {
-                        waitmsg(TXT_CANTREADLEVEL, hoglev_arr[i]->fullpath);
-                    }
-                    else {
-                        checkmem( levdat = MALLOC(hoglev_arr[i]->size) );
-
-                        if (fread(levdat, 1, hoglev_arr[i]->size,
-                                  lf) != hoglev_arr[i]->size) {
-                            waitmsg(TXT_CANTREADLEVEL,
-                                    hoglev_arr[i]->fullpath);
-                            FREE(levdat);
-                            levdat = NULL;
-                        }
-                    }
-                }
-
-                fclose(lf);
+                continue;
             }
         }
 
-        if (levdat) {
-            for (j = strlen(hoglev_arr[i]->name) + 1; j < 13; j++) {
-                hoglev_arr[i]->name[j] = 0;
-            }
-
-            if (fwrite(hoglev_arr[i]->name, 1, 13, df) != 13
-               || fwrite(&hoglev_arr[i]->size, 4, 1, df) != 1
-               || fwrite(levdat, 1, hoglev_arr[i]->size,
-                         df) != hoglev_arr[i]->size) {
-                waitmsg(TXT_CANTWRITEHOGLEV, hoglev_arr[i]->name, newhogname);
-            }
-
-            FREE(levdat);
-            levdat = NULL;
+        if (!ok) {
+            waitmsg(TXT_CANTWRITEHOGLEV, hoglev_arr[i]->name, newhogname);
+        }
 
-            if (hoglev_arr[i]->secret) {
-                fprintf(mf, "%s,%.2d\n", hoglev_arr[i]->name,
-                        hoglev_arr[i]->secret);
-            }
-            else {
-                fprintf(mf, "%s\n", hoglev_arr[i]->name);
-            }
+        if (hoglev_arr[i]->secret) {
+            fprintf(mf, "%s,%.2d\n", hoglev_arr[i]->name,
+                    hoglev_arr[i]->secret);
+        }
+        else {
+            fprintf(mf, "%s\n", hoglev_arr[i]->name);
         }
     }
 
     fclose(df);
     fclose(mf);
-
-    if (sf) {
-        fclose(sf);
-    }
+    hog_close(sh);
 
     if (samefile) {
         remove(hogfilename);
@@ -1297,9 +1235,11 @@ void uio_hogfile_write(struct w_button *b) {
 void uio_hogfile_read(struct w_button *b) {
     struct w_button **b_arr = b->data;
     FILE *f;
-    int origdescent = 0, i, equal, levnum, secret_num, nomsnfile = 0;
+    int origdescent = 0, i, equal, levnum, secret_num, nomsnfile = 0,
+        *where;
     char *newhogname, msnname[256], buffer[1024], ext[4], *start, *pos;
     struct hoglevel *swap;
+    struct hog_file *h;
 
 
     strcpy(buffer, current_path);
@@ -1325,15 +1265,13 @@ void uio_hogfile_read(struct w_button *b) {
     hoglevnum = 0;
     hoglev_arr = NULL;
 
-    if ( ( f = fopen(hogfilename, "rb") ) != NULL ) {
-        hoglevnum = uio_getallhoglevels(f, &hoglev_arr);
+    if ( ( h = hog_open(hogfilename) ) != NULL ) {
+        hoglevnum = uio_getallhoglevels(h, &hoglev_arr);
 
         if (hoglevnum < 0) {
             origdescent = 1;
             hoglevnum = -hoglevnum;
         }
-
-        fclose(f);
     }
 
     if (hoglevnum > 0) {
@@ -1344,6 +1282,16 @@ void uio_hogfile_read(struct w_button *b) {
         strcpy(msnname, hogfilename);
         strcpy(&msnname[strlen(msnname) - 3], MSNEXT);
         levnum = 0;
+        /* where the entries of the hog-file are in hoglev_arr */
+        checkmem( where = MALLOC(sizeof(int) * h->num_entries) );
+
+        for (i = 0; i < h->num_entries; i++) {
+            where[i] = -1;
+        }
+
+        for (i = 0; i < hoglevnum; i++) {
+            where[hoglev_arr[i]->entry] = i;
+        }
 
         if ( ( f = fopen(msnname, "r") ) != NULL ) {
             while (fscanf(f, "\n%[^\n]", buffer) == 1) {
@@ -1406,17 +1354,16 @@ void uio_hogfile_read(struct w_button *b) {
                         secret_num = 0;
                     }
 
-                    for (i = 0; i < hoglevnum; i++) {
-                        if (strcmp(hoglev_arr[i]->name, start) == 0) {
-                            break;
-                        }
-                    }
+                    i = hog_find(h, start);
 
-                    if (i < hoglevnum) {
+                    if ( i >= 0 && ( i = where[i] ) >= 0 ) {
                         swap = hoglev_arr[levnum];
-                        hoglev_arr[levnum++] = hoglev_arr[i];
+                        hoglev_arr[levnum] = hoglev_arr[i];
                         hoglev_arr[i] = swap;
                         hoglev_arr[i]->secret = secret_num;
+                        where[hoglev_arr[i]->entry] = i;
+                        where[hoglev_arr[levnum]->entry] = levnum;
+                        levnum++;
                     }
                 }
             }
@@ -1426,8 +1373,11 @@ void uio_hogfile_read(struct w_button *b) {
         else {
             nomsnfile = 1;
         }
+
+        FREE(where);
     }
 
+    hog_close(h);
     uio_rebuild_hoglist(b_arr[11], 0);
 
     if (nomsnfile && !origdescent) {
@@ -13,3 +13,6 @@ char *getfilename(char **path, const char *defname, const char *ext,
                   const char *title,
                   int overwrite_warning);
 void hogfilemanager(void);
+#ifdef HEADLESS
+extern unsigned long userio_questions;
+#endif
@@ -184,7 +184,7 @@ void w_wintofront(struct w_window *w) {
                           bm->ysize,
                           1);
             ws_freebitmap(bm);
-            FREE(n->next);
+            POOLFREE(n->next);
         }
     }
 
@@ -283,7 +283,7 @@ void w_changewintitle(struct w_window *w, char *s) {
     for (n = wi->buttonlist.head, b = NULL;
          n->next != NULL && n->d.w_b->sys_button;
          n = n->next) {
-        if ( (int)n->d.w_b->b.data == 1 ) {
+        if ( (long)n->d.w_b->b.data == 1 ) {
             b = n->d.w_b;
             break;
         }
@@ -0,0 +1,316 @@
+/*  DEVIL - Descent Editor for Vertices, Items and Levels at all
+    Wins: A Grfx-Windows system for DOS.
+    w_headless.c - the display routines of w_system.c without display
+    Copyright (C) 1995  Achim Stremplat (ubdb@rz.uni-karlsruhe.de)
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program (file COPYING); if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA. */
+
+/* Only compiled with -DHEADLESS (see rbench in the Makefile). The bitmaps
+   are plain memory, everything drawn to the screen is thrown away and
+   there are never any events. So the editor can run without GRX, e.g. to
+   render levels in the offscreen drawbuffer. */
+#include <string.h>
+#include "wins_int.h"
+
+#define CHAR_WIDTH 8
+
+/* what ws_bitmap.bitmap points to */
+struct hl_bitmap {
+    char *data;
+    int own; /* data was allocated by ws_createbitmap */
+};
+
+static unsigned char palette[256][3];
+
+
+int ws_initgrfx(int xres, int yres, int colors, const char *fontname) {
+    return 1;
+}
+
+
+void ws_setcolor(int i, int r, int g, int b) {
+    palette[i & 0xff][0] = r;
+    palette[i & 0xff][1] = g;
+    palette[i & 0xff][2] = b;
+}
+
+
+void ws_resetmousecolors(void) {
+}
+
+
+void ws_getcolor(int i, int *r, int *g, int *b) {
+    *r = palette[i & 0xff][0];
+    *g = palette[i & 0xff][1];
+    *b = palette[i & 0xff][2];
+}
+
+
+/* the color in the palette which is nearest to r,g,b */
+GrColor ws_makecolor(int r, int g, int b) {
+    long d, min_d = -1;
+    int i, c = 0;
+
+
+    for (i = 0; i < 256; i++) {
+        d = (long)(palette[i][0] - r) * (palette[i][0] - r) +
+            (long)(palette[i][1] - g) * (palette[i][1] - g) +
+            (long)(palette[i][2] - b) * (palette[i][2] - b);
+
+        if (min_d < 0 || d < min_d) {
+            min_d = d;
+            c = i;
+        }
+    }
+
+    return c;
+}
+
+
+/* the bitmap is the memory bm or (if bm==NULL) some new memory. */
+struct ws_bitmap *ws_createbitmap(int xsize, int ysize, char *bm) {
+    struct ws_bitmap *bmap;
+    struct hl_bitmap *hb;
+
+
+    if (xsize < 0 || ysize < 0) {
+        return NULL;
+    }
+
+    if ( ( bmap = MALLOC( sizeof(struct ws_bitmap) ) ) == NULL ) {
+        return NULL;
+    }
+
+    if ( ( hb = MALLOC( sizeof(struct hl_bitmap) ) ) == NULL ) {
+        FREE(bmap);
+        return NULL;
+    }
+
+    hb->own = (bm == NULL);
+
+    if (bm == NULL) {
+        if ( ( bm = MALLOC(xsize * ysize + 1) ) == NULL ) {
+            FREE(hb);
+            FREE(bmap);
+            return NULL;
+        }
+
+        memset(bm, notes.colindex[cv_winfill], xsize * ysize);
+    }
+
+    hb->data = bm;
+    bmap->bitmap = hb;
+    bmap->xpos = 0;
+    bmap->ypos = 0;
+    bmap->xsize = xsize;
+    bmap->ysize = ysize;
+    bmap->w = NULL;
+    return bmap;
+}
+
+
+char *ws_getbitmapdata(struct ws_bitmap *b) {
+    return ( (struct hl_bitmap *)b->bitmap )->data;
+}
+
+
+void ws_clearbitmap(struct ws_bitmap *b, int c) {
+    memset(ws_getbitmapdata(b), c, b->xsize * b->ysize);
+}
+
+
+/* only between bitmaps, the screen is not saved */
+void ws_copybitmap(struct ws_bitmap *dst, int x1, int y1,
+                   struct ws_bitmap *src, int xpos, int ypos, int xsize,
+                   int ysize,
+                   int withbg)
+{
+    char *s, *d;
+    int x, y;
+
+
+    if (dst == NULL || src == NULL) {
+        return;
+    }
+
+    for (y = 0; y < ysize; y++) {
+        s = ws_getbitmapdata(src) + (ypos + y) * src->xsize + xpos;
+        d = ws_getbitmapdata(dst) + (y1 + y) * dst->xsize + x1;
+
+        if (withbg) {
+            memcpy(d, s, xsize);
+        }
+        else {
+            for (x = 0; x < xsize; x++) {
+                if (s[x] != notes.colindex[cv_winfill]) {
+                    d[x] = s[x];
+                }
+            }
+        }
+    }
+}
+
+
+struct ws_bitmap *ws_savebitmap(struct ws_bitmap *bm, int x1, int y1,
+                                int xsize,
+                                int ysize)
+{
+    struct ws_bitmap *bmap;
+
+
+    if (xsize < 0 || ysize < 0 || y1 < 0 || x1 < 0) {
+        return NULL;
+    }
+
+    checkmem( bmap = ws_createbitmap(xsize, ysize, NULL) );
+    ws_copybitmap(bmap, 0, 0, bm, x1, y1, xsize, ysize, 1);
+    bmap->xpos = x1;
+    bmap->ypos = y1;
+    return bmap;
+}
+
+
+void ws_freebitmap(struct ws_bitmap *bm) {
+    struct hl_bitmap *hb;
+
+
+    my_assert(bm);
+
+    if ( ( hb = bm->bitmap ) != NULL ) {
+        if (hb->own) {
+            FREE(hb->data);
+        }
+
+        FREE(hb);
+    }
+
+    free(bm);
+}
+
+
+void ws_restorebitmap(struct ws_bitmap *bm) {
+    my_assert(bm != NULL && bm->bitmap != NULL);
+    ws_freebitmap(bm);
+}
+
+
+void ws_drawline(int x1, int y1, int x2, int y2, int c, int xor) {
+}
+
+
+void ws_drawcircle(int x, int y, int r, int c, int xor) {
+}
+
+
+void ws_bmdrawline(struct ws_bitmap *bm, int x1, int y1, int x2, int y2,
+                   int c,
+                   int xor)
+{
+}
+
+
+void ws_drawbox(int x1, int y1, int xsize, int ysize, int c, int xor) {
+}
+
+
+void ws_drawfilledbox(int x1, int y1, int xsize, int ysize, int c, int xor) {
+}
+
+
+void ws_drawframedbox(int x, int y, int xs, int ys, int w, int ltc, int rbc,
+                      int inc) {
+}
+
+
+void ws_setclipping(int x1, int y1, int x2, int y2) {
+}
+
+
+int ws_pixstrlen(const char *txt) {
+    return txt == NULL ? 0 : strlen(txt) * CHAR_WIDTH;
+}
+
+
+int ws_charstrlen(int w) {
+    return w / CHAR_WIDTH;
+}
+
+
+void ws_drawtext(int x, int y, int w, const char *txt, int fg, int bg) {
+}
+
+
+void ws_bmdrawtext(struct ws_bitmap *bm, int x, int y, int w, const char *txt,
+                   GrColor fg,
+                   GrColor bg)
+{
+}
+
+
+void ws_textmode(void) {
+}
+
+
+/* there are no events. If wait>0 this would wait forever, so it's
+   treated as an error. */
+int ws_getevent(struct ws_event *se, int wait) {
+    my_assert(wait <= 0);
+    se->flags = ws_f_none;
+    se->x = se->y = 0;
+    se->buttons = ws_bt_none;
+    se->key = 0;
+    se->kbstat = 0;
+    return 0;
+}
+
+
+void ws_drawpatternedbox(int x1, int y1, int xsize, int ysize, int c) {
+}
+
+
+void ws_erasemouse(void) {
+}
+
+
+void ws_displaymouse(void) {
+}
+
+
+void ws_mousewarp(int x, int y) {
+}
+
+
+void ws_setdriver(const char *name) {
+}
+
+
+ws_cursor *ws_initcursor(char *data, int w, int h, int xo, int yo,
+                         GrColorTableP colortable)
+{
+    return NULL;
+}
+
+
+void ws_changecursor(ws_cursor *cursor) {
+}
+
+
+void ws_killcursor(ws_cursor *cursor) {
+}
+
+
+GrKeyType ws_waitforkey(void) {
+    return 0;
+}
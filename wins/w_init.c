@@ -1286,7 +1286,7 @@ void w_resizeinwin(struct w_window *w, int x, int y) {
     for (n = wi->buttonlist.head, b = NULL;
          n->next != NULL && n->d.w_b->sys_button;
          n = n->next) {
-        if ( (int)n->d.w_b->b.data == 1 ) {
+        if ( (long)n->d.w_b->b.data == 1 ) {
             b = &n->d.w_b->b;
             break;
         }
@@ -1433,7 +1433,7 @@ void w_readcfg(FILE *f) {
 
             for (n2 = n->d.w_w->buttonlist.head, b = NULL; n2->next != NULL
                 && n2->d.w_b->sys_button; n2 = n2->next) {
-                if ( (int)n2->d.w_b->b.data == 1 ) {
+                if ( (long)n2->d.w_b->b.data == 1 ) {
                     b = n2->d.w_b;
                     break;
                 }
@@ -28,6 +28,55 @@ void initlist(struct list *l) {
     l->head = (struct node *)&l->dummy;
     l->tail = (struct node *)&l->head;
     l->size = l->maxnum = 0;
+    l->index = NULL;
+    l->indexsize = 0;
+    l->ordered = 0;
+    l->pool = NULL;
+}
+
+
+/* make room for number no in the index of l. returns 0 if no mem. */
+static int growindex(struct list *l, int no) {
+    struct node **index;
+    int size;
+
+
+    if (no < l->indexsize) {
+        return 1;
+    }
+
+    size = l->indexsize * 2 > no + 1 ? l->indexsize * 2 : no + 1;
+
+    if (size < 64) {
+        size = 64;
+    }
+
+    if ( ( index = REALLOC( l->index, sizeof(struct node *) * size ) ) ==
+        NULL ) {
+        return 0;
+    }
+
+    memset( index + l->indexsize, 0, sizeof(struct node *) *
+           (size - l->indexsize) );
+    l->index = index;
+    l->indexsize = size;
+    return 1;
+}
+
+
+/* enter n in the index of l. if there's no mem for the index, the index
+   is dropped and findnode falls back to searching the list. */
+static void indexnode(struct list *l, struct node *n) {
+    if (l->index == NULL || n->no < 0) {
+        return;
+    }
+
+    if ( !growindex(l, n->no) ) {
+        unindexlist(l);
+        return;
+    }
+
+    l->index[n->no] = n;
 }
 
 
@@ -36,7 +85,7 @@ struct node *insertnode(struct list *l, struct node *nprev, int no,
     struct node *n;
 
 
-    if ( ( n = MALLOC( sizeof(struct node) ) ) == NULL ) {
+    if ( ( n = w_poolalloc( l->pool, sizeof(struct node) ) ) == NULL ) {
         return NULL;
     }
 
@@ -45,6 +94,10 @@ struct node *insertnode(struct list *l, struct node *nprev, int no,
     n->prev = nprev;
     n->no = (no == -1 ? l->maxnum : no);
 
+    if (nprev != l->tail || n->no != l->maxnum) {
+        l->ordered = -1;
+    }
+
     if (n->no >= l->maxnum) {
         l->maxnum = n->no + 1;
     }
@@ -52,6 +105,7 @@ struct node *insertnode(struct list *l, struct node *nprev, int no,
     nprev->next->prev = n;
     nprev->next = n;
     l->size++;
+    indexnode(l, n);
     return n;
 }
 
@@ -70,6 +124,10 @@ struct node *findnode(struct list *l, int no) {
     struct node *n;
 
 
+    if (l->index != NULL) {
+        return no >= 0 && no < l->indexsize ? l->index[no] : NULL;
+    }
+
     for (n = l->head; n->next != NULL; n = n->next) {
         if (n->no == no) {
             return n;
@@ -93,6 +151,11 @@ void copylisthead(struct list *d, struct list *s) {
         d->head->prev = (struct node *)&d->head;
         d->tail->next = (struct node *)&d->dummy;
     }
+
+    d->pool = s->pool;
+    d->index = s->index;
+    d->indexsize = s->indexsize;
+    d->ordered = s->ordered;
 }
 
 
@@ -100,6 +163,12 @@ void unlistnode(struct list *l, struct node *n) {
     n->prev->next = n->next;
     n->next->prev = n->prev;
     l->size--;
+    l->ordered = -1;
+
+    if (l->index != NULL && n->no >= 0 && n->no < l->indexsize &&
+        l->index[n->no] == n) {
+        l->index[n->no] = NULL;
+    }
 }
 
 
@@ -110,12 +179,35 @@ void listnode_tail(struct list *l, struct node *n) {
     n->next->prev = n;
     n->no = l->maxnum++;
     l->size++;
+    indexnode(l, n);
+}
+
+
+/* put n, which is in no list, at the end of l without changing its
+   number. */
+void linknode_tail(struct list *l, struct node *n) {
+    n->prev = l->tail;
+    n->next = l->tail->next;
+    n->prev->next = n;
+    n->next->prev = n;
+    l->size++;
+    l->ordered = -1;
+    indexnode(l, n);
+}
+
+
+/* move n, which is in l, to the end of l without changing its number. */
+void movenode_tail(struct list *l, struct node *n) {
+    if (n != l->tail) {
+        unlistnode(l, n);
+        linknode_tail(l, n);
+    }
 }
 
 
 void killnode(struct list *l, struct node *n) {
     unlistnode(l, n);
-    free(n);
+    POOLFREE(n);
 }
 
 
@@ -124,11 +216,165 @@ void killlist(struct list *l) {
 
 
     for (n = l->head->next; n != NULL; n = n->next) {
-        free(n->prev);
+        w_poolfree(n->prev);
     }
 
     l->size = 0;
     l->maxnum = 0;
+    l->ordered = 0;
+    unindexlist(l);
+}
+
+
+/* Keep an index from the node numbers to the nodes, so findnode doesn't
+   have to search the list. The numbers in an indexed list must be unique.
+   The index is (re)built from the current numbers, so call this again
+   after changing them by hand. Returns 0 if there's no mem for the index
+   (findnode then searches the list as usual). */
+int indexlist(struct list *l) {
+    struct node *n;
+
+
+    if ( !growindex(l, l->maxnum) ) {
+        unindexlist(l);
+        return 0;
+    }
+
+    memset( l->index, 0, sizeof(struct node *) * l->indexsize );
+
+    /* backwards, so the first of two equal numbers wins like in findnode */
+    for (n = l->tail; n->prev != NULL; n = n->prev) {
+        if (n->no >= 0 && n->no < l->indexsize) {
+            l->index[n->no] = n;
+        }
+    }
+
+    return 1;
 }
 
 
+void unindexlist(struct list *l) {
+    if (l->index != NULL) {
+        FREE(l->index);
+    }
+
+    l->indexsize = 0;
+}
+
+
+
+
+/* Pools for the many small structs of a level. They are allocated in
+   chunks of perchunk blocks and only given back all together with
+   w_killpool. */
+struct w_pool *w_newpool(size_t size, int perchunk) {
+    struct w_pool *p;
+
+
+    if ( ( p = MALLOC( sizeof(struct w_pool) ) ) == NULL ) {
+        return NULL;
+    }
+
+    p->size = sizeof(union w_poolblock) + (size + sizeof(union w_poolblock) -
+                                           1) / sizeof(union w_poolblock) *
+              sizeof(union w_poolblock);
+    p->perchunk = perchunk;
+    p->used = p->dead = 0;
+    p->free = p->chunks = NULL;
+    return p;
+}
+
+
+static void releasepool(struct w_pool *p) {
+    union w_poolblock *c;
+
+
+    while (p->chunks != NULL) {
+        c = p->chunks;
+        p->chunks = c->next;
+        free(c);
+    }
+
+    free(p);
+}
+
+
+/* allocate size bytes from p. if p is NULL or the blocks of p are too
+   small, the block is allocated on its own. */
+void *w_poolalloc(struct w_pool *p, size_t size) {
+    union w_poolblock *b, *c;
+    int i;
+
+
+    if ( p == NULL || size > p->size - sizeof(union w_poolblock) ) {
+        if ( ( b = MALLOC(sizeof(union w_poolblock) + size) ) == NULL ) {
+            return NULL;
+        }
+
+        b->pool = NULL;
+        return b + 1;
+    }
+
+    if (p->free == NULL) {
+        if ( ( c = MALLOC(sizeof(union w_poolblock) + p->size *
+                          p->perchunk) ) == NULL ) {
+            return NULL;
+        }
+
+        c->next = p->chunks;
+        p->chunks = c;
+
+        for (i = 0; i < p->perchunk; i++) {
+            b = (union w_poolblock *)( (char *)(c + 1) + p->size * i );
+            b->next = p->free;
+            p->free = b;
+        }
+    }
+
+    b = p->free;
+    p->free = b->next;
+    b->pool = p;
+    p->used++;
+    return b + 1;
+}
+
+
+void w_poolfree(void *d) {
+    union w_poolblock *b = d;
+    struct w_pool *p;
+
+
+    if (d == NULL) {
+        return;
+    }
+
+    b--;
+
+    if ( ( p = b->pool ) == NULL ) {
+        free(b);
+        return;
+    }
+
+    b->next = p->free;
+    p->free = b;
+
+    if (--p->used == 0 && p->dead) {
+        releasepool(p);
+    }
+}
+
+
+/* give back the memory of p. if there are still blocks in use, this is
+   done when the last of them is freed. */
+void w_killpool(struct w_pool *p) {
+    if (p == NULL) {
+        return;
+    }
+
+    if (p->used == 0) {
+        releasepool(p);
+    }
+    else {
+        p->dead = 1;
+    }
+}
@@ -38,9 +38,30 @@
             void *v;
         } d;
     };
+    /* pool of fixed size blocks. every block has a header which says
+       where it belongs to, so blocks from a pool and blocks allocated
+       without one (pool NULL) can both be freed with w_poolfree. */
+    union w_poolblock {
+        struct w_pool *pool;
+        union w_poolblock *next;
+        double align_d;
+        long align_l;
+    };
+    struct w_pool {
+        size_t size; /* size of a block with header */
+        int perchunk, used, dead;
+        union w_poolblock *free, *chunks;
+    };
+    #define POOLFREE(b) (w_poolfree(b), b = NULL)
     struct list {
         struct node *head, *dummy, *tail;
         int size, maxnum;
+        struct w_pool *pool; /* nodes are allocated from here */
+        /* optional number index (see indexlist). ordered is the start
+           number if the nodes are numbered consecutively in list order,
+           otherwise -1. */
+        struct node **index;
+        int indexsize, ordered;
     };
 
     void initlist(struct list *l);
@@ -54,6 +75,14 @@
     void listnode_tail(struct list *l, struct node *n);
     void killnode(struct list *l, struct node *n);
     void killlist(struct list *l);
+    int indexlist(struct list *l);
+    void unindexlist(struct list *l);
+    void linknode_tail(struct list *l, struct node *n);
+    void movenode_tail(struct list *l, struct node *n);
+    struct w_pool *w_newpool(size_t size, int perchunk);
+    void *w_poolalloc(struct w_pool *p, size_t size);
+    void w_poolfree(void *d);
+    void w_killpool(struct w_pool *p);
 
 
 #endif
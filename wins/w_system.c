@@ -29,6 +29,7 @@
 #include <dirent.h>
 #include "linux.h"
 
+#ifndef HEADLESS /* the display routines without display are in w_headless.c */
 #define DEFAULT_FONT "wins.fnt"
 
 struct ws_internals {
@@ -114,6 +115,12 @@ void ws_getcolor(int i, int *r, int *g, int *b) {
 }
 
 
+/* Return the color with the selected red, green and blue components. */
+GrColor ws_makecolor(int r, int g, int b) {
+    return GrAllocColor(r, g, b);
+}
+
+
 /* Create bitmap with bm inside. */
 struct ws_bitmap *ws_createbitmap(int xsize, int ysize, char *bm) {
     GrContext *gc;
@@ -488,6 +495,9 @@ int ws_getevent(struct ws_event *se, int wait) {
 }
 
 
+#endif
+
+
 /* gives all filenames at 'path' with extension(s) 'ext' (the extensions
    must be seperated with a '.'). In numfiles is the number
    of files found returned. If numfiles==0 no file found, numfiles==-1 path
@@ -650,6 +660,7 @@ void ws_disablectrlc(void) {
 }
 
 
+#ifndef HEADLESS
 /* Plot a dot-non-dot-non filled Box */
 void ws_drawpatternedbox(int x1, int y1, int xsize, int ysize, int c) {
     int x, y, m;
@@ -727,5 +738,4 @@ void ws_killcursor(ws_cursor *cursor) {
 GrKeyType ws_waitforkey() {
     return GrKeyRead();
 }
-
-
+#endif
@@ -6,8 +6,15 @@
 #ifndef W_SYSTEM
 #define W_SYSTEM
 
+#ifdef HEADLESS
+/* no display, see w_headless.c. Only the types of GRX are needed. */
+typedef int GrColor;
+typedef GrColor *GrColorTableP;
+typedef int GrKeyType;
+#else
 #include <grx20.h>
 #include <grxkeys.h>
+#endif
 /* Some constants you must modify: */
 /* quite clear: */
 #define SYS_COMPILER_NAME "GNU-C 2.7.1 with libgrx 2.00beta"
@@ -54,6 +61,7 @@
     void ws_killcursor(ws_cursor *cursor);
     void ws_setcolor(int i, int r, int g, int b);
     void ws_getcolor(int i, int *r, int *g, int *b);
+    GrColor ws_makecolor(int r, int g, int b);
     struct ws_bitmap *ws_createbitmap(int xsize, int ysize, char *bm);
     char *ws_getbitmapdata(struct ws_bitmap *b);
     void ws_copybitmap(struct ws_bitmap *dst, int x1, int y1,
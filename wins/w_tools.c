@@ -140,7 +140,7 @@ char *w_copystr(const char *str) {
 
 /* Return the GrColor with the selected red, green and blue components. */
 GrColor w_makecolor(int r, int g, int b) {
-    return GrAllocColor(r, g, b);
+    return ws_makecolor(r, g, b);
 }
 
 
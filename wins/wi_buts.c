@@ -97,7 +97,7 @@ int wi_drawbutton(struct wi_button *b, int highlighted) {
     struct node *n;
     const char **s;
     char buffer[1024];
-    int xp, yp, xs, ys, i, x, y, columns, colwidth, collength;
+    int xp, yp, xs, ys, i, x, y, colwidth, collength;
 
 
     my_assert(b != NULL && b->b.w != NULL);
@@ -238,8 +238,8 @@ int wi_drawbutton(struct wi_button *b, int highlighted) {
             }
 
             if (highlighted == 1) {
-                columns = wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength,
-                                          &colwidth);
+                wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength,
+                                &colwidth);
                 checkmem( b->bm = ws_savebitmap(NULL, xp, yp, xs, ys) );
                 ws_drawframedbox(xp, yp, xs, ys, 2,
                                  notes.colindex[cv_buttonlt],
@@ -299,8 +299,8 @@ int wi_drawbutton(struct wi_button *b, int highlighted) {
                              notes.colindex[cv_buttonin]);
 
             if (highlighted == 2) {
-                columns = wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength,
-                                          &colwidth);
+                wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength,
+                                &colwidth);
 
                 if (b->bm == NULL) {
                     checkmem( b->bm = ws_savebitmap(NULL, xp, yp, xs, ys) );
@@ -708,7 +708,7 @@ int wi_b_drag(struct ws_event *ws, struct wi_button *b) {
 
 
 int wi_b_choose(struct ws_event *ws, struct wi_button *b) {
-    int i, oldi, xp, yp, xs, ys, cxs, collength, columns, oldx, oldy;
+    int i, oldi, xp, yp, xs, ys, cxs, collength, oldx, oldy;
 
 
     my_assert(b->b.d.d != NULL)
@@ -718,7 +718,7 @@ int wi_b_choose(struct ws_event *ws, struct wi_button *b) {
     }
 
     wi_drawbutton(b, 1);
-    columns = wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength, &cxs);
+    wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength, &cxs);
     oldi = -1;
     oldx = oldy = 0;
     i = b->b.d.ls->selected;
@@ -792,8 +792,7 @@ int wi_b_choose(struct ws_event *ws, struct wi_button *b) {
 
 
 int wi_b_tag(struct ws_event *ws, struct wi_button *b) {
-    int pos, oldpos, leftright, xp, yp, xs, ys, num_selected, cxs, collength,
-        cols;
+    int pos, oldpos, leftright, xp, yp, xs, ys, num_selected, cxs, collength;
 
 
     my_assert(b->b.d.d != NULL)
@@ -824,7 +823,7 @@ int wi_b_tag(struct ws_event *ws, struct wi_button *b) {
         }
     }
 
-    cols = wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength, &cxs);
+    wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength, &cxs);
     wi_drawbutton(b, 2);
     oldpos = -1;
 
@@ -978,7 +977,7 @@ int wi_handlestringbutton(struct ws_event *ws, struct wi_button *b, int p,
     char buffer[256], *oldstr;
 
 
-    memset(buffer, 256, 0);
+    memset(buffer, 0, 256);
     strncpy(buffer, b->b.d.str->str, 254);
     oldstr = b->b.d.str->str;
     b->b.d.str->str = buffer;
@@ -7,8 +7,8 @@ int wi_drawbutton(struct wi_button *b, int highlighted);
 void wi_undrawbutton(struct wi_button *b);
 
 
-int(*wi_buttonhandling[w_b_number]) (struct ws_event *ws,
-                                     struct wi_button *b);
+extern int(*wi_buttonhandling[w_b_number]) (struct ws_event *ws,
+                                            struct wi_button *b);
 void wi_changecurbutton(struct node *n);
 int wi_handlestringbutton(struct ws_event *ws, struct wi_button *b, int p,
                           int leftright);
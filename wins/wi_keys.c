@@ -186,8 +186,8 @@ int wi_bk_choose(struct ws_event *ws, struct wi_button *b) {
 
 
 int wi_bk_tag(struct ws_event *ws, struct wi_button *b) {
-    int pos, leftright, xp, yp, xs, ys, num_selected, end = 0, cols,
-        collength, cxs;
+    int pos, leftright, xp, yp, xs, ys, num_selected, end = 0, collength,
+        cxs;
 
 
     my_assert(b->b.d.d != NULL)
@@ -200,7 +200,7 @@ int wi_bk_tag(struct ws_event *ws, struct wi_button *b) {
         }
     }
 
-    cols = wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength, &cxs);
+    wi_choosecoords(b, &xp, &yp, &xs, &ys, &collength, &cxs);
     wi_drawbutton(b, 2);
     pos = 0;
 